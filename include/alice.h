@@ -27,6 +27,13 @@
 
 #define ALICE_ERROR(msg, ...) sys_error("ERROR: " msg "\n", ##__VA_ARGS__)
 
+/* jobs.c */
+void alice_notice(const char *fmt, ...);
+
+// NOTICE output from parallel jobs is kept in order (see alice/jobs.h)
+#undef NOTICE
+#define NOTICE(fmt, ...) alice_notice(fmt "\n", ##__VA_ARGS__)
+
 /* conv.c */
 void set_input_encoding(const char *enc);
 void set_output_encoding(const char *enc);
@@ -66,6 +73,7 @@ UDIR *checked_opendir(const char *path);
 void checked_stat(const char *path, ustat *s);
 void mkdir_for_file(const char *filename);
 void chdir_to_file(const char *filename);
+char *path_dirname_r(const char *path);
 struct string *replace_extension(const char *file, const char *ext);
 struct string *string_path_join(const struct string *dir, const char *rest);
 bool parse_version(const char *str, int *major, int *minor);
@@ -162,6 +162,10 @@ void ar_extract_all(struct archive *ar, const char *output_file, uint32_t flags)
 void ar_extract_file(struct archive *ar, char *file_name, char *output_file, uint32_t flags);
 void ar_extract_index(struct archive *ar, int file_index, char *output_file, uint32_t flags);
 
+// thumbnail.c
+void ar_thumbnail_all(struct archive *ar, const char *output_dir, int size);
+void ar_contact_sheet(struct archive *ar, const char *output_file, int size, int columns);
+
 // open.c
 struct archive *open_archive(const char *path, enum archive_type *type, int *error);
 struct archive *open_ald_archive(const char *path, int *error, char *(*conv)(const char*));
@@ -0,0 +1,43 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+
+#ifndef ALICE_CG_CACHE_H_
+#define ALICE_CG_CACHE_H_
+
+/*
+ * Thread-safe cache of decoded CGs, keyed by path. Used to share a decoded
+ * base CG between jobs which encode DCF diffs against it.
+ *
+ * Every cg_cache_get must be paired with a cg_cache_release. A CG is
+ * decoded on first use and freed when it has no users and no outstanding
+ * reservations; cg_cache_reserve announces a future cg_cache_get, so that
+ * a CG shared by many jobs is decoded only once. A reservation which won't
+ * be followed by a cg_cache_get must be withdrawn with cg_cache_unreserve.
+ * The returned CG must be treated as read-only.
+ */
+
+struct cg;
+struct cg_cache;
+
+struct cg_cache *cg_cache_new(void);
+void cg_cache_free(struct cg_cache *cache);
+void cg_cache_reserve(struct cg_cache *cache, const char *path);
+void cg_cache_unreserve(struct cg_cache *cache, const char *path);
+struct cg *cg_cache_get(struct cg_cache *cache, const char *path);
+void cg_cache_release(struct cg_cache *cache, const char *path);
+
+#endif /* ALICE_CG_CACHE_H_ */
@@ -17,29 +17,156 @@
 #ifndef ALICE_EX_H
 #define ALICE_EX_H
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 
 struct ex;
+struct ex_block;
 struct ex_value;
 struct ex_table;
 struct ex_list;
 struct ex_tree;
+struct ex_reader;
+struct ex_reader_index;
+struct ex_index;
+struct ex_tree_index;
+struct ex_columns;
+struct ex_field;
 struct port;
+struct buffer;
 struct string;
 
+struct ex *ex_parse(FILE *in, const char *basepath);
 struct ex *ex_parse_file(const char *path);
 void ex_write(FILE *out, struct ex *ex);
+void ex_write_columns(struct buffer *out, struct ex_columns *c);
 uint8_t *ex_write_mem(struct ex *ex, size_t *size_out);
 void ex_write_file(const char *path, struct ex *ex);
+void ex_write_block(struct buffer *out, struct ex_block *blk);
+size_t ex_flatten_begin(struct buffer *out);
+uint8_t *ex_flatten_end(struct buffer *out, size_t data_loc, uint32_t nr_blocks,
+		size_t *size_out);
+void ex_write_flat(FILE *out, uint8_t *flat, size_t size);
 
 void ex_dump_value(struct port *port, struct ex_value *val);
 void ex_dump_key_value(struct port *port, struct string *key, struct ex_value *val);
 void ex_dump_table(struct port *port, struct ex_table *table);
+void ex_dump_columns(struct port *port, struct ex_columns *c);
 void ex_dump_table_row(struct port *port, struct ex_table *table, int row);
 void ex_dump_list(struct port *port, struct ex_list *list);
 void ex_dump_tree(struct port *port, struct ex_tree *tree);
 void ex_dump(struct port *port, struct ex *ex);
-void ex_dump_split(FILE *out, struct ex *ex, const char *dir);
+void ex_dump_reader(struct port *port, struct ex_reader *r);
+void ex_dump_reader_block(struct port *port, struct ex_reader *r, uint32_t i);
+void ex_dump_split(FILE *out, struct ex_reader *r, const char *dir);
+
+struct ex_index *ex_index_new(struct ex *ex);
+void ex_index_free(struct ex_index *index);
+int32_t ex_index_get_int(struct ex_index *index, const char *name, int32_t dflt);
+struct string *ex_index_get_string(struct ex_index *index, const char *name);
+struct ex_table *ex_index_get_table(struct ex_index *index, const char *name);
+struct ex_tree_index *ex_tree_index_new(void);
+void ex_tree_index_free(struct ex_tree_index *index);
+struct ex_tree *ex_tree_index_child(struct ex_tree_index *index, struct ex_tree *tree,
+		const char *name);
+
+/*
+ * Columnar table (see core/ex/columns.c).
+ */
+struct ex_column {
+	uint32_t type; // EX_INT, EX_FLOAT or EX_STRING
+	union {
+		int32_t *i;
+		float *f;
+		uint32_t *s; // offsets into heap
+	};
+};
+
+struct ex_columns {
+	uint32_t nr_fields;
+	struct ex_field *fields; // not owned
+	uint32_t nr_columns;
+	uint32_t nr_rows;
+	struct ex_column *columns;
+	char *heap;
+	size_t heap_size;
+	size_t heap_cap;
+};
+
+struct ex_columns *ex_columns_new(struct ex_field *fields, uint32_t nr_fields,
+		uint32_t nr_columns, uint32_t nr_rows);
+void ex_columns_free(struct ex_columns *c);
+uint32_t ex_columns_add_string(struct ex_columns *c, const char *s, size_t len);
+
+static inline int32_t ex_columns_int(struct ex_columns *c, uint32_t row, uint32_t col)
+{
+	return c->columns[col].i[row];
+}
+
+static inline float ex_columns_float(struct ex_columns *c, uint32_t row, uint32_t col)
+{
+	return c->columns[col].f[row];
+}
+
+static inline const char *ex_columns_string(struct ex_columns *c, uint32_t row, uint32_t col)
+{
+	return c->heap + c->columns[col].s[row];
+}
+
+struct ex_reader_block {
+	uint32_t type;
+	const char *name; // not NUL-terminated
+	size_t name_len;
+	size_t off;       // offset of block data (name + value)
+	size_t size;
+	struct ex_block *block; // decoded block (or NULL)
+	struct ex_table *header;     // fields of a columnar table (no rows)
+	struct ex_columns *columns;  // columnar table (or NULL)
+};
+
+struct ex_reader {
+	uint8_t *data; // decompressed block data
+	size_t size;
+	uint32_t nr_blocks;
+	struct ex_reader_block *blocks;
+	struct string *(*conv)(const char*,size_t);
+	struct ex_reader_index *index;
+};
+
+struct ex_reader *ex_reader_open(const char *path);
+struct ex_reader *ex_reader_open_conv(const char *path, struct string*(*conv)(const char*,size_t));
+struct ex_reader *ex_reader_open_mem(const uint8_t *data, size_t size);
+void ex_reader_close(struct ex_reader *r);
+int ex_reader_find(struct ex_reader *r, const char *name);
+struct ex_block *ex_reader_block(struct ex_reader *r, uint32_t i);
+void ex_reader_release(struct ex_reader *r, uint32_t i);
+struct ex_value *ex_reader_get(struct ex_reader *r, const char *name);
+int32_t ex_reader_get_int(struct ex_reader *r, const char *name, int32_t dflt);
+float ex_reader_get_float(struct ex_reader *r, const char *name, float dflt);
+const char *ex_reader_get_string(struct ex_reader *r, const char *name, size_t *len);
+struct ex_table *ex_reader_get_table(struct ex_reader *r, const char *name);
+struct ex_list *ex_reader_get_list(struct ex_reader *r, const char *name);
+struct ex_tree *ex_reader_get_tree(struct ex_reader *r, const char *name);
+struct ex *ex_reader_to_ex(struct ex_reader *r);
+struct ex_columns *ex_reader_columns(struct ex_reader *r, uint32_t i);
+
+bool ex_value_equal(struct ex_value *a, struct ex_value *b);
+bool ex_value_equal_approx(struct ex_value *a, struct ex_value *b, float epsilon);
+void ex_diff(struct port *port, struct ex_reader *a, struct ex_reader *b);
+void ex_patch(struct ex *base, struct ex *patch);
+
+#define EX_DELETE_BLOCK "__delete__"
+
+enum ex_edit_mode {
+	EX_EDIT_APPEND,
+	EX_EDIT_REPLACE,
+	EX_EDIT_PATCH,
+};
+
+void ex_edit(struct ex *base, struct ex *edit, enum ex_edit_mode mode);
+uint8_t *ex_splice(struct ex_reader *base, struct ex *edit, enum ex_edit_mode mode,
+		size_t *size_out);
 
 #endif /* ALICE_EX_H */
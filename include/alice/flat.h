@@ -20,9 +20,18 @@
 #include <stdbool.h>
 
 struct flat;
+struct flat_manifest;
 struct string;
 
+struct flat_manifest *flat_read_manifest(const char *xpath);
+struct flat *flat_load_manifest(struct flat_manifest *mf);
+struct string *flat_manifest_output_path(struct flat_manifest *mf);
+void flat_manifest_free(struct flat_manifest *mf);
 struct flat *flat_build(const char *xpath, struct string **output_path);
+
+bool flat_deps_up_to_date(const char *deps_path);
+void flat_write_deps(struct flat_manifest *mf, const char *deps_path, const char *output_path);
+
 void flat_extract(struct flat *flat, const char *output_file, bool png);
 
 #endif /* ALICE_FLAT_H */
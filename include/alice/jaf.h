@@ -19,6 +19,7 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include "system4.h"
 #include "system4/ain.h"
@@ -621,6 +622,7 @@ struct jaf_block_item *jaf_rassign(struct jaf_expression *lhs, struct jaf_expres
 struct jaf_block_item *jaf_assert(struct jaf_expression *expr, int line, const char *file);
 struct jaf_expression *jaf_copy_expression(struct jaf_expression *e);
 void jaf_free_expr(struct jaf_expression *expr);
+void jaf_free_block_item(struct jaf_block_item *item);
 void jaf_free_block(struct jaf_block *block);
 
 // jaf_parser.y
@@ -629,11 +631,18 @@ extern struct jaf_block *jaf_toplevel;
 struct jaf_block *jaf_parse(struct ain *ain, const char **files, unsigned nr_files);
 
 // jaf_compile.c
-void jaf_build(struct ain *out, const char **files, unsigned nr_files, const char **headers, unsigned nr_headers);
+enum {
+	JAF_OPTIMIZE = 1, // fold constant branches and remove unreachable code
+};
+void jaf_build(struct ain *out, const char **files, unsigned nr_files, const char **headers,
+		unsigned nr_headers, uint32_t flags);
 
 // jaf_eval.c
 struct jaf_expression *jaf_simplify(struct jaf_expression *in);
 
+// jaf_optimize.c
+void jaf_optimize(struct ain *ain, struct jaf_block *block);
+
 // jaf_types.c
 void jaf_type_check_expression(struct jaf_env *env, struct jaf_expression *expr);
 void jaf_type_check_statement(struct jaf_env *env, struct jaf_block_item *stmt);
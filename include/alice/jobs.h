@@ -0,0 +1,55 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+#ifndef ALICE_JOBS_H_
+#define ALICE_JOBS_H_
+
+#include <stdbool.h>
+
+/*
+ * Job scheduler backed by a global thread pool.
+ *
+ * Jobs are added to a group, optionally with dependencies on other jobs in
+ * the same group, and then the group is run to completion. Groups may be
+ * nested: a job may create and run its own group, which shares the same
+ * threads (a thread waiting on a group executes queued jobs while it waits).
+ *
+ * Output written with NOTICE from within a job is buffered and written in
+ * the order that the jobs were added, so that the log of a parallel run
+ * matches the log of a sequential run. If a job fails with a fatal error, no
+ * further jobs are started and the log is written up to the failing job
+ * before exiting. Code which exits by other means than sys_error should call
+ * jobs_cancel first.
+ *
+ * If jobs_init has not been called (or was called with nr_threads <= 1),
+ * jobs are run sequentially on the calling thread.
+ */
+
+struct job;
+struct job_group;
+
+void jobs_init(unsigned nr_threads);
+void jobs_fini(void);
+unsigned jobs_nr_cpus(void);
+void jobs_cancel(void);
+bool jobs_active(void);
+
+struct job_group *job_group_new(void);
+struct job *job_group_add(struct job_group *group, void (*fn)(void*), void *data);
+void job_depends(struct job *job, struct job *dep);
+void job_group_run(struct job_group *group);
+
+#endif /* ALICE_JOBS_H_ */
@@ -0,0 +1,154 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+
+#ifndef ALICE_JSON_H_
+#define ALICE_JSON_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct port;
+
+/*
+ * Streaming JSON writer. Values are written to a port as they are emitted,
+ * without building a document in memory. Pretty-printed output is identical
+ * to cJSON_Print (and compact output to cJSON_PrintUnformatted), so the two
+ * can be used interchangeably.
+ *
+ * Inside an object, each value must be preceded by a call to json_key.
+ */
+
+struct json_level {
+	bool object;
+	bool empty;
+};
+
+struct json_writer {
+	struct port *port;
+	bool pretty;
+	unsigned depth;
+	unsigned max_depth;
+	struct json_level *levels;
+	size_t len;
+	char buf[64 * 1024];
+};
+
+void json_writer_init(struct json_writer *w, struct port *port, bool pretty);
+void json_writer_flush(struct json_writer *w);
+void json_writer_fini(struct json_writer *w);
+// free the writer without writing buffered output (which may be incomplete)
+void json_writer_discard(struct json_writer *w);
+
+void json_begin_object(struct json_writer *w);
+void json_end_object(struct json_writer *w);
+void json_begin_array(struct json_writer *w);
+void json_end_array(struct json_writer *w);
+void json_key(struct json_writer *w, const char *key);
+
+void json_string(struct json_writer *w, const char *str);
+void json_number(struct json_writer *w, double d);
+void json_int(struct json_writer *w, int64_t i);
+void json_bool(struct json_writer *w, bool b);
+void json_null(struct json_writer *w);
+void json_int_array(struct json_writer *w, const int32_t *values, int count);
+
+/*
+ * Pull parser for JSON held in memory. Tokens are read one at a time with
+ * json_next, so a document can be consumed in a single pass without building
+ * a tree. Object keys are interned against the table of names passed to
+ * json_reader_init: json_next_key yields the index of the key in that table
+ * (or -1 for keys not in the table, whose values can be skipped with
+ * json_skip). Errors are fatal and report the line of the input.
+ */
+
+enum json_token {
+	JSON_END,
+	JSON_BEGIN_OBJECT,
+	JSON_END_OBJECT,
+	JSON_BEGIN_ARRAY,
+	JSON_END_ARRAY,
+	JSON_KEY,
+	JSON_STRING,
+	JSON_NUMBER,
+	JSON_TRUE,
+	JSON_FALSE,
+	JSON_NULL,
+};
+
+struct kh_json_keys_s;
+
+struct json_reader {
+	const char *name;
+	const char *buf;
+	const char *p;
+	const char *end;
+	enum json_token token;
+	bool need_comma;
+	// open objects/arrays ('{' or '[')
+	unsigned depth;
+	unsigned max_depth;
+	char *stack;
+	// value of the current string, key or number token
+	char *str;
+	size_t str_len;
+	size_t str_cap;
+	double number;
+	// index of the most recent key
+	int key;
+	const char * const *key_names;
+	struct kh_json_keys_s *keys;
+};
+
+/*
+ * A saved reader position (see json_mark). The reader may be rewound to it
+ * until the container which was open when the mark was taken is closed.
+ */
+struct json_mark {
+	const char *p;
+	enum json_token token;
+	bool need_comma;
+	unsigned depth;
+	int key;
+};
+
+// Keys with an index of 64 or more are looked up, but not tracked in masks.
+#define JSON_MAX_TRACKED_KEYS 64
+#define JSON_KEY_BIT(key) ((key) < 0 || (key) >= JSON_MAX_TRACKED_KEYS ? 0 : UINT64_C(1) << (key))
+
+void json_reader_init(struct json_reader *r, const char *buf, size_t len, const char *name,
+		const char * const *key_names, int nr_keys);
+void json_reader_fini(struct json_reader *r);
+_Noreturn void json_error(struct json_reader *r, const char *fmt, ...);
+
+enum json_token json_next(struct json_reader *r);
+bool json_next_key(struct json_reader *r, int *key);
+void json_expect(struct json_reader *r, enum json_token token);
+void json_skip(struct json_reader *r);
+void json_mark(struct json_reader *r, struct json_mark *mark);
+void json_rewind(struct json_reader *r, const struct json_mark *mark);
+int json_count_elements(struct json_reader *r);
+void json_require(struct json_reader *r, uint64_t seen, int key);
+
+int json_int_value(struct json_reader *r);
+int json_read_int(struct json_reader *r);
+double json_read_number(struct json_reader *r);
+bool json_read_bool(struct json_reader *r);
+char *json_read_string(struct json_reader *r);
+int32_t *json_read_int_array(struct json_reader *r, int *n);
+
+#endif /* ALICE_JSON_H_ */
@@ -0,0 +1,48 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+#ifndef ALICE_PROFILE_H_
+#define ALICE_PROFILE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Lightweight span profiler. Spans are recorded between calls to
+ * profile_begin/profile_end and may be nested. Each span records wall time,
+ * CPU time, peak RSS and bytes read/written, along with any item counts
+ * attached via profile_count. Spans may be recorded from any thread (CPU time
+ * and I/O are measured per thread, peak RSS for the whole process). When
+ * profiling is not enabled these functions do nothing.
+ */
+
+extern bool profile_enabled;
+
+void profile_enable(void);
+void profile_begin(const char *fmt, ...);
+void profile_end(void);
+void profile_count(const char *name, uint64_t n);
+size_t profile_parent(void);
+void profile_push_parent(size_t parent);
+void profile_pop_parent(void);
+void profile_write_json(FILE *out);
+void profile_write_chrome_trace(FILE *out);
+void profile_print_summary(FILE *out);
+void profile_fini(void);
+
+#endif /* ALICE_PROFILE_H_ */
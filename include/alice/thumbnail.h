@@ -0,0 +1,35 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+
+#ifndef ALICE_THUMBNAIL_H_
+#define ALICE_THUMBNAIL_H_
+
+#include <stdbool.h>
+
+struct cg;
+struct string;
+
+/* scale.c */
+struct cg *scale_cg_bicubic(struct cg *in, float scale);
+
+/* thumbnail.c */
+struct cg *thumbnail_scale(struct cg *in, int size, bool upscale);
+struct string *thumbnail_default_cache_dir(void);
+int thumbnail_cache_size(int size);
+struct string *thumbnail_cache_file(const struct string *cache_dir, const char *path, int size);
+
+#endif /* ALICE_THUMBNAIL_H_ */
@@ -28,6 +28,7 @@
 #include "alice.h"
 #include "alice/jaf.h"
 #include "alice/ain.h"
+#include "alice/profile.h"
 #include "alice/project.h"
 #include "cli.h"
 
@@ -45,6 +46,8 @@ enum {
 	LOPT_NO_VALIDATE,
 	LOPT_AIN_VERSION,
 	LOPT_SILENT,
+	LOPT_OPTIMIZE,
+	LOPT_PROFILE,
 };
 
 enum input_type {
@@ -97,6 +100,8 @@ int command_ain_edit(int argc, char *argv[])
 	int minor_version = 0;
 	bool transcode = false;
 	uint32_t flags = 0;
+	uint32_t jaf_flags = 0;
+	const char *profile_file = NULL;
 	hll_list hlls = {0};
 
 	set_input_encoding("UTF-8");
@@ -159,6 +164,12 @@ int command_ain_edit(int argc, char *argv[])
 		case LOPT_SILENT:
 			sys_silent = true;
 			break;
+		case LOPT_OPTIMIZE:
+			jaf_flags |= JAF_OPTIMIZE;
+			break;
+		case LOPT_PROFILE:
+			profile_file = optarg;
+			break;
 		}
 	}
 	argc -= optind;
@@ -170,6 +181,9 @@ int command_ain_edit(int argc, char *argv[])
 
 	initialize_instructions(major_version);
 
+	if (profile_file)
+		profile_enable();
+
 	if (project_file) {
 		WARNING("'ain edit -p' is deprecated, and will be removed in a future version");
 		if (nr_inputs > 0) {
@@ -211,7 +225,7 @@ int command_ain_edit(int argc, char *argv[])
 			break;
 		case IN_JAF:
 			jaf_build(ain, &inputs[i].filename, 1, (const char**)vector_data(hlls),
-					vector_length(hlls));
+					vector_length(hlls), jaf_flags);
 			break;
 		case IN_TEXT:
 			ain_read_text(inputs[i].filename, ain);
@@ -224,9 +238,18 @@ int command_ain_edit(int argc, char *argv[])
 
 write_ain_file:
 	NOTICE("Writing AIN file...");
+	profile_begin("ain.write");
 	ain_write(output_file, ain);
+	profile_end();
 	ain_free(ain);
 
+	if (profile_file) {
+		FILE *out = checked_fopen(profile_file, "wb");
+		profile_write_json(out);
+		fclose(out);
+		profile_fini();
+	}
+
 	char *p;
 	vector_foreach(p, hlls) {
 		free(p);
@@ -253,6 +276,8 @@ struct command cmd_ain_edit = {
 		{ "ain-version", 0,   "Specify the .ain version",                     required_argument, LOPT_AIN_VERSION },
 		{ "raw",         0,   "Read code in raw mode",                        no_argument,       LOPT_RAW },
 		{ "no-validate", 0,   "Skip validation of .jam code",                 no_argument,       LOPT_NO_VALIDATE },
+		{ "optimize",    0,   "Remove dead code from .jaf source code",       no_argument,       LOPT_OPTIMIZE },
+		{ "profile",     0,   "Write per-pass timings to a JSON file",        required_argument, LOPT_PROFILE },
 		{ "silent",      0,   "Don't write messages to stdout",               no_argument,       LOPT_SILENT },
 		{ "transcode",   0,   "Change the .ain file's text encoding",         required_argument, LOPT_TRANSCODE },
 		{ 0 }
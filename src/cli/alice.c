@@ -17,6 +17,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <limits.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <iconv.h>
@@ -70,6 +71,7 @@ struct command cmd_ar = {
 		&cmd_ar_extract,
 		&cmd_ar_list,
 		&cmd_ar_pack,
+		&cmd_ar_thumbnail,
 		NULL
 	}
 };
@@ -108,6 +110,7 @@ struct command cmd_ex = {
 		&cmd_ex_build,
 		&cmd_ex_edit,
 		&cmd_ex_compare,
+		&cmd_ex_diff,
 		NULL
 	}
 };
@@ -181,6 +184,18 @@ FILE *alice_open_output_file(const char *path)
 	return out;
 }
 
+/*
+ * Parse the argument to -j/--jobs (a positive number of worker threads).
+ */
+unsigned parse_jobs_arg(struct command *cmd, const char *arg)
+{
+	char *endptr;
+	long n = strtol(arg, &endptr, 10);
+	if (!*arg || *endptr || n < 1 || n > INT_MAX)
+		USAGE_ERROR(cmd, "Invalid number of jobs: %s", arg);
+	return n;
+}
+
 static void print_version(void)
 {
 	puts("alice-tools version " ALICE_TOOLS_VERSION);
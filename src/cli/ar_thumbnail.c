@@ -0,0 +1,116 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "system4.h"
+#include "system4/archive.h"
+#include "alice.h"
+#include "alice/ar.h"
+#include "alice/jobs.h"
+#include "cli.h"
+
+enum {
+	LOPT_OUTPUT = 256,
+	LOPT_SIZE,
+	LOPT_CONTACT_SHEET,
+	LOPT_COLUMNS,
+	LOPT_JOBS,
+};
+
+int command_ar_thumbnail(int argc, char *argv[])
+{
+	char *output = NULL;
+	int size = 0;
+	bool contact_sheet = false;
+	int columns = 8;
+	unsigned nr_threads = 0;
+
+	while (1) {
+		int c = alice_getopt(argc, argv, &cmd_ar_thumbnail);
+		if (c == -1)
+			break;
+		switch (c) {
+		case 'o':
+		case LOPT_OUTPUT:
+			output = optarg;
+			break;
+		case 's':
+		case LOPT_SIZE:
+			size = atoi(optarg);
+			break;
+		case 'c':
+		case LOPT_CONTACT_SHEET:
+			contact_sheet = true;
+			break;
+		case LOPT_COLUMNS:
+			columns = atoi(optarg);
+			break;
+		case 'j':
+		case LOPT_JOBS:
+			nr_threads = parse_jobs_arg(&cmd_ar_thumbnail, optarg);
+			break;
+		}
+	}
+
+	argc -= optind;
+	argv += optind;
+
+	if (argc != 1)
+		USAGE_ERROR(&cmd_ar_thumbnail, "Wrong number of arguments");
+	if (!size)
+		size = contact_sheet ? 128 : 256;
+	if (size < 16 || size > 4096)
+		USAGE_ERROR(&cmd_ar_thumbnail, "Size out of range (allowed range is [16-4096])");
+	if (columns < 1)
+		USAGE_ERROR(&cmd_ar_thumbnail, "Invalid number of columns");
+
+	struct archive *ar;
+	enum archive_type type;
+	int error;
+	ar = open_archive(argv[0], &type, &error);
+	if (!ar) {
+		ALICE_ERROR("Opening archive: %s", archive_strerror(error));
+	}
+
+	jobs_init(nr_threads);
+	if (contact_sheet)
+		ar_contact_sheet(ar, output ? output : "out.png", size, columns);
+	else
+		ar_thumbnail_all(ar, output ? output : ".", size);
+	jobs_fini();
+
+	archive_free(ar);
+	return 0;
+}
+
+struct command cmd_ar_thumbnail = {
+	.name = "thumbnail",
+	.usage = "[options...] <input-file>",
+	.description = "Create thumbnails for the images in an archive file",
+	.parent = &cmd_ar,
+	.fun = command_ar_thumbnail,
+	.options = {
+		{ "output",        'o', "Specify output directory (or file, with --contact-sheet)", required_argument, LOPT_OUTPUT },
+		{ "size",          's', "Specify thumbnail size (default 256, or 128 with --contact-sheet)", required_argument, LOPT_SIZE },
+		{ "contact-sheet", 'c', "Write a single contact sheet instead of one thumbnail per image", no_argument, LOPT_CONTACT_SHEET },
+		{ "columns",       0,   "Number of columns in the contact sheet (default 8)", required_argument, LOPT_COLUMNS },
+		{ "jobs",          'j', "Number of parallel jobs (default: number of CPUs)", required_argument, LOPT_JOBS },
+		{ 0 }
+	}
+};
@@ -17,12 +17,13 @@
 #include <errno.h>
 #include <stdlib.h>
 #include <string.h>
-#include "cJSON.h"
 #include "system4.h"
 #include "system4/file.h"
 #include "system4/savefile.h"
 #include "system4/string.h"
+#include "system4/vector.h"
 #include "alice.h"
+#include "alice/json.h"
 #include "cli.h"
 
 enum {
@@ -30,28 +31,141 @@ enum {
 	LOPT_OUTPUT,
 };
 
-static int json_get_int(cJSON *o, const char *key)
-{
-	cJSON *v = cJSON_GetObjectItem(o, key);
-	if (!cJSON_IsNumber(v))
-		ALICE_ERROR("Expected a number for '%s'", key);
-	return v->valueint;
-}
+enum {
+	K_SAVE_TYPE,
+	K_ENCRYPTED,
+	K_COMPRESSION_LEVEL,
+	K_KEY,
+	K_UK1,
+	K_UK2,
+	K_UK3,
+	K_UK4,
+	K_VERSION,
+	K_NUM_AIN_GLOBALS,
+	K_GROUP,
+	K_STRUCT_DEFS,
+	K_GLOBALS,
+	K_NAME,
+	K_FIELDS,
+	K_TYPE,
+	K_VALUE,
+	K_UNKNOWN,
+	K_AT_TYPE,
+	K_ARRAY_RANK,
+	K_DIMENSIONS,
+	K_VALUES,
+	K_LINT,
+	K_FLOAT,
+	K_VOID,
+	K_FUNCTYPE,
+	K_REF,
+	K_COMMENTS,
+	K_COMMENTS_ONLY,
+	K_IP,
+	K_STACK,
+	K_CALL_FRAMES,
+	K_RETURN_RECORDS,
+	K_NEXT_SEQ,
+	K_HEAP,
+	K_FUNC_NAMES,
+	K_LOCAL_PTR,
+	K_STRUCT_PTR,
+	K_RETURN_ADDR,
+	K_CALLER_FUNC,
+	K_LOCAL_ADDR,
+	K_CRC,
+	K_SEQ,
+	K_FUNC,
+	K_TYPES,
+	K_SLOTS,
+	K_UK,
+	K_TEXT,
+	K_RANK_MINUS_1,
+	K_DATA_TYPE,
+	K_STRUCT_TYPE,
+	K_ROOT_RANK,
+	K_IS_NOT_EMPTY,
+	K_CTOR,
+	K_DTOR,
+	NR_KEYS
+};
+
+static const char * const key_names[NR_KEYS] = {
+	[K_SAVE_TYPE]         = "save_type",
+	[K_ENCRYPTED]         = "encrypted",
+	[K_COMPRESSION_LEVEL] = "compression_level",
+	[K_KEY]               = "key",
+	[K_UK1]               = "uk1",
+	[K_UK2]               = "uk2",
+	[K_UK3]               = "uk3",
+	[K_UK4]               = "uk4",
+	[K_VERSION]           = "version",
+	[K_NUM_AIN_GLOBALS]   = "num_ain_globals",
+	[K_GROUP]             = "group",
+	[K_STRUCT_DEFS]       = "struct_defs",
+	[K_GLOBALS]           = "globals",
+	[K_NAME]              = "name",
+	[K_FIELDS]            = "fields",
+	[K_TYPE]              = "type",
+	[K_VALUE]             = "value",
+	[K_UNKNOWN]           = "unknown",
+	[K_AT_TYPE]           = "@type",
+	[K_ARRAY_RANK]        = "array_rank",
+	[K_DIMENSIONS]        = "dimensions",
+	[K_VALUES]            = "values",
+	[K_LINT]              = "lint",
+	[K_FLOAT]             = "float",
+	[K_VOID]              = "void",
+	[K_FUNCTYPE]          = "functype",
+	[K_REF]               = "ref",
+	[K_COMMENTS]          = "comments",
+	[K_COMMENTS_ONLY]     = "comments_only",
+	[K_IP]                = "ip",
+	[K_STACK]             = "stack",
+	[K_CALL_FRAMES]       = "call_frames",
+	[K_RETURN_RECORDS]    = "return_records",
+	[K_NEXT_SEQ]          = "next_seq",
+	[K_HEAP]              = "heap",
+	[K_FUNC_NAMES]        = "func_names",
+	[K_LOCAL_PTR]         = "local_ptr",
+	[K_STRUCT_PTR]        = "struct_ptr",
+	[K_RETURN_ADDR]       = "return_addr",
+	[K_CALLER_FUNC]       = "caller_func",
+	[K_LOCAL_ADDR]        = "local_addr",
+	[K_CRC]               = "crc",
+	[K_SEQ]               = "seq",
+	[K_FUNC]              = "func",
+	[K_TYPES]             = "types",
+	[K_SLOTS]             = "slots",
+	[K_UK]                = "uk",
+	[K_TEXT]              = "text",
+	[K_RANK_MINUS_1]      = "rank_minus_1",
+	[K_DATA_TYPE]         = "data_type",
+	[K_STRUCT_TYPE]       = "struct_type",
+	[K_ROOT_RANK]         = "root_rank",
+	[K_IS_NOT_EMPTY]      = "is_not_empty",
+	[K_CTOR]              = "ctor",
+	[K_DTOR]              = "dtor",
+};
 
-static char *json_get_string(cJSON *o, const char *key)
+static char *read_string(struct json_reader *r)
 {
-	cJSON *v = cJSON_GetObjectItem(o, key);
-	if (!cJSON_IsString(v))
-		ALICE_ERROR("Expected a string for '%s'", key);
-	return conv_output(v->valuestring);
+	if (json_next(r) != JSON_STRING)
+		json_error(r, "Expected a string for '%s'", key_names[r->key]);
+	return conv_output(r->str);
 }
 
-static cJSON *json_get_array(cJSON *o, const char *key)
+static char **read_string_array(struct json_reader *r, int32_t *n_out)
 {
-	cJSON *v = cJSON_GetObjectItem(o, key);
-	if (!cJSON_IsArray(v))
-		ALICE_ERROR("Expected an array for '%s'", key);
-	return v;
+	vector_t(char*) a = vector_initializer;
+	json_expect(r, JSON_BEGIN_ARRAY);
+	while (json_next(r) != JSON_END_ARRAY) {
+		if (r->token != JSON_STRING)
+			json_error(r, "Non-string in %s", key_names[r->key]);
+		vector_push(char*, a, conv_output(r->str));
+	}
+	*n_out = vector_length(a);
+	return vector_data(a);
 }
 
 struct typed_value {
@@ -60,404 +174,893 @@ struct typed_value {
 };
 #define TYPED_VALUE(t, v) ((struct typed_value) { .type = (t), .value = (v) })
 
-static struct typed_value add_value_to_gsave(cJSON *v, struct gsave *save);
+static struct typed_value gsave_value(struct json_reader *r, struct gsave *save);
 
-static void collect_flat_arrays(cJSON *a, struct gsave_array *array, struct gsave *save)
+/*
+ * Read the flat arrays of a (possibly nested) array of values. The array has
+ * already been begun.
+ */
+static void read_flat_arrays(struct json_reader *r, struct gsave_array *array, struct gsave *save)
 {
-	if (cJSON_IsArray(cJSON_GetArrayItem(a, 0))) {
-		cJSON *e;
-		cJSON_ArrayForEach(e, a) {
-			collect_flat_arrays(e, array, save);
-		}
+	if (json_next(r) == JSON_BEGIN_ARRAY) {
+		do {
+			if (r->token != JSON_BEGIN_ARRAY)
+				json_error(r, "Expected an array");
+			read_flat_arrays(r, array, save);
+		} while (json_next(r) != JSON_END_ARRAY);
 		return;
 	}
+
+	vector_t(struct gsave_array_value) values = vector_initializer;
+	for (; r->token != JSON_END_ARRAY; json_next(r)) {
+		struct typed_value tv = gsave_value(r, save);
+		struct gsave_array_value v = { .type = tv.type, .value = tv.value };
+		vector_push(struct gsave_array_value, values, v);
+	}
+	if (vector_empty(values))
+		ALICE_ERROR("empty flat_array");
+
 	array->flat_arrays = xrealloc_array(array->flat_arrays, array->nr_flat_arrays, array->nr_flat_arrays+1, sizeof(struct gsave_flat_array));
 	struct gsave_flat_array *fa = &array->flat_arrays[array->nr_flat_arrays++];
-	fa->nr_values = cJSON_GetArraySize(a);
-	fa->values = xcalloc(fa->nr_values, sizeof(struct gsave_array_value));
-	struct gsave_array_value *dest = fa->values;
-	cJSON *e;
-	cJSON_ArrayForEach(e, a) {
-		struct typed_value tv = add_value_to_gsave(e, save);
-		dest->type = tv.type;
-		dest->value = tv.value;
-		dest++;
-	}
-	if (!fa->nr_values)
-		ALICE_ERROR("empty flat_array");
+	fa->nr_values = vector_length(values);
+	fa->values = vector_data(values);
 	fa->type = fa->values[0].type;
 }
 
-static struct typed_value add_value_to_gsave(cJSON *v, struct gsave *save)
+/*
+ * Read a struct value of the type `name` (the value of its "@type" key).
+ */
+static struct typed_value gsave_struct(struct json_reader *r, struct gsave *save, char *name)
 {
-	if (cJSON_IsBool(v))
-		return TYPED_VALUE(AIN_BOOL, v->valueint);
-	if (cJSON_IsNumber(v))
-		return TYPED_VALUE(AIN_INT, v->valueint);
-	if (cJSON_IsString(v)) {
-		struct string *s = string_conv_output(v->valuestring, strlen(v->valuestring));
-		int32_t v = gsave_add_string(save, s);
-		free_string(s);
-		return TYPED_VALUE(AIN_STRING, v);
-	}
-	if (!cJSON_IsObject(v))
-		ALICE_ERROR("unexpected json object: %s", cJSON_PrintUnformatted(v));
-
-	cJSON *struct_name = cJSON_GetObjectItem(v, "@type");
-	if (cJSON_IsString(struct_name)) {
-		int nr_fields = cJSON_GetArraySize(v) - 1;
-		struct gsave_record rec = {
-			.type = GSAVE_RECORD_STRUCT,
-			.struct_name = conv_output(struct_name->valuestring),
-			.nr_indices = nr_fields,
-			.indices = xcalloc(nr_fields, sizeof(int32_t)),
+	struct gsave_record rec = {
+		.type = GSAVE_RECORD_STRUCT,
+		.struct_name = name,
+	};
+	vector_t(int32_t) indices = vector_initializer;
+	int key;
+	while (json_next_key(r, &key)) {
+		if (key == K_AT_TYPE) {
+			json_skip(r);
+			continue;
+		}
+		char *name = conv_output(r->str);
+		json_next(r);
+		struct typed_value tv = gsave_value(r, save);
+		struct gsave_keyval kv = {
+			.name = name,
+			.type = tv.type,
+			.value = tv.value
 		};
-		if (save->version >= 7) {
-			rec.struct_index = gsave_get_struct_def(save, rec.struct_name);
-			if (rec.struct_index < 0)
-				ALICE_ERROR("no struct definition for %s", struct_name->valuestring);
+		vector_push(int32_t, indices, gsave_add_keyval(save, &kv));
+	}
+	// struct_index is resolved once the struct definitions have been read
+	rec.nr_indices = vector_length(indices);
+	rec.indices = vector_data(indices);
+	return TYPED_VALUE(AIN_STRUCT, gsave_add_record(save, &rec));
+}
+
+/*
+ * Read an object value. Structs are identified by an "@type" key (usually,
+ * but not necessarily, the first); anything else is an array or a tagged
+ * scalar.
+ */
+static struct typed_value gsave_object(struct json_reader *r, struct gsave *save)
+{
+	struct json_mark mark;
+	json_mark(r, &mark);
+	int key;
+	while (json_next_key(r, &key)) {
+		if (key == K_AT_TYPE) {
+			char *name = read_string(r);
+			json_rewind(r, &mark);
+			return gsave_struct(r, save, name);
+		}
+		json_skip(r);
+	}
+	json_rewind(r, &mark);
+
+	struct gsave_array array = { .rank = -1 };
+	int nr_dimensions = 0;
+	int32_t type = 0;
+	// tagged scalar ("lint", "float", etc.)
+	int tag = -1;
+	int32_t value = 0;
+	uint64_t seen = 0;
+	while (json_next_key(r, &key)) {
+		seen |= JSON_KEY_BIT(key);
+		switch (key) {
+		case K_ARRAY_RANK:
+			array.rank = json_read_int(r);
+			break;
+		case K_TYPE:
+			type = json_read_int(r);
+			break;
+		case K_DIMENSIONS:
+			array.dimensions = json_read_int_array(r, &nr_dimensions);
+			break;
+		case K_VALUES:
+			json_expect(r, JSON_BEGIN_ARRAY);
+			read_flat_arrays(r, &array, save);
+			break;
+		case K_FLOAT: {
+			union { int32_t i; float f; } u = { .f = json_read_number(r) };
+			tag = key;
+			value = u.i;
+			break;
 		}
-		int32_t *index = rec.indices;
-		cJSON *field;
-		cJSON_ArrayForEach(field, v) {
-			if (!strcmp(field->string, "@type"))
-				continue;
-			struct typed_value tv = add_value_to_gsave(field, save);
-			struct gsave_keyval kv = {
-				.name = conv_output(field->string),
-				.type = tv.type,
-				.value = tv.value
-			};
-			*index++ = gsave_add_keyval(save, &kv);
+		case K_LINT:
+		case K_VOID:
+		case K_FUNCTYPE:
+		case K_REF:
+			tag = key;
+			value = json_read_int(r);
+			break;
+		default:
+			json_skip(r);
+			break;
 		}
-		return TYPED_VALUE(AIN_STRUCT, gsave_add_record(save, &rec));
 	}
 
-	cJSON *array_rank = cJSON_GetObjectItem(v, "array_rank");
-	if (cJSON_IsNumber(array_rank)) {
-		struct gsave_array array = { .rank = array_rank->valueint };
+	if (seen & JSON_KEY_BIT(K_ARRAY_RANK)) {
+		json_require(r, seen, K_TYPE);
 		if (array.rank >= 0) {
-			cJSON *dims = json_get_array(v, "dimensions");
-			array.dimensions = xcalloc(array.rank, sizeof(int32_t));
-			for (int i = 0; i < array.rank; i++)
-				array.dimensions[i] = cJSON_GetArrayItem(dims, i)->valueint;
-			collect_flat_arrays(json_get_array(v, "values"), &array, save);
+			json_require(r, seen, K_DIMENSIONS);
+			json_require(r, seen, K_VALUES);
+			if (nr_dimensions < array.rank)
+				json_error(r, "Too few dimensions for array of rank %d", array.rank);
 		}
-		return TYPED_VALUE(json_get_int(v, "type"), gsave_add_array(save, &array));
+		return TYPED_VALUE(type, gsave_add_array(save, &array));
 	}
-
-	cJSON *num = cJSON_GetObjectItem(v, "lint");
-	if (cJSON_IsNumber(num)) {
-		return TYPED_VALUE(AIN_LONG_INT, num->valueint);
+	switch (tag) {
+	case K_LINT:
+		return TYPED_VALUE(AIN_LONG_INT, value);
+	case K_FLOAT:
+		return TYPED_VALUE(AIN_FLOAT, value);
+	case K_VOID:
+		return TYPED_VALUE(AIN_VOID, value);
+	case K_FUNCTYPE:
+		return TYPED_VALUE(AIN_FUNC_TYPE, value);
+	case K_REF:
+		return TYPED_VALUE(value, -1);
 	}
-	num = cJSON_GetObjectItem(v, "float");
-	if (cJSON_IsNumber(num)) {
-		union { int32_t i; float f; } u = { .f = num->valuedouble };
-		return TYPED_VALUE(AIN_FLOAT, u.i);
+	json_error(r, "Unexpected JSON object");
+}
+
+/*
+ * Add the value beginning with the current token to the save.
+ */
+static struct typed_value gsave_value(struct json_reader *r, struct gsave *save)
+{
+	switch (r->token) {
+	case JSON_TRUE:
+	case JSON_FALSE:
+		return TYPED_VALUE(AIN_BOOL, r->token == JSON_TRUE);
+	case JSON_NUMBER:
+		return TYPED_VALUE(AIN_INT, json_int_value(r));
+	case JSON_STRING: {
+		struct string *s = string_conv_output(r->str, strlen(r->str));
+		int32_t v = gsave_add_string(save, s);
+		free_string(s);
+		return TYPED_VALUE(AIN_STRING, v);
 	}
-	num = cJSON_GetObjectItem(v, "void");
-	if (cJSON_IsNumber(num)) {
-		return TYPED_VALUE(AIN_VOID, num->valueint);
+	case JSON_BEGIN_OBJECT:
+		return gsave_object(r, save);
+	default:
+		json_error(r, "Unexpected JSON value");
 	}
-	num = cJSON_GetObjectItem(v, "functype");
-	if (cJSON_IsNumber(num)) {
-		return TYPED_VALUE(AIN_FUNC_TYPE, num->valueint);
+}
+static void read_struct_def(struct json_reader *r, struct gsave_struct_def *sd)
+{
+	vector_t(struct gsave_field_def) fields = vector_initializer;
+	uint64_t seen = 0;
+	int key;
+	while (json_next_key(r, &key)) {
+		seen |= JSON_KEY_BIT(key);
+		switch (key) {
+		case K_NAME:
+			sd->name = read_string(r);
+			break;
+		case K_FIELDS:
+			json_expect(r, JSON_BEGIN_ARRAY);
+			while (json_next(r) != JSON_END_ARRAY) {
+				if (r->token != JSON_BEGIN_OBJECT)
+					json_error(r, "Expected an object");
+				struct gsave_field_def f = {0};
+				uint64_t fseen = 0;
+				while (json_next_key(r, &key)) {
+					fseen |= JSON_KEY_BIT(key);
+					if (key == K_TYPE)
+						f.type = json_read_int(r);
+					else if (key == K_NAME)
+						f.name = read_string(r);
+					else
+						json_skip(r);
+				}
+				json_require(r, fseen, K_TYPE);
+				json_require(r, fseen, K_NAME);
+				vector_push(struct gsave_field_def, fields, f);
+			}
+			break;
+		default:
+			json_skip(r);
+			break;
+		}
 	}
-	num = cJSON_GetObjectItem(v, "ref");
-	if (cJSON_IsNumber(num)) {
-		return TYPED_VALUE(num->valueint, -1);
+	json_require(r, seen, K_NAME);
+	json_require(r, seen, K_FIELDS);
+	sd->nr_fields = vector_length(fields);
+	sd->fields = vector_data(fields);
+}
+
+static void read_struct_defs(struct json_reader *r, struct gsave *save)
+{
+	vector_t(struct gsave_struct_def) defs = vector_initializer;
+	json_expect(r, JSON_BEGIN_ARRAY);
+	while (json_next(r) != JSON_END_ARRAY) {
+		if (r->token != JSON_BEGIN_OBJECT)
+			json_error(r, "Expected an object");
+		struct gsave_struct_def sd = {0};
+		read_struct_def(r, &sd);
+		vector_push(struct gsave_struct_def, defs, sd);
 	}
-	ALICE_ERROR("unexpected json object: %s", cJSON_PrintUnformatted(v));
+	save->nr_struct_defs = vector_length(defs);
+	save->struct_defs = vector_data(defs);
 }
 
-static struct gsave *json_to_gsave(cJSON *root)
+static void read_gsave_global(struct json_reader *r, struct gsave *save, struct gsave_global *g)
 {
-	struct gsave *save = xcalloc(1, sizeof(struct gsave));
-	save->key = json_get_string(root, "key");
-	save->uk1 = json_get_int(root, "uk1");
-	save->version = json_get_int(root, "version");
-	save->uk2 = json_get_int(root, "uk2");
-	save->nr_ain_globals = json_get_int(root, "num_ain_globals");
-	if (save->version >= 5)
-		save->group = json_get_string(root, "group");
-
-	if (save->version >= 7) {
-		cJSON *struct_defs = json_get_array(root, "struct_defs");
-		save->nr_struct_defs = cJSON_GetArraySize(struct_defs);
-		save->struct_defs = xcalloc(save->nr_struct_defs, sizeof(struct gsave_struct_def));
-		int i;
-		cJSON *o;
-		cJSON_ArrayForEachIndex(i, o, struct_defs) {
-			struct gsave_struct_def *sd = &save->struct_defs[i];
-			sd->name = json_get_string(o, "name");
-			cJSON *fields = json_get_array(o, "fields");
-			sd->nr_fields = cJSON_GetArraySize(fields);
-			sd->fields = xcalloc(sd->nr_fields, sizeof(struct gsave_field_def));
-			int j;
-			cJSON *f;
-			cJSON_ArrayForEachIndex(j, f, fields) {
-				sd->fields[j].type = json_get_int(f, "type");
-				sd->fields[j].name = json_get_string(f, "name");
-			}
+	uint64_t seen = 0;
+	int key;
+	while (json_next_key(r, &key)) {
+		seen |= JSON_KEY_BIT(key);
+		switch (key) {
+		case K_NAME:
+			g->name = read_string(r);
+			break;
+		case K_VALUE: {
+			json_next(r);
+			struct typed_value tv = gsave_value(r, save);
+			g->type = tv.type;
+			g->value = tv.value;
+			break;
+		}
+		case K_UNKNOWN:
+			g->unknown = json_read_int(r);
+			break;
+		default:
+			json_skip(r);
+			break;
 		}
 	}
+	json_require(r, seen, K_NAME);
+	json_require(r, seen, K_VALUE);
+	if (save->version <= 5)
+		json_require(r, seen, K_UNKNOWN);
+}
 
-	cJSON *globals = json_get_array(root, "globals");
-	int nr_globals = cJSON_GetArraySize(globals);
-	gsave_add_globals_record(save, nr_globals);
-	int i;
-	cJSON *o;
-	cJSON_ArrayForEachIndex(i, o, globals) {
-		save->globals[i].name = json_get_string(o, "name");
-		cJSON *v = cJSON_GetObjectItem(o, "value");
-		struct typed_value tv = add_value_to_gsave(v, save);
-		save->globals[i].type = tv.type;
-		save->globals[i].value = tv.value;
-		if (save->version <= 5)
-			save->globals[i].unknown = json_get_int(o, "unknown");
-	}
-	return save;
+static void read_gsave_globals(struct json_reader *r, struct gsave *save)
+{
+	json_expect(r, JSON_BEGIN_ARRAY);
+	// the globals record precedes the records of the values
+	gsave_add_globals_record(save, json_count_elements(r));
+	for (int i = 0; json_next(r) != JSON_END_ARRAY; i++) {
+		if (r->token != JSON_BEGIN_OBJECT)
+			json_error(r, "Expected an object");
+		read_gsave_global(r, save, &save->globals[i]);
+	}
 }
 
-static int32_t *json_to_int_array(cJSON *array, int32_t *n_out)
+static void read_gsave_key(struct json_reader *r, int key, struct gsave *save)
 {
-	int n = cJSON_GetArraySize(array);
-	int32_t *a = xcalloc(n, sizeof(int32_t));
-	int i;
-	cJSON *item;
-	cJSON_ArrayForEachIndex(i, item, array) {
-		if (!cJSON_IsNumber(item))
-			ALICE_ERROR("Non-number in %s", array->string);
-		a[i] = item->valueint;
-	}
-	*n_out = n;
-	return a;
+	switch (key) {
+	case K_KEY:
+		save->key = read_string(r);
+		break;
+	case K_UK1:
+		save->uk1 = json_read_int(r);
+		break;
+	case K_UK2:
+		save->uk2 = json_read_int(r);
+		break;
+	case K_NUM_AIN_GLOBALS:
+		save->nr_ain_globals = json_read_int(r);
+		break;
+	case K_GROUP:
+		save->group = read_string(r);
+		break;
+	case K_STRUCT_DEFS:
+		read_struct_defs(r, save);
+		break;
+	case K_GLOBALS:
+		read_gsave_globals(r, save);
+		break;
+	default:
+		json_skip(r);
+		break;
+	}
 }
 
-static char **json_to_string_array(cJSON *array, int32_t *n_out)
+static void finish_gsave(struct json_reader *r, uint64_t seen, struct gsave *save)
 {
-	int n = cJSON_GetArraySize(array);
-	char **a = xcalloc(n, sizeof(char*));
-	int i;
-	cJSON *item;
-	cJSON_ArrayForEachIndex(i, item, array) {
-		if (!cJSON_IsString(item))
-			ALICE_ERROR("Non-string in %s", array->string);
-		a[i] = conv_output(item->valuestring);
-	}
-	*n_out = n;
-	return a;
+	json_require(r, seen, K_KEY);
+	json_require(r, seen, K_UK1);
+	json_require(r, seen, K_VERSION);
+	json_require(r, seen, K_UK2);
+	json_require(r, seen, K_NUM_AIN_GLOBALS);
+	json_require(r, seen, K_GLOBALS);
+	if (save->version >= 5)
+		json_require(r, seen, K_GROUP);
+	if (save->version < 7)
+		return;
+
+	json_require(r, seen, K_STRUCT_DEFS);
+	for (int i = 0; i < save->nr_records; i++) {
+		struct gsave_record *rec = &save->records[i];
+		if (rec->type != GSAVE_RECORD_STRUCT)
+			continue;
+		rec->struct_index = gsave_get_struct_def(save, rec->struct_name);
+		if (rec->struct_index < 0)
+			ALICE_ERROR("no struct definition for %s", rec->struct_name);
+	}
 }
 
-static struct rsave_symbol json_to_rsave_symbol(cJSON *json)
+static struct rsave_symbol read_rsave_symbol(struct json_reader *r)
 {
-	if (cJSON_IsString(json))
-		return (struct rsave_symbol) { .name = conv_output(json->valuestring) };
-	else if (cJSON_IsNumber(json))
-		return (struct rsave_symbol) { .id = json->valueint };
-	else
-		ALICE_ERROR("Expected string or number for '%s'", json->string);
+	switch (json_next(r)) {
+	case JSON_STRING:
+		return (struct rsave_symbol) { .name = conv_output(r->str) };
+	case JSON_NUMBER:
+		return (struct rsave_symbol) { .id = json_int_value(r) };
+	default:
+		json_error(r, "Expected string or number for '%s'", key_names[r->key]);
+	}
 }
 
-static void json_to_rsave_call_frame(cJSON *f, struct rsave_call_frame *dest)
+static void read_rsave_call_frame(struct json_reader *r, struct rsave_call_frame *dest)
 {
-	dest->type = json_get_int(f, "type");
-	dest->local_ptr = json_get_int(f, "local_ptr");
-	dest->struct_ptr = dest->type == RSAVE_METHOD_CALL ?
-		json_get_int(f, "struct_ptr") : -1;
+	uint64_t seen = 0;
+	int key;
+	dest->struct_ptr = -1;
+	while (json_next_key(r, &key)) {
+		seen |= JSON_KEY_BIT(key);
+		switch (key) {
+		case K_TYPE:
+			dest->type = json_read_int(r);
+			break;
+		case K_LOCAL_PTR:
+			dest->local_ptr = json_read_int(r);
+			break;
+		case K_STRUCT_PTR:
+			dest->struct_ptr = json_read_int(r);
+			break;
+		default:
+			json_skip(r);
+			break;
+		}
+	}
+	json_require(r, seen, K_TYPE);
+	json_require(r, seen, K_LOCAL_PTR);
+	if (dest->type == RSAVE_METHOD_CALL)
+		json_require(r, seen, K_STRUCT_PTR);
+	else
+		dest->struct_ptr = -1;
 }
 
-static void json_to_rsave_return_record(cJSON *f, struct rsave_return_record *dest)
+/*
+ * Read a return record beginning with the current token.
+ */
+static void rsave_return_record(struct json_reader *r, struct rsave_return_record *dest)
 {
-	if (cJSON_IsNull(f)) {
+	if (r->token == JSON_NULL) {
 		dest->return_addr = -1;
 		return;
 	}
-	dest->return_addr = json_get_int(f, "return_addr");
-	dest->caller_func = json_get_string(f, "caller_func");
-	dest->local_addr = json_get_int(f, "local_addr");
-	dest->crc = json_get_int(f, "crc");
+	if (r->token != JSON_BEGIN_OBJECT)
+		json_error(r, "Expected an object or null");
+
+	uint64_t seen = 0;
+	int key;
+	while (json_next_key(r, &key)) {
+		seen |= JSON_KEY_BIT(key);
+		switch (key) {
+		case K_RETURN_ADDR:
+			dest->return_addr = json_read_int(r);
+			break;
+		case K_CALLER_FUNC:
+			dest->caller_func = read_string(r);
+			break;
+		case K_LOCAL_ADDR:
+			dest->local_addr = json_read_int(r);
+			break;
+		case K_CRC:
+			dest->crc = json_read_int(r);
+			break;
+		default:
+			json_skip(r);
+			break;
+		}
+	}
+	json_require(r, seen, K_RETURN_ADDR);
+	json_require(r, seen, K_CALLER_FUNC);
+	json_require(r, seen, K_LOCAL_ADDR);
+	json_require(r, seen, K_CRC);
 }
 
-static struct rsave_heap_frame *json_to_rsave_frame(int32_t version, cJSON *json, enum rsave_heap_tag type)
-{
+// the fields of any kind of heap object
+struct heap_fields {
+	uint64_t seen;
+	enum rsave_heap_tag tag;
+	int32_t ref;
+	int32_t seq;
+	int32_t struct_ptr;
+	int32_t uk;
+	int32_t rank_minus_1;
+	int32_t data_type;
+	int32_t root_rank;
+	int32_t is_not_empty;
+	struct rsave_symbol func;
+	struct rsave_symbol struct_type;
+	struct rsave_symbol ctor;
+	struct rsave_symbol dtor;
+	int nr_types;
+	int32_t *types;
 	int nr_slots;
-	int32_t *slots = json_to_int_array(json_get_array(json, "slots"), &nr_slots);
-	struct rsave_heap_frame *f = xmalloc(sizeof(struct rsave_heap_frame) + nr_slots * sizeof(int32_t));
-	f->tag = type;
-	f->ref = json_get_int(json, "ref");
-	if (version >= 9)
-		f->seq = json_get_int(json, "seq");
-	f->func = json_to_rsave_symbol(cJSON_GetObjectItem(json, "func"));
-	f->types = json_to_int_array(json_get_array(json, "types"), &f->nr_types);
-	if (type == RSAVE_LOCALS && version >= 9)
-		f->struct_ptr = json_get_int(json, "struct_ptr");
-	f->nr_slots = nr_slots;
-	memcpy(f->slots, slots, nr_slots * sizeof(int32_t));
-	free(slots);
-	return f;
+	int32_t *slots;
+	int text_len;
+	char *text;
+};
+
+static enum rsave_heap_tag read_heap_tag(struct json_reader *r)
+{
+	if (json_next(r) != JSON_STRING)
+		json_error(r, "Expected a string for 'type'");
+	if (!strcmp(r->str, "globals"))
+		return RSAVE_GLOBALS;
+	if (!strcmp(r->str, "locals"))
+		return RSAVE_LOCALS;
+	if (!strcmp(r->str, "string"))
+		return RSAVE_STRING;
+	if (!strcmp(r->str, "array"))
+		return RSAVE_ARRAY;
+	if (!strcmp(r->str, "struct"))
+		return RSAVE_STRUCT;
+	if (!strcmp(r->str, "delegate"))
+		return RSAVE_DELEGATE;
+	ALICE_ERROR("unknown heap object type %s", r->str);
 }
 
-static struct rsave_heap_string *json_to_rsave_string(int32_t version, cJSON *json)
+static void read_heap_text(struct json_reader *r, struct heap_fields *h)
 {
-	cJSON *text = cJSON_GetObjectItem(json, "text");
-	char *buf;
-	int len;
-	if (cJSON_IsString(text)) {
-		buf = conv_output(text->valuestring);
-		len = strlen(buf) + 1;
-	} else if (cJSON_IsArray(text)) {
-		len = cJSON_GetArraySize(text);
-		buf = xmalloc(len);
-		int i;
-		cJSON *e;
-		cJSON_ArrayForEachIndex(i, e, text) {
-			buf[i] = e->valueint;
+	switch (json_next(r)) {
+	case JSON_STRING:
+		h->text = conv_output(r->str);
+		h->text_len = strlen(h->text) + 1;
+		break;
+	case JSON_BEGIN_ARRAY: {
+		vector_t(char) buf = vector_initializer;
+		while (json_next(r) != JSON_END_ARRAY) {
+			vector_push(char, buf, json_int_value(r));
 		}
-	} else {
+		h->text = vector_data(buf);
+		h->text_len = vector_length(buf);
+		break;
+	}
+	default:
 		ALICE_ERROR("No valid 'text' field.");
 	}
+}
 
-	struct rsave_heap_string *s = xmalloc(sizeof(struct rsave_heap_string) + len);
-	s->tag = RSAVE_STRING;
-	s->ref = json_get_int(json, "ref");
+static void read_heap_fields(struct json_reader *r, struct heap_fields *h)
+{
+	int key;
+	while (json_next_key(r, &key)) {
+		h->seen |= JSON_KEY_BIT(key);
+		switch (key) {
+		case K_TYPE:
+			h->tag = read_heap_tag(r);
+			break;
+		case K_REF:
+			h->ref = json_read_int(r);
+			break;
+		case K_SEQ:
+			h->seq = json_read_int(r);
+			break;
+		case K_STRUCT_PTR:
+			h->struct_ptr = json_read_int(r);
+			break;
+		case K_UK:
+			h->uk = json_read_int(r);
+			break;
+		case K_RANK_MINUS_1:
+			h->rank_minus_1 = json_read_int(r);
+			break;
+		case K_DATA_TYPE:
+			h->data_type = json_read_int(r);
+			break;
+		case K_ROOT_RANK:
+			h->root_rank = json_read_int(r);
+			break;
+		case K_IS_NOT_EMPTY:
+			h->is_not_empty = json_read_int(r);
+			break;
+		case K_FUNC:
+			h->func = read_rsave_symbol(r);
+			break;
+		case K_STRUCT_TYPE:
+			h->struct_type = read_rsave_symbol(r);
+			break;
+		case K_CTOR:
+			h->ctor = read_rsave_symbol(r);
+			break;
+		case K_DTOR:
+			h->dtor = read_rsave_symbol(r);
+			break;
+		case K_TYPES:
+			h->types = json_read_int_array(r, &h->nr_types);
+			break;
+		case K_SLOTS:
+			h->slots = json_read_int_array(r, &h->nr_slots);
+			break;
+		case K_TEXT:
+			read_heap_text(r, h);
+			break;
+		default:
+			json_skip(r);
+			break;
+		}
+	}
+}
+
+static void require_heap_fields(struct json_reader *r, int32_t version, struct heap_fields *h)
+{
+	json_require(r, h->seen, K_REF);
 	if (version >= 9)
-		s->seq = json_get_int(json, "seq");
-	s->uk = json_get_int(json, "uk");
-	s->len = len;
-	memcpy(s->text, buf, len);
-	free(buf);
+		json_require(r, h->seen, K_SEQ);
+}
+
+static void *heap_frame(struct json_reader *r, int32_t version, struct heap_fields *h)
+{
+	require_heap_fields(r, version, h);
+	json_require(r, h->seen, K_SLOTS);
+	json_require(r, h->seen, K_FUNC);
+	json_require(r, h->seen, K_TYPES);
+	if (h->tag == RSAVE_LOCALS && version >= 9)
+		json_require(r, h->seen, K_STRUCT_PTR);
+	struct rsave_heap_frame *f = xmalloc(sizeof(struct rsave_heap_frame) + h->nr_slots * sizeof(int32_t));
+	f->tag = h->tag;
+	f->ref = h->ref;
+	f->seq = h->seq;
+	f->func = h->func;
+	f->nr_types = h->nr_types;
+	f->types = h->types;
+	f->struct_ptr = h->struct_ptr;
+	f->nr_slots = h->nr_slots;
+	memcpy(f->slots, h->slots, h->nr_slots * sizeof(int32_t));
+	return f;
+}
+
+static void *heap_string(struct json_reader *r, int32_t version, struct heap_fields *h)
+{
+	require_heap_fields(r, version, h);
+	json_require(r, h->seen, K_TEXT);
+	json_require(r, h->seen, K_UK);
+	struct rsave_heap_string *s = xmalloc(sizeof(struct rsave_heap_string) + h->text_len);
+	s->tag = RSAVE_STRING;
+	s->ref = h->ref;
+	s->seq = h->seq;
+	s->uk = h->uk;
+	s->len = h->text_len;
+	memcpy(s->text, h->text, h->text_len);
 	return s;
 }
 
-static struct rsave_heap_array *json_to_rsave_array(int32_t version, cJSON *json)
+static void *heap_array(struct json_reader *r, int32_t version, struct heap_fields *h)
 {
-	int nr_slots;
-	int32_t *slots = json_to_int_array(json_get_array(json, "slots"), &nr_slots);
-	struct rsave_heap_array *a = xmalloc(sizeof(struct rsave_heap_array) + nr_slots * sizeof(int32_t));
+	require_heap_fields(r, version, h);
+	json_require(r, h->seen, K_SLOTS);
+	json_require(r, h->seen, K_RANK_MINUS_1);
+	json_require(r, h->seen, K_DATA_TYPE);
+	json_require(r, h->seen, K_STRUCT_TYPE);
+	json_require(r, h->seen, K_ROOT_RANK);
+	json_require(r, h->seen, K_IS_NOT_EMPTY);
+	struct rsave_heap_array *a = xmalloc(sizeof(struct rsave_heap_array) + h->nr_slots * sizeof(int32_t));
 	a->tag = RSAVE_ARRAY;
-	a->ref = json_get_int(json, "ref");
-	if (version >= 9)
-		a->seq = json_get_int(json, "seq");
-	a->rank_minus_1 = json_get_int(json, "rank_minus_1");
-	a->data_type = json_get_int(json, "data_type");
-	a->struct_type = json_to_rsave_symbol(cJSON_GetObjectItem(json, "struct_type"));
-	a->root_rank = json_get_int(json, "root_rank");
-	a->is_not_empty = json_get_int(json, "is_not_empty");
-	a->nr_slots = nr_slots;
-	memcpy(a->slots, slots, nr_slots * sizeof(int32_t));
-	free(slots);
+	a->ref = h->ref;
+	a->seq = h->seq;
+	a->rank_minus_1 = h->rank_minus_1;
+	a->data_type = h->data_type;
+	a->struct_type = h->struct_type;
+	a->root_rank = h->root_rank;
+	a->is_not_empty = h->is_not_empty;
+	a->nr_slots = h->nr_slots;
+	memcpy(a->slots, h->slots, h->nr_slots * sizeof(int32_t));
 	return a;
 }
 
-static struct rsave_heap_struct *json_to_rsave_struct(int32_t version, cJSON *json)
+static void *heap_struct(struct json_reader *r, int32_t version, struct heap_fields *h)
 {
-	int nr_slots;
-	int32_t *slots = json_to_int_array(json_get_array(json, "slots"), &nr_slots);
-	struct rsave_heap_struct *s = xmalloc(sizeof(struct rsave_heap_struct) + nr_slots * sizeof(int32_t));
+	require_heap_fields(r, version, h);
+	json_require(r, h->seen, K_SLOTS);
+	json_require(r, h->seen, K_CTOR);
+	json_require(r, h->seen, K_DTOR);
+	json_require(r, h->seen, K_UK);
+	json_require(r, h->seen, K_STRUCT_TYPE);
+	json_require(r, h->seen, K_TYPES);
+	struct rsave_heap_struct *s = xmalloc(sizeof(struct rsave_heap_struct) + h->nr_slots * sizeof(int32_t));
 	s->tag = RSAVE_STRUCT;
-	s->ref = json_get_int(json, "ref");
-	if (version >= 9)
-		s->seq = json_get_int(json, "seq");
-	s->ctor = json_to_rsave_symbol(cJSON_GetObjectItem(json, "ctor"));
-	s->dtor = json_to_rsave_symbol(cJSON_GetObjectItem(json, "dtor"));
-	s->uk = json_get_int(json, "uk");
-	s->struct_type = json_to_rsave_symbol(cJSON_GetObjectItem(json, "struct_type"));
-	s->types = json_to_int_array(json_get_array(json, "types"), &s->nr_types);
-	s->nr_slots = nr_slots;
-	memcpy(s->slots, slots, nr_slots * sizeof(int32_t));
-	free(slots);
+	s->ref = h->ref;
+	s->seq = h->seq;
+	s->ctor = h->ctor;
+	s->dtor = h->dtor;
+	s->uk = h->uk;
+	s->struct_type = h->struct_type;
+	s->nr_types = h->nr_types;
+	s->types = h->types;
+	s->nr_slots = h->nr_slots;
+	memcpy(s->slots, h->slots, h->nr_slots * sizeof(int32_t));
 	return s;
 }
 
-static struct rsave_heap_delegate *json_to_rsave_delegate(int32_t version, cJSON *json)
+static void *heap_delegate(struct json_reader *r, int32_t version, struct heap_fields *h)
 {
-	int nr_slots;
-	int32_t *slots = json_to_int_array(json_get_array(json, "slots"), &nr_slots);
-	struct rsave_heap_delegate *d = xmalloc(sizeof(struct rsave_heap_delegate) + nr_slots * sizeof(int32_t));
+	require_heap_fields(r, version, h);
+	json_require(r, h->seen, K_SLOTS);
+	struct rsave_heap_delegate *d = xmalloc(sizeof(struct rsave_heap_delegate) + h->nr_slots * sizeof(int32_t));
 	d->tag = RSAVE_DELEGATE;
-	d->ref = json_get_int(json, "ref");
-	if (version >= 9)
-		d->seq = json_get_int(json, "seq");
-	d->nr_slots = nr_slots;
-	memcpy(d->slots, slots, nr_slots * sizeof(int32_t));
-	free(slots);
+	d->ref = h->ref;
+	d->seq = h->seq;
+	d->nr_slots = h->nr_slots;
+	memcpy(d->slots, h->slots, h->nr_slots * sizeof(int32_t));
 	return d;
 }
 
-static void *json_to_heap_obj(int32_t version, cJSON *item)
+/*
+ * Read a heap object. Its fields are collected first, since the "type" key
+ * which determines the kind of object may come in any position.
+ */
+static void *read_heap_obj(struct json_reader *r, int32_t version)
 {
-	if (cJSON_IsNull(item))
+	if (r->token == JSON_NULL)
 		return rsave_null;
-	cJSON *type = cJSON_GetObjectItem(item, "type");
-	if (!strcmp(type->valuestring, "globals"))
-		return json_to_rsave_frame(version, item, RSAVE_GLOBALS);
-	if (!strcmp(type->valuestring, "locals"))
-		return json_to_rsave_frame(version, item, RSAVE_LOCALS);
-	if (!strcmp(type->valuestring, "string"))
-		return json_to_rsave_string(version, item);
-	if (!strcmp(type->valuestring, "array"))
-		return json_to_rsave_array(version, item);
-	if (!strcmp(type->valuestring, "struct"))
-		return json_to_rsave_struct(version, item);
-	if (!strcmp(type->valuestring, "delegate"))
-		return json_to_rsave_delegate(version, item);
-	ALICE_ERROR("unknown heap object type %s", type->valuestring);
+	if (r->token != JSON_BEGIN_OBJECT)
+		json_error(r, "Expected an object or null");
+
+	struct heap_fields h = {0};
+	read_heap_fields(r, &h);
+	json_require(r, h.seen, K_TYPE);
+
+	void *obj;
+	switch (h.tag) {
+	case RSAVE_GLOBALS:
+	case RSAVE_LOCALS:
+		obj = heap_frame(r, version, &h);
+		// types are owned by the frame
+		h.types = NULL;
+		break;
+	case RSAVE_STRING:
+		obj = heap_string(r, version, &h);
+		break;
+	case RSAVE_ARRAY:
+		obj = heap_array(r, version, &h);
+		break;
+	case RSAVE_STRUCT:
+		obj = heap_struct(r, version, &h);
+		h.types = NULL;
+		break;
+	case RSAVE_DELEGATE:
+		obj = heap_delegate(r, version, &h);
+		break;
+	default:
+		ALICE_ERROR("unknown heap object type");
+	}
+	free(h.types);
+	free(h.slots);
+	free(h.text);
+	return obj;
 }
 
-static struct rsave *json_to_rsave(cJSON *root)
+static void read_rsave_key(struct json_reader *r, int key, struct rsave *save)
 {
-	int i;
-	cJSON *item;
-	struct rsave *save = xcalloc(1, sizeof(struct rsave));
-	save->version = json_get_int(root, "version");
-	save->key = json_get_string(root, "key");
-	if (save->version >= 7) {
-		cJSON *comments = json_get_array(root, "comments");
-		save->comments = json_to_string_array(comments, &save->nr_comments);
+	switch (key) {
+	case K_KEY:
+		save->key = read_string(r);
+		break;
+	case K_COMMENTS:
+		save->comments = read_string_array(r, &save->nr_comments);
+		break;
+	case K_COMMENTS_ONLY:
+		json_next(r);
+		save->comments_only = r->token == JSON_TRUE;
+		json_skip(r);
+		break;
+	case K_IP:
+		json_next(r);
+		rsave_return_record(r, &save->ip);
+		break;
+	case K_UK1:
+		save->uk1 = json_read_int(r);
+		break;
+	case K_STACK:
+		save->stack = json_read_int_array(r, &save->stack_size);
+		break;
+	case K_CALL_FRAMES: {
+		vector_t(struct rsave_call_frame) frames = vector_initializer;
+		json_expect(r, JSON_BEGIN_ARRAY);
+		while (json_next(r) != JSON_END_ARRAY) {
+			if (r->token != JSON_BEGIN_OBJECT)
+				json_error(r, "Expected an object");
+			struct rsave_call_frame f = {0};
+			read_rsave_call_frame(r, &f);
+			vector_push(struct rsave_call_frame, frames, f);
+		}
+		save->nr_call_frames = vector_length(frames);
+		save->call_frames = vector_data(frames);
+		break;
+	}
+	case K_RETURN_RECORDS: {
+		vector_t(struct rsave_return_record) records = vector_initializer;
+		json_expect(r, JSON_BEGIN_ARRAY);
+		while (json_next(r) != JSON_END_ARRAY) {
+			struct rsave_return_record rec = {0};
+			rsave_return_record(r, &rec);
+			vector_push(struct rsave_return_record, records, rec);
+		}
+		save->nr_return_records = vector_length(records);
+		save->return_records = vector_data(records);
+		break;
 	}
-	if (cJSON_IsTrue(cJSON_GetObjectItem(root, "comments_only"))) {
-		save->comments_only = true;
-		return save;
+	case K_UK2:
+		save->uk2 = json_read_int(r);
+		break;
+	case K_UK3:
+		save->uk3 = json_read_int(r);
+		break;
+	case K_UK4:
+		save->uk4 = json_read_int(r);
+		break;
+	case K_NEXT_SEQ:
+		save->next_seq = json_read_int(r);
+		break;
+	case K_HEAP: {
+		vector_t(void*) heap = vector_initializer;
+		json_expect(r, JSON_BEGIN_ARRAY);
+		while (json_next(r) != JSON_END_ARRAY) {
+			vector_push(void*, heap, read_heap_obj(r, save->version));
+		}
+		save->nr_heap_objs = vector_length(heap);
+		save->heap = vector_data(heap);
+		break;
+	}
+	case K_FUNC_NAMES:
+		save->func_names = read_string_array(r, &save->nr_func_names);
+		break;
+	default:
+		json_skip(r);
+		break;
 	}
+}
 
-	json_to_rsave_return_record(cJSON_GetObjectItem(root, "ip"), &save->ip);
-	save->uk1 = json_get_int(root, "uk1");
+static void finish_rsave(struct json_reader *r, uint64_t seen, struct rsave *save)
+{
+	json_require(r, seen, K_VERSION);
+	json_require(r, seen, K_KEY);
+	if (save->version >= 7)
+		json_require(r, seen, K_COMMENTS);
+	if (save->comments_only)
+		return;
+	json_require(r, seen, K_IP);
+	json_require(r, seen, K_UK1);
+	json_require(r, seen, K_STACK);
+	json_require(r, seen, K_CALL_FRAMES);
+	json_require(r, seen, K_RETURN_RECORDS);
+	json_require(r, seen, K_UK2);
+	json_require(r, seen, K_UK3);
+	json_require(r, seen, K_UK4);
+	if (save->version >= 9)
+		json_require(r, seen, K_NEXT_SEQ);
+	json_require(r, seen, K_HEAP);
+	if (save->version >= 6)
+		json_require(r, seen, K_FUNC_NAMES);
+}
 
-	save->stack = json_to_int_array(json_get_array(root, "stack"), &save->stack_size);
+struct save_json {
+	struct gsave *gsave;
+	struct rsave *rsave;
+	bool encrypt;
+	int compression_level;
+};
 
-	cJSON *call_frames = json_get_array(root, "call_frames");
-	save->nr_call_frames = cJSON_GetArraySize(call_frames);
-	save->call_frames = xcalloc(save->nr_call_frames, sizeof(struct rsave_call_frame));
-	cJSON_ArrayForEachIndex(i, item, call_frames) {
-		json_to_rsave_call_frame(item, &save->call_frames[i]);
+/*
+ * Read the keys which the rest of the save depends on ("save_type" and
+ * "version") ahead of the other members, which may then come in any order.
+ * Returns a mask of the keys found.
+ */
+static uint64_t read_save_header(struct json_reader *r, struct save_json *save, int32_t *version)
+{
+	const uint64_t want = JSON_KEY_BIT(K_SAVE_TYPE) | JSON_KEY_BIT(K_VERSION);
+	uint64_t seen = 0;
+	struct json_mark mark;
+	json_mark(r, &mark);
+	int key;
+	while ((seen & want) != want && json_next_key(r, &key)) {
+		switch (key) {
+		case K_SAVE_TYPE:
+			if (json_next(r) != JSON_STRING)
+				ALICE_ERROR("not a save json");
+			if (!strcmp(r->str, "global_save"))
+				save->gsave = xcalloc(1, sizeof(struct gsave));
+			else if (!strcmp(r->str, "resume_save"))
+				save->rsave = xcalloc(1, sizeof(struct rsave));
+			else
+				ALICE_ERROR("unrecognized save_type '%s'", r->str);
+			break;
+		case K_VERSION:
+			*version = json_read_int(r);
+			break;
+		default:
+			json_skip(r);
+			break;
+		}
+		seen |= JSON_KEY_BIT(key);
 	}
+	json_rewind(r, &mark);
+	return seen;
+}
 
-	cJSON *return_records = json_get_array(root, "return_records");
-	save->nr_return_records = cJSON_GetArraySize(return_records);
-	save->return_records = xcalloc(save->nr_return_records, sizeof(struct rsave_return_record));
-	cJSON_ArrayForEachIndex(i, item, return_records) {
-		json_to_rsave_return_record(item, &save->return_records[i]);
-	}
+/*
+ * Read a save from JSON. Only the header keys are looked ahead for; the rest
+ * is read in a single pass.
+ */
+static void read_save_json(struct json_reader *r, struct save_json *save)
+{
+	save->encrypt = true;
+	save->compression_level = 9;
 
-	save->uk2 = json_get_int(root, "uk2");
-	save->uk3 = json_get_int(root, "uk3");
-	save->uk4 = json_get_int(root, "uk4");
-	if (save->version >= 9)
-		save->next_seq = json_get_int(root, "next_seq");
+	if (json_next(r) != JSON_BEGIN_OBJECT)
+		ALICE_ERROR("not a save json");
+	int32_t version = 0;
+	uint64_t seen = read_save_header(r, save, &version);
+	if (save->gsave)
+		save->gsave->version = version;
+	else if (save->rsave)
+		save->rsave->version = version;
+	else
+		ALICE_ERROR("not a save json");
 
-	cJSON *heap = json_get_array(root, "heap");
-	save->nr_heap_objs = cJSON_GetArraySize(heap);
-	save->heap = xcalloc(save->nr_heap_objs, sizeof(void*));
-	cJSON_ArrayForEachIndex(i, item, heap) {
-		save->heap[i] = json_to_heap_obj(save->version, item);
+	int key;
+	while (json_next_key(r, &key)) {
+		switch (key) {
+		case K_SAVE_TYPE:
+		case K_VERSION:
+			// already read by read_save_header
+			json_skip(r);
+			break;
+		case K_ENCRYPTED:
+			json_next(r);
+			if (r->token == JSON_TRUE || r->token == JSON_FALSE)
+				save->encrypt = r->token == JSON_TRUE;
+			json_skip(r);
+			break;
+		case K_COMPRESSION_LEVEL:
+			json_next(r);
+			if (r->token == JSON_NUMBER)
+				save->compression_level = json_int_value(r);
+			json_skip(r);
+			break;
+		default:
+			if (save->gsave)
+				read_gsave_key(r, key, save->gsave);
+			else
+				read_rsave_key(r, key, save->rsave);
+			break;
+		}
+		seen |= JSON_KEY_BIT(key);
 	}
 
-	if (save->version >= 6) {
-		cJSON *func_names = json_get_array(root, "func_names");
-		save->func_names = json_to_string_array(func_names, &save->nr_func_names);
-	}
-	return save;
+	if (save->gsave)
+		finish_gsave(r, seen, save->gsave);
+	else
+		finish_rsave(r, seen, save->rsave);
 }
 
 int command_asd_build(int argc, char *argv[])
@@ -512,35 +1115,23 @@ int command_asd_build(int argc, char *argv[])
 		return 0;
 	}
 
-	cJSON *json = cJSON_Parse(buf);
-	if (!json)
-		ALICE_ERROR("Failed to parse JSON");
-
-	cJSON *v = cJSON_GetObjectItem(json, "encrypted");
-	bool encrypt = cJSON_IsBool(v) ? v->valueint : true;
-	v = cJSON_GetObjectItem(json, "compression_level");
-	int compression_level = cJSON_IsNumber(v) ? v->valueint : 9;
+	struct json_reader r;
+	struct save_json save = {0};
+	json_reader_init(&r, buf, len, argv[0], key_names, NR_KEYS);
+	read_save_json(&r, &save);
+	json_reader_fini(&r);
 
-	cJSON *save_type = cJSON_GetObjectItem(json, "save_type");
-	if (!cJSON_IsString(save_type)) {
-		ALICE_ERROR("not a save json");
-	}
 	enum savefile_error error;
-	if (!strcmp(save_type->valuestring, "global_save")) {
-		struct gsave *gs = json_to_gsave(json);
-		error = gsave_write(gs, out, encrypt, compression_level);
-		gsave_free(gs);
-	} else if (!strcmp(save_type->valuestring, "resume_save")) {
-		struct rsave *rs = json_to_rsave(json);
-		error = rsave_write(rs, out, encrypt, compression_level);
-		rsave_free(rs);
+	if (save.gsave) {
+		error = gsave_write(save.gsave, out, save.encrypt, save.compression_level);
+		gsave_free(save.gsave);
 	} else {
-		ALICE_ERROR("unrecognized save_type '%s'", save_type->valuestring);
+		error = rsave_write(save.rsave, out, save.encrypt, save.compression_level);
+		rsave_free(save.rsave);
 	}
 	if (error != SAVEFILE_SUCCESS)
 		ALICE_ERROR("Error writing output: %s", savefile_strerror(error));
 
-	cJSON_Delete(json);
 	free(buf);
 	return 0;
 }
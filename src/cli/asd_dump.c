@@ -15,372 +15,849 @@
  */
 
 #include <errno.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include "cJSON.h"
+#include <sys/stat.h>
 #include "system4.h"
+#include "system4/file.h"
 #include "system4/savefile.h"
 #include "system4/string.h"
+#include "system4/vector.h"
 #include "alice.h"
+#include "alice/jobs.h"
+#include "alice/json.h"
+#include "alice/port.h"
 #include "cli.h"
 
 enum {
 	LOPT_DECODE = 256,
 	LOPT_OUTPUT,
+	LOPT_BATCH,
+	LOPT_FILE_LIST,
+	LOPT_JOBS,
+	LOPT_GLOBALS,
+	LOPT_STRUCT_TYPES,
+	LOPT_HEAP_KINDS,
+	LOPT_COMMENTS_ONLY,
 };
 
-static cJSON *to_json_string(const char *s)
+/*
+ * A projection selects part of a save file to be written. Names are stored
+ * in the save file's encoding so that they can be compared directly.
+ */
+typedef vector_t(char*) name_list;
+
+struct projection {
+	name_list globals;
+	name_list struct_types;
+	unsigned heap_kinds; // bitmask of (1 << enum rsave_heap_tag)
+	bool comments_only;  // stop reading resume saves after the comments
+};
+
+#define HEAP_KIND_ALL ((1u << RSAVE_GLOBALS) | (1u << RSAVE_LOCALS) | (1u << RSAVE_STRING) \
+		| (1u << RSAVE_ARRAY) | (1u << RSAVE_STRUCT) | (1u << RSAVE_DELEGATE))
+
+static bool name_selected(const char *name, const name_list *names)
 {
-	char *u = conv_output(s);
-	cJSON *json = cJSON_CreateString(u);
-	free(u);
-	return json;
+	if (!name)
+		return false;
+	char *s;
+	vector_foreach(s, *names) {
+		if (!strcmp(name, s))
+			return true;
+	}
+	return false;
 }
 
-static int cb_get_number(int i, void *data)
+static void name_list_free(name_list *names)
 {
-	return ((int32_t *)data)[i];
+	char *s;
+	vector_foreach(s, *names) {
+		free(s);
+	}
+	vector_destroy(*names);
 }
 
-static cJSON *int_array_to_json(int32_t *nums, int count)
+static bool heap_projected(const struct projection *proj)
 {
-	return cJSON_CreateIntArray_cb(count, cb_get_number, nums);
+	return proj && (proj->heap_kinds != HEAP_KIND_ALL || !vector_empty(proj->struct_types));
 }
 
-static cJSON *cb_get_string(int i, void *data)
+static void write_string(struct json_writer *w, const char *s)
 {
-	return to_json_string(((char **)data)[i]);
+	char *u = conv_output(s);
+	json_string(w, u);
+	free(u);
 }
 
-static cJSON *string_array_to_json(char **strs, int count)
+static void write_key(struct json_writer *w, const char *s)
 {
-	return cJSON_CreateArray_cb(count, cb_get_string, strs);
+	char *u = conv_output(s);
+	json_key(w, u);
+	free(u);
 }
 
-static cJSON *create_number_wrapper(const char *key, double value)
+static void string_array_to_json(struct json_writer *w, char **strs, int count)
 {
-	cJSON *o = cJSON_CreateObject();
-	cJSON_AddNumberToObject(o, key, value);
-	return o;
+	json_begin_array(w);
+	for (int i = 0; i < count; i++) {
+		write_string(w, strs[i]);
+	}
+	json_end_array(w);
 }
 
-static cJSON *value_to_json(int32_t value, enum ain_data_type type, struct gsave *save);
+static void number_wrapper(struct json_writer *w, const char *key, double value)
+{
+	json_begin_object(w);
+	json_key(w, key);
+	json_number(w, value);
+	json_end_object(w);
+}
+
+// size of the buffer for conversion errors
+#define ERROR_SIZE 256
 
-static cJSON *array_to_json(int rank, int32_t *dims, struct gsave_flat_array **fa, struct gsave *save)
+/*
+ * Record an error for a value which can't be represented (only the first
+ * error is kept) and write null in its place.
+ */
+static void value_error(struct json_writer *w, char *error, const char *fmt, ...)
 {
-	cJSON *a = cJSON_CreateArray();
+	if (!*error) {
+		va_list ap;
+		va_start(ap, fmt);
+		vsnprintf(error, ERROR_SIZE, fmt, ap);
+		va_end(ap);
+	}
+	json_null(w);
+}
+
+static void value_to_json(struct json_writer *w, int32_t value, enum ain_data_type type,
+		struct gsave *save, char *error);
+
+static void array_to_json(struct json_writer *w, int rank, int32_t *dims, struct gsave_flat_array **fa,
+		struct gsave *save, char *error)
+{
+	json_begin_array(w);
 	if (rank > 1) {
 		for (int i = 0; i < dims[rank - 1]; i++) {
-			cJSON_AddItemToArray(a, array_to_json(rank - 1, dims, fa, save));
+			array_to_json(w, rank - 1, dims, fa, save, error);
 		}
 	} else if (rank == 1) {
 		for (int i = 0; i < (*fa)->nr_values; i++) {
-			cJSON *item = value_to_json((*fa)->values[i].value, (*fa)->values[i].type, save);
-			cJSON_AddItemToArray(a, item);
+			value_to_json(w, (*fa)->values[i].value, (*fa)->values[i].type, save, error);
 		}
 		(*fa)++;
 	}
-	return a;
+	json_end_array(w);
 }
 
-static cJSON *value_to_json(int32_t value, enum ain_data_type type, struct gsave *save)
+static void value_to_json(struct json_writer *w, int32_t value, enum ain_data_type type,
+		struct gsave *save, char *error)
 {
 	switch (type) {
 	case AIN_BOOL:
-		return cJSON_CreateBool(value);
+		json_bool(w, value);
+		break;
 	case AIN_INT:
-		return cJSON_CreateNumber(value);
+		json_int(w, value);
+		break;
 	case AIN_STRING:
 		if (value == GSAVE7_EMPTY_STRING)
-			return cJSON_CreateString("");
-		return to_json_string(save->strings[value]->text);
+			json_string(w, "");
+		else
+			write_string(w, save->strings[value]->text);
+		break;
 	case AIN_LONG_INT:
-		return create_number_wrapper("lint", value);
+		number_wrapper(w, "lint", value);
+		break;
 	case AIN_VOID:
-		return create_number_wrapper("void", value);
+		number_wrapper(w, "void", value);
+		break;
 	case AIN_FUNC_TYPE:
-		return create_number_wrapper("functype", value);
+		number_wrapper(w, "functype", value);
+		break;
 	case AIN_FLOAT:
 		{
 			union { int32_t i; float f; } v = { .i = value };
-			return create_number_wrapper("float", v.f);
+			number_wrapper(w, "float", v.f);
+			break;
 		}
 	case AIN_REF_TYPE:
-		return create_number_wrapper("ref", type);
+		number_wrapper(w, "ref", type);
+		break;
 	case AIN_STRUCT:
 		{
 			struct gsave_record *r = &save->records[value];
-			cJSON *o = cJSON_CreateObject();
 			if (save->version <= 5) {
-				if (r->type != GSAVE_RECORD_STRUCT)
-					ALICE_ERROR("unexpected type in records table: %d", r->type);
-				cJSON_AddItemToObjectCS(o, "@type", to_json_string(r->struct_name));
+				if (r->type != GSAVE_RECORD_STRUCT) {
+					value_error(w, error, "unexpected type in records table: %d", r->type);
+					break;
+				}
+				json_begin_object(w);
+				json_key(w, "@type");
+				write_string(w, r->struct_name);
 				for (int i = 0; i < r->nr_indices; i++) {
 					struct gsave_keyval *kv = &save->keyvals[r->indices[i]];
-					char *key = conv_output(kv->name);
-					cJSON_AddItemToObject(o, key, value_to_json(kv->value, kv->type, save));
-					free(key);
+					write_key(w, kv->name);
+					value_to_json(w, kv->value, kv->type, save, error);
 				}
 			} else {
-				if (r->struct_index < 0)
-					ALICE_ERROR("unexpected type in records table: %d", r->type);
+				if (r->struct_index < 0) {
+					value_error(w, error, "unexpected type in records table: %d", r->type);
+					break;
+				}
 				struct gsave_struct_def *sd = &save->struct_defs[r->struct_index];
-				cJSON_AddItemToObjectCS(o, "@type", to_json_string(sd->name));
-				if (r->nr_indices != sd->nr_fields)
-					ALICE_ERROR("record %d has %d fields, but struct %d has %d fields", value, r->nr_indices, r->struct_index, sd->nr_fields);
+				if (r->nr_indices != sd->nr_fields) {
+					value_error(w, error, "record %d has %d fields, but struct %d has %d fields",
+							value, r->nr_indices, r->struct_index, sd->nr_fields);
+					break;
+				}
+				json_begin_object(w);
+				json_key(w, "@type");
+				write_string(w, sd->name);
 				for (int i = 0; i < r->nr_indices; i++) {
 					struct gsave_keyval *kv = &save->keyvals[r->indices[i]];
 					struct gsave_field_def *fd = &sd->fields[i];
-					char *key = conv_output(fd->name);
-					cJSON_AddItemToObject(o, key, value_to_json(kv->value, fd->type, save));
-					free(key);
+					write_key(w, fd->name);
+					value_to_json(w, kv->value, fd->type, save, error);
 				}
 			}
-			return o;
+			json_end_object(w);
+			break;
 		}
 	case AIN_ARRAY_TYPE:
 		{
 			struct gsave_array *a = &save->arrays[value];
-			cJSON *o = cJSON_CreateObject();
-			cJSON_AddNumberToObject(o, "array_rank", a->rank);
-			cJSON_AddNumberToObject(o, "type", type);
+			json_begin_object(w);
+			json_key(w, "array_rank");
+			json_int(w, a->rank);
+			json_key(w, "type");
+			json_int(w, type);
 			if (a->rank < 0) {
-				cJSON_AddItemToObjectCS(o, "value", cJSON_CreateNull());
-				return o;
+				json_key(w, "value");
+				json_null(w);
+				json_end_object(w);
+				break;
 			}
-			cJSON_AddItemToObjectCS(o, "dimensions", int_array_to_json(a->dimensions, a->rank));
+			json_key(w, "dimensions");
+			json_int_array(w, a->dimensions, a->rank);
 			struct gsave_flat_array *fa = a->flat_arrays;
-			cJSON_AddItemToObjectCS(o, "values", array_to_json(a->rank, a->dimensions, &fa, save));
+			json_key(w, "values");
+			array_to_json(w, a->rank, a->dimensions, &fa, save, error);
 			assert(fa == a->flat_arrays + a->nr_flat_arrays);
-			return o;
+			json_end_object(w);
+			break;
 		}
 	default:
-		ALICE_ERROR("Unhandled value type: %d", type);
+		value_error(w, error, "Unhandled value type: %d", type);
 	}
 }
 
-static cJSON *gsave_to_json(struct gsave *save)
+static const char *gsave_struct_name(struct gsave *save, int32_t value)
+{
+	struct gsave_record *r = &save->records[value];
+	if (save->version <= 5)
+		return r->struct_name;
+	return r->struct_index < 0 ? NULL : save->struct_defs[r->struct_index].name;
+}
+
+static bool gsave_global_selected(struct gsave *save, struct gsave_global *g,
+		const struct projection *proj)
+{
+	if (!proj)
+		return true;
+	if (!vector_empty(proj->globals) && !name_selected(g->name, &proj->globals))
+		return false;
+	if (!vector_empty(proj->struct_types)) {
+		if (g->type != AIN_STRUCT)
+			return false;
+		return name_selected(gsave_struct_name(save, g->value), &proj->struct_types);
+	}
+	return true;
+}
+
+/*
+ * Write the members of the JSON object for a global save. The caller writes
+ * the enclosing object. If `proj` is non-NULL, only the selected globals
+ * (and struct definitions) are written. Values which can't be represented
+ * are reported in `error`.
+ */
+static void gsave_to_json(struct json_writer *w, struct gsave *save, const struct projection *proj,
+		char *error)
 {
-	cJSON *root = cJSON_CreateObject();
-	cJSON_AddStringToObject(root, "save_type", "global_save");
-	cJSON_AddItemToObjectCS(root, "key", to_json_string(save->key));
-	cJSON_AddNumberToObject(root, "uk1", save->uk1);
-	cJSON_AddNumberToObject(root, "version", save->version);
-	cJSON_AddNumberToObject(root, "uk2", save->uk2);
-	cJSON_AddNumberToObject(root, "num_ain_globals", save->nr_ain_globals);
-	if (save->version >= 5)
-		cJSON_AddItemToObjectCS(root, "group", to_json_string(save->group));
+	json_key(w, "save_type");
+	json_string(w, "global_save");
+	json_key(w, "key");
+	write_string(w, save->key);
+	json_key(w, "uk1");
+	json_int(w, save->uk1);
+	json_key(w, "version");
+	json_int(w, save->version);
+	json_key(w, "uk2");
+	json_int(w, save->uk2);
+	json_key(w, "num_ain_globals");
+	json_int(w, save->nr_ain_globals);
+	if (save->version >= 5) {
+		json_key(w, "group");
+		write_string(w, save->group);
+	}
 
-	cJSON *globals = cJSON_CreateArray();
-	cJSON_AddItemToObjectCS(root, "globals", globals);
+	json_key(w, "globals");
+	json_begin_array(w);
 	for (struct gsave_global *g = save->globals; g < save->globals + save->nr_globals; g++) {
-		cJSON *global = cJSON_CreateObject();
-		cJSON_AddItemToArray(globals, global);
-		cJSON_AddItemToObjectCS(global, "name", to_json_string(g->name));
-		cJSON_AddItemToObjectCS(global, "value", value_to_json(g->value, g->type, save));
-		if (save->version <= 5)
-			cJSON_AddNumberToObject(global, "unknown", g->unknown);
+		if (!gsave_global_selected(save, g, proj))
+			continue;
+		json_begin_object(w);
+		json_key(w, "name");
+		write_string(w, g->name);
+		json_key(w, "value");
+		value_to_json(w, g->value, g->type, save, error);
+		if (save->version <= 5) {
+			json_key(w, "unknown");
+			json_int(w, g->unknown);
+		}
+		json_end_object(w);
 	}
+	json_end_array(w);
 
 	if (save->version >= 7) {
-		cJSON *struct_defs = cJSON_CreateArray();
-		cJSON_AddItemToObjectCS(root, "struct_defs", struct_defs);
+		json_key(w, "struct_defs");
+		json_begin_array(w);
 		for (struct gsave_struct_def *sd = save->struct_defs; sd < save->struct_defs + save->nr_struct_defs; sd++) {
-			cJSON *struct_def = cJSON_CreateObject();
-			cJSON_AddItemToArray(struct_defs, struct_def);
-			cJSON_AddItemToObjectCS(struct_def, "name", to_json_string(sd->name));
-			cJSON *fields = cJSON_CreateArray();
-			cJSON_AddItemToObjectCS(struct_def, "fields", fields);
+			if (proj && !vector_empty(proj->struct_types)
+					&& !name_selected(sd->name, &proj->struct_types))
+				continue;
+			json_begin_object(w);
+			json_key(w, "name");
+			write_string(w, sd->name);
+			json_key(w, "fields");
+			json_begin_array(w);
 			for (struct gsave_field_def *fd = sd->fields; fd < sd->fields + sd->nr_fields; fd++) {
-				cJSON *field = cJSON_CreateObject();
-				cJSON_AddItemToArray(fields, field);
-				cJSON_AddNumberToObject(field, "type", fd->type);
-				cJSON_AddItemToObjectCS(field, "name", to_json_string(fd->name));
+				json_begin_object(w);
+				json_key(w, "type");
+				json_int(w, fd->type);
+				json_key(w, "name");
+				write_string(w, fd->name);
+				json_end_object(w);
 			}
+			json_end_array(w);
+			json_end_object(w);
 		}
+		json_end_array(w);
 	}
-
-	return root;
 }
 
-static cJSON *rsave_symbol_to_json(struct rsave_symbol *sym)
+static void rsave_symbol_to_json(struct json_writer *w, struct rsave_symbol *sym)
 {
 	if (sym->name)
-		return to_json_string(sym->name);
-	return cJSON_CreateNumber(sym->id);
+		write_string(w, sym->name);
+	else
+		json_int(w, sym->id);
 }
 
-static cJSON *rsave_call_frame_to_json(struct rsave_call_frame *f)
+static void rsave_call_frame_to_json(struct json_writer *w, struct rsave_call_frame *f)
 {
-	cJSON *o = cJSON_CreateObject();
-	cJSON_AddNumberToObject(o, "type", f->type);
-	cJSON_AddNumberToObject(o, "local_ptr", f->local_ptr);
-	if (f->type == RSAVE_METHOD_CALL)
-		cJSON_AddNumberToObject(o, "struct_ptr", f->struct_ptr);
-	return o;
+	json_begin_object(w);
+	json_key(w, "type");
+	json_int(w, f->type);
+	json_key(w, "local_ptr");
+	json_int(w, f->local_ptr);
+	if (f->type == RSAVE_METHOD_CALL) {
+		json_key(w, "struct_ptr");
+		json_int(w, f->struct_ptr);
+	}
+	json_end_object(w);
 }
 
-static cJSON *rsave_return_record_to_json(struct rsave_return_record *f)
+static void rsave_return_record_to_json(struct json_writer *w, struct rsave_return_record *f)
 {
-	if (f->return_addr == -1)
-		return cJSON_CreateNull();
-	cJSON *o = cJSON_CreateObject();
-	cJSON_AddNumberToObject(o, "return_addr", f->return_addr);
-	cJSON_AddItemToObjectCS(o, "caller_func", to_json_string(f->caller_func));
-	cJSON_AddNumberToObject(o, "local_addr", f->local_addr);
-	cJSON_AddNumberToObject(o, "crc", f->crc);
-	return o;
+	if (f->return_addr == -1) {
+		json_null(w);
+		return;
+	}
+	json_begin_object(w);
+	json_key(w, "return_addr");
+	json_int(w, f->return_addr);
+	json_key(w, "caller_func");
+	write_string(w, f->caller_func);
+	json_key(w, "local_addr");
+	json_int(w, f->local_addr);
+	json_key(w, "crc");
+	json_int(w, f->crc);
+	json_end_object(w);
 }
 
-static cJSON *rsave_frame_to_json(int32_t version, struct rsave_heap_frame *f)
+static void rsave_heap_header(struct json_writer *w, int32_t version, const char *type,
+		int32_t ref, int32_t seq)
 {
-	cJSON *o = cJSON_CreateObject();
-	cJSON_AddStringToObject(o, "type", f->tag == RSAVE_GLOBALS ? "globals" : "locals");
-	cJSON_AddNumberToObject(o, "ref", f->ref);
-	if (version >= 9)
-		cJSON_AddNumberToObject(o, "seq", f->seq);
-	cJSON_AddItemToObjectCS(o, "func", rsave_symbol_to_json(&f->func));
-
-	cJSON *types = cJSON_CreateArray();
-	for (int i = 0; i < f->nr_types; i++)
-		cJSON_AddItemToArray(types, cJSON_CreateNumber(f->types[i]));
-	cJSON_AddItemToObjectCS(o, "types", types);
+	json_begin_object(w);
+	json_key(w, "type");
+	json_string(w, type);
+	json_key(w, "ref");
+	json_int(w, ref);
+	if (version >= 9) {
+		json_key(w, "seq");
+		json_int(w, seq);
+	}
+}
 
-	if (f->tag == RSAVE_LOCALS && version >= 9)
-		cJSON_AddNumberToObject(o, "struct_ptr", f->struct_ptr);
-	cJSON_AddItemToObjectCS(o, "slots", int_array_to_json(f->slots, f->nr_slots));
-	return o;
+static void rsave_frame_to_json(struct json_writer *w, int32_t version, struct rsave_heap_frame *f)
+{
+	rsave_heap_header(w, version, f->tag == RSAVE_GLOBALS ? "globals" : "locals", f->ref, f->seq);
+	json_key(w, "func");
+	rsave_symbol_to_json(w, &f->func);
+	json_key(w, "types");
+	json_int_array(w, f->types, f->nr_types);
+	if (f->tag == RSAVE_LOCALS && version >= 9) {
+		json_key(w, "struct_ptr");
+		json_int(w, f->struct_ptr);
+	}
+	json_key(w, "slots");
+	json_int_array(w, f->slots, f->nr_slots);
+	json_end_object(w);
 }
 
-static cJSON *rsave_string_to_json(int32_t version, struct rsave_heap_string *s)
+static void rsave_string_to_json(struct json_writer *w, int32_t version, struct rsave_heap_string *s)
 {
-	cJSON *o = cJSON_CreateObject();
-	cJSON_AddStringToObject(o, "type", "string");
-	cJSON_AddNumberToObject(o, "ref", s->ref);
-	if (version >= 9)
-		cJSON_AddNumberToObject(o, "seq", s->seq);
-	cJSON_AddNumberToObject(o, "uk", s->uk);
+	rsave_heap_header(w, version, "string", s->ref, s->seq);
+	json_key(w, "uk");
+	json_int(w, s->uk);
+	json_key(w, "text");
 	if (strlen(s->text) + 1 == (size_t)s->len) {
-		cJSON_AddItemToObjectCS(o, "text", to_json_string(s->text));
+		write_string(w, s->text);
 	} else {
 		// Serialize as a byte array.
-		cJSON *bytes = cJSON_CreateArray();
+		json_begin_array(w);
 		for (int i = 0; i < s->len; i++)
-			cJSON_AddItemToArray(bytes, cJSON_CreateNumber(s->text[i]));
-		cJSON_AddItemToObjectCS(o, "text", bytes);
+			json_int(w, s->text[i]);
+		json_end_array(w);
 	}
-	return o;
+	json_end_object(w);
 }
 
-static cJSON *rsave_array_to_json(int32_t version, struct rsave_heap_array *a)
+static void rsave_array_to_json(struct json_writer *w, int32_t version, struct rsave_heap_array *a)
 {
-	cJSON *o = cJSON_CreateObject();
-	cJSON_AddStringToObject(o, "type", "array");
-	cJSON_AddNumberToObject(o, "ref", a->ref);
-	if (version >= 9)
-		cJSON_AddNumberToObject(o, "seq", a->seq);
-	cJSON_AddNumberToObject(o, "rank_minus_1", a->rank_minus_1);
-	cJSON_AddNumberToObject(o, "data_type", a->data_type);
-	cJSON_AddItemToObjectCS(o, "struct_type", rsave_symbol_to_json(&a->struct_type));
-	cJSON_AddNumberToObject(o, "root_rank", a->root_rank);
-	cJSON_AddNumberToObject(o, "is_not_empty", a->is_not_empty);
-	cJSON_AddItemToObjectCS(o, "slots", int_array_to_json(a->slots, a->nr_slots));
-	return o;
+	rsave_heap_header(w, version, "array", a->ref, a->seq);
+	json_key(w, "rank_minus_1");
+	json_int(w, a->rank_minus_1);
+	json_key(w, "data_type");
+	json_int(w, a->data_type);
+	json_key(w, "struct_type");
+	rsave_symbol_to_json(w, &a->struct_type);
+	json_key(w, "root_rank");
+	json_int(w, a->root_rank);
+	json_key(w, "is_not_empty");
+	json_int(w, a->is_not_empty);
+	json_key(w, "slots");
+	json_int_array(w, a->slots, a->nr_slots);
+	json_end_object(w);
 }
 
-static cJSON *rsave_struct_to_json(int32_t version, struct rsave_heap_struct *s)
+static void rsave_struct_to_json(struct json_writer *w, int32_t version, struct rsave_heap_struct *s)
 {
-	cJSON *o = cJSON_CreateObject();
-	cJSON_AddStringToObject(o, "type", "struct");
-	cJSON_AddNumberToObject(o, "ref", s->ref);
-	if (version >= 9)
-		cJSON_AddNumberToObject(o, "seq", s->seq);
-	cJSON_AddItemToObjectCS(o, "ctor", rsave_symbol_to_json(&s->ctor));
-	cJSON_AddItemToObjectCS(o, "dtor", rsave_symbol_to_json(&s->dtor));
-	cJSON_AddNumberToObject(o, "uk", s->uk);
-	cJSON_AddItemToObjectCS(o, "struct_type", rsave_symbol_to_json(&s->struct_type));
-
-	cJSON *types = cJSON_CreateArray();
-	for (int i = 0; i < s->nr_types; i++)
-		cJSON_AddItemToArray(types, cJSON_CreateNumber(s->types[i]));
-	cJSON_AddItemToObjectCS(o, "types", types);
-
-	cJSON_AddItemToObjectCS(o, "slots", int_array_to_json(s->slots, s->nr_slots));
-	return o;
+	rsave_heap_header(w, version, "struct", s->ref, s->seq);
+	json_key(w, "ctor");
+	rsave_symbol_to_json(w, &s->ctor);
+	json_key(w, "dtor");
+	rsave_symbol_to_json(w, &s->dtor);
+	json_key(w, "uk");
+	json_int(w, s->uk);
+	json_key(w, "struct_type");
+	rsave_symbol_to_json(w, &s->struct_type);
+	json_key(w, "types");
+	json_int_array(w, s->types, s->nr_types);
+	json_key(w, "slots");
+	json_int_array(w, s->slots, s->nr_slots);
+	json_end_object(w);
 }
 
-static cJSON *rsave_delegate_to_json(int32_t version, struct rsave_heap_delegate *d)
+static void rsave_delegate_to_json(struct json_writer *w, int32_t version, struct rsave_heap_delegate *d)
 {
-	cJSON *o = cJSON_CreateObject();
-	cJSON_AddStringToObject(o, "type", "delegate");
-	cJSON_AddNumberToObject(o, "ref", d->ref);
-	if (version >= 9)
-		cJSON_AddNumberToObject(o, "seq", d->seq);
-	cJSON_AddItemToObjectCS(o, "slots", int_array_to_json(d->slots, d->nr_slots));
-	return o;
+	rsave_heap_header(w, version, "delegate", d->ref, d->seq);
+	json_key(w, "slots");
+	json_int_array(w, d->slots, d->nr_slots);
+	json_end_object(w);
 }
 
-static cJSON *heap_obj_to_json(int i, void *data)
+static void heap_obj_to_json(struct json_writer *w, struct rsave *save, int i, char *error)
 {
-	struct rsave *save = data;
 	void *obj = save->heap[i];
 	enum rsave_heap_tag *tag = obj;
 	switch (*tag) {
 	case RSAVE_GLOBALS:
-	case RSAVE_LOCALS:   return rsave_frame_to_json(save->version, obj);
-	case RSAVE_STRING:   return rsave_string_to_json(save->version, obj);
-	case RSAVE_ARRAY:    return rsave_array_to_json(save->version, obj);
-	case RSAVE_STRUCT:   return rsave_struct_to_json(save->version, obj);
-	case RSAVE_DELEGATE: return rsave_delegate_to_json(save->version, obj);
-	case RSAVE_NULL:     return cJSON_CreateNull();
+	case RSAVE_LOCALS:   rsave_frame_to_json(w, save->version, obj); return;
+	case RSAVE_STRING:   rsave_string_to_json(w, save->version, obj); return;
+	case RSAVE_ARRAY:    rsave_array_to_json(w, save->version, obj); return;
+	case RSAVE_STRUCT:   rsave_struct_to_json(w, save->version, obj); return;
+	case RSAVE_DELEGATE: rsave_delegate_to_json(w, save->version, obj); return;
+	case RSAVE_NULL:     json_null(w); return;
 	}
-	ALICE_ERROR("unknown heap object tag %d", *tag);
+	value_error(w, error, "unknown heap object tag %d", *tag);
 }
 
-static cJSON *rsave_to_json(struct rsave *save)
+static bool rsave_symbol_selected(struct rsave_symbol *sym, const name_list *names)
 {
-	cJSON *root = cJSON_CreateObject();
-	cJSON_AddStringToObject(root, "save_type", "resume_save");
-	cJSON_AddNumberToObject(root, "version", save->version);
-	cJSON_AddItemToObjectCS(root, "key", to_json_string(save->key));
+	if (sym->name)
+		return name_selected(sym->name, names);
+	char id[16];
+	snprintf(id, sizeof(id), "%d", sym->id);
+	return name_selected(id, names);
+}
+
+static bool heap_obj_selected(struct rsave *save, int i, const struct projection *proj)
+{
+	enum rsave_heap_tag *tag = save->heap[i];
+	// unknown objects are selected, so that they are reported
+	if ((unsigned)*tag > RSAVE_NULL)
+		return true;
+	if (*tag == RSAVE_NULL || !(proj->heap_kinds & (1u << *tag)))
+		return false;
+	if (*tag == RSAVE_STRUCT && !vector_empty(proj->struct_types)) {
+		struct rsave_heap_struct *s = save->heap[i];
+		return rsave_symbol_selected(&s->struct_type, &proj->struct_types);
+	}
+	return true;
+}
+
+/*
+ * Write the members of the JSON object for a resume save. The caller writes
+ * the enclosing object. If the heap is projected, it is written as an object
+ * mapping heap indices to the selected objects. Heap objects which can't be
+ * represented are reported in `error`.
+ */
+static void rsave_to_json(struct json_writer *w, struct rsave *save, const struct projection *proj,
+		char *error)
+{
+	json_key(w, "save_type");
+	json_string(w, "resume_save");
+	json_key(w, "version");
+	json_int(w, save->version);
+	json_key(w, "key");
+	write_string(w, save->key);
 
 	if (save->version >= 7) {
-		cJSON_AddItemToObjectCS(root, "comments", string_array_to_json(save->comments, save->nr_comments));
+		json_key(w, "comments");
+		string_array_to_json(w, save->comments, save->nr_comments);
 	}
 	if (save->comments_only) {
-		cJSON_AddBoolToObject(root, "comments_only", true);
-		return root;
+		json_key(w, "comments_only");
+		json_bool(w, true);
+		return;
 	}
 
-	cJSON_AddItemToObjectCS(root, "ip", rsave_return_record_to_json(&save->ip));
-	cJSON_AddNumberToObject(root, "uk1", save->uk1);
-	cJSON_AddItemToObjectCS(root, "stack", int_array_to_json(save->stack, save->stack_size));
+	json_key(w, "ip");
+	rsave_return_record_to_json(w, &save->ip);
+	json_key(w, "uk1");
+	json_int(w, save->uk1);
+	json_key(w, "stack");
+	json_int_array(w, save->stack, save->stack_size);
 
-	cJSON *call_frames = cJSON_CreateArray();
+	json_key(w, "call_frames");
+	json_begin_array(w);
 	for (int i = 0; i < save->nr_call_frames; i++)
-		cJSON_AddItemToArray(call_frames, rsave_call_frame_to_json(&save->call_frames[i]));
-	cJSON_AddItemToObjectCS(root, "call_frames", call_frames);
+		rsave_call_frame_to_json(w, &save->call_frames[i]);
+	json_end_array(w);
 
-	cJSON *return_records = cJSON_CreateArray();
+	json_key(w, "return_records");
+	json_begin_array(w);
 	for (int i = 0; i < save->nr_return_records; i++)
-		cJSON_AddItemToArray(return_records, rsave_return_record_to_json(&save->return_records[i]));
-	cJSON_AddItemToObjectCS(root, "return_records", return_records);
+		rsave_return_record_to_json(w, &save->return_records[i]);
+	json_end_array(w);
+
+	json_key(w, "uk2");
+	json_int(w, save->uk2);
+	json_key(w, "uk3");
+	json_int(w, save->uk3);
+	json_key(w, "uk4");
+	json_int(w, save->uk4);
+	if (save->version >= 9) {
+		json_key(w, "next_seq");
+		json_int(w, save->next_seq);
+	}
+	json_key(w, "heap");
+	if (heap_projected(proj)) {
+		json_begin_object(w);
+		for (int i = 0; i < save->nr_heap_objs; i++) {
+			if (!heap_obj_selected(save, i, proj))
+				continue;
+			char index[16];
+			snprintf(index, sizeof(index), "%d", i);
+			json_key(w, index);
+			heap_obj_to_json(w, save, i, error);
+		}
+		json_end_object(w);
+	} else {
+		json_begin_array(w);
+		for (int i = 0; i < save->nr_heap_objs; i++)
+			heap_obj_to_json(w, save, i, error);
+		json_end_array(w);
+	}
+	json_key(w, "func_names");
+	string_array_to_json(w, save->func_names, save->nr_func_names);
+}
+
+/*
+ * Write the members of the JSON object for a decoded save file. Returns false
+ * and stores a message in `error` if the save could not be parsed (in which
+ * case nothing is written) or contains values which can't be represented (in
+ * which case the output is incomplete).
+ */
+static bool savefile_to_json(struct json_writer *w, struct savefile *save,
+		const struct projection *proj, char *error)
+{
+	enum savefile_error e;
+	*error = '\0';
+	if (!memcmp(save->buf, "RSM\0", 4)) {
+		// heap filters only limit what is written; the heap is always
+		// decoded unless nothing past the comments is wanted
+		enum rsave_read_mode mode = proj && proj->comments_only ? RSAVE_READ_COMMENTS : RSAVE_READ_ALL;
+		struct rsave *rsave = xcalloc(1, sizeof(struct rsave));
+		e = rsave_parse(save->buf, save->len, mode, rsave);
+		if (e == SAVEFILE_SUCCESS)
+			rsave_to_json(w, rsave, proj, error);
+		rsave_free(rsave);
+	} else {
+		struct gsave *gsave = xcalloc(1, sizeof(struct gsave));
+		e = gsave_parse(save->buf, save->len, gsave);
+		if (e == SAVEFILE_SUCCESS)
+			gsave_to_json(w, gsave, proj, error);
+		gsave_free(gsave);
+	}
+	if (e != SAVEFILE_SUCCESS) {
+		snprintf(error, ERROR_SIZE, "%s", savefile_strerror(e));
+		return false;
+	}
+	if (*error)
+		return false;
 
-	cJSON_AddNumberToObject(root, "uk2", save->uk2);
-	cJSON_AddNumberToObject(root, "uk3", save->uk3);
-	cJSON_AddNumberToObject(root, "uk4", save->uk4);
-	if (save->version >= 9)
-		cJSON_AddNumberToObject(root, "next_seq", save->next_seq);
-	cJSON_AddItemToObjectCS(root, "heap", cJSON_CreateArray_cb(save->nr_heap_objs, heap_obj_to_json, save));
-	cJSON_AddItemToObjectCS(root, "func_names", string_array_to_json(save->func_names, save->nr_func_names));
-	return root;
+	// Add some metadata about the envelope format.
+	json_key(w, "encrypted");
+	json_bool(w, save->encrypted);
+	json_key(w, "compression_level");
+	json_int(w, save->compression_level);
+	return true;
+}
+
+/*
+ * Batch mode: inputs are save files or directories (searched recursively for
+ * .asd files), dumped in parallel as newline-delimited JSON with one record
+ * per file, in input order. Files which can't be read or converted produce a
+ * record with only "file" and "error" members.
+ */
+
+// number of records buffered before being written out
+#define BATCH_CHUNK_SIZE 256
+
+struct dump_job {
+	struct batch *batch;
+	struct string *path;
+	uint8_t *record;
+	size_t record_size;
+};
+
+struct batch {
+	const struct projection *proj;
+	vector_t(struct dump_job) jobs;
+	atomic_uint nr_failed;
+};
+
+static void batch_add_file(struct batch *b, struct string *path)
+{
+	struct dump_job *job = vector_pushp(struct dump_job, b->jobs);
+	*job = (struct dump_job) {
+		.batch = b,
+		.path = string_ref(path),
+	};
+}
+
+static void batch_add_dir(struct batch *b, struct string *dir)
+{
+	char *d_name;
+	UDIR *d = checked_opendir(dir->text);
+	while ((d_name = readdir_utf8(d)) != NULL) {
+		if (d_name[0] == '.') {
+			free(d_name);
+			continue;
+		}
+
+		ustat s;
+		struct string *path = string_path_join(dir, d_name);
+		checked_stat(path->text, &s);
+		if (S_ISDIR(s.st_mode)) {
+			batch_add_dir(b, path);
+		} else if (S_ISREG(s.st_mode)) {
+			const char *ext = file_extension(d_name);
+			if (ext && !strcasecmp(ext, "asd"))
+				batch_add_file(b, path);
+		}
+		free_string(path);
+		free(d_name);
+	}
+	closedir_utf8(d);
+}
+
+static void batch_add_path(struct batch *b, const char *path)
+{
+	ustat s;
+	struct string *str = cstr_to_string(path);
+	if (!stat_utf8(path, &s) && S_ISDIR(s.st_mode))
+		batch_add_dir(b, str);
+	else
+		batch_add_file(b, str);
+	free_string(str);
+}
+
+/*
+ * Read input paths from a file (or stdin, if path is "-"), one per line.
+ */
+static void batch_add_file_list(struct batch *b, const char *path)
+{
+	FILE *f = strcmp(path, "-") ? checked_fopen(path, "rb") : stdin;
+	char line[PATH_MAX];
+	while (fgets(line, sizeof(line), f)) {
+		size_t len = strcspn(line, "\r\n");
+		line[len] = '\0';
+		if (len)
+			batch_add_path(b, line);
+	}
+	if (f != stdin)
+		fclose(f);
+}
+
+static void dump_job(void *data)
+{
+	struct dump_job *job = data;
+	struct port port;
+	struct json_writer *w = xmalloc(sizeof(struct json_writer));
+	port_buffer_init(&port);
+	json_writer_init(w, &port, false);
+	json_begin_object(w);
+	json_key(w, "file");
+	json_string(w, job->path->text);
+
+	char error[ERROR_SIZE];
+	enum savefile_error e;
+	struct savefile *save = savefile_read(job->path->text, &e);
+	bool ok;
+	if (save) {
+		ok = savefile_to_json(w, save, job->batch->proj, error);
+		savefile_free(save);
+	} else {
+		snprintf(error, sizeof(error), "%s", savefile_strerror(e));
+		ok = false;
+	}
+	if (!ok) {
+		WARNING("Cannot read '%s': %s", job->path->text, error);
+		// discard the partial record
+		json_writer_discard(w);
+		port_close(&port);
+		port_buffer_init(&port);
+		json_writer_init(w, &port, false);
+		json_begin_object(w);
+		json_key(w, "file");
+		json_string(w, job->path->text);
+		json_key(w, "error");
+		json_string(w, error);
+		atomic_fetch_add(&job->batch->nr_failed, 1);
+	}
+
+	json_end_object(w);
+	json_writer_fini(w);
+	port_printf(&port, "\n");
+	job->record = port_buffer_get(&port, &job->record_size);
+	port_close(&port);
+	free(w);
+}
+
+static int dump_batch(struct batch *b, FILE *out, int argc, char *argv[], const char *file_list)
+{
+	for (int i = 0; i < argc; i++) {
+		batch_add_path(b, argv[i]);
+	}
+	if (file_list)
+		batch_add_file_list(b, file_list);
+
+	// records are written in input order, a chunk at a time
+	for (size_t start = 0; start < vector_length(b->jobs); start += BATCH_CHUNK_SIZE) {
+		size_t end = min(start + BATCH_CHUNK_SIZE, vector_length(b->jobs));
+		struct job_group *group = job_group_new();
+		for (size_t i = start; i < end; i++) {
+			job_group_add(group, dump_job, &vector_A(b->jobs, i));
+		}
+		job_group_run(group);
+
+		for (size_t i = start; i < end; i++) {
+			struct dump_job *job = &vector_A(b->jobs, i);
+			if (fwrite(job->record, job->record_size, 1, out) != 1)
+				ALICE_ERROR("Error writing to file: %s", strerror(errno));
+			free(job->record);
+			free_string(job->path);
+		}
+	}
+
+	vector_destroy(b->jobs);
+	return atomic_load(&b->nr_failed) ? 1 : 0;
+}
+
+/*
+ * Parse a comma-separated list of names, converting them to the save file
+ * encoding.
+ */
+static void parse_name_list(const char *arg, name_list *names)
+{
+	char *list = xstrdup(arg);
+	for (char *name = strtok(list, ","); name; name = strtok(NULL, ",")) {
+		vector_push(char*, *names, conv_input(name));
+	}
+	free(list);
+}
+
+static unsigned parse_heap_kinds(const char *arg)
+{
+	static const struct { const char *name; enum rsave_heap_tag tag; } kinds[] = {
+		{ "globals",  RSAVE_GLOBALS },
+		{ "locals",   RSAVE_LOCALS },
+		{ "string",   RSAVE_STRING },
+		{ "array",    RSAVE_ARRAY },
+		{ "struct",   RSAVE_STRUCT },
+		{ "delegate", RSAVE_DELEGATE },
+	};
+	if (!strcmp(arg, "none"))
+		return 0;
+
+	unsigned mask = 0;
+	char *list = xstrdup(arg);
+	for (char *name = strtok(list, ","); name; name = strtok(NULL, ",")) {
+		unsigned i;
+		for (i = 0; i < sizeof(kinds) / sizeof(*kinds); i++) {
+			if (!strcmp(name, kinds[i].name))
+				break;
+		}
+		if (i == sizeof(kinds) / sizeof(*kinds))
+			USAGE_ERROR(&cmd_asd_dump, "Unknown heap object kind: %s", name);
+		mask |= 1u << kinds[i].tag;
+	}
+	free(list);
+	return mask;
 }
 
 int command_asd_dump(int argc, char *argv[])
 {
 	bool decode = false;
 	char *output_file = NULL;
+	bool batch = false;
+	const char *file_list = NULL;
+	unsigned nr_threads = 0;
+	bool project = false;
+	bool heap_kinds_set = false;
+	struct projection proj = { .heap_kinds = HEAP_KIND_ALL };
+	vector_init(proj.globals);
+	vector_init(proj.struct_types);
 
 	while (1) {
 		int c = alice_getopt(argc, argv, &cmd_asd_dump);
@@ -396,12 +873,66 @@ int command_asd_dump(int argc, char *argv[])
 		case LOPT_OUTPUT:
 			output_file = optarg;
 			break;
+		case 'b':
+		case LOPT_BATCH:
+			batch = true;
+			break;
+		case LOPT_FILE_LIST:
+			file_list = optarg;
+			break;
+		case 'j':
+		case LOPT_JOBS:
+			nr_threads = parse_jobs_arg(&cmd_asd_dump, optarg);
+			break;
+		case LOPT_GLOBALS:
+			parse_name_list(optarg, &proj.globals);
+			project = true;
+			break;
+		case LOPT_STRUCT_TYPES:
+			parse_name_list(optarg, &proj.struct_types);
+			project = true;
+			break;
+		case LOPT_HEAP_KINDS:
+			proj.heap_kinds = parse_heap_kinds(optarg);
+			heap_kinds_set = true;
+			project = true;
+			break;
+		case LOPT_COMMENTS_ONLY:
+			proj.comments_only = true;
+			project = true;
+			break;
 		}
 	}
 
 	argc -= optind;
 	argv += optind;
 
+	// selecting struct types implies selecting only struct heap objects
+	if (!vector_empty(proj.struct_types) && !heap_kinds_set)
+		proj.heap_kinds = 1u << RSAVE_STRUCT;
+	if (project && decode)
+		USAGE_ERROR(&cmd_asd_dump, "--decode cannot be used with a projection");
+
+	if (batch) {
+		if (decode)
+			USAGE_ERROR(&cmd_asd_dump, "--decode cannot be used with --batch");
+		if (argc < 1 && !file_list)
+			USAGE_ERROR(&cmd_asd_dump, "No input files specified");
+		struct batch b = { .proj = project ? &proj : NULL };
+		vector_init(b.jobs);
+		FILE *out = alice_open_output_file(output_file);
+		jobs_init(nr_threads);
+		int r = dump_batch(&b, out, argc, argv, file_list);
+		jobs_fini();
+		if (output_file)
+			fclose(out);
+		else
+			fflush(out);
+		name_list_free(&proj.globals);
+		name_list_free(&proj.struct_types);
+		return r;
+	}
+
 	if (argc != 1) {
 		USAGE_ERROR(&cmd_asd_dump, "Wrong number of arguments.");
 	}
@@ -419,32 +950,19 @@ int command_asd_dump(int argc, char *argv[])
 		return 0;
 	}
 
-	cJSON *json;
-	if (!memcmp(save->buf, "RSM\0", 4)) {
-		struct rsave *rsave = xcalloc(1, sizeof(struct rsave));
-		error = rsave_parse(save->buf, save->len, RSAVE_READ_ALL, rsave);
-		if (error != SAVEFILE_SUCCESS)
-			ALICE_ERROR("Cannot parse '%s': %s", argv[0], savefile_strerror(error));
-		json = rsave_to_json(rsave);
-		rsave_free(rsave);
-	} else {
-		struct gsave *gsave = xcalloc(1, sizeof(struct gsave));
-		error = gsave_parse(save->buf, save->len, gsave);
-		if (error != SAVEFILE_SUCCESS)
-			ALICE_ERROR("Cannot parse '%s': %s", argv[0], savefile_strerror(error));
-		json = gsave_to_json(gsave);
-		gsave_free(gsave);
-	}
-	// Add some metadata about the envelope format.
-	cJSON_AddBoolToObject(json, "encrypted", save->encrypted);
-	cJSON_AddNumberToObject(json, "compression_level", save->compression_level);
-
-	char *text = cJSON_Print(json);
-	if (fputs(text, out) == EOF)
-		ALICE_ERROR("Error writing to file: %s", strerror(errno));
-
-	free(text);
-	cJSON_Delete(json);
+	struct port port;
+	struct json_writer *w = xmalloc(sizeof(struct json_writer));
+	port_file_init(&port, out);
+	json_writer_init(w, &port, true);
+	json_begin_object(w);
+	char msg[ERROR_SIZE];
+	if (!savefile_to_json(w, save, project ? &proj : NULL, msg))
+		ALICE_ERROR("Cannot parse '%s': %s", argv[0], msg);
+	json_end_object(w);
+	json_writer_fini(w);
+	port_close(&port);
+
+	free(w);
 	savefile_free(save);
 	return 0;
 }
@@ -456,8 +974,15 @@ struct command cmd_asd_dump = {
 	.parent = &cmd_asd,
 	.fun = command_asd_dump,
 	.options = {
-		{ "decode", 'd', "Dump decrypted and uncompressed save file", no_argument, LOPT_DECODE },
-		{ "output", 'o', "Specify the output file path",              required_argument, LOPT_OUTPUT },
+		{ "decode",       'd', "Dump decrypted and uncompressed save file", no_argument, LOPT_DECODE },
+		{ "output",       'o', "Specify the output file path",              required_argument, LOPT_OUTPUT },
+		{ "batch",        'b', "Dump all arguments (files or directories) in parallel as NDJSON", no_argument, LOPT_BATCH },
+		{ "file-list",    0,   "Read input paths for --batch from a file ('-' for stdin)", required_argument, LOPT_FILE_LIST },
+		{ "jobs",         'j', "Number of parallel jobs for --batch (default: number of CPUs)", required_argument, LOPT_JOBS },
+		{ "globals",      0,   "Only dump the named globals of a global save (comma-separated)", required_argument, LOPT_GLOBALS },
+		{ "struct-types", 0,   "Only dump structs of the named types (comma-separated)", required_argument, LOPT_STRUCT_TYPES },
+		{ "heap-kinds",   0,   "Only dump heap objects of the given kinds (globals,locals,string,array,struct,delegate or none). The heap is still decoded; 'none' writes every other field with an empty heap", required_argument, LOPT_HEAP_KINDS },
+		{ "comments-only", 0,  "Only read resume saves up to the comments (skips decoding the stack and heap)", no_argument, LOPT_COMMENTS_ONLY },
 		{ 0 }
 	}
 };
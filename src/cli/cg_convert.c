@@ -14,21 +14,33 @@
  * along with this program; if not, see <http://gnu.org/licenses/>.
  */
 
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/stat.h>
 #include "system4.h"
 #include "system4/cg.h"
 #include "system4/dcf.h"
 #include "system4/file.h"
 #include "system4/string.h"
+#include "system4/vector.h"
+#include "khash.h"
 #include "alice.h"
+#include "alice/jobs.h"
 #include "cli.h"
 
 enum {
 	LOPT_TO = 256,
 	LOPT_BASE,
+	LOPT_BATCH,
+	LOPT_OUTPUT_DIR,
+	LOPT_FILE_LIST,
+	LOPT_FORCE,
+	LOPT_JOBS,
 };
 
 static enum cg_type parse_cg_format(const char *fmt)
@@ -50,11 +62,264 @@ static enum cg_type parse_cg_format(const char *fmt)
 	ALICE_ERROR("Unknown CG format: %s", fmt);
 }
 
+/*
+ * Encode a CG in memory. For DCF output, `base` is the decoded base CG and
+ * `base_name` its (UTF-8) file name.
+ */
+static uint8_t *encode_cg(struct cg *in, enum cg_type format, struct cg *base,
+		const char *base_name, size_t *size_out)
+{
+	if (format != ALCG_DCF)
+		return cg_write_mem(in, format, size_out);
+
+	char *base_sjis = conv_input(base_name);
+	uint8_t *dcf = dcf_encode(base, in, base_sjis, size_out);
+	free(base_sjis);
+	return dcf;
+}
+
+/*
+ * Batch mode: inputs are CG files or directories (searched recursively for
+ * CG files), converted in parallel. Outputs which are newer than their
+ * inputs are skipped unless --force is given.
+ */
+
+static const char * const cg_input_extensions[] = {
+	"qnt", "ajp", "png", "pms", "webp", "dcf", "pcf", NULL
+};
+
+struct convert_job {
+	struct batch *batch;
+	struct string *src;
+	struct string *dst;
+};
+
+// output path -> index of the job writing it
+KHASH_MAP_INIT_STR(output_index, size_t);
+
+struct batch {
+	enum cg_type format;
+	struct cg *base;
+	const char *base_name;
+	struct string *output_dir;
+	bool force;
+	vector_t(struct convert_job) jobs;
+	khash_t(output_index) *outputs;
+	unsigned nr_skipped;
+	atomic_uint nr_converted;
+	atomic_uint nr_failed;
+	atomic_uint_fast64_t bytes_in;
+	atomic_uint_fast64_t bytes_out;
+};
+
+static bool is_cg_file(const char *path, enum cg_type format)
+{
+	const char *ext = file_extension(path);
+	if (!ext)
+		return false;
+	// don't pick up outputs of a previous run
+	if (!strcasecmp(ext, cg_file_extension(format)))
+		return false;
+	for (int i = 0; cg_input_extensions[i]; i++) {
+		if (!strcasecmp(ext, cg_input_extensions[i]))
+			return true;
+	}
+	return false;
+}
+
+static void batch_add_file(struct batch *b, struct string *src, ustat *src_s,
+		struct string *dst_dir, const char *name)
+{
+	struct string *dst_base = dst_dir ? string_path_join(dst_dir, name) : string_ref(src);
+	struct string *dst = replace_extension(dst_base->text, cg_file_extension(b->format));
+	free_string(dst_base);
+
+	ustat dst_s;
+	if (!b->force && !stat_utf8(dst->text, &dst_s) && src_s->st_mtime < dst_s.st_mtime) {
+		b->nr_skipped++;
+		free_string(dst);
+		return;
+	}
+
+	// an input given more than once is only converted once, and two
+	// inputs can't be converted to the same output file
+	int ret;
+	khiter_t k = kh_put(output_index, b->outputs, dst->text, &ret);
+	if (!ret) {
+		struct convert_job *other = &vector_A(b->jobs, kh_value(b->outputs, k));
+		if (strcmp(other->src->text, src->text)) {
+			WARNING("Skipping %s: output file %s is already written for %s",
+					src->text, dst->text, other->src->text);
+			atomic_fetch_add(&b->nr_failed, 1);
+		}
+		free_string(dst);
+		return;
+	}
+	kh_value(b->outputs, k) = vector_length(b->jobs);
+
+	struct convert_job *job = vector_pushp(struct convert_job, b->jobs);
+	*job = (struct convert_job) {
+		.batch = b,
+		.src = string_ref(src),
+		.dst = dst,
+	};
+}
+
+static void batch_add_dir(struct batch *b, struct string *dir, struct string *dst_dir)
+{
+	char *d_name;
+	UDIR *d = checked_opendir(dir->text);
+	while ((d_name = readdir_utf8(d)) != NULL) {
+		if (d_name[0] == '.') {
+			free(d_name);
+			continue;
+		}
+
+		ustat s;
+		struct string *path = string_path_join(dir, d_name);
+		checked_stat(path->text, &s);
+		if (S_ISDIR(s.st_mode)) {
+			struct string *sub = dst_dir ? string_path_join(dst_dir, d_name) : NULL;
+			batch_add_dir(b, path, sub);
+			if (sub)
+				free_string(sub);
+		} else if (S_ISREG(s.st_mode) && is_cg_file(d_name, b->format)) {
+			batch_add_file(b, path, &s, dst_dir, d_name);
+		}
+		free_string(path);
+		free(d_name);
+	}
+	closedir_utf8(d);
+}
+
+static void batch_add_path(struct batch *b, const char *path)
+{
+	ustat s;
+	if (stat_utf8(path, &s)) {
+		WARNING("stat(\"%s\"): %s", path, strerror(errno));
+		atomic_fetch_add(&b->nr_failed, 1);
+		return;
+	}
+
+	struct string *src = cstr_to_string(path);
+	if (S_ISDIR(s.st_mode)) {
+		batch_add_dir(b, src, b->output_dir);
+	} else {
+		const char *name = strrchr(path, '/');
+		batch_add_file(b, src, &s, b->output_dir, name ? name + 1 : path);
+	}
+	free_string(src);
+}
+
+/*
+ * Read input paths from a file (or stdin, if path is "-"), one per line.
+ */
+static void batch_add_file_list(struct batch *b, const char *path)
+{
+	FILE *f = strcmp(path, "-") ? checked_fopen(path, "rb") : stdin;
+	char line[PATH_MAX];
+	while (fgets(line, sizeof(line), f)) {
+		size_t len = strcspn(line, "\r\n");
+		line[len] = '\0';
+		if (len)
+			batch_add_path(b, line);
+	}
+	if (f != stdin)
+		fclose(f);
+}
+
+static void convert_job(void *data)
+{
+	struct convert_job *job = data;
+	struct batch *b = job->batch;
+
+	struct cg *in = cg_load_file(job->src->text);
+	if (!in) {
+		WARNING("Failed to read input CG: %s", job->src->text);
+		atomic_fetch_add(&b->nr_failed, 1);
+		return;
+	}
+
+	size_t size;
+	uint8_t *data_out = encode_cg(in, b->format, b->base, b->base_name, &size);
+	cg_free(in);
+	if (!data_out) {
+		WARNING("Failed to encode CG: %s", job->src->text);
+		atomic_fetch_add(&b->nr_failed, 1);
+		return;
+	}
+
+	mkdir_for_file(job->dst->text);
+	if (!file_write(job->dst->text, data_out, size)) {
+		WARNING("file_write(\"%s\"): %s", job->dst->text, strerror(errno));
+		atomic_fetch_add(&b->nr_failed, 1);
+		free(data_out);
+		return;
+	}
+	free(data_out);
+
+	ustat s;
+	if (!stat_utf8(job->src->text, &s))
+		atomic_fetch_add(&b->bytes_in, s.st_size);
+	atomic_fetch_add(&b->bytes_out, size);
+	atomic_fetch_add(&b->nr_converted, 1);
+	NOTICE("%s -> %s", job->src->text, job->dst->text);
+}
+
+static double wall_clock(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int convert_batch(struct batch *b, int argc, char *argv[], const char *file_list)
+{
+	double start = wall_clock();
+	for (int i = 0; i < argc; i++) {
+		batch_add_path(b, argv[i]);
+	}
+	if (file_list)
+		batch_add_file_list(b, file_list);
+
+	struct job_group *group = job_group_new();
+	struct convert_job *job;
+	vector_foreach_p(job, b->jobs) {
+		job_group_add(group, convert_job, job);
+	}
+	job_group_run(group);
+
+	double elapsed = wall_clock() - start;
+	unsigned converted = atomic_load(&b->nr_converted);
+	unsigned failed = atomic_load(&b->nr_failed);
+	double mib_in = atomic_load(&b->bytes_in) / (1024.0 * 1024.0);
+	double mib_out = atomic_load(&b->bytes_out) / (1024.0 * 1024.0);
+	NOTICE("Converted %u files (%u up to date, %u failed) in %.2fs", converted,
+			b->nr_skipped, failed, elapsed);
+	if (elapsed > 0 && converted) {
+		NOTICE("%.1f files/s, %.1f MiB/s in, %.1f MiB/s out", converted / elapsed,
+				mib_in / elapsed, mib_out / elapsed);
+	}
+
+	vector_foreach_p(job, b->jobs) {
+		free_string(job->src);
+		free_string(job->dst);
+	}
+	vector_destroy(b->jobs);
+	kh_destroy(output_index, b->outputs);
+	return failed ? 1 : 0;
+}
+
 int command_cg_convert(int argc, char *argv[])
 {
 	enum cg_type output_format = ALCG_UNKNOWN;
 	struct string *output_file;
 	const char *base_cg_name = NULL;
+	bool batch = false;
+	const char *output_dir = NULL;
+	const char *file_list = NULL;
+	bool force = false;
+	unsigned nr_threads = 0;
 
 	while (1) {
 		int c = alice_getopt(argc, argv, &cmd_cg_convert);
@@ -68,12 +333,61 @@ int command_cg_convert(int argc, char *argv[])
 		case LOPT_BASE:
 			base_cg_name = optarg;
 			break;
+		case 'b':
+		case LOPT_BATCH:
+			batch = true;
+			break;
+		case 'o':
+		case LOPT_OUTPUT_DIR:
+			output_dir = optarg;
+			break;
+		case LOPT_FILE_LIST:
+			file_list = optarg;
+			break;
+		case 'f':
+		case LOPT_FORCE:
+			force = true;
+			break;
+		case 'j':
+		case LOPT_JOBS:
+			nr_threads = parse_jobs_arg(&cmd_cg_convert, optarg);
+			break;
 		}
 	}
 
 	argc -= optind;
 	argv += optind;
 
+	if (batch) {
+		if (argc < 1 && !file_list)
+			USAGE_ERROR(&cmd_cg_convert, "No input files specified");
+		if (output_format == ALCG_UNKNOWN)
+			ALICE_ERROR("No output format specified");
+		struct batch b = {
+			.format = output_format,
+			.base_name = base_cg_name,
+			.output_dir = output_dir ? cstr_to_string(output_dir) : NULL,
+			.force = force,
+		};
+		vector_init(b.jobs);
+		b.outputs = kh_init(output_index);
+		if (output_format == ALCG_DCF) {
+			// the base CG is decoded once and shared by every job
+			if (!base_cg_name)
+				ALICE_ERROR("No base CG specified for DCF encoding");
+			if (!(b.base = cg_load_file(base_cg_name)))
+				ALICE_ERROR("Failed to read base CG: %s", base_cg_name);
+		}
+		jobs_init(nr_threads);
+		int r = convert_batch(&b, argc, argv, file_list);
+		jobs_fini();
+		if (b.base)
+			cg_free(b.base);
+		if (b.output_dir)
+			free_string(b.output_dir);
+		return r;
+	}
+
 	// check argument count
 	if (argc < 1 || argc > 2)
 		USAGE_ERROR(&cmd_cg_convert, "Wrong number of arguments");
@@ -129,13 +443,18 @@ int command_cg_convert(int argc, char *argv[])
 
 struct command cmd_cg_convert = {
 	.name = "convert",
-	.usage = "[options...] <input-file> <output-file>",
-	.description = "Convert a CG file to another format",
+	.usage = "[options...] <input-file> [<output-file>] | --batch [options...] <input-file-or-dir>...",
+	.description = "Convert CG files to another format",
 	.parent = &cmd_cg,
 	.fun = command_cg_convert,
 	.options = {
 		{ "to",   't', "Specify output format", required_argument, LOPT_TO },
 		{ "base", 0,   "Specify base CG for DCF encoding", required_argument, LOPT_BASE },
+		{ "batch", 'b', "Convert all arguments (files or directories) in parallel", no_argument, LOPT_BATCH },
+		{ "output-dir", 'o', "Specify output directory for --batch (default: alongside input)", required_argument, LOPT_OUTPUT_DIR },
+		{ "file-list", 0, "Read input paths for --batch from a file ('-' for stdin)", required_argument, LOPT_FILE_LIST },
+		{ "force", 'f', "Convert files even if the output is up to date", no_argument, LOPT_FORCE },
+		{ "jobs", 'j', "Number of parallel jobs for --batch (default: number of CPUs)", required_argument, LOPT_JOBS },
 		{ 0 }
 	}
 };
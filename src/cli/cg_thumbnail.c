@@ -18,24 +18,130 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <limits.h>
 #include "system4.h"
 #include "system4/cg.h"
 #include "system4/file.h"
 #include "system4/string.h"
 #include "alice.h"
+#include "alice/jobs.h"
+#include "alice/thumbnail.h"
 #include "cli.h"
 
-struct cg *scale_cg_bicubic(struct cg *in, float scale);
-
 enum {
 	LOPT_OUTPUT = 256,
 	LOPT_SIZE,
+	LOPT_BATCH,
+	LOPT_CACHE_DIR,
+	LOPT_JOBS,
 };
 
+// number of paths read from stdin before thumbnails are generated
+#define BATCH_SIZE 64
+
+struct thumbnail_job {
+	char *path;
+	const struct string *cache_dir;
+	int size;
+	struct string *thumb;
+};
+
+static void thumbnail_job(void *data)
+{
+	struct thumbnail_job *job = data;
+	job->thumb = thumbnail_cache_file(job->cache_dir, job->path, job->size);
+}
+
+static void run_batch(struct thumbnail_job *jobs, unsigned nr_jobs)
+{
+	struct job_group *group = job_group_new();
+	for (unsigned i = 0; i < nr_jobs; i++) {
+		job_group_add(group, thumbnail_job, &jobs[i]);
+	}
+	job_group_run(group);
+
+	// results are written in input order
+	for (unsigned i = 0; i < nr_jobs; i++) {
+		if (printf("%s\n", jobs[i].thumb ? jobs[i].thumb->text : "") < 0)
+			ALICE_ERROR("Error writing to stdout: %s", strerror(errno));
+		if (jobs[i].thumb)
+			free_string(jobs[i].thumb);
+		free(jobs[i].path);
+	}
+	fflush(stdout);
+}
+
+static int hex_digit(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+/*
+ * Get a path from a line of input, which may be a path or a file:// URI.
+ */
+static char *input_path(const char *line)
+{
+	if (strncmp(line, "file://", 7))
+		return xstrdup(line);
+	char *path = xmalloc(strlen(line));
+	char *dst = path;
+	for (const char *p = line + 7; *p; p++) {
+		int hi, lo;
+		if (p[0] == '%' && (hi = hex_digit(p[1])) >= 0 && (lo = hex_digit(p[2])) >= 0) {
+			*dst++ = (hi << 4) | lo;
+			p += 2;
+		} else {
+			*dst++ = *p;
+		}
+	}
+	*dst = '\0';
+	return path;
+}
+
+/*
+ * Read paths from stdin and write the path of each file's thumbnail in the
+ * thumbnail cache to stdout (or an empty line if the file couldn't be
+ * thumbnailed), in the same order. Thumbnails are generated in batches; an
+ * empty line of input forces the current batch to be processed.
+ */
+static void thumbnail_batch(const struct string *cache_dir, int size)
+{
+	struct thumbnail_job jobs[BATCH_SIZE];
+	unsigned nr_jobs = 0;
+	char line[PATH_MAX + 8];
+	while (fgets(line, sizeof(line), stdin)) {
+		size_t len = strlen(line);
+		while (len && (line[len-1] == '\n' || line[len-1] == '\r'))
+			line[--len] = '\0';
+		if (len) {
+			jobs[nr_jobs++] = (struct thumbnail_job) {
+				.path = input_path(line),
+				.cache_dir = cache_dir,
+				.size = size,
+			};
+		}
+		if (nr_jobs == BATCH_SIZE || (!len && nr_jobs)) {
+			run_batch(jobs, nr_jobs);
+			nr_jobs = 0;
+		}
+	}
+	if (nr_jobs)
+		run_batch(jobs, nr_jobs);
+}
+
 static int command_cg_thumbnail(int argc, char *argv[])
 {
 	char *output_file = NULL;
 	int size = 256;
+	bool batch = false;
+	struct string *cache_dir = NULL;
+	unsigned nr_threads = 0;
 
 	while (1) {
 		int c = alice_getopt(argc, argv, &cmd_cg_thumbnail);
@@ -50,24 +156,47 @@ static int command_cg_thumbnail(int argc, char *argv[])
 		case LOPT_SIZE:
 			size = atoi(optarg);
 			break;
+		case 'b':
+		case LOPT_BATCH:
+			batch = true;
+			break;
+		case LOPT_CACHE_DIR:
+			cache_dir = cstr_to_string(optarg);
+			break;
+		case 'j':
+		case LOPT_JOBS:
+			nr_threads = parse_jobs_arg(&cmd_cg_thumbnail, optarg);
+			break;
 		}
 	}
 
 	argc -= optind;
 	argv += optind;
 
-	if (argc != 1)
-		USAGE_ERROR(&cmd_cg_thumbnail, "Wrong number of arguments");
 	if (size < 16 || size > 4096)
 		USAGE_ERROR(&cmd_cg_thumbnail, "Size out of range (allowed range is [16-4096])");
 
+	if (batch) {
+		if (argc != 0)
+			USAGE_ERROR(&cmd_cg_thumbnail, "Wrong number of arguments");
+		if (!cache_dir)
+			cache_dir = thumbnail_default_cache_dir();
+		jobs_init(nr_threads);
+		thumbnail_batch(cache_dir, thumbnail_cache_size(size));
+		jobs_fini();
+		free_string(cache_dir);
+		return 0;
+	}
+
+	if (argc != 1)
+		USAGE_ERROR(&cmd_cg_thumbnail, "Wrong number of arguments");
+
 	struct cg *in = cg_load_file(argv[0]);
 	if (!in)
 		ALICE_ERROR("Failed to load input CG: %s", argv[0]);
 
 	// scale/write output CG
-	float scale = (float)size / (float)max(in->metrics.w, in->metrics.h);
-	struct cg *out = scale_cg_bicubic(in, scale);
+	struct cg *out = thumbnail_scale(in, size, true);
 	// TODO: output format other than png?
 	FILE *f = checked_fopen(output_file ? output_file : "out.png", "wb");
 	if (!cg_write(out, ALCG_PNG, f))
@@ -81,13 +210,16 @@ static int command_cg_thumbnail(int argc, char *argv[])
 
 struct command cmd_cg_thumbnail = {
 	.name = "thumbnail",
-	.usage = "[options...] <input-file>",
+	.usage = "[options...] [<input-file>]",
 	.description = "Create a thumbnail from a CG",
 	.parent = &cmd_cg,
 	.fun = command_cg_thumbnail,
 	.options = {
 		{ "output", 'o', "Specify output file (default 'out.png')", required_argument, LOPT_OUTPUT },
 		{ "size",   's', "Specify output size (default 256)", required_argument, LOPT_SIZE },
+		{ "batch",  'b', "Read input files from stdin and write thumbnails to the thumbnail cache", no_argument, LOPT_BATCH },
+		{ "cache-dir", 0, "Specify the thumbnail cache directory (default $XDG_CACHE_HOME/thumbnails)", required_argument, LOPT_CACHE_DIR },
+		{ "jobs",   'j', "Number of parallel jobs for --batch (default: number of CPUs)", required_argument, LOPT_JOBS },
 		{ 0 }
 	}
 };
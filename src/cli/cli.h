@@ -45,6 +45,7 @@ struct command {
 void print_usage(struct command *cmd);
 int alice_getopt(int argc, char *argv[], struct command *cmd);
 FILE *alice_open_output_file(const char *path);
+unsigned parse_jobs_arg(struct command *cmd, const char *arg);
 
 extern struct command cmd_acx_dump;
 extern struct command cmd_acx_build;
@@ -54,12 +55,14 @@ extern struct command cmd_ain_edit;
 extern struct command cmd_ar_extract;
 extern struct command cmd_ar_list;
 extern struct command cmd_ar_pack;
+extern struct command cmd_ar_thumbnail;
 extern struct command cmd_asd_dump;
 extern struct command cmd_asd_build;
 extern struct command cmd_cg_convert;
 extern struct command cmd_cg_thumbnail;
 extern struct command cmd_ex_build;
 extern struct command cmd_ex_compare;
+extern struct command cmd_ex_diff;
 extern struct command cmd_ex_dump;
 extern struct command cmd_ex_edit;
 extern struct command cmd_flat_build;
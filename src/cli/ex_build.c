@@ -30,7 +30,6 @@
 #include "cli.h"
 
 extern bool columns_first;
-extern unsigned long yex_line;
 
 enum {
 	LOPT_OUTPUT = 256,
@@ -0,0 +1,83 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <getopt.h>
+#include "system4.h"
+#include "system4/ex.h"
+#include "alice.h"
+#include "alice/ex.h"
+#include "alice/port.h"
+#include "cli.h"
+
+enum {
+	LOPT_OUTPUT = 256,
+};
+
+static int command_ex_diff(int argc, char *argv[])
+{
+	char *output_file = NULL;
+
+	while (1) {
+		int c = alice_getopt(argc, argv, &cmd_ex_diff);
+		if (c == -1)
+			break;
+
+		switch (c) {
+		case 'o':
+		case LOPT_OUTPUT:
+			output_file = optarg;
+			break;
+		}
+	}
+
+	argc -= optind;
+	argv += optind;
+
+	if (argc != 2) {
+		USAGE_ERROR(&cmd_ex_diff, "Wrong number of arguments.");
+	}
+
+	struct ex_reader *a = ex_reader_open(argv[0]);
+	if (!a)
+		ALICE_ERROR("ex_reader_open(\"%s\") failed", argv[0]);
+	struct ex_reader *b = ex_reader_open(argv[1]);
+	if (!b)
+		ALICE_ERROR("ex_reader_open(\"%s\") failed", argv[1]);
+
+	FILE *out = alice_open_output_file(output_file);
+	struct port port;
+	port_file_init(&port, out);
+	ex_diff(&port, a, b);
+	port_close(&port);
+	fclose(out);
+
+	ex_reader_close(a);
+	ex_reader_close(b);
+	return 0;
+}
+
+struct command cmd_ex_diff = {
+	.name = "diff",
+	.usage = "[options...] <old-file> <new-file>",
+	.description = "Write a patch which transforms one .ex file into another",
+	.parent = &cmd_ex,
+	.fun = command_ex_diff,
+	.options = {
+		{ "output", 'o', "Specify the output file path", required_argument, LOPT_OUTPUT },
+		{ 0 }
+	}
+};
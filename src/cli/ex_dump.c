@@ -27,8 +27,10 @@
 #include "system4.h"
 #include "system4/ex.h"
 #include "system4/string.h"
+#include "system4/vector.h"
 #include "alice.h"
 #include "alice/ex.h"
+#include "alice/jobs.h"
 #include "alice/port.h"
 #include "cli.h"
 
@@ -36,13 +38,62 @@ enum {
 	LOPT_DECRYPT = 256,
 	LOPT_OUTPUT,
 	LOPT_SPLIT,
+	LOPT_JOBS,
+	LOPT_PATH,
 };
 
+/*
+ * Dump the blocks or tree nodes named by `paths` (<block>[.<node>...]). Only
+ * the blocks containing them are decoded.
+ */
+static void dump_paths(struct port *port, struct ex_reader *r, char **paths, unsigned nr_paths)
+{
+	struct ex_tree_index *index = ex_tree_index_new();
+	for (unsigned i = 0; i < nr_paths; i++) {
+		char *path = conv_input(paths[i]);
+		char *name = strtok(path, ".");
+		int b = name ? ex_reader_find(r, name) : -1;
+		if (b < 0)
+			ALICE_ERROR("No block named '%s'", paths[i]);
+
+		// blocks stay decoded so that their trees are only indexed once
+		struct ex_block *block = ex_reader_block(r, b);
+		struct string *key = block->name;
+		struct ex_value *value = &block->val;
+		struct ex_value node_value = { .type = EX_TREE };
+		while ((name = strtok(NULL, "."))) {
+			if (value->type != EX_TREE)
+				ALICE_ERROR("No node named '%s'", paths[i]);
+			struct ex_tree *node = ex_tree_index_child(index, value->tree, name);
+			if (!node)
+				ALICE_ERROR("No node named '%s'", paths[i]);
+			if (node->is_leaf) {
+				key = node->leaf.name;
+				value = &node->leaf.value;
+			} else {
+				key = node->name;
+				node_value.tree = node;
+				value = &node_value;
+			}
+		}
+		free(path);
+
+		ex_dump_key_value(port, key, value);
+		port_putc(port, ';');
+		if (i+1 < nr_paths)
+			port_printf(port, "\n\n");
+	}
+	port_putc(port, '\n');
+	ex_tree_index_free(index);
+}
+
 int command_ex_dump(int argc, char *argv[])
 {
 	bool decrypt = false;
 	bool split = false;
 	char *output_file = NULL;
+	unsigned nr_threads = 0;
+	vector_t(char*) paths = vector_initializer;
 
 	while (1) {
 		int c = alice_getopt(argc, argv, &cmd_ex_dump);
@@ -62,6 +113,13 @@ int command_ex_dump(int argc, char *argv[])
 		case LOPT_SPLIT:
 			split = true;
 			break;
+		case 'j':
+		case LOPT_JOBS:
+			nr_threads = parse_jobs_arg(&cmd_ex_dump, optarg);
+			break;
+		case LOPT_PATH:
+			vector_push(char*, paths, optarg);
+			break;
 		}
 	}
 
@@ -84,25 +142,36 @@ int command_ex_dump(int argc, char *argv[])
 		return 0;
 	}
 
-	struct ex *ex = ex_read_file(argv[0]);
+	struct ex_reader *ex = ex_reader_open(argv[0]);
 	if (!ex)
-		ALICE_ERROR("ex_read_file(\"%s\") failed", argv[0]);
+		ALICE_ERROR("ex_reader_open(\"%s\") failed", argv[0]);
 
-	if (split) {
+	if (!vector_empty(paths)) {
+		if (split)
+			USAGE_ERROR(&cmd_ex_dump, "--path cannot be used with --split");
+		struct port port;
+		port_file_init(&port, out);
+		dump_paths(&port, ex, vector_data(paths), vector_length(paths));
+		port_close(&port);
+		fclose(out);
+	} else if (split) {
 		const char *dir;
 		if (output_file)
 			dir = dirname(output_file);
 		else
 			dir = ".";
+		jobs_init(nr_threads);
 		ex_dump_split(out, ex, dir);
+		jobs_fini();
 	} else {
 		struct port port;
 		port_file_init(&port, out);
-		ex_dump(&port, ex);
+		ex_dump_reader(&port, ex);
 		port_close(&port);
 		fclose(out);
 	}
-	ex_free(ex);
+	ex_reader_close(ex);
+	vector_destroy(paths);
 
 	return 0;
 }
@@ -117,6 +186,8 @@ struct command cmd_ex_dump = {
 		{ "decrypt", 'd', "Decrypt the .ex file only",            no_argument, LOPT_DECRYPT },
 		{ "output",  'o', "Specify the output file path",         required_argument, LOPT_OUTPUT },
 		{ "split",   's', "Split the output into multiple files", no_argument, LOPT_SPLIT },
+		{ "jobs",    'j', "Number of parallel jobs for --split (default: number of CPUs)", required_argument, LOPT_JOBS },
+		{ "path",    0,   "Only dump the given block or tree node (<block>[.<node>...]); may be repeated", required_argument, LOPT_PATH },
 		{ 0 }
 	}
 };
@@ -28,12 +28,14 @@ enum {
 	LOPT_OLD,
 	LOPT_EXTRACT,
 	LOPT_REPLACE,
+	LOPT_PATCH,
 };
 
 static int command_ex_edit(int argc, char *argv[]) {
 	const char *output_file = NULL;
 	bool extract = false;
 	bool replace = false;
+	bool patch = false;
 	set_input_encoding("UTF-8");
 	set_output_encoding("CP932");
 
@@ -58,6 +60,10 @@ static int command_ex_edit(int argc, char *argv[]) {
 		case LOPT_REPLACE:
 			replace = true;
 			break;
+		case 'p':
+		case LOPT_PATCH:
+			patch = true;
+			break;
 		}
 	}
 
@@ -67,34 +73,40 @@ static int command_ex_edit(int argc, char *argv[]) {
 	if (argc != 2) {
 		USAGE_ERROR(&cmd_ex_edit, "Wrong number of arguments");
 	}
-	if (extract && replace) {
-		USAGE_ERROR(&cmd_ex_edit, "Cannot extract and replace in the same operation");
+	if (extract + replace + patch > 1) {
+		USAGE_ERROR(&cmd_ex_edit, "Only one of --extract, --replace and --patch may be given");
 	}
 
 	FILE *out = alice_open_output_file(output_file);
 
-	struct ex *base = ex_read_file(argv[0]);
-	if (!base) {
-		ALICE_ERROR("failed to read .ex file: %s", argv[0]);
-	}
-
 	struct ex *edit = ex_parse_file(argv[1]);
 	if (!edit) {
 		ALICE_ERROR("failed to parse .txtex file: %s", argv[1]);
 	}
 
 	if (extract) {
+		struct ex *base = ex_read_file(argv[0]);
+		if (!base) {
+			ALICE_ERROR("failed to read .ex file: %s", argv[0]);
+		}
 		struct ex *extract = ex_extract_append(base, edit);
 		ex_write(out, extract);
 		ex_free(extract);
-	} else if (replace) {
-		ex_replace(base, edit);
-		ex_write(out, base);
+		ex_free(base);
 	} else {
-		ex_append(base, edit);
-		ex_write(out, base);
+		// only the blocks named in the edit are decoded and re-encoded
+		struct ex_reader *base = ex_reader_open(argv[0]);
+		if (!base) {
+			ALICE_ERROR("failed to read .ex file: %s", argv[0]);
+		}
+		enum ex_edit_mode mode = patch ? EX_EDIT_PATCH
+			: replace ? EX_EDIT_REPLACE
+			: EX_EDIT_APPEND;
+		size_t size;
+		uint8_t *flat = ex_splice(base, edit, mode, &size);
+		ex_write_flat(out, flat, size);
+		ex_reader_close(base);
 	}
-	ex_free(base);
 	ex_free(edit);
 	fclose(out);
 	return 0;
@@ -111,6 +123,7 @@ struct command cmd_ex_edit = {
 		{ "old",       0, "Use for pre-Evenicle .ex files",    no_argument,       LOPT_OLD },
 		{ "extract", 'e', "Only write modified objects",       no_argument,       LOPT_EXTRACT },
 		{ "replace", 'r', "Replace data instead of appending", no_argument,       LOPT_REPLACE },
+		{ "patch",   'p', "Apply a patch from 'ex diff'",      no_argument,       LOPT_PATCH },
 		{ 0 }
 	}
 };
@@ -23,16 +23,19 @@
 #include "system4/string.h"
 #include "alice.h"
 #include "alice/flat.h"
+#include "alice/jobs.h"
 #include "cli.h"
 
 enum {
 	LOPT_OUTPUT = 256,
+	LOPT_JOBS,
 };
 
 int command_flat_build(int argc, char *argv[])
 {
 	struct string *mf_output_file = NULL;
 	struct string *output_file = NULL;
+	unsigned nr_threads = 0;
 	set_input_encoding("UTF-8");
 	set_output_encoding("CP932");
 
@@ -45,6 +48,10 @@ int command_flat_build(int argc, char *argv[])
 		case LOPT_OUTPUT:
 			output_file = make_string(optarg, strlen(optarg));
 			break;
+		case 'j':
+		case LOPT_JOBS:
+			nr_threads = parse_jobs_arg(&cmd_flat_build, optarg);
+			break;
 		}
 	}
 
@@ -57,7 +64,9 @@ int command_flat_build(int argc, char *argv[])
 	}
 
 	// build flat object from manifest
+	jobs_init(nr_threads);
 	struct flat *flat = flat_build(argv[0], &mf_output_file);
+	jobs_fini();
 	if (!output_file) {
 		if (mf_output_file) {
 			struct string *dir = cstr_to_string(path_dirname(argv[0]));
@@ -88,6 +97,7 @@ struct command cmd_flat_build = {
 	.fun = command_flat_build,
 	.options = {
 		{ "output", 'o', "Specify the output file", required_argument, LOPT_OUTPUT },
+		{ "jobs",   'j', "Number of parallel jobs (default: number of CPUs)", required_argument, LOPT_JOBS },
 		{ 0 }
 	}
 };
@@ -25,6 +25,7 @@
 #include "system4/string.h"
 #include "alice.h"
 #include "alice/flat.h"
+#include "alice/jobs.h"
 #include "cli.h"
 
 static struct string *get_output_path(const char *output_file, const char *input_file)
@@ -37,12 +38,14 @@ static struct string *get_output_path(const char *output_file, const char *input
 enum {
 	LOPT_OUTPUT = 256,
 	LOPT_PNG,
+	LOPT_JOBS,
 };
 
 int command_flat_extract(int argc, char *argv[])
 {
 	char *output_file = NULL;
 	bool png = false;
+	unsigned nr_threads = 0;
 
 	while (1) {
 		int c = alice_getopt(argc, argv, &cmd_flat_extract);
@@ -56,6 +59,10 @@ int command_flat_extract(int argc, char *argv[])
 		case LOPT_PNG:
 			png = true;
 			break;
+		case 'j':
+		case LOPT_JOBS:
+			nr_threads = parse_jobs_arg(&cmd_flat_extract, optarg);
+			break;
 		}
 	}
 
@@ -81,7 +88,9 @@ int command_flat_extract(int argc, char *argv[])
 
 	// write manifest
 	struct string *out_file = get_output_path(output_file, argv[0]);
+	jobs_init(nr_threads);
 	flat_extract(flat, out_file->text, png);
+	jobs_fini();
 
 	free_string(out_file);
 	flat_free(flat);
@@ -98,6 +107,7 @@ struct command cmd_flat_extract = {
 	.options = {
 		{ "output", 'o', "Specify output file", required_argument, LOPT_OUTPUT },
 		{ "png",    0,   "Output images as .png format", no_argument, LOPT_PNG },
+		{ "jobs",   'j', "Number of parallel jobs (default: number of CPUs)", required_argument, LOPT_JOBS },
 		{ 0 }
 	}
 };
@@ -21,8 +21,10 @@
 #include <errno.h>
 #include <getopt.h>
 #include <limits.h>
+#include <math.h>
 #include <webp/encode.h>
 #include <png.h>
+#include "cJSON.h"
 #include "little_endian.h"
 #include "system4.h"
 #include "system4/file.h"
@@ -30,13 +32,17 @@
 #include "system4/string.h"
 #include "system4/utfsjis.h"
 #include "alice.h"
+#include "alice/jobs.h"
 #include "cli.h"
 
-static void write_bitmap(FILE *f, struct fnl_glyph *g, uint8_t *pixels)
+/*
+ * Write a 1-bit grayscale PNG. 'rows' points to each row of the image, from
+ * top to bottom.
+ */
+static void write_png(FILE *f, unsigned width, unsigned height, png_byte **rows)
 {
 	png_structp png_ptr = NULL;
 	png_infop info_ptr = NULL;
-	png_byte **row_pointers = NULL;
 
 	png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
 	if (!png_ptr)
@@ -54,39 +60,197 @@ static void write_bitmap(FILE *f, struct fnl_glyph *g, uint8_t *pixels)
 	if (setjmp(png_jmpbuf(png_ptr)))
 		ERROR("png_write_header failed");
 
-	png_set_IHDR(png_ptr, info_ptr, g->width, g->height, 1,
+	png_set_IHDR(png_ptr, info_ptr, width, height, 1,
 		     PNG_COLOR_TYPE_GRAY, PNG_INTERLACE_NONE,
 		     PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
 	png_write_info(png_ptr, info_ptr);
 
-	uint32_t stride = fnl_glyph_stride(g);
-	row_pointers = png_malloc(png_ptr, g->height * sizeof(png_byte*));
-	for (unsigned i = 0; i < g->height; i++) {
-		row_pointers[g->height - (i+1)] = pixels + i*stride;
-	}
-
 	if (setjmp(png_jmpbuf(png_ptr)))
 		ERROR("png_write_image failed");
 
-	png_write_image(png_ptr, row_pointers);
+	png_write_image(png_ptr, rows);
 
 	if (setjmp(png_jmpbuf(png_ptr)))
 		ERROR("png_write_end failed");
 
 	png_write_end(png_ptr, NULL);
-
-	png_free(png_ptr, row_pointers);
 	png_destroy_write_struct(&png_ptr, &info_ptr);
 }
 
+static FILE *open_output(const char *path)
+{
+	FILE *f = file_open_utf8(path, "wb");
+	if (!f) {
+		ERROR("fopen failed: %s", strerror(errno));
+	}
+	return f;
+}
+
+// number of glyphs exported by a single job
+#define GLYPHS_PER_JOB 256
+
+struct glyph_job {
+	struct fnl *fnl;
+	struct fnl_font_face *face;
+	unsigned font;
+	const char *output_dir;
+	size_t start;
+	size_t end;
+};
+
+static void glyph_job(void *data)
+{
+	struct glyph_job *job = data;
+	char path[PATH_MAX];
+	// row pointers are reused for every glyph in the job
+	unsigned max_rows = 0;
+	png_byte **rows = NULL;
+
+	for (size_t g = job->start; g < job->end; g++) {
+		struct fnl_glyph *glyph = &job->face->glyphs[g];
+		if (!glyph->data_pos)
+			continue;
+
+		if (glyph->height > max_rows) {
+			max_rows = glyph->height;
+			rows = xrealloc(rows, max_rows * sizeof(png_byte*));
+		}
+
+		// glyph bitmaps are stored bottom-up
+		uint8_t *pixels = fnl_glyph_data(job->fnl, glyph);
+		uint32_t stride = fnl_glyph_stride(glyph);
+		for (unsigned i = 0; i < glyph->height; i++) {
+			rows[glyph->height - (i+1)] = pixels + i*stride;
+		}
+
+		snprintf(path, sizeof(path), "%s/font_%u/%upx/glyph_%u.png", job->output_dir,
+				job->font, (unsigned)job->face->height, (unsigned)g);
+		FILE *f = open_output(path);
+		write_png(f, glyph->width, glyph->height, rows);
+		fclose(f);
+		free(pixels);
+	}
+	free(rows);
+	free(job);
+}
+
+/*
+ * Write every glyph of a face into a single PNG (glyphs are laid out in a
+ * grid of equally sized cells), along with a JSON index giving the position
+ * and size of each glyph within the atlas.
+ */
+static void atlas_job(void *data)
+{
+	struct glyph_job *job = data;
+	struct fnl_font_face *face = job->face;
+	char path[PATH_MAX];
+
+	unsigned cell_w = 1, cell_h = 1, nr_glyphs = 0;
+	for (size_t g = 0; g < face->nr_glyphs; g++) {
+		struct fnl_glyph *glyph = &face->glyphs[g];
+		if (!glyph->data_pos)
+			continue;
+		cell_w = max(cell_w, glyph->width);
+		cell_h = max(cell_h, glyph->height);
+		nr_glyphs++;
+	}
+
+	// roughly square atlas
+	unsigned cols = max(1, (unsigned)ceil(sqrt(nr_glyphs * (double)cell_h / cell_w)));
+	unsigned atlas_rows = max(1, (nr_glyphs + cols - 1) / cols);
+	unsigned width = cols * cell_w;
+	unsigned height = atlas_rows * cell_h;
+	unsigned stride = (width + 7) / 8;
+	uint8_t *atlas = xcalloc(height, stride);
+
+	cJSON *index = cJSON_CreateObject();
+	cJSON_AddNumberToObject(index, "width", width);
+	cJSON_AddNumberToObject(index, "height", height);
+	cJSON *glyphs = cJSON_AddArrayToObject(index, "glyphs");
+
+	unsigned n = 0;
+	for (size_t g = 0; g < face->nr_glyphs; g++) {
+		struct fnl_glyph *glyph = &face->glyphs[g];
+		if (!glyph->data_pos)
+			continue;
+
+		unsigned x = (n % cols) * cell_w;
+		unsigned y = (n / cols) * cell_h;
+		uint8_t *pixels = fnl_glyph_data(job->fnl, glyph);
+		uint32_t glyph_stride = fnl_glyph_stride(glyph);
+		for (unsigned row = 0; row < glyph->height; row++) {
+			// glyph bitmaps are stored bottom-up
+			uint8_t *src = pixels + (glyph->height - (row+1)) * glyph_stride;
+			uint8_t *dst = atlas + (y + row) * stride;
+			for (unsigned col = 0; col < glyph->width; col++) {
+				if (src[col / 8] & (0x80 >> (col % 8)))
+					dst[(x + col) / 8] |= 0x80 >> ((x + col) % 8);
+			}
+		}
+		free(pixels);
+
+		cJSON *o = cJSON_CreateObject();
+		cJSON_AddNumberToObject(o, "glyph", g);
+		cJSON_AddNumberToObject(o, "x", x);
+		cJSON_AddNumberToObject(o, "y", y);
+		cJSON_AddNumberToObject(o, "width", glyph->width);
+		cJSON_AddNumberToObject(o, "height", glyph->height);
+		cJSON_AddItemToArray(glyphs, o);
+		n++;
+	}
+
+	png_byte **rows = xmalloc(height * sizeof(png_byte*));
+	for (unsigned i = 0; i < height; i++) {
+		rows[i] = atlas + i*stride;
+	}
+	snprintf(path, sizeof(path), "%s/font_%u/%upx.png", job->output_dir, job->font,
+			(unsigned)face->height);
+	FILE *f = open_output(path);
+	write_png(f, width, height, rows);
+	fclose(f);
+	free(rows);
+	free(atlas);
+
+	snprintf(path, sizeof(path), "%s/font_%u/%upx.json", job->output_dir, job->font,
+			(unsigned)face->height);
+	f = open_output(path);
+	char *text = cJSON_Print(index);
+	if (fputs(text, f) == EOF)
+		ERROR("fputs failed: %s", strerror(errno));
+	fclose(f);
+	free(text);
+	cJSON_Delete(index);
+	free(job);
+}
+
+static void add_job(struct job_group *group, void (*fun)(void*), struct fnl *fnl,
+		struct fnl_font_face *face, unsigned font, const char *output_dir,
+		size_t start, size_t end)
+{
+	struct glyph_job *job = xmalloc(sizeof(struct glyph_job));
+	*job = (struct glyph_job) {
+		.fnl = fnl,
+		.face = face,
+		.font = font,
+		.output_dir = output_dir,
+		.start = start,
+		.end = end,
+	};
+	job_group_add(group, fun, job);
+}
+
 enum {
 	LOPT_OUTPUT = 256,
+	LOPT_ATLAS,
+	LOPT_JOBS,
 };
 
 int command_fnl_dump(int argc, char *argv[])
 {
 	char path[PATH_MAX];
 	char *output_dir = ".";
+	bool atlas = false;
+	unsigned nr_threads = 0;
 	while (1) {
 		int c = alice_getopt(argc, argv, &cmd_fnl_dump);
 		if (c == -1)
@@ -97,6 +261,14 @@ int command_fnl_dump(int argc, char *argv[])
 		case LOPT_OUTPUT:
 			output_dir = optarg;
 			break;
+		case 'a':
+		case LOPT_ATLAS:
+			atlas = true;
+			break;
+		case 'j':
+		case LOPT_JOBS:
+			nr_threads = parse_jobs_arg(&cmd_fnl_dump, optarg);
+			break;
 		}
 	}
 
@@ -111,6 +283,8 @@ int command_fnl_dump(int argc, char *argv[])
 	if (!fnl)
 		ALICE_ERROR("fnl_open failed");
 
+	jobs_init(nr_threads);
+	struct job_group *group = job_group_new();
 	for (size_t font = 0; font < fnl->nr_fonts; font++) {
 		NOTICE("FONT %u", (unsigned)font);
 		for (size_t face = 0; face < fnl->fonts[font].nr_faces; face++) {
@@ -118,29 +292,26 @@ int command_fnl_dump(int argc, char *argv[])
 			NOTICE("\tsize %lu (%lu glyphs)", font_face->height, font_face->nr_glyphs);
 
 			// create subdir
-			sprintf(path, "%s/font_%u/%upx", output_dir, (unsigned)font, (unsigned)font_face->height);
+			if (atlas)
+				sprintf(path, "%s/font_%u", output_dir, (unsigned)font);
+			else
+				sprintf(path, "%s/font_%u/%upx", output_dir, (unsigned)font, (unsigned)font_face->height);
 			mkdir_p(path);
 
 			// extract glyphs
-			for (size_t g = 0; g < font_face->nr_glyphs; g++) {
-				struct fnl_glyph *glyph = &font_face->glyphs[g];
-				if (!glyph->data_pos)
-					continue;
-
-				sprintf(path, "%s/font_%u/%upx/glyph_%u.png", output_dir, (unsigned)font,
-					(unsigned)font_face->height, (unsigned)g);
-				FILE *f = file_open_utf8(path, "wb");
-				if (!f) {
-					ERROR("fopen failed: %s", strerror(errno));
-				}
-
-				uint8_t *data = fnl_glyph_data(fnl, glyph);
-				write_bitmap(f, glyph, data);
-				free(data);
-				fclose(f);
+			if (atlas) {
+				add_job(group, atlas_job, fnl, font_face, font, output_dir, 0, font_face->nr_glyphs);
+				continue;
+			}
+			for (size_t g = 0; g < font_face->nr_glyphs; g += GLYPHS_PER_JOB) {
+				size_t end = min(g + GLYPHS_PER_JOB, font_face->nr_glyphs);
+				add_job(group, glyph_job, fnl, font_face, font, output_dir, g, end);
 			}
 		}
 	}
+	job_group_run(group);
+	jobs_fini();
+
 	fnl_free(fnl);
 	return 0;
 }
@@ -153,6 +324,8 @@ struct command cmd_fnl_dump = {
 	.fun = command_fnl_dump,
 	.options = {
 		{ "output", 'o', "Specify the output directory", required_argument, LOPT_OUTPUT },
+		{ "atlas",  'a', "Write each face as a single atlas PNG with a JSON index", no_argument, LOPT_ATLAS },
+		{ "jobs",   'j', "Number of parallel jobs (default: number of CPUs)", required_argument, LOPT_JOBS },
 		{ 0 }
 	}
 };
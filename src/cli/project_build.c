@@ -21,11 +21,20 @@
 #include "system4.h"
 #include "system4/file.h"
 #include "alice.h"
+#include "alice/jobs.h"
+#include "alice/profile.h"
 #include "alice/project.h"
 #include "cli.h"
 
+enum {
+	LOPT_JOBS = 256,
+	LOPT_PROFILE,
+};
+
 static int command_project_build(int argc, char *argv[])
 {
+	const char *profile_file = NULL;
+	unsigned nr_threads = 0;
 	set_input_encoding("UTF-8");
 	set_output_encoding("CP932");
 
@@ -33,6 +42,15 @@ static int command_project_build(int argc, char *argv[])
 		int c = alice_getopt(argc, argv, &cmd_project_build);
 		if (c == -1)
 			break;
+		switch (c) {
+		case 'j':
+		case LOPT_JOBS:
+			nr_threads = parse_jobs_arg(&cmd_project_build, optarg);
+			break;
+		case LOPT_PROFILE:
+			profile_file = optarg;
+			break;
+		}
 	}
 
 	argc -= optind;
@@ -41,7 +59,20 @@ static int command_project_build(int argc, char *argv[])
 	if (argc != 1)
 		USAGE_ERROR(&cmd_project_build, "Wrong number of arguments");
 
+	if (profile_file)
+		profile_enable();
+
+	jobs_init(nr_threads);
 	pje_build(argv[0]);
+	jobs_fini();
+
+	if (profile_file) {
+		profile_print_summary(stdout);
+		FILE *out = checked_fopen(profile_file, "wb");
+		profile_write_chrome_trace(out);
+		fclose(out);
+		profile_fini();
+	}
 	return 0;
 }
 
@@ -52,6 +83,8 @@ struct command cmd_project_build = {
 	.parent = &cmd_project,
 	.fun = command_project_build,
 	.options = {
+		{ "jobs", 'j', "Number of parallel jobs (default: number of CPUs)", required_argument, LOPT_JOBS },
+		{ "profile", 0, "Profile the build (writes a Chrome trace)", required_argument, LOPT_PROFILE },
 		{ 0 }
 	}
 };
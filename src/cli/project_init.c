@@ -111,9 +111,9 @@ static void dump_hll(struct ain *ain)
 
 static void dump_ex(const char *project_name, const char *ex_name)
 {
-	struct ex *ex = ex_read_file(ex_name);
+	struct ex_reader *ex = ex_reader_open(ex_name);
 	if (!ex)
-		ALICE_ERROR("ex_read_file(\"%s\") failed", ex_name);
+		ALICE_ERROR("ex_reader_open(\"%s\") failed", ex_name);
 
 	// alice ex dump --split -o ex/$PROJECT_NAME.x $EXPATH
 	mkdir_p_checked("ex");
@@ -123,7 +123,7 @@ static void dump_ex(const char *project_name, const char *ex_name)
 	NOTICE("alice ex dump --split -o \"%s\" \"%s\"", out_name, ex_name);
 	FILE *out = alice_open_output_file(out_name);
 	ex_dump_split(out, ex, "ex");
-	ex_free(ex);
+	ex_reader_close(ex);
 }
 
 static char *get_project_name(const char *base_name)
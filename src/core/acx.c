@@ -28,13 +28,95 @@
 #include "alice.h"
 #include "alice/acx.h"
 
-// TODO: this should write to a buffer instead of a file, and there should be a
-//       separate wrapper function which writes to a file
+/*
+ * Streaming ACX writer. Records are serialized into a fixed-size chunk and
+ * deflated straight to the output file, so memory use doesn't depend on the
+ * size of the table. The compressed size is patched into the header once the
+ * stream is finished; when the output isn't seekable (e.g. a pipe), the
+ * compressed data is collected in memory instead.
+ */
+
+#define ACX_CHUNK_SIZE (64 * 1024)
+
+struct acx_writer {
+	FILE *out;
+	z_stream z;
+	struct buffer *mem;
+	unsigned long compressed_size;
+	size_t in_len;
+	uint8_t in[ACX_CHUNK_SIZE];
+	uint8_t out_buf[ACX_CHUNK_SIZE];
+};
+
+static void writer_emit(struct acx_writer *w, uint8_t *data, size_t size)
+{
+	if (!size)
+		return;
+	w->compressed_size += size;
+	if (w->mem)
+		buffer_write_bytes(w->mem, data, size);
+	else if (fwrite(data, size, 1, w->out) != 1)
+		ERROR("fwrite: %s", strerror(errno));
+}
+
+static void writer_deflate(struct acx_writer *w, uint8_t *data, size_t size, int flush)
+{
+	w->z.next_in = data;
+	w->z.avail_in = size;
+	do {
+		w->z.next_out = w->out_buf;
+		w->z.avail_out = ACX_CHUNK_SIZE;
+		int r = deflate(&w->z, flush);
+		if (r == Z_STREAM_ERROR)
+			ERROR("deflate failed");
+		writer_emit(w, w->out_buf, ACX_CHUNK_SIZE - w->z.avail_out);
+		if (r == Z_STREAM_END)
+			break;
+	} while (w->z.avail_out == 0 || (flush == Z_FINISH));
+}
+
+static void writer_flush(struct acx_writer *w)
+{
+	writer_deflate(w, w->in, w->in_len, Z_NO_FLUSH);
+	w->in_len = 0;
+}
+
+static void writer_bytes(struct acx_writer *w, const void *data, size_t size)
+{
+	if (w->in_len + size > ACX_CHUNK_SIZE) {
+		writer_flush(w);
+		// large values bypass the chunk
+		if (size > ACX_CHUNK_SIZE) {
+			writer_deflate(w, (uint8_t*)data, size, Z_NO_FLUSH);
+			return;
+		}
+	}
+	memcpy(w->in + w->in_len, data, size);
+	w->in_len += size;
+}
+
+static void writer_int32(struct acx_writer *w, int32_t v)
+{
+	uint8_t b[4];
+	LittleEndian_putDW(b, 0, v);
+	writer_bytes(w, b, 4);
+}
+
+static void write_header(FILE *out, unsigned long compressed_size, unsigned long size)
+{
+	uint8_t header[8];
+	LittleEndian_putDW(header, 0, compressed_size);
+	LittleEndian_putDW(header, 4, size);
+	if (fwrite(header, 8, 1, out) != 1)
+		ERROR("fwrite: %s", strerror(errno));
+}
+
 void acx_write(FILE *out, struct acx *acx)
 {
 	if (fwrite("ACX\0\0\0\0", 8, 1, out) != 1)
 		ERROR("fwrite: %s", strerror(errno));
 
+	// size of the serialized (uncompressed) data
 	unsigned long size = 8 + acx->nr_columns*4;
 	for (int line = 0; line < acx->nr_lines; line++) {
 		for (int col = 0; col < acx->nr_columns; col++) {
@@ -46,93 +128,175 @@ void acx_write(FILE *out, struct acx *acx)
 		}
 	}
 
-	// serialize
-	struct buffer buf;
-	buffer_init(&buf, NULL, 0);
+	struct acx_writer *w = xcalloc(1, sizeof(struct acx_writer));
+	w->out = out;
+	if (deflateInit(&w->z, 1) != Z_OK)
+		ERROR("deflateInit failed");
+
+	// write placeholder header (patched below)
+	long header_pos = ftell(out);
+	struct buffer mem;
+	if (header_pos < 0) {
+		buffer_init(&mem, NULL, 0);
+		w->mem = &mem;
+	} else {
+		write_header(out, 0, size);
+	}
 
-	buffer_write_int32(&buf, acx->nr_columns);
+	// serialize
+	writer_int32(w, acx->nr_columns);
 	for (int col = 0; col < acx->nr_columns; col++) {
-		buffer_write_int32(&buf, acx->column_types[col]);
+		writer_int32(w, acx->column_types[col]);
 	}
-	buffer_write_int32(&buf, acx->nr_lines);
+	writer_int32(w, acx->nr_lines);
 
 	for (int line = 0; line < acx->nr_lines; line++) {
 		for (int col = 0; col < acx->nr_columns; col++) {
 			if (acx->column_types[col] == ACX_STRING) {
-				buffer_write_string(&buf, acx->lines[line*acx->nr_columns + col].s);
+				struct string *s = acx->lines[line*acx->nr_columns + col].s;
+				writer_bytes(w, s->text, s->size + 1);
 			} else {
-				buffer_write_int32(&buf, acx->lines[line*acx->nr_columns + col].i);
+				writer_int32(w, acx->lines[line*acx->nr_columns + col].i);
 			}
 		}
 	}
+	writer_deflate(w, w->in, w->in_len, Z_FINISH);
+	deflateEnd(&w->z);
 
-	// compress serialized data
-	unsigned long compressed_size = buf.index * 1.001 + 12;
-	uint8_t *dst = xmalloc(compressed_size);
-	int r = compress2(dst, &compressed_size, buf.buf, buf.index, 1);
-	if (r != Z_OK) {
-		ERROR("compress failed");
+	if (w->mem) {
+		write_header(out, w->compressed_size, size);
+		if (fwrite(mem.buf, mem.index, 1, out) != 1)
+			ERROR("fwrite: %s", strerror(errno));
+		free(mem.buf);
+	} else {
+		// patch compressed size into header
+		long end = ftell(out);
+		if (fseek(out, header_pos, SEEK_SET))
+			ERROR("fseek: %s", strerror(errno));
+		write_header(out, w->compressed_size, size);
+		if (fseek(out, end, SEEK_SET))
+			ERROR("fseek: %s", strerror(errno));
 	}
 
-	// write data header
-	uint8_t header[8];
-	LittleEndian_putDW(header, 0, compressed_size);
-	LittleEndian_putDW(header, 4, buf.index);
-	if (fwrite(header, 8, 1, out) != 1)
-		ERROR("fwrite: %s", strerror(errno));
+	fflush(out);
+	free(w);
+}
 
-	// write compressed data
-	if (fwrite(dst, compressed_size, 1, out) != 1)
-		ERROR("fwrite: %s", strerror(errno));
+/*
+ * Buffered CSV output. Cells are appended to a fixed-size buffer which is
+ * written out with a single fwrite when full.
+ */
 
-	fflush(out);
-	free(buf.buf);
-	free(dst);
+#define CSV_BUFFER_SIZE (64 * 1024)
+
+struct csv_writer {
+	FILE *out;
+	size_t len;
+	char buf[CSV_BUFFER_SIZE];
+};
+
+static void csv_flush(struct csv_writer *w)
+{
+	if (w->len && fwrite(w->buf, w->len, 1, w->out) != 1)
+		ALICE_ERROR("fwrite: %s", strerror(errno));
+	w->len = 0;
 }
 
-static void write_string(FILE *out, const char *str)
+static void csv_write(struct csv_writer *w, const char *data, size_t size)
 {
-	char *u = conv_output(str);
-
-	fputc('"', out);
-	for (int i = 0; u[i]; i++) {
-		switch (u[i]) {
-		case '"':  fprintf(out, "\\\""); break;
-		case '\n': fprintf(out, "\\n");  break;
-		default:   fputc(u[i], out);     break;
+	if (w->len + size > CSV_BUFFER_SIZE) {
+		csv_flush(w);
+		if (size > CSV_BUFFER_SIZE) {
+			if (fwrite(data, size, 1, w->out) != 1)
+				ALICE_ERROR("fwrite: %s", strerror(errno));
+			return;
 		}
 	}
-	fputc('"', out);
+	memcpy(w->buf + w->len, data, size);
+	w->len += size;
+}
+
+static void csv_putc(struct csv_writer *w, char c)
+{
+	if (w->len == CSV_BUFFER_SIZE)
+		csv_flush(w);
+	w->buf[w->len++] = c;
+}
+
+static void csv_write_int(struct csv_writer *w, int i)
+{
+	char buf[16];
+	int len = snprintf(buf, sizeof(buf), "%d", i);
+	csv_write(w, buf, len);
+}
+
+static bool is_ascii(const char *str)
+{
+	for (const uint8_t *p = (const uint8_t*)str; *p; p++) {
+		if (*p >= 0x80)
+			return false;
+	}
+	return true;
+}
+
+static void write_string(struct csv_writer *w, const char *str)
+{
+	// plain ASCII is the same in every output encoding
+	char *u = is_ascii(str) ? NULL : conv_output(str);
+	const char *p = u ? u : str;
+
+	csv_putc(w, '"');
+	while (*p) {
+		// copy runs of characters that don't need escaping in bulk
+		size_t run = strcspn(p, "\"\n");
+		csv_write(w, p, run);
+		p += run;
+		if (*p == '"')
+			csv_write(w, "\\\"", 2);
+		else if (*p == '\n')
+			csv_write(w, "\\n", 2);
+		else
+			break;
+		p++;
+	}
+	csv_putc(w, '"');
 
 	free(u);
 }
 
 void acx_dump(FILE *out, struct acx *acx)
 {
+	struct csv_writer *w = xmalloc(sizeof(struct csv_writer));
+	w->out = out;
+	w->len = 0;
+
 	for (int col = 0; col < acx->nr_columns; col++) {
 		if (col > 0)
-			fputc(',', out);
+			csv_putc(w, ',');
 		switch (acx->column_types[col]) {
-		case ACX_INT:    fprintf(out, "int"); break;
-		case ACX_STRING: fprintf(out, "string"); break;
+		case ACX_INT:    csv_write(w, "int", 3); break;
+		case ACX_STRING: csv_write(w, "string", 6); break;
 		default:
 			WARNING("Unknown column type: %d", acx->column_types[col]);
-			fprintf(out, "%d", acx->column_types[col]);
+			csv_write_int(w, acx->column_types[col]);
 			break;
 		}
 	}
-	fputc('\n', out);
+	csv_putc(w, '\n');
 
 	for (int line = 0; line < acx->nr_lines; line++) {
 		for (int col = 0; col < acx->nr_columns; col++) {
 			if (col > 0)
-				fputc(',', out);
+				csv_putc(w, ',');
 			if (acx->column_types[col] == ACX_STRING) {
-				write_string(out, acx_get_string(acx, line, col)->text);
+				write_string(w, acx_get_string(acx, line, col)->text);
 			} else {
-				fprintf(out, "%d", acx_get_int(acx, line, col));
+				csv_write_int(w, acx_get_int(acx, line, col));
 			}
 		}
-		fputc('\n', out);
+		csv_putc(w, '\n');
 	}
+
+	csv_flush(w);
+	free(w);
 }
@@ -20,340 +20,369 @@
 #include <string.h>
 #include <errno.h>
 #include "alice.h"
-#include "cJSON.h"
+#include "alice/json.h"
+#include "alice/port.h"
 #include "system4.h"
 #include "system4/ain.h"
 #include "system4/string.h"
 
-static cJSON *_ain_type_to_json(possibly_unused struct ain *ain, struct ain_type *t)
+static void ain_type_to_json(struct json_writer *w, struct ain_type *t)
 {
-	cJSON *a = cJSON_CreateArray();
-	cJSON_AddItemToArray(a, cJSON_CreateNumber(t->data));
-	cJSON_AddItemToArray(a, cJSON_CreateNumber(t->struc));
-	cJSON_AddItemToArray(a, cJSON_CreateNumber(t->rank));
-	return a;
-}
-
-static cJSON *ain_type_to_json(struct ain *ain, struct ain_type *t)
-{
-	cJSON *a = _ain_type_to_json(ain, t);
+	json_begin_array(w);
+	json_int(w, t->data);
+	json_int(w, t->struc);
+	json_int(w, t->rank);
 	if (t->array_type) {
-		cJSON_AddItemToArray(a, ain_type_to_json(ain, t->array_type));
+		ain_type_to_json(w, t->array_type);
 	} else {
-		cJSON_AddItemToArray(a, cJSON_CreateNull());
+		json_null(w);
 	}
-	return a;
+	json_end_array(w);
 }
 
-static cJSON *ain_variable_to_json(struct ain *ain, struct ain_variable *var)
+static void ain_variable_to_json(struct json_writer *w, struct ain_variable *var)
 {
-	cJSON *o = cJSON_CreateObject();
-	cJSON_AddStringToObject(o, "name", var->name);
-	if (var->name2)
-		cJSON_AddStringToObject(o, "name2", var->name2);
-	cJSON_AddItemToObject(o, "type", ain_type_to_json(ain, &var->type));
+	json_begin_object(w);
+	json_key(w, "name");
+	json_string(w, var->name);
+	if (var->name2) {
+		json_key(w, "name2");
+		json_string(w, var->name2);
+	}
+	json_key(w, "type");
+	ain_type_to_json(w, &var->type);
 	if (var->has_initval) {
+		json_key(w, "initval");
 		switch (var->type.data) {
 		case AIN_STRING:
-			cJSON_AddStringToObject(o, "initval", var->initval.s);
+			json_string(w, var->initval.s);
 			break;
 		case AIN_FLOAT:
-			cJSON_AddNumberToObject(o, "initval", var->initval.f);
+			json_number(w, var->initval.f);
 			break;
 		default:
-			cJSON_AddNumberToObject(o, "initval", var->initval.i);
+			json_int(w, var->initval.i);
 		}
 	}
-	if (var->group_index >= 0)
-		cJSON_AddNumberToObject(o, "group-index", var->group_index);
-	return o;
+	if (var->group_index >= 0) {
+		json_key(w, "group-index");
+		json_int(w, var->group_index);
+	}
+	json_end_object(w);
 }
 
-static cJSON *ain_function_to_json(struct ain *ain, struct ain_function *f)
+static void ain_variables_to_json(struct json_writer *w, struct ain_variable *vars, int start, int end)
 {
-	cJSON *a;
-	cJSON *o = cJSON_CreateObject();
-	cJSON_AddNumberToObject(o, "index", f - ain->functions);
-	cJSON_AddNumberToObject(o, "address", f->address);
-	cJSON_AddStringToObject(o, "name", f->name);
-	if (f->is_label)
-		cJSON_AddBoolToObject(o, "is-label", true);
-	cJSON_AddItemToObject(o, "return-type", ain_type_to_json(ain, &f->return_type));
-	if (f->is_lambda)
-		cJSON_AddBoolToObject(o, "unknown-bool", true);
-	cJSON_AddNumberToObject(o, "crc", f->crc);
-
-	a = cJSON_CreateArray();
-	for (int i = 0; i < f->nr_args; i++) {
-		cJSON_AddItemToArray(a, ain_variable_to_json(ain, &f->vars[i]));
+	json_begin_array(w);
+	for (int i = start; i < end; i++) {
+		ain_variable_to_json(w, &vars[i]);
 	}
-	cJSON_AddItemToObject(o, "arguments", a);
+	json_end_array(w);
+}
 
-	a = cJSON_CreateArray();
-	for (int i = f->nr_args; i < f->nr_vars; i++) {
-		cJSON_AddItemToArray(a, ain_variable_to_json(ain, &f->vars[i]));
+static void ain_function_to_json(struct json_writer *w, struct ain *ain, struct ain_function *f)
+{
+	json_begin_object(w);
+	json_key(w, "index");
+	json_int(w, f - ain->functions);
+	json_key(w, "address");
+	json_int(w, f->address);
+	json_key(w, "name");
+	json_string(w, f->name);
+	if (f->is_label) {
+		json_key(w, "is-label");
+		json_bool(w, true);
 	}
-	cJSON_AddItemToObject(o, "variables", a);
-	return o;
+	json_key(w, "return-type");
+	ain_type_to_json(w, &f->return_type);
+	if (f->is_lambda) {
+		json_key(w, "unknown-bool");
+		json_bool(w, true);
+	}
+	json_key(w, "crc");
+	json_number(w, f->crc);
+	json_key(w, "arguments");
+	ain_variables_to_json(w, f->vars, 0, f->nr_args);
+	json_key(w, "variables");
+	ain_variables_to_json(w, f->vars, f->nr_args, f->nr_vars);
+	json_end_object(w);
 }
 
-static cJSON *ain_structure_to_json(struct ain *ain, struct ain_struct *s)
+static void ain_structure_to_json(struct json_writer *w, struct ain_struct *s)
 {
-	cJSON *a;
-	cJSON *o = cJSON_CreateObject();
-	cJSON_AddStringToObject(o, "name", s->name);
+	json_begin_object(w);
+	json_key(w, "name");
+	json_string(w, s->name);
 
 	if (s->nr_interfaces > 0) {
-		a = cJSON_CreateArray();
+		json_key(w, "interfaces");
+		json_begin_array(w);
 		for (int i = 0; i < s->nr_interfaces; i++) {
-			cJSON *iface = cJSON_CreateArray();
-			cJSON_AddItemToArray(iface, cJSON_CreateNumber(s->interfaces[i].struct_type)); // TODO: use struct name
-			cJSON_AddItemToArray(iface, cJSON_CreateNumber(s->interfaces[i].vtable_offset));
-			cJSON_AddItemToArray(a, iface);
+			json_begin_array(w);
+			json_int(w, s->interfaces[i].struct_type); // TODO: use struct name
+			json_int(w, s->interfaces[i].vtable_offset);
+			json_end_array(w);
 		}
-		cJSON_AddItemToObject(o, "interfaces", a);
+		json_end_array(w);
 	}
 
-	if (s->constructor >= 0)
-		cJSON_AddNumberToObject(o, "constructor", s->constructor); // TODO: use function name
-	if (s->destructor >= 0)
-		cJSON_AddNumberToObject(o, "destructor", s->destructor); // TODO: use function name
-
-	a = cJSON_CreateArray();
-	for (int i = 0; i < s->nr_members; i++) {
-		cJSON_AddItemToArray(a, ain_variable_to_json(ain, &s->members[i]));
+	if (s->constructor >= 0) {
+		json_key(w, "constructor");
+		json_int(w, s->constructor); // TODO: use function name
+	}
+	if (s->destructor >= 0) {
+		json_key(w, "destructor");
+		json_int(w, s->destructor); // TODO: use function name
 	}
-	cJSON_AddItemToObject(o, "members", a);
 
-	return o;
+	json_key(w, "members");
+	ain_variables_to_json(w, s->members, 0, s->nr_members);
+	json_end_object(w);
 }
 
-static cJSON *ain_library_to_json(struct ain *ain, struct ain_library *lib)
+static void ain_library_to_json(struct json_writer *w, struct ain *ain, struct ain_library *lib)
 {
-	cJSON *o = cJSON_CreateObject();
-	cJSON_AddStringToObject(o, "name", lib->name);
+	json_begin_object(w);
+	json_key(w, "name");
+	json_string(w, lib->name);
 
-	cJSON *functions = cJSON_CreateArray();
+	json_key(w, "functions");
+	json_begin_array(w);
 	for (int i = 0; i < lib->nr_functions; i++) {
-		cJSON *f = cJSON_CreateObject();
-		cJSON_AddStringToObject(f, "name", lib->functions[i].name);
+		json_begin_object(w);
+		json_key(w, "name");
+		json_string(w, lib->functions[i].name);
+		json_key(w, "return-type");
 		if (AIN_VERSION_GTE(ain, 14, 0)) {
-			cJSON_AddItemToObject(f, "return-type",
-					ain_type_to_json(ain, &lib->functions[i].return_type));
+			ain_type_to_json(w, &lib->functions[i].return_type);
 		} else {
-			cJSON_AddNumberToObject(f, "return-type",
-					lib->functions[i].return_type.data);
+			json_int(w, lib->functions[i].return_type.data);
 		}
 
-		cJSON *args = cJSON_CreateArray();
+		json_key(w, "arguments");
+		json_begin_array(w);
 		for (int j = 0; j < lib->functions[i].nr_arguments; j++) {
 			struct ain_hll_argument *a = &lib->functions[i].arguments[j];
-			cJSON *arg = cJSON_CreateObject();
-			cJSON_AddStringToObject(arg, "name", a->name);
+			json_begin_object(w);
+			json_key(w, "name");
+			json_string(w, a->name);
+			json_key(w, "type");
 			if (AIN_VERSION_GTE(ain, 14, 0)) {
-				cJSON_AddItemToObject(arg, "type", ain_type_to_json(ain, &a->type));
+				ain_type_to_json(w, &a->type);
 			} else {
-				cJSON_AddNumberToObject(arg, "type", a->type.data);
+				json_int(w, a->type.data);
 			}
-			cJSON_AddItemToArray(args, arg);
+			json_end_object(w);
 		}
-		cJSON_AddItemToObject(f, "arguments", args);
-		cJSON_AddItemToArray(functions, f);
+		json_end_array(w);
+		json_end_object(w);
 	}
-	cJSON_AddItemToObject(o, "functions", functions);
+	json_end_array(w);
 
-	return o;
+	json_end_object(w);
 }
 
-static cJSON *ain_switch_to_json(struct ain_switch *sw)
+static void ain_switch_to_json(struct json_writer *w, struct ain_switch *sw)
 {
-	cJSON *o = cJSON_CreateObject();
-	cJSON_AddNumberToObject(o, "case-type", sw->case_type);
-	cJSON_AddNumberToObject(o, "default-address", sw->default_address);
-
-	cJSON *a = cJSON_CreateArray();
+	json_begin_object(w);
+	json_key(w, "case-type");
+	json_int(w, sw->case_type);
+	json_key(w, "default-address");
+	json_int(w, sw->default_address);
+
+	json_key(w, "cases");
+	json_begin_array(w);
 	for (int i = 0; i < sw->nr_cases; i++) {
-		cJSON *scase = cJSON_CreateObject();
-		cJSON_AddNumberToObject(scase, "value", sw->cases[i].value);
-		cJSON_AddNumberToObject(scase, "address", sw->cases[i].address);
-		cJSON_AddItemToArray(a, scase);
+		json_begin_object(w);
+		json_key(w, "value");
+		json_int(w, sw->cases[i].value);
+		json_key(w, "address");
+		json_int(w, sw->cases[i].address);
+		json_end_object(w);
 	}
-	cJSON_AddItemToObject(o, "cases", a);
+	json_end_array(w);
 
-	return o;
+	json_end_object(w);
 }
 
-static cJSON *ain_scenario_label_to_json(struct ain_scenario_label *label)
+static void ain_scenario_label_to_json(struct json_writer *w, struct ain_scenario_label *label)
 {
-	cJSON *o = cJSON_CreateObject();
-	cJSON_AddStringToObject(o, "name", label->name);
-	cJSON_AddNumberToObject(o, "address", label->address);
-	return o;
+	json_begin_object(w);
+	json_key(w, "name");
+	json_string(w, label->name);
+	json_key(w, "address");
+	json_int(w, label->address);
+	json_end_object(w);
 }
 
-static cJSON *ain_function_type_to_json(struct ain *ain, struct ain_function_type *ft)
+static void ain_function_type_to_json(struct json_writer *w, struct ain_function_type *ft)
 {
-	cJSON *a;
-	cJSON *o = cJSON_CreateObject();
-	cJSON_AddStringToObject(o, "name", ft->name);
-	cJSON_AddItemToObject(o, "return-type", ain_type_to_json(ain, &ft->return_type));
-
-	a = cJSON_CreateArray();
-	for (int i = 0; i < ft->nr_arguments; i++) {
-		cJSON_AddItemToArray(a, ain_variable_to_json(ain, &ft->variables[i]));
-	}
-	cJSON_AddItemToObject(o, "arguments", a);
-
-	a = cJSON_CreateArray();
-	for (int i = ft->nr_arguments; i < ft->nr_variables; i++) {
-		cJSON_AddItemToArray(a, ain_variable_to_json(ain, &ft->variables[i]));
-	}
-	cJSON_AddItemToObject(o, "variables", a);
-
-	return o;
+	json_begin_object(w);
+	json_key(w, "name");
+	json_string(w, ft->name);
+	json_key(w, "return-type");
+	ain_type_to_json(w, &ft->return_type);
+	json_key(w, "arguments");
+	ain_variables_to_json(w, ft->variables, 0, ft->nr_arguments);
+	json_key(w, "variables");
+	ain_variables_to_json(w, ft->variables, ft->nr_arguments, ft->nr_variables);
+	json_end_object(w);
 }
 
-static cJSON *ain_enum_to_json(struct ain_enum *e)
+static void ain_enum_to_json(struct json_writer *w, struct ain_enum *e)
 {
-	cJSON *o = cJSON_CreateObject();
-	cJSON_AddStringToObject(o, "name", e->name);
+	json_begin_object(w);
+	json_key(w, "name");
+	json_string(w, e->name);
 
-	cJSON *a = cJSON_CreateArray();
+	json_key(w, "values");
+	json_begin_array(w);
 	for (int i = 0; i < e->nr_values; i++) {
-		cJSON *v = cJSON_CreateArray();
-		cJSON_AddItemToArray(v, cJSON_CreateString(e->values[i].symbol->text));
-		cJSON_AddItemToArray(v, cJSON_CreateNumber(e->values[i].value));
-		cJSON_AddItemToArray(a, v);
+		json_begin_array(w);
+		json_string(w, e->values[i].symbol->text);
+		json_int(w, e->values[i].value);
+		json_end_array(w);
 	}
-	cJSON_AddItemToObject(o, "values", a);
+	json_end_array(w);
 
-	return o;
+	json_end_object(w);
 }
 
-static cJSON *ain_to_json(struct ain *ain)
+static void ain_to_json(struct json_writer *w, struct ain *ain)
 {
-	cJSON *a;
-	cJSON *j = cJSON_CreateObject();
+	json_begin_object(w);
 
 	// VERS: ain version
-	cJSON_AddNumberToObject(j, "version", ain->version);
+	json_key(w, "version");
+	json_int(w, ain->version);
 
 	// KEYC: keycode
-	cJSON_AddNumberToObject(j, "keycode", ain->keycode);
+	json_key(w, "keycode");
+	json_int(w, ain->keycode);
 
 	// FUNC: functions
-	a = cJSON_CreateArray();
+	json_key(w, "functions");
+	json_begin_array(w);
 	for (int i = 0; i < ain->nr_functions; i++) {
-		cJSON_AddItemToArray(a, ain_function_to_json(ain, &ain->functions[i]));
+		ain_function_to_json(w, ain, &ain->functions[i]);
 	}
-	cJSON_AddItemToObject(j, "functions", a);
+	json_end_array(w);
 
 	// GLOB: globals
-	a = cJSON_CreateArray();
-	for (int i = 0; i < ain->nr_globals; i++) {
-		cJSON_AddItemToArray(a, ain_variable_to_json(ain, &ain->globals[i]));
-	}
-	cJSON_AddItemToObject(j, "globals", a);
+	json_key(w, "globals");
+	ain_variables_to_json(w, ain->globals, 0, ain->nr_globals);
 
 	// STRT: structures
-	a = cJSON_CreateArray();
+	json_key(w, "structures");
+	json_begin_array(w);
 	for (int i = 0; i < ain->nr_structures; i++) {
-		cJSON_AddItemToArray(a, ain_structure_to_json(ain, &ain->structures[i]));
+		ain_structure_to_json(w, &ain->structures[i]);
 	}
-	cJSON_AddItemToObject(j, "structures", a);
+	json_end_array(w);
 
 	// MAIN: main function index
-	cJSON_AddNumberToObject(j, "main", ain->main);
+	json_key(w, "main");
+	json_int(w, ain->main);
 
 	// MSGF: message function index
-	cJSON_AddNumberToObject(j, "msgf", ain->msgf);
+	json_key(w, "msgf");
+	json_int(w, ain->msgf);
 
 	// HLL0: libraries
-	a = cJSON_CreateArray();
+	json_key(w, "libraries");
+	json_begin_array(w);
 	for (int i = 0; i < ain->nr_libraries; i++) {
-		cJSON_AddItemToArray(a, ain_library_to_json(ain, &ain->libraries[i]));
+		ain_library_to_json(w, ain, &ain->libraries[i]);
 	}
-	cJSON_AddItemToObject(j, "libraries", a);
+	json_end_array(w);
 
 	// SWI0: switch
-	a = cJSON_CreateArray();
+	json_key(w, "switches");
+	json_begin_array(w);
 	for (int i = 0; i < ain->nr_switches; i++) {
-		cJSON_AddItemToArray(a, ain_switch_to_json(&ain->switches[i]));
+		ain_switch_to_json(w, &ain->switches[i]);
 	}
-	cJSON_AddItemToObject(j, "switches", a);
+	json_end_array(w);
 
 	// GVER: game version
-	cJSON_AddNumberToObject(j, "game-version", ain->game_version);
+	json_key(w, "game-version");
+	json_int(w, ain->game_version);
 
 	// SLBL: scenario labels
 	if (ain->nr_scenario_labels > 0) {
-		a = cJSON_CreateArray();
+		json_key(w, "scenario-labels");
+		json_begin_array(w);
 		for (int i = 0; i < ain->nr_scenario_labels; i++) {
-			cJSON_AddItemToArray(a, ain_scenario_label_to_json(&ain->scenario_labels[i]));
+			ain_scenario_label_to_json(w, &ain->scenario_labels[i]);
 		}
-		cJSON_AddItemToObject(j, "scenario-labels", a);
+		json_end_array(w);
 	}
 
 	// FNAM: filenames
-	a = cJSON_CreateArray();
+	json_key(w, "filenames");
+	json_begin_array(w);
 	for (int i = 0; i < ain->nr_filenames; i++) {
-		cJSON_AddItemToArray(a, cJSON_CreateString(ain->filenames[i]));
+		json_string(w, ain->filenames[i]);
 	}
-	cJSON_AddItemToObject(j, "filenames", a);
+	json_end_array(w);
 
 	// OJMP: ???
-	cJSON_AddNumberToObject(j, "ojmp", ain->ojmp);
+	json_key(w, "ojmp");
+	json_int(w, ain->ojmp);
 
 	// FNCT: function types
 	if (ain->nr_function_types > 0) {
-		a = cJSON_CreateArray();
+		json_key(w, "function-types");
+		json_begin_array(w);
 		for (int i = 0; i < ain->nr_function_types; i++) {
-			cJSON_AddItemToArray(a, ain_function_type_to_json(ain, &ain->function_types[i]));
+			ain_function_type_to_json(w, &ain->function_types[i]);
 		}
-		cJSON_AddItemToObject(j, "function-types", a);
+		json_end_array(w);
 	}
 
 	// DELG: delegates
 	if (ain->nr_delegates > 0) {
-		a = cJSON_CreateArray();
+		json_key(w, "delegates");
+		json_begin_array(w);
 		for (int i = 0; i < ain->nr_delegates; i++) {
-			cJSON_AddItemToArray(a, ain_function_type_to_json(ain, &ain->delegates[i]));
+			ain_function_type_to_json(w, &ain->delegates[i]);
 		}
-		cJSON_AddItemToObject(j, "delegates", a);
+		json_end_array(w);
 	}
 
 	// OBJG: global group names
 	if (ain->nr_global_groups > 0) {
-		a = cJSON_CreateArray();
+		json_key(w, "global-groups");
+		json_begin_array(w);
 		for (int i = 0; i < ain->nr_global_groups; i++) {
-			cJSON_AddItemToArray(a, cJSON_CreateString(ain->global_group_names[i]));
+			json_string(w, ain->global_group_names[i]);
 		}
-		cJSON_AddItemToObject(j, "global-groups", a);
+		json_end_array(w);
 	}
 
 	// ENUM: enumerations
 	if (ain->nr_enums > 0) {
-		a = cJSON_CreateArray();
+		json_key(w, "enums");
+		json_begin_array(w);
 		for (int i = 0; i < ain->nr_enums; i++) {
-			cJSON_AddItemToArray(a, ain_enum_to_json(&ain->enums[i]));
+			ain_enum_to_json(w, &ain->enums[i]);
 		}
-		cJSON_AddItemToObject(j, "enums", a);
+		json_end_array(w);
 	}
 
-	return j;
+	json_end_object(w);
 }
 
 void ain_dump_json(FILE *out, struct ain *ain)
 {
-	cJSON *j = ain_to_json(ain);
-	char *str = cJSON_Print(j);
-
-	if (fwrite(str, strlen(str), 1, out) != 1)
-		ERROR("Failed to write to file: %s", strerror(errno));
+	struct port port;
+	struct json_writer *w = xmalloc(sizeof(struct json_writer));
+	port_file_init(&port, out);
+	json_writer_init(w, &port, true);
+	ain_to_json(w, ain);
+	json_writer_fini(w);
+	free(w);
 
 	if (fclose(out))
 		ERROR("Failed to close file: %s", strerror(errno));
-
-	free(str);
-	cJSON_Delete(j);
 }
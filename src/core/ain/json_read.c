@@ -19,526 +19,838 @@
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
-#include "cJSON.h"
 #include "system4.h"
 #include "system4/ain.h"
 #include "system4/file.h"
 #include "system4/string.h"
-
-static bool cJSON_GetObjectBool(const cJSON * const o, const char * const name, bool def)
-{
-	cJSON *v = cJSON_GetObjectItem(o, name);
-	if (v && !cJSON_IsBool(v))
-		ERROR("Expected a boolean for '%s'", name);
-	return v ? v->valueint : def;
-}
-
-static int cJSON_GetObjectInteger(const cJSON * const o, const char * const name, int def)
-{
-	cJSON *v = cJSON_GetObjectItem(o, name);
-	if (v && !cJSON_IsNumber(v))
-		ERROR("Expected a number for '%s'", name);
-	return v ? v->valueint : def;
-}
-
-static int cJSON_GetObjectInteger_NonNull(const cJSON * const o, const char * const name)
-{
-	cJSON *v = cJSON_GetObjectItem(o, name);
-	if (!v || !cJSON_IsNumber(v))
-		ERROR("Expected a number for '%s'", name);
-	return v->valueint;
-}
-
-static char *cJSON_GetObjectString(const cJSON * const o, const char * const name)
-{
-	cJSON *v = cJSON_GetObjectItem(o, name);
-	if (v && !cJSON_IsString(v))
-		ERROR("Expected string for '%s'", name);
-	return v ? strdup(v->valuestring) : NULL;
-}
-
-static char *cJSON_GetObjectString_NonNull(const cJSON * const o, const char * const name)
-{
-	cJSON *v = cJSON_GetObjectItem(o, name);
-	if (!v || !cJSON_IsString(v))
-		ERROR("Expected string for '%s'", name);
-	return strdup(v->valuestring);
-}
-
-static cJSON *cJSON_GetObjectArray(const cJSON * const o, const char * const name)
-{
-	cJSON *v = cJSON_GetObjectItem(o, name);
-	if (v && !cJSON_IsArray(v))
-		ERROR("Expected an array for '%s'", name);
-	return v;
-}
-
-static cJSON *cJSON_GetObjectArray_NonNull(const cJSON * const o, const char * const name)
-{
-	cJSON *v = cJSON_GetObjectItem(o, name);
-	if (!v || !cJSON_IsArray(v))
-		ERROR("Expected an array for '%s'", name);
-	return v;
-}
-
-static void _read_type_declaration(cJSON *decl, struct ain_type *dst)
-{
-	dst->data  = cJSON_GetArrayItem(decl, 0)->valueint;
-	dst->struc = cJSON_GetArrayItem(decl, 1)->valueint;
-	dst->rank  = cJSON_GetArrayItem(decl, 2)->valueint;
-}
-
-static void read_type_declaration(cJSON *decl, struct ain_type *dst)
+#include "system4/vector.h"
+#include "alice/json.h"
+
+enum {
+	K_VERSION,
+	K_KEYCODE,
+	K_FUNCTIONS,
+	K_GLOBALS,
+	K_STRUCTURES,
+	K_MAIN,
+	K_MSGF,
+	K_LIBRARIES,
+	K_SWITCHES,
+	K_GAME_VERSION,
+	K_SCENARIO_LABELS,
+	K_FILENAMES,
+	K_OJMP,
+	K_FUNCTION_TYPES,
+	K_DELEGATES,
+	K_GLOBAL_GROUPS,
+	K_ENUMS,
+	K_NAME,
+	K_NAME2,
+	K_TYPE,
+	K_INITVAL,
+	K_GROUP_INDEX,
+	K_ADDRESS,
+	K_IS_LABEL,
+	K_RETURN_TYPE,
+	K_UNKNOWN_BOOL,
+	K_CRC,
+	K_ARGUMENTS,
+	K_VARIABLES,
+	K_INTERFACES,
+	K_CONSTRUCTOR,
+	K_DESTRUCTOR,
+	K_MEMBERS,
+	K_CASE_TYPE,
+	K_DEFAULT_ADDRESS,
+	K_CASES,
+	K_VALUE,
+	K_VALUES,
+	NR_KEYS
+};
+
+static const char * const key_names[NR_KEYS] = {
+	[K_VERSION]         = "version",
+	[K_KEYCODE]         = "keycode",
+	[K_FUNCTIONS]       = "functions",
+	[K_GLOBALS]         = "globals",
+	[K_STRUCTURES]      = "structures",
+	[K_MAIN]            = "main",
+	[K_MSGF]            = "msgf",
+	[K_LIBRARIES]       = "libraries",
+	[K_SWITCHES]        = "switches",
+	[K_GAME_VERSION]    = "game-version",
+	[K_SCENARIO_LABELS] = "scenario-labels",
+	[K_FILENAMES]       = "filenames",
+	[K_OJMP]            = "ojmp",
+	[K_FUNCTION_TYPES]  = "function-types",
+	[K_DELEGATES]       = "delegates",
+	[K_GLOBAL_GROUPS]   = "global-groups",
+	[K_ENUMS]           = "enums",
+	[K_NAME]            = "name",
+	[K_NAME2]           = "name2",
+	[K_TYPE]            = "type",
+	[K_INITVAL]         = "initval",
+	[K_GROUP_INDEX]     = "group-index",
+	[K_ADDRESS]         = "address",
+	[K_IS_LABEL]        = "is-label",
+	[K_RETURN_TYPE]     = "return-type",
+	[K_UNKNOWN_BOOL]    = "unknown-bool",
+	[K_CRC]             = "crc",
+	[K_ARGUMENTS]       = "arguments",
+	[K_VARIABLES]       = "variables",
+	[K_INTERFACES]      = "interfaces",
+	[K_CONSTRUCTOR]     = "constructor",
+	[K_DESTRUCTOR]      = "destructor",
+	[K_MEMBERS]         = "members",
+	[K_CASE_TYPE]       = "case-type",
+	[K_DEFAULT_ADDRESS] = "default-address",
+	[K_CASES]           = "cases",
+	[K_VALUE]           = "value",
+	[K_VALUES]          = "values",
+};
+
+typedef vector_t(struct ain_variable) variable_list;
+
+static void expect_object(struct json_reader *r, const char *list)
+{
+	if (r->token != JSON_BEGIN_OBJECT)
+		ERROR("Non-object in %s list", list);
+}
+
+/*
+ * Read the elements of a type declaration array. The array has already been
+ * begun.
+ */
+static void read_type_declaration_elements(struct json_reader *r, struct ain_type *dst)
 {
-	int size = cJSON_GetArraySize(decl);
+	int size = json_count_elements(r);
 	if (size < 3 || size > 4)
 		ERROR("Invalid type declaration (array size = %d)", size);
 
-	_read_type_declaration(decl, dst);
-	if (size != 4)
-		return;
-	cJSON *a = cJSON_GetArrayItem(decl, 3);
-	if (cJSON_IsNull(a))
-		return;
-	if (!cJSON_IsArray(a))
-		ERROR("Non-array in array-type slot");
-	if (cJSON_GetArraySize(a) == 0)
-		return;
+	dst->data  = json_read_int(r);
+	dst->struc = json_read_int(r);
+	dst->rank  = json_read_int(r);
+	if (size == 4) {
+		switch (json_next(r)) {
+		case JSON_NULL:
+			break;
+		case JSON_BEGIN_ARRAY:
+			if (json_count_elements(r) == 0) {
+				json_skip(r);
+				break;
+			}
+			dst->array_type = xcalloc(1, sizeof(struct ain_type));
+			read_type_declaration_elements(r, dst->array_type);
+			break;
+		default:
+			ERROR("Non-array in array-type slot");
+		}
+	}
+	json_expect(r, JSON_END_ARRAY);
+}
 
-	dst->array_type = xcalloc(1, sizeof(struct ain_type));
-	read_type_declaration(a, dst->array_type);
+static void read_type_declaration(struct json_reader *r, struct ain_type *dst)
+{
+	json_expect(r, JSON_BEGIN_ARRAY);
+	read_type_declaration_elements(r, dst);
 }
 
-static void read_type_declaration_or_data_type(cJSON *decl, struct ain_type *dst)
+static void read_type_declaration_or_data_type(struct json_reader *r, struct ain_type *dst)
 {
-	if (cJSON_IsArray(decl)) {
-		read_type_declaration(decl, dst);
-	} else if (cJSON_IsNumber(decl)) {
-		dst->data = decl->valueint;
+	switch (json_next(r)) {
+	case JSON_BEGIN_ARRAY:
+		read_type_declaration_elements(r, dst);
+		break;
+	case JSON_NUMBER:
+		dst->data = json_int_value(r);
 		dst->struc = -1;
 		dst->rank = 0;
-	} else {
+		break;
+	default:
 		ERROR("Invalid type declaration (not a number or array)");
 	}
 }
 
-static void read_variable_declaration(cJSON *decl, struct ain_variable *dst)
+static void read_variable_declaration(struct json_reader *r, struct ain_variable *dst)
 {
-	dst->name = cJSON_GetObjectString_NonNull(decl, "name");
-	dst->name2 = cJSON_GetObjectString(decl, "name2");
-	read_type_declaration(cJSON_GetObjectArray_NonNull(decl, "type"), &dst->type);
+	// the initval is interpreted according to the type, which may come later
+	enum json_token initval = JSON_END;
+	char *initval_s = NULL;
+	double initval_f = 0;
+	int initval_i = 0;
+
+	uint64_t seen = 0;
+	int key;
+	dst->group_index = -1;
+	while (json_next_key(r, &key)) {
+		seen |= JSON_KEY_BIT(key);
+		switch (key) {
+		case K_NAME:
+			dst->name = json_read_string(r);
+			break;
+		case K_NAME2:
+			dst->name2 = json_read_string(r);
+			break;
+		case K_TYPE:
+			read_type_declaration(r, &dst->type);
+			break;
+		case K_INITVAL:
+			initval = json_next(r);
+			if (initval == JSON_STRING) {
+				initval_s = xstrdup(r->str);
+			} else if (initval == JSON_NUMBER) {
+				initval_f = r->number;
+				initval_i = json_int_value(r);
+			} else {
+				json_skip(r);
+			}
+			break;
+		case K_GROUP_INDEX:
+			dst->group_index = json_read_int(r);
+			break;
+		default:
+			json_skip(r);
+			break;
+		}
+	}
+	json_require(r, seen, K_NAME);
+	json_require(r, seen, K_TYPE);
 
-	cJSON *v = cJSON_GetObjectItem(decl, "initval");
-	if (v) {
+	if (initval != JSON_END) {
 		switch (dst->type.data) {
 		case AIN_STRING:
-			if (!cJSON_IsString(v))
+			if (initval != JSON_STRING)
 				ERROR("Non-string initval for string variable");
-			dst->initval.s = strdup(v->valuestring);
+			dst->initval.s = initval_s;
+			initval_s = NULL;
 			break;
 		case AIN_FLOAT:
-			if (!cJSON_IsNumber(v))
+			if (initval != JSON_NUMBER)
 				ERROR("Non-number initval for float variable");
-			dst->initval.f = v->valuedouble;
+			dst->initval.f = initval_f;
 			break;
 		default:
-			if (!cJSON_IsNumber(v))
+			if (initval != JSON_NUMBER)
 				ERROR("Non-number initval for variable");
-			dst->initval.i = v->valueint;
+			dst->initval.i = initval_i;
 			break;
 		}
 	}
-
-	dst->group_index = cJSON_GetObjectInteger(decl, "group-index", -1);
+	free(initval_s);
 }
 
-static void read_function_declaration(cJSON *decl, struct ain_function *dst)
+static void read_variable_list(struct json_reader *r, variable_list *vars, const char *list)
 {
-	int i;
-	cJSON *args, *vars, *v;
-
-	dst->address = cJSON_GetObjectInteger(decl, "address", 0);
-	dst->name = cJSON_GetObjectString_NonNull(decl, "name");
-	dst->is_label = cJSON_GetObjectBool(decl, "is-label", 0);
-	read_type_declaration(cJSON_GetObjectArray_NonNull(decl, "return-type"), &dst->return_type);
-	dst->is_lambda = cJSON_GetObjectInteger(decl, "unknown-bool", 0);
-	dst->crc = cJSON_GetObjectInteger(decl, "crc", 0);
-
-	args = cJSON_GetObjectArray_NonNull(decl, "arguments");
-	vars = cJSON_GetObjectArray_NonNull(decl, "variables");
-	dst->nr_args = cJSON_GetArraySize(args);
-	dst->nr_vars = dst->nr_args + cJSON_GetArraySize(vars);
+	json_expect(r, JSON_BEGIN_ARRAY);
+	while (json_next(r) != JSON_END_ARRAY) {
+		expect_object(r, list);
+		struct ain_variable var = {0};
+		read_variable_declaration(r, &var);
+		vector_push(struct ain_variable, *vars, var);
+	}
+}
 
-	i = 0;
-	dst->vars = xcalloc(dst->nr_vars, sizeof(struct ain_variable));
-	cJSON_ArrayForEach(v, args) {
-		if (!cJSON_IsObject(v))
-			ERROR("Non-object in argument list");
-		read_variable_declaration(v, &dst->vars[i]);
-		i++;
+/*
+ * Concatenate argument and variable lists (arguments come first).
+ */
+static struct ain_variable *concat_variables(variable_list *args, variable_list *vars)
+{
+	for (size_t i = 0; i < vector_length(*vars); i++) {
+		vector_push(struct ain_variable, *args, vector_A(*vars, i));
 	}
-	cJSON_ArrayForEach(v, vars) {
-		if (!cJSON_IsObject(v))
-			ERROR("Non-object in variable list");
-		read_variable_declaration(v, &dst->vars[i]);
-		i++;
+	vector_destroy(*vars);
+	return vector_data(*args);
+}
+
+static void read_function_declaration(struct json_reader *r, struct ain_function *dst)
+{
+	variable_list args = vector_initializer;
+	variable_list vars = vector_initializer;
+	uint64_t seen = 0;
+	int key;
+	while (json_next_key(r, &key)) {
+		seen |= JSON_KEY_BIT(key);
+		switch (key) {
+		case K_ADDRESS:
+			dst->address = json_read_int(r);
+			break;
+		case K_NAME:
+			dst->name = json_read_string(r);
+			break;
+		case K_IS_LABEL:
+			dst->is_label = json_read_bool(r);
+			break;
+		case K_RETURN_TYPE:
+			read_type_declaration(r, &dst->return_type);
+			break;
+		case K_UNKNOWN_BOOL:
+			// written as a boolean by ain_dump_json
+			json_next(r);
+			dst->is_lambda = r->token == JSON_TRUE
+				|| (r->token != JSON_FALSE && json_int_value(r));
+			break;
+		case K_CRC:
+			dst->crc = json_read_int(r);
+			break;
+		case K_ARGUMENTS:
+			read_variable_list(r, &args, "argument");
+			break;
+		case K_VARIABLES:
+			read_variable_list(r, &vars, "variable");
+			break;
+		default:
+			json_skip(r);
+			break;
+		}
 	}
+	json_require(r, seen, K_NAME);
+	json_require(r, seen, K_RETURN_TYPE);
+	json_require(r, seen, K_ARGUMENTS);
+	json_require(r, seen, K_VARIABLES);
+
+	dst->nr_args = vector_length(args);
+	dst->nr_vars = dst->nr_args + vector_length(vars);
+	dst->vars = concat_variables(&args, &vars);
 }
 
-static void read_function_declarations(cJSON *decl, struct ain *ain)
+static void read_function_declarations(struct json_reader *r, struct ain *ain)
 {
-	int i;
-	cJSON *f;
-	struct ain_function *functions = xcalloc(cJSON_GetArraySize(decl), sizeof(struct ain_function));
-	cJSON_ArrayForEachIndex(i, f, decl) {
-		if (!cJSON_IsObject(f))
-			ERROR("Non-object in function list");
-		read_function_declaration(f, &functions[i]);
+	vector_t(struct ain_function) functions = vector_initializer;
+	json_expect(r, JSON_BEGIN_ARRAY);
+	while (json_next(r) != JSON_END_ARRAY) {
+		expect_object(r, "function");
+		struct ain_function f = {0};
+		read_function_declaration(r, &f);
+		vector_push(struct ain_function, functions, f);
 	}
 
 	ain_free_functions(ain);
-	ain->functions = functions;
-	ain->nr_functions = i;
+	ain->functions = vector_data(functions);
+	ain->nr_functions = vector_length(functions);
 	ain_index_functions(ain);
 }
 
-static struct ain_variable *read_variable_declarations(cJSON *decl, int *n)
+static struct ain_variable *read_variable_declarations(struct json_reader *r, int *n)
 {
-	cJSON *v;
-	int i;
-	struct ain_variable *vars = xcalloc(cJSON_GetArraySize(decl), sizeof(struct ain_variable));
-	cJSON_ArrayForEachIndex(i, v, decl) {
-		if (!cJSON_IsObject(v))
-			ERROR("Non-object in variable list");
-		read_variable_declaration(v, &vars[i]);
-	}
-	*n = i;
-	return vars;
+	variable_list vars = vector_initializer;
+	read_variable_list(r, &vars, "variable");
+	*n = vector_length(vars);
+	return vector_data(vars);
 }
 
-static void read_global_declarations(cJSON *decl, struct ain *ain)
+static void read_global_declarations(struct json_reader *r, struct ain *ain)
 {
 	ain_free_globals(ain);
-	ain->globals = read_variable_declarations(decl, &ain->nr_globals);
+	ain->globals = read_variable_declarations(r, &ain->nr_globals);
 }
 
-static struct ain_interface *read_interface_list(cJSON *decl, int32_t *n)
+static struct ain_interface *read_interface_list(struct json_reader *r, int32_t *n)
 {
-	*n = cJSON_GetArraySize(decl);
-	struct ain_interface *iface = xcalloc(*n, sizeof(struct ain_interface));
-
-	cJSON *v;
-	int i;
-	cJSON_ArrayForEachIndex(i, v, decl) {
-		if (!cJSON_IsArray(v))
+	vector_t(struct ain_interface) iface = vector_initializer;
+	json_expect(r, JSON_BEGIN_ARRAY);
+	while (json_next(r) != JSON_END_ARRAY) {
+		if (r->token != JSON_BEGIN_ARRAY)
 			ERROR("Non-array in interface list");
-		if (cJSON_GetArraySize(v) != 2)
+		if (json_count_elements(r) != 2)
 			ERROR("Wrong size array in interface list");
-		iface[i].struct_type = cJSON_GetArrayItem(v, 0)->valueint;
-		iface[i].vtable_offset = cJSON_GetArrayItem(v, 1)->valueint;
+		struct ain_interface i = {0};
+		i.struct_type = json_read_int(r);
+		i.vtable_offset = json_read_int(r);
+		json_expect(r, JSON_END_ARRAY);
+		vector_push(struct ain_interface, iface, i);
 	}
-
-	*n = i;
-	return iface;
+	*n = vector_length(iface);
+	return vector_data(iface);
 }
 
-static void read_structure_declaration(cJSON *decl, struct ain_struct *dst)
+static void read_structure_declaration(struct json_reader *r, struct ain_struct *dst)
 {
-	cJSON *a;
-	dst->name = cJSON_GetObjectString_NonNull(decl, "name");
-	if ((a = cJSON_GetObjectArray(decl, "interfaces"))) {
-		dst->interfaces = read_interface_list(a, &dst->nr_interfaces);
-	}
-	dst->constructor = cJSON_GetObjectInteger(decl, "constructor", -1);
-	dst->destructor = cJSON_GetObjectInteger(decl, "destructor", -1);
-	if ((a = cJSON_GetObjectArray(decl, "members"))) {
-		dst->members = read_variable_declarations(a, &dst->nr_members);
+	uint64_t seen = 0;
+	int key;
+	dst->constructor = -1;
+	dst->destructor = -1;
+	while (json_next_key(r, &key)) {
+		seen |= JSON_KEY_BIT(key);
+		switch (key) {
+		case K_NAME:
+			dst->name = json_read_string(r);
+			break;
+		case K_INTERFACES:
+			dst->interfaces = read_interface_list(r, &dst->nr_interfaces);
+			break;
+		case K_CONSTRUCTOR:
+			dst->constructor = json_read_int(r);
+			break;
+		case K_DESTRUCTOR:
+			dst->destructor = json_read_int(r);
+			break;
+		case K_MEMBERS:
+			dst->members = read_variable_declarations(r, &dst->nr_members);
+			break;
+		default:
+			json_skip(r);
+			break;
+		}
 	}
+	json_require(r, seen, K_NAME);
 }
 
-static void read_structure_declarations(cJSON *decl, struct ain *ain)
+static void read_structure_declarations(struct json_reader *r, struct ain *ain)
 {
-	int i;
-	cJSON *s;
-	struct ain_struct *structs = xcalloc(cJSON_GetArraySize(decl), sizeof(struct ain_struct));
-	cJSON_ArrayForEachIndex(i, s, decl) {
-		if (!cJSON_IsObject(s))
-			ERROR("Non-object in structure list");
-		read_structure_declaration(s, &structs[i]);
+	vector_t(struct ain_struct) structs = vector_initializer;
+	json_expect(r, JSON_BEGIN_ARRAY);
+	while (json_next(r) != JSON_END_ARRAY) {
+		expect_object(r, "structure");
+		struct ain_struct s = {0};
+		read_structure_declaration(r, &s);
+		vector_push(struct ain_struct, structs, s);
 	}
 
 	ain_free_structures(ain);
-	ain->structures = structs;
-	ain->nr_structures = i;
+	ain->structures = vector_data(structs);
+	ain->nr_structures = vector_length(structs);
 	ain_index_structures(ain);
 }
 
-static void read_library_declaration(cJSON *decl, struct ain_library *dst)
+static void read_hll_argument(struct json_reader *r, struct ain_hll_argument *dst)
 {
-	dst->name = cJSON_GetObjectString_NonNull(decl, "name");
-
-	int i;
-	cJSON *f, *jfuns = cJSON_GetObjectArray_NonNull(decl, "functions");
-	struct ain_hll_function *funs = xcalloc(cJSON_GetArraySize(jfuns), sizeof(struct ain_hll_function));
-	cJSON_ArrayForEachIndex(i, f, jfuns) {
-		funs[i].name = cJSON_GetObjectString_NonNull(f, "name");
-		read_type_declaration_or_data_type(cJSON_GetObjectItem(f, "return-type"),
-				&funs[i].return_type);
-
-		int j;
-		cJSON *arg, *jargs = cJSON_GetObjectArray_NonNull(f, "arguments");
-		struct ain_hll_argument *args = xcalloc(cJSON_GetArraySize(jargs), sizeof(struct ain_hll_argument));
-		cJSON_ArrayForEachIndex(j, arg, jargs) {
-			args[j].name = cJSON_GetObjectString_NonNull(arg, "name");
-			read_type_declaration_or_data_type(cJSON_GetObjectItem(arg, "type"),
-					&args[j].type);
+	uint64_t seen = 0;
+	int key;
+	while (json_next_key(r, &key)) {
+		seen |= JSON_KEY_BIT(key);
+		switch (key) {
+		case K_NAME:
+			dst->name = json_read_string(r);
+			break;
+		case K_TYPE:
+			read_type_declaration_or_data_type(r, &dst->type);
+			break;
+		default:
+			json_skip(r);
+			break;
 		}
-		funs[i].nr_arguments = j;
-		funs[i].arguments = args;
 	}
+	json_require(r, seen, K_NAME);
+	json_require(r, seen, K_TYPE);
+}
 
-	dst->nr_functions = i;
-	dst->functions = funs;
+static void read_hll_function(struct json_reader *r, struct ain_hll_function *dst)
+{
+	vector_t(struct ain_hll_argument) args = vector_initializer;
+	uint64_t seen = 0;
+	int key;
+	while (json_next_key(r, &key)) {
+		seen |= JSON_KEY_BIT(key);
+		switch (key) {
+		case K_NAME:
+			dst->name = json_read_string(r);
+			break;
+		case K_RETURN_TYPE:
+			read_type_declaration_or_data_type(r, &dst->return_type);
+			break;
+		case K_ARGUMENTS:
+			json_expect(r, JSON_BEGIN_ARRAY);
+			while (json_next(r) != JSON_END_ARRAY) {
+				expect_object(r, "argument");
+				struct ain_hll_argument arg = {0};
+				read_hll_argument(r, &arg);
+				vector_push(struct ain_hll_argument, args, arg);
+			}
+			break;
+		default:
+			json_skip(r);
+			break;
+		}
+	}
+	json_require(r, seen, K_NAME);
+	json_require(r, seen, K_RETURN_TYPE);
+	json_require(r, seen, K_ARGUMENTS);
+	dst->nr_arguments = vector_length(args);
+	dst->arguments = vector_data(args);
+}
+
+static void read_library_declaration(struct json_reader *r, struct ain_library *dst)
+{
+	vector_t(struct ain_hll_function) funs = vector_initializer;
+	uint64_t seen = 0;
+	int key;
+	while (json_next_key(r, &key)) {
+		seen |= JSON_KEY_BIT(key);
+		switch (key) {
+		case K_NAME:
+			dst->name = json_read_string(r);
+			break;
+		case K_FUNCTIONS:
+			json_expect(r, JSON_BEGIN_ARRAY);
+			while (json_next(r) != JSON_END_ARRAY) {
+				expect_object(r, "library function");
+				struct ain_hll_function f = {0};
+				read_hll_function(r, &f);
+				vector_push(struct ain_hll_function, funs, f);
+			}
+			break;
+		default:
+			json_skip(r);
+			break;
+		}
+	}
+	json_require(r, seen, K_NAME);
+	json_require(r, seen, K_FUNCTIONS);
+	dst->nr_functions = vector_length(funs);
+	dst->functions = vector_data(funs);
 }
 
-static void read_library_declarations(cJSON *decl, struct ain *ain)
+static void read_library_declarations(struct json_reader *r, struct ain *ain)
 {
-	int i;
-	cJSON *lib;
-	struct ain_library *libs = xcalloc(cJSON_GetArraySize(decl), sizeof(struct ain_library));
-	cJSON_ArrayForEachIndex(i, lib, decl) {
-		if (!cJSON_IsObject(lib))
-			ERROR("Non-object in library list");
-		read_library_declaration(lib, &libs[i]);
+	vector_t(struct ain_library) libs = vector_initializer;
+	json_expect(r, JSON_BEGIN_ARRAY);
+	while (json_next(r) != JSON_END_ARRAY) {
+		expect_object(r, "library");
+		struct ain_library lib = {0};
+		read_library_declaration(r, &lib);
+		vector_push(struct ain_library, libs, lib);
 	}
 
 	ain_free_libraries(ain);
-	ain->libraries = libs;
-	ain->nr_libraries = i;
+	ain->libraries = vector_data(libs);
+	ain->nr_libraries = vector_length(libs);
 }
 
-static void read_switch_declaration(cJSON *decl, struct ain_switch *dst)
+static void read_switch_case(struct json_reader *r, struct ain_switch_case *dst)
 {
-	dst->case_type = cJSON_GetObjectInteger_NonNull(decl, "case-type");
-	dst->default_address = cJSON_GetObjectInteger_NonNull(decl, "default-address");
-
-	int i;
-	cJSON *v, *a = cJSON_GetObjectArray_NonNull(decl, "cases");
-	struct ain_switch_case *cases = xcalloc(cJSON_GetArraySize(a), sizeof(struct ain_switch_case));
-	cJSON_ArrayForEachIndex(i, v, a) {
-		if (!cJSON_IsObject(v))
-			ERROR("Non-object in switch case list");
-		cases[i].value = cJSON_GetObjectInteger_NonNull(v, "value");
-		cases[i].address = cJSON_GetObjectInteger_NonNull(v, "address");
+	uint64_t seen = 0;
+	int key;
+	while (json_next_key(r, &key)) {
+		seen |= JSON_KEY_BIT(key);
+		switch (key) {
+		case K_VALUE:
+			dst->value = json_read_int(r);
+			break;
+		case K_ADDRESS:
+			dst->address = json_read_int(r);
+			break;
+		default:
+			json_skip(r);
+			break;
+		}
 	}
-	dst->cases = cases;
-	dst->nr_cases = i;
+	json_require(r, seen, K_VALUE);
+	json_require(r, seen, K_ADDRESS);
 }
 
-static void read_switch_declarations(cJSON *decl, struct ain *ain)
+static void read_switch_declaration(struct json_reader *r, struct ain_switch *dst)
 {
-	int i;
-	cJSON *s;
-	struct ain_switch *switches = xcalloc(cJSON_GetArraySize(decl), sizeof(struct ain_switch));
-	cJSON_ArrayForEachIndex(i, s, decl) {
-		if (!cJSON_IsObject(s))
-			ERROR("Non-object in switch list");
-		read_switch_declaration(s, &switches[i]);
+	vector_t(struct ain_switch_case) cases = vector_initializer;
+	uint64_t seen = 0;
+	int key;
+	while (json_next_key(r, &key)) {
+		seen |= JSON_KEY_BIT(key);
+		switch (key) {
+		case K_CASE_TYPE:
+			dst->case_type = json_read_int(r);
+			break;
+		case K_DEFAULT_ADDRESS:
+			dst->default_address = json_read_int(r);
+			break;
+		case K_CASES:
+			json_expect(r, JSON_BEGIN_ARRAY);
+			while (json_next(r) != JSON_END_ARRAY) {
+				expect_object(r, "switch case");
+				struct ain_switch_case c = {0};
+				read_switch_case(r, &c);
+				vector_push(struct ain_switch_case, cases, c);
+			}
+			break;
+		default:
+			json_skip(r);
+			break;
+		}
+	}
+	json_require(r, seen, K_CASE_TYPE);
+	json_require(r, seen, K_DEFAULT_ADDRESS);
+	json_require(r, seen, K_CASES);
+	dst->cases = vector_data(cases);
+	dst->nr_cases = vector_length(cases);
+}
+
+static void read_switch_declarations(struct json_reader *r, struct ain *ain)
+{
+	vector_t(struct ain_switch) switches = vector_initializer;
+	json_expect(r, JSON_BEGIN_ARRAY);
+	while (json_next(r) != JSON_END_ARRAY) {
+		expect_object(r, "switch");
+		struct ain_switch s = {0};
+		read_switch_declaration(r, &s);
+		vector_push(struct ain_switch, switches, s);
 	}
 
 	ain_free_switches(ain);
-	ain->switches = switches;
-	ain->nr_switches = i;
+	ain->switches = vector_data(switches);
+	ain->nr_switches = vector_length(switches);
+}
+
+static void read_scenario_label(struct json_reader *r, struct ain_scenario_label *dst)
+{
+	uint64_t seen = 0;
+	int key;
+	while (json_next_key(r, &key)) {
+		seen |= JSON_KEY_BIT(key);
+		switch (key) {
+		case K_NAME:
+			dst->name = json_read_string(r);
+			break;
+		case K_ADDRESS:
+			dst->address = json_read_int(r);
+			break;
+		default:
+			json_skip(r);
+			break;
+		}
+	}
+	json_require(r, seen, K_NAME);
+	json_require(r, seen, K_ADDRESS);
 }
 
-static void read_scenario_labels(cJSON *decl, struct ain *ain)
+static void read_scenario_labels(struct json_reader *r, struct ain *ain)
 {
-	int i;
-	cJSON *l;
-	struct ain_scenario_label *labels = xcalloc(cJSON_GetArraySize(decl), sizeof(struct ain_scenario_label));
-	cJSON_ArrayForEachIndex(i, l, decl) {
-		if (!cJSON_IsObject(l))
-			ERROR("Non-object in scenario label list");
-		labels[i].name = cJSON_GetObjectString_NonNull(l, "name");
-		labels[i].address = cJSON_GetObjectInteger_NonNull(l, "address");
+	vector_t(struct ain_scenario_label) labels = vector_initializer;
+	json_expect(r, JSON_BEGIN_ARRAY);
+	while (json_next(r) != JSON_END_ARRAY) {
+		expect_object(r, "scenario label");
+		struct ain_scenario_label l = {0};
+		read_scenario_label(r, &l);
+		vector_push(struct ain_scenario_label, labels, l);
 	}
 
 	ain_free_scenario_labels(ain);
-	ain->scenario_labels = labels;
-	ain->nr_scenario_labels = i;
+	ain->scenario_labels = vector_data(labels);
+	ain->nr_scenario_labels = vector_length(labels);
 }
 
-static char **read_string_array(cJSON *decl, int *n)
+static char **read_string_array(struct json_reader *r, int *n)
 {
-	int i;
-	cJSON *str;
-	char **strings = xcalloc(cJSON_GetArraySize(decl), sizeof(char*));
-	cJSON_ArrayForEachIndex(i, str, decl) {
-		if (!cJSON_IsString(str))
+	vector_t(char*) strings = vector_initializer;
+	json_expect(r, JSON_BEGIN_ARRAY);
+	while (json_next(r) != JSON_END_ARRAY) {
+		if (r->token != JSON_STRING)
 			ERROR("Non-string in string list");
-		strings[i] = strdup(str->valuestring);
+		vector_push(char*, strings, xstrdup(r->str));
 	}
-	*n = i;
-	return strings;
+	*n = vector_length(strings);
+	return vector_data(strings);
 }
 
-static void read_filename_declarations(cJSON *decl, struct ain *ain)
+static void read_filename_declarations(struct json_reader *r, struct ain *ain)
 {
 	ain_free_filenames(ain);
-	ain->filenames = read_string_array(decl, &ain->nr_filenames);
-}
-
-static void read_function_type_declaration(cJSON *decl, struct ain_function_type *dst)
-{
-	dst->name = cJSON_GetObjectString_NonNull(decl, "name");
-	read_type_declaration(cJSON_GetObjectArray_NonNull(decl, "return-type"), &dst->return_type);
-
-	int i = 0;
-	cJSON *v;
-	cJSON *args = cJSON_GetObjectArray_NonNull(decl, "arguments");
-	cJSON *vars = cJSON_GetObjectArray_NonNull(decl, "variables");
-	dst->nr_arguments = cJSON_GetArraySize(args);
-	dst->nr_variables = cJSON_GetArraySize(vars) + dst->nr_arguments;
-	struct ain_variable *variables = xcalloc(dst->nr_variables, sizeof(struct ain_variable));
-	cJSON_ArrayForEach(v, args) {
-		if (!cJSON_IsObject(v))
-			ERROR("Non-object in argument list");
-		read_variable_declaration(v, &variables[i]);
-		i++;
-	}
-	cJSON_ArrayForEach(v, vars) {
-		if (!cJSON_IsObject(v))
-			ERROR("Non-object in variable list");
-		read_variable_declaration(v, &variables[i]);
-		i++;
+	ain->filenames = read_string_array(r, &ain->nr_filenames);
+}
+
+static void read_function_type_declaration(struct json_reader *r, struct ain_function_type *dst)
+{
+	variable_list args = vector_initializer;
+	variable_list vars = vector_initializer;
+	uint64_t seen = 0;
+	int key;
+	while (json_next_key(r, &key)) {
+		seen |= JSON_KEY_BIT(key);
+		switch (key) {
+		case K_NAME:
+			dst->name = json_read_string(r);
+			break;
+		case K_RETURN_TYPE:
+			read_type_declaration(r, &dst->return_type);
+			break;
+		case K_ARGUMENTS:
+			read_variable_list(r, &args, "argument");
+			break;
+		case K_VARIABLES:
+			read_variable_list(r, &vars, "variable");
+			break;
+		default:
+			json_skip(r);
+			break;
+		}
 	}
-	dst->variables = variables;
+	json_require(r, seen, K_NAME);
+	json_require(r, seen, K_RETURN_TYPE);
+	json_require(r, seen, K_ARGUMENTS);
+	json_require(r, seen, K_VARIABLES);
+
+	dst->nr_arguments = vector_length(args);
+	dst->nr_variables = dst->nr_arguments + vector_length(vars);
+	dst->variables = concat_variables(&args, &vars);
 }
 
-static struct ain_function_type *_read_function_type_declarations(cJSON *decl, int *n)
+static struct ain_function_type *_read_function_type_declarations(struct json_reader *r, int *n)
 {
-	int i;
-	cJSON *f;
-	struct ain_function_type *types = xcalloc(cJSON_GetArraySize(decl), sizeof(struct ain_function_type));
-	cJSON_ArrayForEachIndex(i, f, decl) {
-		if (!cJSON_IsObject(f))
-			ERROR("Non-object in function type list");
-		read_function_type_declaration(f, &types[i]);
+	vector_t(struct ain_function_type) types = vector_initializer;
+	json_expect(r, JSON_BEGIN_ARRAY);
+	while (json_next(r) != JSON_END_ARRAY) {
+		expect_object(r, "function type");
+		struct ain_function_type t = {0};
+		read_function_type_declaration(r, &t);
+		vector_push(struct ain_function_type, types, t);
 	}
-	*n = i;
-	return types;
+	*n = vector_length(types);
+	return vector_data(types);
 }
 
-static void read_function_type_declarations(cJSON *decl, struct ain *ain)
+static void read_function_type_declarations(struct json_reader *r, struct ain *ain)
 {
 	ain_free_function_types(ain);
-	ain->function_types = _read_function_type_declarations(decl, &ain->nr_function_types);
+	ain->function_types = _read_function_type_declarations(r, &ain->nr_function_types);
 }
 
-static void read_delegate_declarations(cJSON *decl, struct ain *ain)
+static void read_delegate_declarations(struct json_reader *r, struct ain *ain)
 {
 	ain_free_delegates(ain);
-	ain->delegates = _read_function_type_declarations(decl, &ain->nr_delegates);
+	ain->delegates = _read_function_type_declarations(r, &ain->nr_delegates);
 	ain->DELG.present = true;
 }
 
-static void read_global_group_declarations(cJSON *decl, struct ain *ain)
+static void read_global_group_declarations(struct json_reader *r, struct ain *ain)
 {
 	ain_free_global_groups(ain);
-	ain->global_group_names = read_string_array(decl, &ain->nr_global_groups);
-}
-
-static void read_enum_declarations(cJSON *decl, struct ain *ain)
-{
-	int i;
-	cJSON *e;
-	struct ain_enum *enums = xcalloc(cJSON_GetArraySize(decl), sizeof(struct ain_enum));
-	cJSON_ArrayForEachIndex(i, e, decl) {
-		if (!cJSON_IsObject(e))
-			ERROR("Non-object in enum list");
-		enums[i].name = cJSON_GetObjectString_NonNull(e, "name");
-
-		int j;
-		cJSON *s, *syms = cJSON_GetObjectArray_NonNull(e, "values");
-		struct ain_enum_value *values = xcalloc(cJSON_GetArraySize(syms),
-				sizeof(struct ain_enum_value));
-		cJSON_ArrayForEachIndex(j, s, syms) {
-			if (cJSON_IsArray(s)) {
-				if (cJSON_GetArraySize(s) != 2)
-					ERROR("Unexpected enum array size");
-				cJSON *str = cJSON_GetArrayItem(s, 0);
-				cJSON *val = cJSON_GetArrayItem(s, 1);
-				if (!cJSON_IsString(str))
-					ERROR("Non-string as enum symbol");
-				if (!cJSON_IsNumber(val))
-					ERROR("Non-number as enum value");
-				values[j].symbol = make_string(str->valuestring, strlen(str->valuestring));
-				values[j].value = val->valueint;
-			} else if (cJSON_IsString(s)) {
-				values[j].symbol = make_string(s->valuestring, strlen(s->valuestring));
-				values[j].value = j;
-			} else {
-				ERROR("Invalid value as enum value list");
-			}
+	ain->global_group_names = read_string_array(r, &ain->nr_global_groups);
+}
+
+static void read_enum_values(struct json_reader *r, struct ain_enum *dst)
+{
+	vector_t(struct ain_enum_value) values = vector_initializer;
+	json_expect(r, JSON_BEGIN_ARRAY);
+	while (json_next(r) != JSON_END_ARRAY) {
+		struct ain_enum_value v;
+		if (r->token == JSON_BEGIN_ARRAY) {
+			if (json_count_elements(r) != 2)
+				ERROR("Unexpected enum array size");
+			if (json_next(r) != JSON_STRING)
+				ERROR("Non-string as enum symbol");
+			v.symbol = make_string(r->str, strlen(r->str));
+			if (json_next(r) != JSON_NUMBER)
+				ERROR("Non-number as enum value");
+			v.value = json_int_value(r);
+			json_expect(r, JSON_END_ARRAY);
+		} else if (r->token == JSON_STRING) {
+			v.symbol = make_string(r->str, strlen(r->str));
+			v.value = vector_length(values);
+		} else {
+			ERROR("Invalid value as enum value list");
+		}
+		vector_push(struct ain_enum_value, values, v);
+	}
+	dst->nr_values = vector_length(values);
+	dst->values = vector_data(values);
+}
+
+static void read_enum_declaration(struct json_reader *r, struct ain_enum *dst)
+{
+	uint64_t seen = 0;
+	int key;
+	while (json_next_key(r, &key)) {
+		seen |= JSON_KEY_BIT(key);
+		switch (key) {
+		case K_NAME:
+			dst->name = json_read_string(r);
+			break;
+		case K_VALUES:
+			read_enum_values(r, dst);
+			break;
+		default:
+			json_skip(r);
+			break;
 		}
-		enums[i].nr_values = j;
-		enums[i].values = values;
+	}
+	json_require(r, seen, K_NAME);
+	json_require(r, seen, K_VALUES);
+}
+
+static void read_enum_declarations(struct json_reader *r, struct ain *ain)
+{
+	vector_t(struct ain_enum) enums = vector_initializer;
+	json_expect(r, JSON_BEGIN_ARRAY);
+	while (json_next(r) != JSON_END_ARRAY) {
+		expect_object(r, "enum");
+		struct ain_enum e = {0};
+		read_enum_declaration(r, &e);
+		vector_push(struct ain_enum, enums, e);
 	}
 
 	ain_free_enums(ain);
-	ain->enums = enums;
-	ain->nr_enums = i;
-}
-
-static void read_json_declarations(cJSON *decl, struct ain *ain)
-{
-	cJSON *v;
-
-	// VERS
-	ain->version = cJSON_GetObjectInteger(decl, "version", 0);
-	// KEYC
-	ain->keycode = cJSON_GetObjectInteger(decl, "keycode", 0);
-	// FUNC
-	if ((v = cJSON_GetObjectArray(decl, "functions")))
-		read_function_declarations(v, ain);
-	// GLOB
-	if ((v = cJSON_GetObjectArray(decl, "globals")))
-		read_global_declarations(v, ain);
-	// STRT
-	if ((v = cJSON_GetObjectArray(decl, "structures")))
-		read_structure_declarations(v, ain);
-	// MAIN
-	ain->main = cJSON_GetObjectInteger(decl, "main", 0);
-	// MSGF
-	ain->msgf = cJSON_GetObjectInteger(decl, "msgf", 0);
-	// HLL0
-	if ((v = cJSON_GetObjectArray(decl, "libraries")))
-		read_library_declarations(v, ain);
-	// SWI0
-	if ((v = cJSON_GetObjectArray(decl, "switches")))
-		read_switch_declarations(v, ain);
-	// GVER
-	ain->game_version = cJSON_GetObjectInteger(decl, "game-version", 0);
-	// SLBL
-	if ((v = cJSON_GetObjectArray(decl, "scenario-labels")))
-		read_scenario_labels(v, ain);
-	// FNAM
-	if ((v = cJSON_GetObjectArray(decl, "filenames")))
-		read_filename_declarations(v, ain);
-	// OJMP
-	ain->ojmp = cJSON_GetObjectInteger(decl, "ojmp", 0);
-	// FNCT
-	if ((v = cJSON_GetObjectArray(decl, "function-types")))
-		read_function_type_declarations(v, ain);
-	// DELG
-	if ((v = cJSON_GetObjectArray(decl, "delegates")))
-		read_delegate_declarations(v, ain);
-	// OBJG
-	if ((v = cJSON_GetObjectArray(decl, "global-groups")))
-		read_global_group_declarations(v, ain);
-	// ENUM
-	if ((v = cJSON_GetObjectArray(decl, "enums")))
-		read_enum_declarations(v, ain);
+	ain->enums = vector_data(enums);
+	ain->nr_enums = vector_length(enums);
+}
+
+static void read_json_declarations(struct json_reader *r, struct ain *ain)
+{
+	// scalar fields are reset when missing
+	ain->version = 0;
+	ain->keycode = 0;
+	ain->main = 0;
+	ain->msgf = 0;
+	ain->game_version = 0;
+	ain->ojmp = 0;
+
+	json_expect(r, JSON_BEGIN_OBJECT);
+	int key;
+	while (json_next_key(r, &key)) {
+		switch (key) {
+		case K_VERSION: // VERS
+			ain->version = json_read_int(r);
+			break;
+		case K_KEYCODE: // KEYC
+			ain->keycode = json_read_int(r);
+			break;
+		case K_FUNCTIONS: // FUNC
+			read_function_declarations(r, ain);
+			break;
+		case K_GLOBALS: // GLOB
+			read_global_declarations(r, ain);
+			break;
+		case K_STRUCTURES: // STRT
+			read_structure_declarations(r, ain);
+			break;
+		case K_MAIN: // MAIN
+			ain->main = json_read_int(r);
+			break;
+		case K_MSGF: // MSGF
+			ain->msgf = json_read_int(r);
+			break;
+		case K_LIBRARIES: // HLL0
+			read_library_declarations(r, ain);
+			break;
+		case K_SWITCHES: // SWI0
+			read_switch_declarations(r, ain);
+			break;
+		case K_GAME_VERSION: // GVER
+			ain->game_version = json_read_int(r);
+			break;
+		case K_SCENARIO_LABELS: // SLBL
+			read_scenario_labels(r, ain);
+			break;
+		case K_FILENAMES: // FNAM
+			read_filename_declarations(r, ain);
+			break;
+		case K_OJMP: // OJMP
+			ain->ojmp = json_read_int(r);
+			break;
+		case K_FUNCTION_TYPES: // FNCT
+			read_function_type_declarations(r, ain);
+			break;
+		case K_DELEGATES: // DELG
+			read_delegate_declarations(r, ain);
+			break;
+		case K_GLOBAL_GROUPS: // OBJG
+			read_global_group_declarations(r, ain);
+			break;
+		case K_ENUMS: // ENUM
+			read_enum_declarations(r, ain);
+			break;
+		default:
+			json_skip(r);
+			break;
+		}
+	}
 }
 
 void ain_read_json(const char *filename, struct ain *ain)
@@ -562,12 +874,9 @@ void ain_read_json(const char *filename, struct ain *ain)
 	if (fclose(f))
 		ERROR("Failed to close '%s': %s", filename, strerror(errno));
 
-	cJSON *j = cJSON_Parse(buf);
-	if (!j)
-		ERROR("Failed to parse JSON file '%s'", filename);
-
-	read_json_declarations(j, ain);
-
-	cJSON_Delete(j);
+	struct json_reader r;
+	json_reader_init(&r, buf, len, filename, key_names, NR_KEYS);
+	read_json_declarations(&r, ain);
+	json_reader_fini(&r);
 	free(buf);
 }
@@ -30,8 +30,11 @@
 #include "system4/vector.h"
 #include "alice.h"
 #include "alice/ar.h"
+#include "alice/cg_cache.h"
 #include "alice/ex.h"
 #include "alice/flat.h"
+#include "alice/jobs.h"
+#include "alice/profile.h"
 
 static char path_separator = '/';
 
@@ -81,9 +84,13 @@ static enum cg_type ar_filetype_to_cg_type(enum ar_filetype type)
 	}
 }
 
-static uint8_t *encode_dcf(struct ar_manifest *mf, struct string *src,
-		enum ar_filetype src_fmt, enum ar_filetype dst_fmt, size_t *size_out,
-		struct string *opt)
+/*
+ * Encode a DCF diff. The decoded base CG is taken from `dcf_bases`, which is
+ * shared between the DCF encoding jobs of a pack.
+ */
+static uint8_t *encode_dcf(struct ar_manifest *mf, struct cg_cache *dcf_bases,
+		struct string *src, enum ar_filetype src_fmt, enum ar_filetype dst_fmt,
+		size_t *size_out, struct string *opt)
 {
 	if (!opt)
 		ALICE_ERROR("No base CG provided for DCF encoding");
@@ -93,7 +100,7 @@ static uint8_t *encode_dcf(struct ar_manifest *mf, struct string *src,
 	struct cg *diff = cg_load_file(src->text);
 	if (!diff)
 		ALICE_ERROR("Failed to load CG: %s", src->text);
-	struct cg *base = cg_load_file(file_name->text);
+	struct cg *base = cg_cache_get(dcf_bases, file_name->text);
 	if (!base)
 		ALICE_ERROR("Failed to load base CG: %s", file_name->text);
 
@@ -101,23 +108,23 @@ static uint8_t *encode_dcf(struct ar_manifest *mf, struct string *src,
 	if (!dcf)
 		ALICE_ERROR("Failed to encode DCF file");
 
-	cg_free(base);
+	cg_cache_release(dcf_bases, file_name->text);
 	cg_free(diff);
 	free_string(base_name);
 	free_string(file_name);
 	return dcf;
 }
 
-static uint8_t *convert_file_mem(struct ar_manifest *mf, struct string *src,
-		enum ar_filetype src_fmt, enum ar_filetype dst_fmt, size_t *size_out,
-		struct string *opt)
+static uint8_t *convert_file_mem(struct ar_manifest *mf, struct cg_cache *dcf_bases,
+		struct string *src, enum ar_filetype src_fmt, enum ar_filetype dst_fmt,
+		size_t *size_out, struct string *opt)
 {
 	NOTICE("%s -> %s", src->text, ar_ft_extension(dst_fmt));
 	switch (src_fmt) {
 	case AR_FT_PNG:
 	case AR_FT_QNT: {
 		if (dst_fmt == AR_FT_DCF)
-			return encode_dcf(mf, src, src_fmt, dst_fmt, size_out, opt);
+			return encode_dcf(mf, dcf_bases, src, src_fmt, dst_fmt, size_out, opt);
 		struct cg *cg = cg_load_file(src->text);
 		if (!cg)
 			ALICE_ERROR("Failed to load CG: %s", src->text);
@@ -156,57 +163,148 @@ static uint8_t *convert_file_mem(struct ar_manifest *mf, struct string *src,
 	}
 }
 
+struct alicepack_job {
+	struct ar_manifest *mf;
+	struct cg_cache *dcf_bases;
+	struct alicepack_line *line;
+	struct ar_file_spec *spec;
+};
+
+static bool is_dcf_line(struct alicepack_line *line)
+{
+	return line->dst_fmt == AR_FT_DCF && line->opt;
+}
+
+/*
+ * Convert a .flat line with a cache. The timestamp of the .x file doesn't
+ * capture changes to the files it references, so the cached .flat is
+ * checked against a dependency file instead.
+ */
+static void alicepack_convert_flat(struct alicepack_line *line, struct ar_file_spec *spec)
+{
+	struct string *deps_path = string_dup(line->cache);
+	string_append_cstr(&deps_path, ".deps", 5);
+	spec->name = string_ref(line->dst);
+	if (flat_deps_up_to_date(deps_path->text)) {
+		spec->type = AR_FILE_SPEC_DISK;
+		spec->disk.path = string_ref(line->cache);
+		free_string(deps_path);
+		return;
+	}
+
+	NOTICE("%s -> %s", line->src->text, ar_ft_extension(line->dst_fmt));
+	profile_begin("convert %s", line->src->text);
+	struct flat_manifest *fmf = flat_read_manifest(line->src->text);
+	struct flat *flat = flat_load_manifest(fmf);
+	spec->type = AR_FILE_SPEC_MEM;
+	spec->mem.data = xmalloc(flat->data_size);
+	spec->mem.size = flat->data_size;
+	memcpy(spec->mem.data, flat->data, flat->data_size);
+	profile_count("bytes", spec->mem.size);
+	profile_end();
+
+	if (file_write(line->cache->text, spec->mem.data, spec->mem.size)) {
+		flat_write_deps(fmf, deps_path->text, line->cache->text);
+	} else {
+		WARNING("file_write(\"%s\"): %s", line->cache->text, strerror(errno));
+	}
+	flat_manifest_free(fmf);
+	flat_free(flat);
+	free_string(deps_path);
+}
+
+static void alicepack_convert(void *data)
+{
+	struct alicepack_job *job = data;
+	struct ar_manifest *mf = job->mf;
+	struct cg_cache *dcf_bases = job->dcf_bases;
+	struct alicepack_line *line = job->line;
+	struct ar_file_spec *spec = job->spec;
+	free(job);
+
+	if (line->dst_fmt == AR_FT_FLAT && line->cache) {
+		alicepack_convert_flat(line, spec);
+		return;
+	}
+
+	if (line->cache && file_exists(line->cache->text)) {
+		// check timestamps
+		ustat src_s, cache_s;
+		checked_stat(line->src->text, &src_s);
+		checked_stat(line->cache->text, &cache_s);
+		if (src_s.st_mtime < cache_s.st_mtime) {
+			// cache hit: give back the base CG reservation
+			if (is_dcf_line(line)) {
+				struct string *base = path_join_string(mf->src_dir, line->opt);
+				cg_cache_unreserve(dcf_bases, base->text);
+				free_string(base);
+			}
+			spec->type = AR_FILE_SPEC_DISK;
+			spec->disk.path = string_ref(line->cache);
+			spec->name = string_ref(line->dst);
+			return;
+		}
+	}
+	spec->type = AR_FILE_SPEC_MEM;
+	profile_begin("convert %s", line->src->text);
+	spec->mem.data = convert_file_mem(mf,
+			dcf_bases,
+			line->src,
+			line->src_fmt,
+			line->dst_fmt,
+			&spec->mem.size,
+			line->opt);
+	profile_count("bytes", spec->mem.size);
+	profile_end();
+	spec->name = string_ref(line->dst);
+	if (line->cache) {
+		// write file to cache
+		if (!file_write(line->cache->text, spec->mem.data, spec->mem.size)) {
+			WARNING("file_write(\"%s\"): %s", line->cache->text,
+					strerror(errno));
+			NOTICE("caching %s", line->cache->text);
+		}
+	}
+}
+
 static struct ar_file_spec **alicepack_to_file_list(struct ar_manifest *mf, size_t *size_out)
 {
 	struct ar_file_spec **files = xcalloc(mf->nr_rows, sizeof(struct ar_file_spec*));
 	*size_out = mf->nr_rows;
 
+	// each base CG is decoded once and shared by all DCF diffs against it
+	struct cg_cache *dcf_bases = cg_cache_new();
+	for (size_t i = 0; i < mf->nr_rows; i++) {
+		struct alicepack_line *line = &mf->alicepack[i];
+		if (is_dcf_line(line)) {
+			struct string *base = path_join_string(mf->src_dir, line->opt);
+			cg_cache_reserve(dcf_bases, base->text);
+			free_string(base);
+		}
+	}
+
+	// conversions are run in parallel
+	struct job_group *group = job_group_new();
 	for (size_t i = 0; i < mf->nr_rows; i++) {
 		files[i] = xmalloc(sizeof(struct ar_file_spec));
 		struct alicepack_line *line = &mf->alicepack[i];
 		if (line->dst_fmt != AR_FT_UNKNOWN) {
-			// XXX: we don't cache .flat files, because timestamp check on .x
-			//      file doesn't capture changes to CGs
-			if (line->dst_fmt == AR_FT_FLAT && line->cache) {
-				free_string(line->cache);
-				line->cache = NULL;
-			}
-			if (line->cache && file_exists(line->cache->text)) {
-				// check timestamps
-				ustat src_s, cache_s;
-				checked_stat(line->src->text, &src_s);
-				checked_stat(line->cache->text, &cache_s);
-				if (src_s.st_mtime < cache_s.st_mtime) {
-					// cache hit
-					files[i]->type = AR_FILE_SPEC_DISK;
-					files[i]->disk.path = string_ref(line->cache);
-					files[i]->name = string_ref(line->dst);
-					continue;
-				}
-			}
-			files[i]->type = AR_FILE_SPEC_MEM;
-			files[i]->mem.data = convert_file_mem(mf,
-					line->src,
-					line->src_fmt,
-					line->dst_fmt,
-					&files[i]->mem.size,
-					line->opt);
-			files[i]->name = string_ref(line->dst);
-			if (line->cache) {
-				// write file to cache
-				if (!file_write(line->cache->text, files[i]->mem.data,
-							files[i]->mem.size)) {
-					WARNING("file_write(\"%s\"): %s", line->cache->text,
-							strerror(errno));
-					NOTICE("caching %s", line->cache->text);
-				}
-			}
+			struct alicepack_job *job = xmalloc(sizeof(struct alicepack_job));
+			*job = (struct alicepack_job) {
+				.mf = mf,
+				.dcf_bases = dcf_bases,
+				.line = line,
+				.spec = files[i],
+			};
+			job_group_add(group, alicepack_convert, job);
 		} else {
 			files[i]->type = AR_FILE_SPEC_DISK;
 			files[i]->disk.path = string_ref(line->src);
 			files[i]->name = string_ref(line->dst);
 		}
 	}
+	job_group_run(group);
+	cg_cache_free(dcf_bases);
 
 	return files;
 }
@@ -283,34 +381,107 @@ static void convert_flat(struct string *src, enum ar_filetype src_fmt,
 		return;
 	}
 
-	// TODO: Only rebuild .flat files if the inputs have been modified.
-	//       This will require splitting flat_build into two parts:
-	//         * flat_read_manifest -> manifest object
-	//         * flat_load_manifest -> flat object
-	//       In between, we can stat the input files to check timestamps.
-	struct string *output_path = NULL;
-	struct flat *flat = flat_build(src->text, &output_path);
+	// dependencies are recorded in a hidden file next to the output, so
+	// that unchanged .flat files aren't rebuilt
+	struct string *deps_name = make_string(".", 1);
+	string_append_cstr(&deps_name, name, strlen(name));
+	string_append_cstr(&deps_name, ".deps", 5);
+	struct string *deps_path = string_path_join(dst_dir, deps_name->text);
+	free_string(deps_name);
+	if (flat_deps_up_to_date(deps_path->text)) {
+		free_string(deps_path);
+		return;
+	}
+
+	profile_begin("convert %s", src->text);
+	struct flat_manifest *mf = flat_read_manifest(src->text);
+	struct string *output_path = flat_manifest_output_path(mf);
 	if (output_path) {
-		struct string *tmp = string_path_join(dst_dir, output_path->text);
-		free_string(output_path);
-		output_path = tmp;
+		output_path = string_path_join(dst_dir, output_path->text);
 	} else {
 		struct string *tmp = string_path_join(dst_dir, name);
 		output_path = replace_extension(tmp->text, "flat");
 		free_string(tmp);
 	}
 
+	struct flat *flat = flat_load_manifest(mf);
 	mkdir_for_file(output_path->text);
 	FILE *out = checked_fopen(output_path->text, "wb");
 	checked_fwrite(flat->data, flat->data_size, out);
 	fclose(out);
+	flat_write_deps(mf, deps_path->text, output_path->text);
+	profile_count("bytes", flat->data_size);
+	profile_end();
 
+	flat_manifest_free(mf);
 	flat_free(flat);
 	free_string(output_path);
+	free_string(deps_path);
+}
+
+struct convert_job {
+	struct string *src;
+	struct string *dst;
+	enum ar_filetype src_fmt;
+	enum ar_filetype dst_fmt;
+	char *name;
+};
+
+static void convert_job_free(struct convert_job *job)
+{
+	free_string(job->src);
+	free_string(job->dst);
+	free(job->name);
+	free(job);
+}
+
+static void convert_flat_job(void *data)
+{
+	struct convert_job *job = data;
+	convert_flat(job->src, job->src_fmt, job->dst, job->name);
+	convert_job_free(job);
 }
 
+static void convert_file_job(void *data)
+{
+	struct convert_job *job = data;
+	NOTICE("%s -> %s", job->src->text, job->dst->text);
+	profile_begin("convert %s", job->src->text);
+
+	// skip transcode if src/dst formats match
+	if (job->src_fmt == job->dst_fmt) {
+		if (!file_copy(job->src->text, job->dst->text)) {
+			ALICE_ERROR("failed to copy file \"%s\": %s", job->dst->text, strerror(errno));
+		}
+	} else {
+		convert_file(job->src, job->src_fmt, job->dst, job->dst_fmt);
+	}
+	profile_end();
+	convert_job_free(job);
+}
+
+static void add_convert_job(struct job_group *group, void (*fn)(void*), struct string *src,
+		enum ar_filetype src_fmt, struct string *dst, enum ar_filetype dst_fmt,
+		const char *name)
+{
+	struct convert_job *job = xmalloc(sizeof(struct convert_job));
+	*job = (struct convert_job) {
+		.src = string_ref(src),
+		.dst = string_ref(dst),
+		.src_fmt = src_fmt,
+		.dst_fmt = dst_fmt,
+		.name = name ? xstrdup(name) : NULL,
+	};
+	job_group_add(group, fn, job);
+}
+
+/*
+ * Queue conversions for the files in src_dir. The conversions are run when
+ * the group is run.
+ */
 static void convert_dir(struct string *src_dir, enum ar_filetype src_fmt,
-			struct string *dst_dir, enum ar_filetype dst_fmt)
+			struct string *dst_dir, enum ar_filetype dst_fmt,
+			struct job_group *group)
 {
 	char *d_name;
 	UDIR *d = checked_opendir(src_dir->text);
@@ -327,7 +498,7 @@ static void convert_dir(struct string *src_dir, enum ar_filetype src_fmt,
 		checked_stat(src_path->text, &src_s);
 
 		if (S_ISDIR(src_s.st_mode)) {
-			convert_dir(src_path, src_fmt, dst_base, dst_fmt);
+			convert_dir(src_path, src_fmt, dst_base, dst_fmt, group);
 			goto loop_next;
 		}
 		if (!S_ISREG(src_s.st_mode)) {
@@ -336,7 +507,7 @@ static void convert_dir(struct string *src_dir, enum ar_filetype src_fmt,
 		}
 		// flat conversion is a special case
 		if (dst_fmt == AR_FT_FLAT) {
-			convert_flat(src_path, src_fmt, dst_dir, d_name);
+			add_convert_job(group, convert_flat_job, src_path, src_fmt, dst_dir, dst_fmt, d_name);
 			goto loop_next;
 		}
 
@@ -352,17 +523,7 @@ static void convert_dir(struct string *src_dir, enum ar_filetype src_fmt,
 				goto loop_next;
 		}
 
-		NOTICE("%s -> %s", src_path->text, dst_path->text);
-
-		// skip transcode if src/dst formats match
-		if (src_fmt == dst_fmt) {
-			if (!file_copy(src_path->text, dst_path->text)) {
-				ALICE_ERROR("failed to copy file \"%s\": %s", dst_path->text, strerror(errno));
-			}
-			goto loop_next;
-		}
-
-		convert_file(src_path, src_fmt, dst_path, dst_fmt);
+		add_convert_job(group, convert_file_job, src_path, src_fmt, dst_path, dst_fmt, NULL);
 
 	loop_next:
 		free_string(src_path);
@@ -373,9 +534,9 @@ static void convert_dir(struct string *src_dir, enum ar_filetype src_fmt,
 	closedir_utf8(d);
 }
 
-static void batchpack_convert(struct batchpack_line *line)
+static void batchpack_convert(struct batchpack_line *line, struct job_group *group)
 {
-	convert_dir(line->src, line->src_fmt, line->dst, line->dst_fmt);
+	convert_dir(line->src, line->src_fmt, line->dst, line->dst_fmt, group);
 }
 
 static void dir_to_file_list(struct string *dst, struct string *base_name, ar_file_list *files, enum ar_filetype fmt)
@@ -445,7 +606,8 @@ static struct ar_file_spec **batchpack_to_file_list(struct ar_manifest *mf, size
 	ar_file_list files;
 	vector_init(files);
 
-	// convert files
+	// convert files (in parallel)
+	struct job_group *group = job_group_new();
 	for (size_t i = 0; i < mf->nr_rows; i++) {
 		struct string *src = mf->batchpack[i].src;
 		struct string *dst = mf->batchpack[i].dst;
@@ -457,9 +619,10 @@ static struct ar_file_spec **batchpack_to_file_list(struct ar_manifest *mf, size
 		if (strcmp(src->text, dst->text)) {
 			if (!is_directory(src->text))
 				ALICE_ERROR("line %d: \"%s\" is not a directory", (int)i+2, src->text);
-			batchpack_convert(mf->batchpack+i);
+			batchpack_convert(mf->batchpack+i, group);
 		}
 	}
+	job_group_run(group);
 
 	// create file list from output dirs
 	for (size_t i = 0; i < mf->nr_rows; i++) {
@@ -623,7 +786,10 @@ void ar_pack_manifest(struct ar_manifest *ar, int afa_version)
 {
 	size_t nr_files;
 	struct ar_file_spec **files = manifest_to_file_list(ar, &nr_files);
+	profile_begin("afa.write %s", ar->output_path->text);
 	write_afa(ar->output_path, files, nr_files, afa_version);
+	profile_count("files", nr_files);
+	profile_end();
 	for (size_t i = 0; i < nr_files; i++) {
 		ar_file_spec_free(files[i]);
 	}
@@ -0,0 +1,232 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "system4.h"
+#include "system4/archive.h"
+#include "system4/cg.h"
+#include "system4/file.h"
+#include "system4/string.h"
+#include "system4/vector.h"
+#include "alice.h"
+#include "alice/ar.h"
+#include "alice/jobs.h"
+#include "alice/thumbnail.h"
+
+/*
+ * Thumbnails are generated directly from the archive: each member is loaded,
+ * decoded and scaled by a job and released again before the next member is
+ * loaded on that thread, so at most one full-size image per thread is in
+ * memory at any time.
+ */
+
+struct member_thumbnail {
+	struct archive_data *file;
+	struct string *output_file; // NULL when building a contact sheet
+	int size;
+	struct cg *cg;
+};
+
+typedef vector_t(struct member_thumbnail) member_list;
+
+static void collect_iter(struct archive_data *data, void *_list)
+{
+	member_list *list = _list;
+	struct member_thumbnail *m = vector_pushp(struct member_thumbnail, *list);
+	*m = (struct member_thumbnail) { .file = archive_copy_descriptor(data) };
+}
+
+static struct string *member_output_file(const char *dir, const char *name)
+{
+	struct string *u = string_conv_output(name, strlen(name));
+	struct string *tmp = replace_extension(u->text, "png");
+	free_string(u);
+	for (unsigned i = 0; i < tmp->size; i++) {
+		if (tmp->text[i] == '\\')
+			tmp->text[i] = '/';
+	}
+	struct string *d = cstr_to_string(dir);
+	struct string *path = string_path_join(d, tmp->text);
+	free_string(d);
+	free_string(tmp);
+	return path;
+}
+
+static void member_warning(const char *msg, struct archive_data *file)
+{
+	char *u = conv_output(file->name);
+	WARNING("%s: %s", msg, u);
+	free(u);
+}
+
+static void member_thumbnail_job(void *data)
+{
+	struct member_thumbnail *m = data;
+	if (!archive_load_file(m->file)) {
+		member_warning("Error loading file", m->file);
+		return;
+	}
+	if (m->file->size < 4 || cg_check_format(m->file->data) == ALCG_UNKNOWN) {
+		archive_release_file(m->file);
+		return;
+	}
+
+	struct cg *cg = cg_load_data(m->file);
+	archive_release_file(m->file);
+	if (!cg) {
+		member_warning("Failed to load CG", m->file);
+		return;
+	}
+	m->cg = thumbnail_scale(cg, m->size, false);
+	cg_free(cg);
+
+	if (!m->output_file)
+		return;
+
+	mkdir_for_file(m->output_file->text);
+	// a file that can't be written doesn't stop the other jobs
+	FILE *f = file_open_utf8(m->output_file->text, "wb");
+	if (!f) {
+		WARNING("fopen(\"%s\"): %s", m->output_file->text, strerror(errno));
+		goto out;
+	}
+	if (cg_write(m->cg, ALCG_PNG, f))
+		NOTICE("%s", m->output_file->text);
+	else
+		WARNING("Failed to write thumbnail: %s", m->output_file->text);
+	fclose(f);
+out:
+	cg_free(m->cg);
+	m->cg = NULL;
+}
+
+static void thumbnail_members(struct archive *ar, member_list *list, const char *output_dir, int size)
+{
+	archive_for_each(ar, collect_iter, list);
+
+	struct job_group *group = job_group_new();
+	struct member_thumbnail *m;
+	vector_foreach_p(m, *list) {
+		m->size = size;
+		if (output_dir)
+			m->output_file = member_output_file(output_dir, m->file->name);
+		job_group_add(group, member_thumbnail_job, m);
+	}
+	job_group_run(group);
+}
+
+static void free_members(member_list *list)
+{
+	struct member_thumbnail *m;
+	vector_foreach_p(m, *list) {
+		if (m->output_file)
+			free_string(m->output_file);
+		if (m->cg)
+			cg_free(m->cg);
+		archive_free_data(m->file);
+	}
+	vector_destroy(*list);
+}
+
+/*
+ * Write a thumbnail of every image in an archive to output_dir, as
+ * <member-name>.png.
+ */
+void ar_thumbnail_all(struct archive *ar, const char *output_dir, int size)
+{
+	member_list list = vector_initializer;
+	thumbnail_members(ar, &list, output_dir, size);
+	free_members(&list);
+}
+
+/*
+ * Copy a thumbnail into the centre of a size x size cell of a contact sheet.
+ */
+static void blit_cell(struct cg *sheet, struct cg *cg, int cell_x, int cell_y, int size)
+{
+	int x = cell_x + (size - cg->metrics.w) / 2;
+	int y = cell_y + (size - cg->metrics.h) / 2;
+	int pitch = cg->metrics.pixel_pitch ? cg->metrics.pixel_pitch : cg->metrics.w * 4;
+	uint8_t *src = cg->pixels;
+	uint8_t *dst = (uint8_t*)sheet->pixels + (y * sheet->metrics.pixel_pitch) + x * 4;
+	for (int row = 0; row < cg->metrics.h; row++) {
+		memcpy(dst, src, cg->metrics.w * 4);
+		src += pitch;
+		dst += sheet->metrics.pixel_pitch;
+	}
+}
+
+/*
+ * Write a contact sheet of every image in an archive to output_file (as PNG).
+ * Thumbnails are laid out in archive order in a grid of size x size cells,
+ * 'columns' cells wide.
+ */
+void ar_contact_sheet(struct archive *ar, const char *output_file, int size, int columns)
+{
+	member_list list = vector_initializer;
+	thumbnail_members(ar, &list, NULL, size);
+
+	int nr_images = 0;
+	struct cg *first = NULL;
+	struct member_thumbnail *m;
+	vector_foreach_p(m, list) {
+		if (!m->cg)
+			continue;
+		if (!first)
+			first = m->cg;
+		nr_images++;
+	}
+	if (!first) {
+		WARNING("No images in archive");
+		free_members(&list);
+		return;
+	}
+
+	if (columns > nr_images)
+		columns = nr_images;
+	int rows = (nr_images + columns - 1) / columns;
+
+	// empty cells are left transparent
+	struct cg *sheet = xmalloc(sizeof(struct cg));
+	*sheet = *first;
+	sheet->metrics.w = columns * size;
+	sheet->metrics.h = rows * size;
+	sheet->metrics.has_alpha = true;
+	sheet->metrics.pixel_pitch = sheet->metrics.w * 4;
+	sheet->pixels = xcalloc(sheet->metrics.h, sheet->metrics.pixel_pitch);
+
+	int i = 0;
+	vector_foreach_p(m, list) {
+		if (!m->cg)
+			continue;
+		blit_cell(sheet, m->cg, (i % columns) * size, (i / columns) * size, size);
+		i++;
+	}
+	free_members(&list);
+
+	FILE *f = checked_fopen(output_file, "wb");
+	if (!f) {
+		cg_free(sheet);
+		return;
+	}
+	if (!cg_write(sheet, ALCG_PNG, f))
+		ALICE_ERROR("cg_write failed");
+	fclose(f);
+	cg_free(sheet);
+}
@@ -0,0 +1,149 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+
+#include <stdlib.h>
+#include <pthread.h>
+#include "system4.h"
+#include "system4/cg.h"
+#include "khash.h"
+#include "alice.h"
+#include "alice/cg_cache.h"
+
+struct cg_cache_entry {
+	// serializes decoding of the CG
+	pthread_mutex_t load_mutex;
+	struct cg *cg;
+	unsigned refs;
+	unsigned pending;
+};
+
+KHASH_MAP_INIT_STR(cg_table, struct cg_cache_entry*);
+
+struct cg_cache {
+	// protects the table and entry counts
+	pthread_mutex_t mutex;
+	khash_t(cg_table) *table;
+};
+
+struct cg_cache *cg_cache_new(void)
+{
+	struct cg_cache *cache = xmalloc(sizeof(struct cg_cache));
+	pthread_mutex_init(&cache->mutex, NULL);
+	cache->table = kh_init(cg_table);
+	return cache;
+}
+
+void cg_cache_free(struct cg_cache *cache)
+{
+	const char *path;
+	struct cg_cache_entry *e;
+	kh_foreach(cache->table, path, e, {
+		if (e->cg)
+			cg_free(e->cg);
+		pthread_mutex_destroy(&e->load_mutex);
+		free((char*)path);
+		free(e);
+	});
+	kh_destroy(cg_table, cache->table);
+	pthread_mutex_destroy(&cache->mutex);
+	free(cache);
+}
+
+// must be called with cache->mutex held
+static struct cg_cache_entry *get_entry(struct cg_cache *cache, const char *path)
+{
+	int ret;
+	khiter_t k = kh_get(cg_table, cache->table, path);
+	if (k != kh_end(cache->table))
+		return kh_value(cache->table, k);
+
+	struct cg_cache_entry *e = xcalloc(1, sizeof(struct cg_cache_entry));
+	pthread_mutex_init(&e->load_mutex, NULL);
+	k = kh_put(cg_table, cache->table, xstrdup(path), &ret);
+	kh_value(cache->table, k) = e;
+	return e;
+}
+
+void cg_cache_reserve(struct cg_cache *cache, const char *path)
+{
+	pthread_mutex_lock(&cache->mutex);
+	get_entry(cache, path)->pending++;
+	pthread_mutex_unlock(&cache->mutex);
+}
+
+/*
+ * Withdraw a reservation made with cg_cache_reserve, freeing the CG if it
+ * has no other users.
+ */
+void cg_cache_unreserve(struct cg_cache *cache, const char *path)
+{
+	struct cg *cg = NULL;
+	pthread_mutex_lock(&cache->mutex);
+	khiter_t k = kh_get(cg_table, cache->table, path);
+	if (k == kh_end(cache->table))
+		ALICE_ERROR("cg_cache_unreserve: no entry for '%s'", path);
+	struct cg_cache_entry *e = kh_value(cache->table, k);
+	if (e->pending && !--e->pending && !e->refs) {
+		cg = e->cg;
+		e->cg = NULL;
+	}
+	pthread_mutex_unlock(&cache->mutex);
+
+	if (cg)
+		cg_free(cg);
+}
+
+/*
+ * Get the decoded CG at `path`, decoding it if it isn't already cached.
+ * Returns NULL if the CG couldn't be loaded (cg_cache_release must still be
+ * called).
+ */
+struct cg *cg_cache_get(struct cg_cache *cache, const char *path)
+{
+	pthread_mutex_lock(&cache->mutex);
+	struct cg_cache_entry *e = get_entry(cache, path);
+	if (e->pending)
+		e->pending--;
+	e->refs++;
+	pthread_mutex_unlock(&cache->mutex);
+
+	// the entry can't be freed while we hold a reference
+	pthread_mutex_lock(&e->load_mutex);
+	if (!e->cg)
+		e->cg = cg_load_file(path);
+	struct cg *cg = e->cg;
+	pthread_mutex_unlock(&e->load_mutex);
+	return cg;
+}
+
+void cg_cache_release(struct cg_cache *cache, const char *path)
+{
+	struct cg *cg = NULL;
+	pthread_mutex_lock(&cache->mutex);
+	khiter_t k = kh_get(cg_table, cache->table, path);
+	if (k == kh_end(cache->table))
+		ALICE_ERROR("cg_cache_release: no entry for '%s'", path);
+	struct cg_cache_entry *e = kh_value(cache->table, k);
+	if (!--e->refs && !e->pending) {
+		cg = e->cg;
+		e->cg = NULL;
+	}
+	pthread_mutex_unlock(&cache->mutex);
+
+	if (cg)
+		cg_free(cg);
+}
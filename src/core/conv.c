@@ -119,11 +119,12 @@ static char *convert_text(iconv_t cd, const char *str, size_t len, const char *e
 
 const char *input_encoding = "CP932";
 const char *output_encoding = "UTF-8";
-static iconv_t output_conv = (iconv_t)-1;
-static iconv_t input_conv = (iconv_t)-1;
-static iconv_t utf8_conv = (iconv_t)-1;
-static iconv_t output_utf8_conv = (iconv_t)-1;
-static iconv_t utf8_input_conv = (iconv_t)-1;
+// iconv descriptors are stateful, so each thread needs its own
+static _Thread_local iconv_t output_conv = (iconv_t)-1;
+static _Thread_local iconv_t input_conv = (iconv_t)-1;
+static _Thread_local iconv_t utf8_conv = (iconv_t)-1;
+static _Thread_local iconv_t output_utf8_conv = (iconv_t)-1;
+static _Thread_local iconv_t utf8_input_conv = (iconv_t)-1;
 
 static void free_conv(iconv_t *conv)
 {
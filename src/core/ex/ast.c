@@ -42,7 +42,7 @@ struct ex *ex_parse_file(const char *path)
 	if (!strcmp(path, "-")) {
 		return ex_parse(stdin, "");
 	}
-	char *basepath = strdup(path_dirname(path));
+	char *basepath = path_dirname_r(path);
 	FILE *f = checked_fopen(path, "rb");
 	struct ex *ex = ex_parse(f, basepath);
 	fclose(f);
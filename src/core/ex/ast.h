@@ -30,7 +30,6 @@ typedef vector_t(value_list*) row_list;
 typedef vector_t(struct ex_tree*) node_list;
 
 // ex_parser.y
-extern struct ex *ex_data;
 enum ex_value_type ast_token_to_value_type(int token);
 
 // ex_lexer.l
@@ -0,0 +1,93 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "system4.h"
+#include "system4/ex.h"
+#include "system4/string.h"
+#include "alice.h"
+#include "alice/ex.h"
+
+/*
+ * Columnar tables. A table whose columns each contain values of a single
+ * scalar type (int, float or string) can be stored as one array per column
+ * rather than one array of tagged values per row. String columns store
+ * offsets into a heap of NUL-terminated strings shared by the whole table.
+ */
+
+static bool scalar_type(uint32_t type)
+{
+	return type == EX_INT || type == EX_FLOAT || type == EX_STRING;
+}
+
+/*
+ * Allocate a columnar table with the column types given by fields. Returns
+ * NULL if there are no fields or any column isn't of a scalar type. The fields are not copied.
+ */
+struct ex_columns *ex_columns_new(struct ex_field *fields, uint32_t nr_fields,
+		uint32_t nr_columns, uint32_t nr_rows)
+{
+	if (!nr_fields || nr_columns > nr_fields)
+		return NULL;
+	for (uint32_t i = 0; i < nr_columns; i++) {
+		if (!scalar_type(fields[i].type))
+			return NULL;
+	}
+
+	struct ex_columns *c = xcalloc(1, sizeof(struct ex_columns));
+	c->nr_fields = nr_fields;
+	c->fields = fields;
+	c->nr_columns = nr_columns;
+	c->nr_rows = nr_rows;
+	c->columns = xcalloc(nr_columns, sizeof(struct ex_column));
+	for (uint32_t i = 0; i < nr_columns; i++) {
+		c->columns[i].type = fields[i].type;
+		// int, float and string offsets are all 4 bytes
+		c->columns[i].i = xcalloc(nr_rows ? nr_rows : 1, sizeof(int32_t));
+	}
+	return c;
+}
+
+void ex_columns_free(struct ex_columns *c)
+{
+	for (uint32_t i = 0; i < c->nr_columns; i++) {
+		free(c->columns[i].i);
+	}
+	free(c->columns);
+	free(c->heap);
+	free(c);
+}
+
+/*
+ * Add a string to the heap, returning its offset.
+ */
+uint32_t ex_columns_add_string(struct ex_columns *c, const char *s, size_t len)
+{
+	if (c->heap_size + len + 1 > c->heap_cap) {
+		c->heap_cap = c->heap_cap ? c->heap_cap * 2 : 4096;
+		while (c->heap_size + len + 1 > c->heap_cap)
+			c->heap_cap *= 2;
+		c->heap = xrealloc(c->heap, c->heap_cap);
+	}
+	uint32_t off = c->heap_size;
+	memcpy(c->heap + off, s, len);
+	c->heap[off + len] = '\0';
+	c->heap_size += len + 1;
+	return off;
+}
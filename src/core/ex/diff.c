@@ -0,0 +1,976 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "system4.h"
+#include "system4/ex.h"
+#include "system4/string.h"
+#include "system4/vector.h"
+#include "khash.h"
+#include "alice.h"
+#include "alice/ex.h"
+#include "alice/port.h"
+
+/*
+ * Structural .ex diff/patch.
+ *
+ * A patch is an ordinary .txtex file. Blocks in the patch are applied to the
+ * block of the same name in the base file (or appended if there is no such
+ * block):
+ *
+ *   - Tables with an indexed int/string field are merged by key: each row in
+ *     the patch replaces the row with the same key, or is appended.
+ *   - Trees are merged by node name: subtrees are merged recursively, and
+ *     leaves replace the node with the same name, or are appended.
+ *   - Anything else (including tables and trees which can't be merged, e.g.
+ *     because their keys are not unique) is replaced.
+ *
+ * Deletions are given in a tree block named "__delete__", which is applied
+ * before anything else. Each node names a block: `name = 0` deletes the
+ * block, `name = (list) { keys... }` deletes table rows by key, and
+ * `name = { ... }` deletes tree nodes (recursively, in the same format).
+ */
+
+KHASH_MAP_INIT_STR(key_index, unsigned);
+
+/*
+ * Equality
+ */
+
+static bool ex_tree_equal(struct ex_tree *a, struct ex_tree *b, float eps);
+static bool value_equal(struct ex_value *a, struct ex_value *b, float eps);
+
+static bool ex_field_equal(struct ex_field *a, struct ex_field *b, float eps)
+{
+	if (a->type != b->type)
+		return false;
+	if (strcmp(a->name->text, b->name->text))
+		return false;
+	if (a->has_value != b->has_value)
+		return false;
+	if (a->is_index != b->is_index)
+		return false;
+	if (a->has_value && !value_equal(&a->value, &b->value, eps))
+		return false;
+	if (a->nr_subfields != b->nr_subfields)
+		return false;
+	for (unsigned i = 0; i < a->nr_subfields; i++) {
+		if (!ex_field_equal(&a->subfields[i], &b->subfields[i], eps))
+			return false;
+	}
+	return true;
+}
+
+static bool ex_fields_equal(struct ex_table *a, struct ex_table *b, float eps)
+{
+	if (a->nr_fields != b->nr_fields)
+		return false;
+	for (unsigned i = 0; i < a->nr_fields; i++) {
+		if (!ex_field_equal(&a->fields[i], &b->fields[i], eps))
+			return false;
+	}
+	return a->nr_columns == b->nr_columns;
+}
+
+static bool ex_row_equal(struct ex_value *a, struct ex_value *b, unsigned nr_columns, float eps)
+{
+	for (unsigned i = 0; i < nr_columns; i++) {
+		if (!value_equal(&a[i], &b[i], eps))
+			return false;
+	}
+	return true;
+}
+
+static bool ex_table_equal(struct ex_table *a, struct ex_table *b, float eps)
+{
+	if (!ex_fields_equal(a, b, eps))
+		return false;
+	if (a->nr_rows != b->nr_rows)
+		return false;
+	for (unsigned i = 0; i < a->nr_rows; i++) {
+		if (!ex_row_equal(a->rows[i], b->rows[i], a->nr_columns, eps))
+			return false;
+	}
+	return true;
+}
+
+static bool ex_list_equal(struct ex_list *a, struct ex_list *b, float eps)
+{
+	if (a->nr_items != b->nr_items)
+		return false;
+	for (unsigned i = 0; i < a->nr_items; i++) {
+		if (a->items[i].size != b->items[i].size)
+			return false;
+		if (!value_equal(&a->items[i].value, &b->items[i].value, eps))
+			return false;
+	}
+	return true;
+}
+
+static bool ex_tree_equal(struct ex_tree *a, struct ex_tree *b, float eps)
+{
+	if (strcmp(a->name->text, b->name->text))
+		return false;
+	if (a->is_leaf != b->is_leaf)
+		return false;
+	if (a->is_leaf) {
+		if (a->leaf.size != b->leaf.size)
+			return false;
+		if (strcmp(a->leaf.name->text, b->leaf.name->text))
+			return false;
+		if (!value_equal(&a->leaf.value, &b->leaf.value, eps))
+			return false;
+	} else {
+		if (a->nr_children != b->nr_children)
+			return false;
+		for (unsigned i = 0; i < a->nr_children; i++) {
+			if (!ex_tree_equal(&a->children[i], &b->children[i], eps))
+				return false;
+		}
+	}
+	return true;
+}
+
+static bool value_equal(struct ex_value *a, struct ex_value *b, float eps)
+{
+	if (a->type != b->type)
+		return false;
+	switch (a->type) {
+	case EX_INT:
+		return a->i == b->i;
+	case EX_FLOAT:
+		if (eps > 0)
+			return fabsf(a->f - b->f) < eps;
+		// exact comparison: distinguishes e.g. 0.0 and -0.0
+		return !memcmp(&a->f, &b->f, sizeof(float));
+	case EX_STRING:
+		return !strcmp(a->s->text, b->s->text);
+	case EX_TABLE:
+		return ex_table_equal(a->t, b->t, eps);
+	case EX_LIST:
+		return ex_list_equal(a->list, b->list, eps);
+	case EX_TREE:
+		return ex_tree_equal(a->tree, b->tree, eps);
+	default:
+		ERROR("Unrecognized type: %d", a->type);
+	}
+}
+
+/*
+ * Compare two values exactly (floats are compared bit for bit).
+ */
+bool ex_value_equal(struct ex_value *a, struct ex_value *b)
+{
+	return value_equal(a, b, 0);
+}
+
+/*
+ * Compare two values, treating floats which differ by less than epsilon as
+ * equal.
+ */
+bool ex_value_equal_approx(struct ex_value *a, struct ex_value *b, float epsilon)
+{
+	return value_equal(a, b, epsilon);
+}
+
+/*
+ * Keys
+ */
+
+struct key_set {
+	unsigned n;
+	char **keys;
+	khash_t(key_index) *map;
+};
+
+static char *value_key(struct ex_value *v)
+{
+	char buf[16];
+	switch (v->type) {
+	case EX_INT:
+		snprintf(buf, sizeof(buf), "i%d", v->i);
+		return xstrdup(buf);
+	case EX_STRING: {
+		char *key = xmalloc(v->s->size + 2);
+		key[0] = 's';
+		memcpy(key+1, v->s->text, v->s->size + 1);
+		return key;
+	}
+	default:
+		return NULL;
+	}
+}
+
+/*
+ * Index a list of keys (taking ownership of the list). Returns false if any
+ * key is missing or duplicated.
+ */
+static bool key_set_init(struct key_set *set, char **keys, unsigned n)
+{
+	set->n = n;
+	set->keys = keys;
+	set->map = kh_init(key_index);
+	for (unsigned i = 0; i < n; i++) {
+		if (!keys[i])
+			return false;
+		int ret;
+		khiter_t k = kh_put(key_index, set->map, keys[i], &ret);
+		if (!ret)
+			return false;
+		kh_value(set->map, k) = i;
+	}
+	return true;
+}
+
+static void key_set_fini(struct key_set *set)
+{
+	if (set->map)
+		kh_destroy(key_index, set->map);
+	for (unsigned i = 0; i < set->n; i++) {
+		free(set->keys[i]);
+	}
+	free(set->keys);
+}
+
+static int key_set_find(struct key_set *set, const char *key)
+{
+	khiter_t k = kh_get(key_index, set->map, key);
+	if (k == kh_end(set->map))
+		return -1;
+	return kh_value(set->map, k);
+}
+
+/*
+ * The first indexed int/string field of a table, or -1.
+ */
+static int index_column(struct ex_table *t)
+{
+	for (uint32_t i = 0; i < t->nr_fields && i < t->nr_columns; i++) {
+		struct ex_field *f = &t->fields[i];
+		if (f->is_index && (f->type == EX_INT || f->type == EX_STRING))
+			return i;
+	}
+	return -1;
+}
+
+static bool table_keys(struct ex_table *t, struct key_set *set)
+{
+	int col = index_column(t);
+	char **keys = xcalloc(t->nr_rows, sizeof(char*));
+	for (uint32_t i = 0; col >= 0 && i < t->nr_rows; i++) {
+		keys[i] = value_key(&t->rows[i][col]);
+	}
+	return key_set_init(set, keys, t->nr_rows) && col >= 0;
+}
+
+static bool tree_keys(struct ex_tree *t, struct key_set *set)
+{
+	if (t->is_leaf) {
+		key_set_init(set, NULL, 0);
+		return false;
+	}
+	char **keys = xcalloc(t->nr_children, sizeof(char*));
+	for (uint32_t i = 0; i < t->nr_children; i++) {
+		keys[i] = xstrdup(t->children[i].name->text);
+	}
+	return key_set_init(set, keys, t->nr_children);
+}
+
+/*
+ * Match up two sequences of unique keys. Keys of b which appear in a (in the
+ * same relative order) are matched, up to the first key which is out of order
+ * or which is new but followed by matched keys. Keys of a which are not
+ * matched are marked as deleted. Deleting those and then appending the
+ * unmatched keys of b (in order) yields b.
+ */
+static void match_keys(struct key_set *a, struct key_set *b, int *b_to_a, bool *a_deleted)
+{
+	unsigned nr_common = 0;
+	for (unsigned i = 0; i < a->n; i++) {
+		a_deleted[i] = true;
+	}
+	for (unsigned j = 0; j < b->n; j++) {
+		b_to_a[j] = key_set_find(a, b->keys[j]);
+		if (b_to_a[j] >= 0) {
+			a_deleted[b_to_a[j]] = false;
+			nr_common++;
+		}
+	}
+
+	unsigned ai = 0;
+	bool tail = false;
+	for (unsigned j = 0; j < b->n; j++) {
+		int i = b_to_a[j];
+		if (!tail) {
+			while (ai < a->n && a_deleted[ai])
+				ai++;
+			if (i >= 0 && (unsigned)i == ai) {
+				ai++;
+				nr_common--;
+				continue;
+			}
+			if (i < 0 && nr_common == 0)
+				continue;
+			tail = true;
+			for (unsigned k = ai; k < a->n; k++) {
+				a_deleted[k] = true;
+			}
+		}
+		b_to_a[j] = -1;
+	}
+}
+
+/*
+ * Diff
+ */
+
+typedef vector_t(void*) alloc_list;
+typedef vector_t(struct ex_tree) node_vector;
+
+struct ex_differ {
+	struct port *port;
+	unsigned nr_emitted;
+	alloc_list tmp;                    // freed after each block
+	alloc_list allocs;                 // freed at the end
+	vector_t(struct string*) strings;  // freed at the end
+	node_vector deletes;
+};
+
+static void *diff_alloc(alloc_list *list, size_t nmemb, size_t size)
+{
+	void *p = xcalloc(nmemb ? nmemb : 1, size);
+	vector_push(void*, *list, p);
+	return p;
+}
+
+static void free_allocs(alloc_list *list)
+{
+	void *p;
+	vector_foreach(p, *list) {
+		free(p);
+	}
+	list->n = 0;
+}
+
+static struct string *diff_string(struct ex_differ *d, struct string *s)
+{
+	s = string_dup(s);
+	vector_push(struct string*, d->strings, s);
+	return s;
+}
+
+static struct ex_tree delete_node(struct string *name, struct ex_value value)
+{
+	return (struct ex_tree) {
+		.name = name,
+		.is_leaf = true,
+		.leaf = {
+			.name = name,
+			.value = value
+		}
+	};
+}
+
+/*
+ * Make a tree from a list of nodes. The node array is added to an allocation
+ * list.
+ */
+static struct ex_tree *make_tree(alloc_list *list, node_vector *nodes)
+{
+	struct ex_tree *tree = diff_alloc(list, 1, sizeof(struct ex_tree));
+	tree->is_leaf = false;
+	tree->nr_children = vector_length(*nodes);
+	tree->children = nodes->a;
+	vector_push(void*, *list, nodes->a);
+	return tree;
+}
+
+static void emit(struct ex_differ *d, struct string *name, struct ex_value *val)
+{
+	if (d->nr_emitted++)
+		port_printf(d->port, "\n\n");
+	ex_dump_key_value(d->port, name, val);
+	port_putc(d->port, ';');
+}
+
+/*
+ * Diff two tables. Returns false if b can't be merged into a by key.
+ * Otherwise *patch is set to a table containing the rows of b which were
+ * changed or added, and *del to the list of keys of rows in a which were
+ * deleted (either may be NULL).
+ */
+static bool diff_table(struct ex_differ *d, struct ex_table *a, struct ex_table *b,
+		struct ex_table **patch, struct ex_list **del)
+{
+	*patch = NULL;
+	*del = NULL;
+	if (!ex_fields_equal(a, b, 0))
+		return false;
+
+	struct key_set ka, kb;
+	bool mergeable = table_keys(a, &ka);
+	mergeable = table_keys(b, &kb) && mergeable;
+	if (!mergeable) {
+		key_set_fini(&ka);
+		key_set_fini(&kb);
+		return false;
+	}
+
+	int *b_to_a = xcalloc(b->nr_rows + 1, sizeof(int));
+	bool *a_deleted = xcalloc(a->nr_rows + 1, sizeof(bool));
+	match_keys(&ka, &kb, b_to_a, a_deleted);
+
+	vector_t(struct ex_value*) rows;
+	vector_init(rows);
+	for (uint32_t j = 0; j < b->nr_rows; j++) {
+		int i = b_to_a[j];
+		if (i < 0 || !ex_row_equal(a->rows[i], b->rows[j], a->nr_columns, 0))
+			vector_push(struct ex_value*, rows, b->rows[j]);
+	}
+	if (vector_length(rows)) {
+		*patch = diff_alloc(&d->tmp, 1, sizeof(struct ex_table));
+		**patch = *b;
+		(*patch)->nr_rows = vector_length(rows);
+		(*patch)->rows = rows.a;
+		vector_push(void*, d->tmp, rows.a);
+	} else {
+		vector_destroy(rows);
+	}
+
+	int col = index_column(a);
+	vector_t(struct ex_list_item) keys;
+	vector_init(keys);
+	for (uint32_t i = 0; i < a->nr_rows; i++) {
+		if (!a_deleted[i])
+			continue;
+		struct ex_list_item *item = vector_pushp(struct ex_list_item, keys);
+		item->size = 0;
+		item->value = a->rows[i][col];
+		if (item->value.type == EX_STRING)
+			item->value.s = diff_string(d, item->value.s);
+	}
+	if (vector_length(keys)) {
+		*del = diff_alloc(&d->allocs, 1, sizeof(struct ex_list));
+		(*del)->nr_items = vector_length(keys);
+		(*del)->items = keys.a;
+		vector_push(void*, d->allocs, keys.a);
+	} else {
+		vector_destroy(keys);
+	}
+
+	free(b_to_a);
+	free(a_deleted);
+	key_set_fini(&ka);
+	key_set_fini(&kb);
+	return true;
+}
+
+/*
+ * Diff two trees. Returns false if b can't be merged into a by node name.
+ * Otherwise *patch is set to a tree containing the nodes of b which were
+ * changed or added, and *del to a tree of nodes in a which were deleted
+ * (either may be NULL).
+ */
+static bool diff_tree(struct ex_differ *d, struct ex_tree *a, struct ex_tree *b,
+		struct ex_tree **patch, struct ex_tree **del)
+{
+	*patch = NULL;
+	*del = NULL;
+
+	struct key_set ka, kb;
+	bool mergeable = tree_keys(a, &ka);
+	mergeable = tree_keys(b, &kb) && mergeable;
+	if (!mergeable) {
+		key_set_fini(&ka);
+		key_set_fini(&kb);
+		return false;
+	}
+
+	int *b_to_a = xcalloc(b->nr_children + 1, sizeof(int));
+	bool *a_deleted = xcalloc(a->nr_children + 1, sizeof(bool));
+	match_keys(&ka, &kb, b_to_a, a_deleted);
+
+	node_vector children;
+	vector_init(children);
+	node_vector deletes;
+	vector_init(deletes);
+	for (uint32_t j = 0; j < b->nr_children; j++) {
+		struct ex_tree *bc = &b->children[j];
+		if (b_to_a[j] < 0) {
+			vector_push(struct ex_tree, children, *bc);
+			continue;
+		}
+		struct ex_tree *ac = &a->children[b_to_a[j]];
+		struct ex_tree *sub_patch, *sub_del;
+		if (!ac->is_leaf && !bc->is_leaf && diff_tree(d, ac, bc, &sub_patch, &sub_del)) {
+			if (sub_patch) {
+				sub_patch->name = bc->name;
+				vector_push(struct ex_tree, children, *sub_patch);
+			}
+			if (sub_del) {
+				sub_del->name = diff_string(d, ac->name);
+				vector_push(struct ex_tree, deletes, *sub_del);
+			}
+		} else if (!ex_tree_equal(ac, bc, 0)) {
+			vector_push(struct ex_tree, children, *bc);
+		}
+	}
+	for (uint32_t i = 0; i < a->nr_children; i++) {
+		if (!a_deleted[i])
+			continue;
+		struct string *name = diff_string(d, a->children[i].name);
+		vector_push(struct ex_tree, deletes,
+			delete_node(name, (struct ex_value) { .type = EX_INT, .i = 0 }));
+	}
+
+	if (vector_length(children))
+		*patch = make_tree(&d->tmp, &children);
+	else
+		vector_destroy(children);
+	if (vector_length(deletes))
+		*del = make_tree(&d->allocs, &deletes);
+	else
+		vector_destroy(deletes);
+
+	free(b_to_a);
+	free(a_deleted);
+	key_set_fini(&ka);
+	key_set_fini(&kb);
+	return true;
+}
+
+static void diff_block(struct ex_differ *d, struct ex_block *a, struct ex_block *b)
+{
+	if (a->val.type == EX_TABLE && b->val.type == EX_TABLE) {
+		struct ex_table *patch;
+		struct ex_list *del;
+		if (diff_table(d, a->val.t, b->val.t, &patch, &del)) {
+			if (patch)
+				emit(d, b->name, &(struct ex_value) { .type = EX_TABLE, .t = patch });
+			if (del) {
+				struct ex_value v = { .type = EX_LIST, .list = del };
+				vector_push(struct ex_tree, d->deletes, delete_node(diff_string(d, a->name), v));
+			}
+			return;
+		}
+	} else if (a->val.type == EX_TREE && b->val.type == EX_TREE) {
+		struct ex_tree *patch, *del;
+		if (diff_tree(d, a->val.tree, b->val.tree, &patch, &del)) {
+			if (patch)
+				emit(d, b->name, &(struct ex_value) { .type = EX_TREE, .tree = patch });
+			if (del) {
+				del->name = diff_string(d, a->name);
+				vector_push(struct ex_tree, d->deletes, *del);
+			}
+			return;
+		}
+	}
+
+	if (!ex_value_equal(&a->val, &b->val))
+		emit(d, b->name, &b->val);
+}
+
+static char **block_keys(struct ex_reader *r)
+{
+	char **keys = xcalloc(r->nr_blocks, sizeof(char*));
+	for (uint32_t i = 0; i < r->nr_blocks; i++) {
+		keys[i] = xmalloc(r->blocks[i].name_len + 1);
+		memcpy(keys[i], r->blocks[i].name, r->blocks[i].name_len);
+		keys[i][r->blocks[i].name_len] = '\0';
+	}
+	return keys;
+}
+
+static bool block_data_equal(struct ex_reader *a, uint32_t i, struct ex_reader *b, uint32_t j)
+{
+	return a->blocks[i].type == b->blocks[j].type
+		&& a->blocks[i].size == b->blocks[j].size
+		&& !memcmp(a->data + a->blocks[i].off, b->data + b->blocks[j].off, a->blocks[i].size);
+}
+
+/*
+ * Write a patch which transforms a into b (see above). Blocks whose data is
+ * identical in both files are not decoded.
+ */
+void ex_diff(struct port *port, struct ex_reader *a, struct ex_reader *b)
+{
+	struct ex_differ d = { .port = port };
+	vector_init(d.tmp);
+	vector_init(d.allocs);
+	vector_init(d.strings);
+	vector_init(d.deletes);
+
+	struct key_set ka, kb;
+	bool mergeable = key_set_init(&ka, block_keys(a), a->nr_blocks);
+	mergeable = key_set_init(&kb, block_keys(b), b->nr_blocks) && mergeable;
+
+	int *b_to_a = xcalloc(b->nr_blocks + 1, sizeof(int));
+	bool *a_deleted = xcalloc(a->nr_blocks + 1, sizeof(bool));
+	if (mergeable) {
+		match_keys(&ka, &kb, b_to_a, a_deleted);
+	} else {
+		// duplicate block names: replace everything
+		for (uint32_t i = 0; i < a->nr_blocks; i++)
+			a_deleted[i] = true;
+		for (uint32_t j = 0; j < b->nr_blocks; j++)
+			b_to_a[j] = -1;
+	}
+
+	for (uint32_t j = 0; j < b->nr_blocks; j++) {
+		int i = b_to_a[j];
+		if (i >= 0 && block_data_equal(a, i, b, j))
+			continue;
+		struct ex_block *bb = ex_reader_block(b, j);
+		if (i < 0)
+			emit(&d, bb->name, &bb->val);
+		else
+			diff_block(&d, ex_reader_block(a, i), bb);
+		free_allocs(&d.tmp);
+		if (i >= 0)
+			ex_reader_release(a, i);
+		ex_reader_release(b, j);
+	}
+
+	for (uint32_t i = 0; i < a->nr_blocks; i++) {
+		if (!a_deleted[i])
+			continue;
+		struct string *name = make_string(a->blocks[i].name, a->blocks[i].name_len);
+		vector_push(struct string*, d.strings, name);
+		vector_push(struct ex_tree, d.deletes,
+			delete_node(name, (struct ex_value) { .type = EX_INT, .i = 0 }));
+	}
+	if (vector_length(d.deletes)) {
+		struct ex_tree *del = make_tree(&d.allocs, &d.deletes);
+		del->name = make_string(EX_DELETE_BLOCK, strlen(EX_DELETE_BLOCK));
+		vector_push(struct string*, d.strings, del->name);
+		emit(&d, del->name, &(struct ex_value) { .type = EX_TREE, .tree = del });
+	} else {
+		vector_destroy(d.deletes);
+	}
+	if (d.nr_emitted)
+		port_putc(port, '\n');
+
+	struct string *s;
+	vector_foreach(s, d.strings) {
+		free_string(s);
+	}
+	vector_destroy(d.strings);
+	free_allocs(&d.allocs);
+	vector_destroy(d.allocs);
+	vector_destroy(d.tmp);
+	free(b_to_a);
+	free(a_deleted);
+	key_set_fini(&ka);
+	key_set_fini(&kb);
+}
+
+/*
+ * Patch
+ */
+
+static void free_value(struct ex_value *v)
+{
+	struct ex *tmp = xmalloc(sizeof(struct ex));
+	tmp->nr_blocks = 1;
+	tmp->blocks = xmalloc(sizeof(struct ex_block));
+	tmp->blocks[0] = (struct ex_block) {
+		.name = make_string("", 0),
+		.val = *v
+	};
+	ex_free(tmp);
+}
+
+static void free_row(struct ex_value *row, uint32_t nr_columns)
+{
+	for (uint32_t i = 0; i < nr_columns; i++) {
+		free_value(&row[i]);
+	}
+	free(row);
+}
+
+static void free_node(struct ex_tree *node)
+{
+	struct ex_tree *tmp = xmalloc(sizeof(struct ex_tree));
+	*tmp = *node;
+	free_value(&(struct ex_value) { .type = EX_TREE, .tree = tmp });
+}
+
+static void update_children(struct ex_tree *tree)
+{
+	free(tree->_children);
+	tree->_children = xcalloc(tree->nr_children + 1, sizeof(struct ex_value));
+	for (uint32_t i = 0; i < tree->nr_children; i++) {
+		tree->_children[i].type = EX_TREE;
+		tree->_children[i].tree = &tree->children[i];
+	}
+}
+
+static void delete_rows(struct ex_table *t, struct ex_list *keys)
+{
+	int col = index_column(t);
+	if (col < 0)
+		return;
+
+	khash_t(key_index) *del = kh_init(key_index);
+	for (uint32_t i = 0; i < keys->nr_items; i++) {
+		char *key = value_key(&keys->items[i].value);
+		int ret;
+		if (key)
+			kh_put(key_index, del, key, &ret);
+		if (key && !ret)
+			free(key);
+	}
+
+	uint32_t n = 0;
+	for (uint32_t i = 0; i < t->nr_rows; i++) {
+		char *key = value_key(&t->rows[i][col]);
+		if (key && kh_get(key_index, del, key) != kh_end(del))
+			free_row(t->rows[i], t->nr_columns);
+		else
+			t->rows[n++] = t->rows[i];
+		free(key);
+	}
+	t->nr_rows = n;
+
+	for (khiter_t k = kh_begin(del); k != kh_end(del); k++) {
+		if (kh_exist(del, k))
+			free((char*)kh_key(del, k));
+	}
+	kh_destroy(key_index, del);
+}
+
+static void delete_nodes(struct ex_tree *t, struct ex_tree *del)
+{
+	if (t->is_leaf || del->is_leaf)
+		return;
+
+	khash_t(key_index) *index = kh_init(key_index);
+	for (uint32_t i = 0; i < del->nr_children; i++) {
+		int ret;
+		khiter_t k = kh_put(key_index, index, del->children[i].name->text, &ret);
+		if (ret)
+			kh_value(index, k) = i;
+	}
+
+	uint32_t n = 0;
+	for (uint32_t i = 0; i < t->nr_children; i++) {
+		khiter_t k = kh_get(key_index, index, t->children[i].name->text);
+		if (k != kh_end(index)) {
+			struct ex_tree *d = &del->children[kh_value(index, k)];
+			if (d->is_leaf) {
+				free_node(&t->children[i]);
+				continue;
+			}
+			delete_nodes(&t->children[i], d);
+		}
+		t->children[n++] = t->children[i];
+	}
+	t->nr_children = n;
+	update_children(t);
+	kh_destroy(key_index, index);
+}
+
+static void delete_blocks(struct ex *base, struct ex_tree *del)
+{
+	if (del->is_leaf)
+		return;
+
+	khash_t(key_index) *index = kh_init(key_index);
+	for (uint32_t i = 0; i < del->nr_children; i++) {
+		int ret;
+		khiter_t k = kh_put(key_index, index, del->children[i].name->text, &ret);
+		if (ret)
+			kh_value(index, k) = i;
+	}
+
+	uint32_t n = 0;
+	for (uint32_t i = 0; i < base->nr_blocks; i++) {
+		struct ex_block *b = &base->blocks[i];
+		khiter_t k = kh_get(key_index, index, b->name->text);
+		if (k != kh_end(index)) {
+			struct ex_tree *d = &del->children[kh_value(index, k)];
+			if (!d->is_leaf) {
+				if (b->val.type == EX_TREE)
+					delete_nodes(b->val.tree, d);
+			} else if (d->leaf.value.type == EX_LIST) {
+				if (b->val.type == EX_TABLE)
+					delete_rows(b->val.t, d->leaf.value.list);
+			} else {
+				free_string(b->name);
+				free_value(&b->val);
+				continue;
+			}
+		}
+		base->blocks[n++] = *b;
+	}
+	base->nr_blocks = n;
+	kh_destroy(key_index, index);
+}
+
+static void swap_values(struct ex_value *a, struct ex_value *b)
+{
+	struct ex_value tmp = *a;
+	*a = *b;
+	*b = tmp;
+}
+
+/*
+ * Merge the rows of patch into base by key. The merged rows are swapped
+ * with the rows they replace (or with dummy rows), so that patch still owns
+ * everything that needs to be freed afterwards.
+ */
+static bool merge_table(struct ex_table *base, struct ex_table *patch)
+{
+	if (!ex_fields_equal(base, patch, 0))
+		return false;
+
+	struct key_set kb, kp;
+	bool mergeable = table_keys(base, &kb);
+	mergeable = table_keys(patch, &kp) && mergeable;
+	if (!mergeable) {
+		key_set_fini(&kb);
+		key_set_fini(&kp);
+		return false;
+	}
+
+	uint32_t nr_rows = base->nr_rows;
+	for (uint32_t j = 0; j < patch->nr_rows; j++) {
+		int i = key_set_find(&kb, kp.keys[j]);
+		if (i >= 0) {
+			struct ex_value *tmp = base->rows[i];
+			base->rows[i] = patch->rows[j];
+			patch->rows[j] = tmp;
+			continue;
+		}
+		base->rows = xrealloc_array(base->rows, nr_rows, nr_rows+1, sizeof(struct ex_value*));
+		base->rows[nr_rows++] = patch->rows[j];
+		patch->rows[j] = xcalloc(patch->nr_columns, sizeof(struct ex_value));
+		for (uint32_t c = 0; c < patch->nr_columns; c++) {
+			patch->rows[j][c].type = EX_INT;
+		}
+	}
+	base->nr_rows = nr_rows;
+
+	key_set_fini(&kb);
+	key_set_fini(&kp);
+	return true;
+}
+
+static bool merge_tree(struct ex_tree *base, struct ex_tree *patch)
+{
+	struct key_set kb, kp;
+	bool mergeable = tree_keys(base, &kb);
+	mergeable = tree_keys(patch, &kp) && mergeable;
+	if (!mergeable) {
+		key_set_fini(&kb);
+		key_set_fini(&kp);
+		return false;
+	}
+
+	uint32_t nr_children = base->nr_children;
+	for (uint32_t j = 0; j < patch->nr_children; j++) {
+		struct ex_tree *pc = &patch->children[j];
+		int i = key_set_find(&kb, kp.keys[j]);
+		if (i >= 0) {
+			struct ex_tree *bc = &base->children[i];
+			if (!bc->is_leaf && !pc->is_leaf && merge_tree(bc, pc))
+				continue;
+			struct ex_tree tmp = *bc;
+			*bc = *pc;
+			*pc = tmp;
+			continue;
+		}
+		base->children = xrealloc_array(base->children, nr_children, nr_children+1,
+				sizeof(struct ex_tree));
+		base->children[nr_children++] = *pc;
+		// leave a dummy node in the patch
+		struct string *name = string_ref(pc->name);
+		*pc = (struct ex_tree) {
+			.name = name,
+			.is_leaf = true,
+			.leaf = {
+				.name = string_ref(name),
+				.value = { .type = EX_INT, .i = 0 }
+			}
+		};
+	}
+	base->nr_children = nr_children;
+	update_children(base);
+
+	key_set_fini(&kb);
+	key_set_fini(&kp);
+	return true;
+}
+
+static void merge_value(struct ex_value *base, struct ex_value *patch)
+{
+	if (base->type == EX_TABLE && patch->type == EX_TABLE && merge_table(base->t, patch->t))
+		return;
+	if (base->type == EX_TREE && patch->type == EX_TREE && merge_tree(base->tree, patch->tree))
+		return;
+	swap_values(base, patch);
+}
+
+/*
+ * Apply a patch (as written by ex_diff) to base. The patch is left in an
+ * unspecified state, and should be freed with ex_free afterwards.
+ */
+void ex_patch(struct ex *base, struct ex *patch)
+{
+	for (uint32_t i = 0; i < patch->nr_blocks; i++) {
+		struct ex_block *p = &patch->blocks[i];
+		if (!strcmp(p->name->text, EX_DELETE_BLOCK) && p->val.type == EX_TREE)
+			delete_blocks(base, p->val.tree);
+	}
+
+	khash_t(key_index) *index = kh_init(key_index);
+	for (uint32_t i = 0; i < base->nr_blocks; i++) {
+		int ret;
+		khiter_t k = kh_put(key_index, index, base->blocks[i].name->text, &ret);
+		if (ret)
+			kh_value(index, k) = i;
+	}
+
+	for (uint32_t i = 0; i < patch->nr_blocks; i++) {
+		struct ex_block *p = &patch->blocks[i];
+		if (!strcmp(p->name->text, EX_DELETE_BLOCK) && p->val.type == EX_TREE)
+			continue;
+
+		khiter_t k = kh_get(key_index, index, p->name->text);
+		if (k != kh_end(index)) {
+			merge_value(&base->blocks[kh_value(index, k)].val, &p->val);
+			continue;
+		}
+
+		// new block: move it to base, leaving a dummy block in the patch
+		uint32_t n = base->nr_blocks;
+		base->blocks = xrealloc_array(base->blocks, n, n+1, sizeof(struct ex_block));
+		base->blocks[n] = *p;
+		base->nr_blocks = n + 1;
+		// later blocks of the same name are merged into this one
+		int ret;
+		k = kh_put(key_index, index, base->blocks[n].name->text, &ret);
+		kh_value(index, k) = n;
+		p->name = string_ref(p->name);
+		p->val = (struct ex_value) { .type = EX_INT, .i = 0 };
+	}
+	kh_destroy(key_index, index);
+}
@@ -29,6 +29,7 @@
 #include "system4/string.h"
 #include "alice.h"
 #include "alice/ex.h"
+#include "alice/jobs.h"
 #include "alice/port.h"
 
 static void indent(struct port *port, int level)
@@ -38,13 +39,34 @@ static void indent(struct port *port, int level)
 	}
 }
 
-static void ex_dump_string(struct port *port, struct string *str)
+static void ex_dump_cstring(struct port *port, const char *str)
 {
-	char *u = escape_string(str->text);
+	char *u = escape_string(str);
 	port_printf(port, "\"%s\"", u);
 	free(u);
 }
 
+static void ex_dump_string(struct port *port, struct string *str)
+{
+	ex_dump_cstring(port, str->text);
+}
+
+/*
+ * Write a float with at least 6 decimal places, and as many more as are
+ * needed for it to be read back exactly.
+ */
+static void ex_dump_float(struct port *port, float f)
+{
+	char buf[256];
+	for (int prec = 6; prec <= 150; prec++) {
+		snprintf(buf, sizeof(buf), "%.*f", prec, f);
+		float r = strtof(buf, NULL);
+		if (!memcmp(&r, &f, sizeof(float)))
+			break;
+	}
+	port_printf(port, "%s", buf);
+}
+
 static void ex_dump_identifier(struct port *port, struct string *s)
 {
 	// empty identifier
@@ -84,7 +106,7 @@ static void _ex_dump_value(struct port *port, struct ex_value *val, bool in_line
 {
 	switch (val->type) {
 	case EX_INT:    port_printf(port, "%d", val->i); break;
-	case EX_FLOAT:  port_printf(port, "%f", val->f); break;
+	case EX_FLOAT:  ex_dump_float(port, val->f); break;
 	case EX_STRING: ex_dump_string(port, val->s); break;
 	case EX_TABLE:  _ex_dump_table(port, val->t, indent_level); break;
 	case EX_LIST:   _ex_dump_list(port, val->list, in_line, indent_level); break;
@@ -136,13 +158,14 @@ static void ex_dump_row(struct port *port, struct ex_value *row, uint32_t nr_col
 	port_printf(port, " }");
 }
 
-static void ex_dump_fields(struct port *port, struct ex_table *table, int indent_level)
+static void ex_dump_fields(struct port *port, struct ex_field *fields, uint32_t nr_fields,
+		int indent_level)
 {
 	indent(port, indent_level);
 	port_printf(port, "{ ");
-	for (uint32_t i = 0; i < table->nr_fields; i++) {
-		ex_dump_field(port, &table->fields[i], indent_level);
-		if (i+1 < table->nr_fields)
+	for (uint32_t i = 0; i < nr_fields; i++) {
+		ex_dump_field(port, &fields[i], indent_level);
+		if (i+1 < nr_fields)
 			port_printf(port, ", ");
 	}
 	port_printf(port, " },\n");
@@ -151,7 +174,7 @@ static void ex_dump_fields(struct port *port, struct ex_table *table, int indent
 void ex_dump_table_row(struct port *port, struct ex_table *table, int row)
 {
 	port_printf(port, "{\n");
-	ex_dump_fields(port, table, 1);
+	ex_dump_fields(port, table->fields, table->nr_fields, 1);
 	indent(port, 1);
 	ex_dump_row(port, table->rows[row], table->nr_columns, 1);
 	port_printf(port, "\n}");
@@ -166,7 +189,7 @@ static void _ex_dump_table(struct port *port, struct ex_table *table, int indent
 
 	indent_level++;
 	if (table->nr_fields) {
-		ex_dump_fields(port, table, indent_level);
+		ex_dump_fields(port, table->fields, table->nr_fields, indent_level);
 	}
 	for (uint32_t i = 0; i < table->nr_rows; i++) {
 		if (toplevel)
@@ -192,6 +215,32 @@ void ex_dump_table(struct port *port, struct ex_table *table)
 	_ex_dump_table(port, table, 0);
 }
 
+/*
+ * Dump a columnar table (in the same format as ex_dump_table).
+ */
+void ex_dump_columns(struct port *port, struct ex_columns *c)
+{
+	port_printf(port, "{\n");
+	ex_dump_fields(port, c->fields, c->nr_fields, 1);
+	for (uint32_t i = 0; i < c->nr_rows; i++) {
+		port_printf(port, "\t{ ");
+		for (uint32_t j = 0; j < c->nr_columns; j++) {
+			switch (c->columns[j].type) {
+			case EX_INT:    port_printf(port, "%d", ex_columns_int(c, i, j)); break;
+			case EX_FLOAT:  ex_dump_float(port, ex_columns_float(c, i, j)); break;
+			case EX_STRING: ex_dump_cstring(port, ex_columns_string(c, i, j)); break;
+			}
+			if (j+1 < c->nr_columns)
+				port_printf(port, ", ");
+		}
+		port_printf(port, " }");
+		if (i+1 < c->nr_rows)
+			port_putc(port, ',');
+		port_putc(port, '\n');
+	}
+	port_putc(port, '}');
+}
+
 static void _ex_dump_list(struct port *port, struct ex_list *list, bool in_line, int indent_level)
 {
 	port_putc(port, '{');
@@ -250,17 +299,22 @@ void ex_dump_tree(struct port *port, struct ex_tree *tree)
 	_ex_dump_tree(port, tree, 0);
 }
 
+static void ex_dump_block_header(struct port *port, uint32_t type, struct string *name)
+{
+	port_printf(port, "%s ", ex_strtype(type));
+	ex_dump_identifier(port, name);
+	port_printf(port, " = ");
+}
+
 static void ex_dump_block(struct port *port, struct ex_block *block)
 {
 	// type name =
-	port_printf(port, "%s ", ex_strtype(block->val.type));
-	ex_dump_identifier(port, block->name);
-	port_printf(port, " = ");
+	ex_dump_block_header(port, block->val.type, block->name);
 
 	// rvalue
 	switch (block->val.type) {
 	case EX_INT:    port_printf(port, "%d", block->val.i); break;
-	case EX_FLOAT:  port_printf(port, "%f", block->val.f); break;
+	case EX_FLOAT:  ex_dump_float(port, block->val.f); break;
 	case EX_STRING: ex_dump_string(port, block->val.s); break;
 	case EX_TABLE:  ex_dump_table(port, block->val.t); break;
 	case EX_LIST:   ex_dump_list(port, block->val.list); break;
@@ -280,31 +334,98 @@ void ex_dump(struct port *port, struct ex *ex)
 	port_putc(port, '\n');
 }
 
-void ex_dump_split(FILE *manifest, struct ex *ex, const char *dir)
+static struct string *reader_block_name(struct ex_reader *r, uint32_t i)
 {
-	struct port manifest_port;
-	port_file_init(&manifest_port, manifest);
+	if (r->conv)
+		return r->conv(r->blocks[i].name, r->blocks[i].name_len);
+	return make_string(r->blocks[i].name, r->blocks[i].name_len);
+}
 
-	for (uint32_t i = 0; i < ex->nr_blocks; i++) {
-		char buf[PATH_MAX];
-		char *name = conv_output(ex->blocks[i].name->text);
-		snprintf(buf, PATH_MAX, "%s/%u_%s.x", dir, i, name);
+/*
+ * Dump a block from a reader. Tables are decoded in columnar form when
+ * possible. The block is left decoded; the caller releases it.
+ */
+void ex_dump_reader_block(struct port *port, struct ex_reader *r, uint32_t i)
+{
+	struct ex_columns *c = ex_reader_columns(r, i);
+	if (c) {
+		struct string *name = reader_block_name(r, i);
+		ex_dump_block_header(port, EX_TABLE, name);
+		ex_dump_columns(port, c);
+		port_putc(port, ';');
+		free_string(name);
+	} else {
+		ex_dump_block(port, ex_reader_block(r, i));
+	}
+}
 
-		FILE *out = file_open_utf8(buf, "w");
-		if (!out)
-			ERROR("Failed to open file '%s': %s", buf, strerror(errno));
+/*
+ * Dump the blocks of a .ex file one at a time (only one block is decoded at
+ * a time).
+ */
+void ex_dump_reader(struct port *port, struct ex_reader *r)
+{
+	for (uint32_t i = 0; i < r->nr_blocks; i++) {
+		ex_dump_reader_block(port, r, i);
+		ex_reader_release(r, i);
+		if (i+1 < r->nr_blocks)
+			port_printf(port, "\n\n");
+	}
+	port_putc(port, '\n');
+}
 
-		struct port block_port;
-		port_file_init(&block_port, out);
-		ex_dump_block(&block_port, &ex->blocks[i]);
-		port_close(&block_port);
+struct split_job {
+	struct ex_reader *r;
+	uint32_t block;
+	const char *dir;
+	char *name; // output-encoded block name
+};
 
-		if (fclose(out))
-			ERROR("Failed to close file '%s': %s", buf, strerror(errno));
+static void dump_split_job(void *data)
+{
+	struct split_job *job = data;
+	char buf[PATH_MAX];
+	snprintf(buf, PATH_MAX, "%s/%u_%s.x", job->dir, job->block, job->name);
+
+	FILE *out = file_open_utf8(buf, "w");
+	if (!out)
+		ERROR("Failed to open file '%s': %s", buf, strerror(errno));
+
+	struct port block_port;
+	port_file_init(&block_port, out);
+	ex_dump_reader_block(&block_port, job->r, job->block);
+	ex_reader_release(job->r, job->block);
+	port_close(&block_port);
+
+	if (fclose(out))
+		ERROR("Failed to close file '%s': %s", buf, strerror(errno));
+}
 
-		fprintf(manifest, "#include \"%u_%s.x\"\n", i, name);
-		free(name);
+/*
+ * Dump each block to its own file (in parallel, if jobs_init has been called)
+ * and write a manifest #including them in order.
+ */
+void ex_dump_split(FILE *manifest, struct ex_reader *r, const char *dir)
+{
+	struct split_job *jobs = xcalloc(r->nr_blocks, sizeof(struct split_job));
+	struct job_group *group = job_group_new();
+	for (uint32_t i = 0; i < r->nr_blocks; i++) {
+		struct string *block_name = reader_block_name(r, i);
+		jobs[i] = (struct split_job) {
+			.r = r,
+			.block = i,
+			.dir = dir,
+			.name = conv_output(block_name->text),
+		};
+		free_string(block_name);
+		job_group_add(group, dump_split_job, &jobs[i]);
 	}
+	job_group_run(group);
 
-	port_close(&manifest_port);
+	for (uint32_t i = 0; i < r->nr_blocks; i++) {
+		fprintf(manifest, "#include \"%u_%s.x\"\n", i, jobs[i].name);
+		free(jobs[i].name);
+	}
+	fflush(manifest);
+	free(jobs);
 }
@@ -0,0 +1,154 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "system4.h"
+#include "system4/ex.h"
+#include "system4/string.h"
+#include "khash.h"
+#include "alice.h"
+#include "alice/ex.h"
+
+/*
+ * Name index for the blocks of a struct ex. Lookups return the first block
+ * with a given name, like ex_get_*. The index must not be used after the ex
+ * is modified.
+ */
+
+KHASH_MAP_INIT_STR(name_index, uint32_t);
+
+struct ex_index {
+	struct ex *ex;
+	khash_t(name_index) *blocks;
+};
+
+struct ex_index *ex_index_new(struct ex *ex)
+{
+	struct ex_index *index = xcalloc(1, sizeof(struct ex_index));
+	index->ex = ex;
+	index->blocks = kh_init(name_index);
+	for (uint32_t i = 0; i < ex->nr_blocks; i++) {
+		int ret;
+		khiter_t k = kh_put(name_index, index->blocks, ex->blocks[i].name->text, &ret);
+		if (ret)
+			kh_value(index->blocks, k) = i;
+	}
+	return index;
+}
+
+void ex_index_free(struct ex_index *index)
+{
+	kh_destroy(name_index, index->blocks);
+	free(index);
+}
+
+static struct ex_value *ex_index_get(struct ex_index *index, const char *name)
+{
+	khiter_t k = kh_get(name_index, index->blocks, name);
+	if (k == kh_end(index->blocks))
+		return NULL;
+	return &index->ex->blocks[kh_value(index->blocks, k)].val;
+}
+
+int32_t ex_index_get_int(struct ex_index *index, const char *name, int32_t dflt)
+{
+	struct ex_value *v = ex_index_get(index, name);
+	return v && v->type == EX_INT ? v->i : dflt;
+}
+
+/*
+ * Returns a new reference to the string (like ex_get_string).
+ */
+struct string *ex_index_get_string(struct ex_index *index, const char *name)
+{
+	struct ex_value *v = ex_index_get(index, name);
+	return v && v->type == EX_STRING ? string_ref(v->s) : NULL;
+}
+
+struct ex_table *ex_index_get_table(struct ex_index *index, const char *name)
+{
+	struct ex_value *v = ex_index_get(index, name);
+	return v && v->type == EX_TABLE ? v->t : NULL;
+}
+
+/*
+ * Name index for the children of tree nodes. The children of large nodes are
+ * indexed on the first lookup in that node; small nodes are searched
+ * linearly. Lookups return the first child with a given name. The index must
+ * not be used after an indexed tree is modified or freed.
+ */
+
+// nodes with fewer children than this are not indexed
+#define MIN_INDEXED_CHILDREN 16
+
+KHASH_MAP_INIT_INT64(tree_index, khash_t(name_index)*);
+
+struct ex_tree_index {
+	khash_t(tree_index) *trees;
+};
+
+struct ex_tree_index *ex_tree_index_new(void)
+{
+	struct ex_tree_index *index = xcalloc(1, sizeof(struct ex_tree_index));
+	index->trees = kh_init(tree_index);
+	return index;
+}
+
+void ex_tree_index_free(struct ex_tree_index *index)
+{
+	for (khiter_t k = kh_begin(index->trees); k != kh_end(index->trees); k++) {
+		if (kh_exist(index->trees, k))
+			kh_destroy(name_index, kh_value(index->trees, k));
+	}
+	kh_destroy(tree_index, index->trees);
+	free(index);
+}
+
+/*
+ * Get the first child of a (non-leaf) tree node with the given name, or NULL.
+ */
+struct ex_tree *ex_tree_index_child(struct ex_tree_index *index, struct ex_tree *tree,
+		const char *name)
+{
+	if (tree->is_leaf)
+		return NULL;
+	if (tree->nr_children < MIN_INDEXED_CHILDREN) {
+		for (uint32_t i = 0; i < tree->nr_children; i++) {
+			if (!strcmp(tree->children[i].name->text, name))
+				return &tree->children[i];
+		}
+		return NULL;
+	}
+
+	int ret;
+	khiter_t k = kh_put(tree_index, index->trees, (uint64_t)(uintptr_t)tree, &ret);
+	if (ret) {
+		khash_t(name_index) *map = kh_init(name_index);
+		for (uint32_t i = 0; i < tree->nr_children; i++) {
+			int r;
+			khiter_t c = kh_put(name_index, map, tree->children[i].name->text, &r);
+			if (r)
+				kh_value(map, c) = i;
+		}
+		kh_value(index->trees, k) = map;
+	}
+	khash_t(name_index) *map = kh_value(index->trees, k);
+	khiter_t c = kh_get(name_index, map, name);
+	return c == kh_end(map) ? NULL : &tree->children[kh_value(map, c)];
+}
@@ -25,6 +25,8 @@
 #include "system4/ex.h"
 #include "system4/string.h"
 #include "alice.h"
+#include "alice/ex.h"
+#include "alice/jobs.h"
 
 bool columns_first = false;
 
@@ -39,15 +41,20 @@ static size_t skip_int32(struct buffer *out)
 	return loc;
 }
 
-static void write_string(struct buffer *out, struct string *s)
+static void write_cstring(struct buffer *out, const char *s, size_t size)
 {
-	size_t padded_size = (s->size + 3) & ~3;
+	size_t padded_size = (size + 3) & ~3;
 	buffer_write_int32(out, padded_size);
-	buffer_write_bytes(out, (uint8_t*)s->text, s->size);
+	buffer_write_bytes(out, (uint8_t*)s, size);
 
 	static const uint8_t pad[4] = { 0, 0, 0, 0 };
-	if (padded_size - s->size)
-		buffer_write_bytes(out, pad, padded_size - s->size);
+	if (padded_size - size)
+		buffer_write_bytes(out, pad, padded_size - size);
+}
+
+static void write_string(struct buffer *out, struct string *s)
+{
+	write_cstring(out, s->text, s->size);
 }
 
 static void _write_value(struct buffer *out, struct ex_value *v)
@@ -128,6 +135,44 @@ static void write_table(struct buffer *out, struct ex_table *table)
 	write_rows(out, table);
 }
 
+/*
+ * Write a columnar table (fields and rows) in the same format as write_table.
+ */
+void ex_write_columns(struct buffer *out, struct ex_columns *c)
+{
+	buffer_write_int32(out, c->nr_fields);
+	for (uint32_t i = 0; i < c->nr_fields; i++) {
+		write_field(out, &c->fields[i]);
+	}
+
+	if (columns_first) {
+		buffer_write_int32(out, c->nr_columns);
+		buffer_write_int32(out, c->nr_rows);
+	} else {
+		buffer_write_int32(out, c->nr_rows);
+		buffer_write_int32(out, c->nr_columns);
+	}
+
+	for (uint32_t i = 0; i < c->nr_rows; i++) {
+		for (uint32_t j = 0; j < c->nr_columns; j++) {
+			buffer_write_int32(out, c->columns[j].type);
+			switch (c->columns[j].type) {
+			case EX_INT:
+				buffer_write_int32(out, ex_columns_int(c, i, j));
+				break;
+			case EX_FLOAT:
+				buffer_write_float(out, ex_columns_float(c, i, j));
+				break;
+			case EX_STRING: {
+				const char *str = ex_columns_string(c, i, j);
+				write_cstring(out, str, strlen(str));
+				break;
+			}
+			}
+		}
+	}
+}
+
 static void write_list(struct buffer *out, struct ex_list *list)
 {
 	buffer_write_int32(out, list->nr_items);
@@ -161,7 +206,7 @@ static void write_tree(struct buffer *out, struct ex_tree *tree)
 	}
 }
 
-static void write_block(struct buffer *out, struct ex_block *blk)
+void ex_write_block(struct buffer *out, struct ex_block *blk)
 {
 	buffer_write_int32(out, blk->val.type);
 	size_t size_loc = skip_int32(out);
@@ -192,6 +237,39 @@ static void write_block(struct buffer *out, struct ex_block *blk)
 	buffer_write_int32_at(out, size_loc, out->index - data_loc);
 }
 
+struct block_job {
+	struct ex_block *block;
+	struct buffer out;
+};
+
+static void write_block_job(void *data)
+{
+	struct block_job *job = data;
+	buffer_init(&job->out, xmalloc(128), 128);
+	ex_write_block(&job->out, job->block);
+}
+
+/*
+ * Serialize blocks in parallel (each into its own buffer) and then
+ * concatenate them in order.
+ */
+static void write_blocks(struct buffer *out, struct ex *ex)
+{
+	struct block_job *jobs = xcalloc(ex->nr_blocks, sizeof(struct block_job));
+	struct job_group *group = job_group_new();
+	for (uint32_t i = 0; i < ex->nr_blocks; i++) {
+		jobs[i].block = &ex->blocks[i];
+		job_group_add(group, write_block_job, &jobs[i]);
+	}
+	job_group_run(group);
+
+	for (uint32_t i = 0; i < ex->nr_blocks; i++) {
+		buffer_write_bytes(out, jobs[i].out.buf, jobs[i].out.index);
+		free(jobs[i].out.buf);
+	}
+	free(jobs);
+}
+
 void ex_compress(struct buffer *out, size_t len, size_t *len_out)
 {
 	unsigned long dst_len = len * 1.001 + 12;
@@ -207,37 +285,53 @@ void ex_compress(struct buffer *out, size_t len, size_t *len_out)
 	free(dst);
 }
 
-uint8_t *ex_flatten(struct ex *ex, size_t *size_out)
+/*
+ * Write the .ex header to a new buffer. Block data should be written to the
+ * buffer after this, followed by a call to ex_flatten_end. Returns the
+ * offset of the block data.
+ */
+size_t ex_flatten_begin(struct buffer *out)
 {
-	struct buffer out;
+	buffer_init(out, xmalloc(128), 128);
+	buffer_write_bytes(out, (uint8_t*)"HEAD", 4);
+	buffer_write_int32(out, 0xc); // ???
+	buffer_write_bytes(out, (uint8_t*)"EXTF", 4);
+	buffer_write_int32(out, 0x1); // ???
+	skip_int32(out); // number of blocks
+	buffer_write_bytes(out, (uint8_t*)"DATA", 4);
+	skip_int32(out); // compressed size
+	skip_int32(out); // uncompressed size
+	return out->index;
+}
 
-	buffer_init(&out, xmalloc(128), 128);
-	buffer_write_bytes(&out, (uint8_t*)"HEAD", 4);
-	buffer_write_int32(&out, 0xc); // ???
-	buffer_write_bytes(&out, (uint8_t*)"EXTF", 4);
-	buffer_write_int32(&out, 0x1); // ???
-	buffer_write_int32(&out, ex->nr_blocks);
-	buffer_write_bytes(&out, (uint8_t*)"DATA", 4);
-	size_t compressed_size_loc = skip_int32(&out);
-	size_t uncompressed_size_loc = skip_int32(&out);
-	size_t data_loc = out.index;
+/*
+ * Compress the block data written after ex_flatten_begin and fill in the
+ * header. The returned data still needs to be encrypted (see ex_write_flat).
+ */
+uint8_t *ex_flatten_end(struct buffer *out, size_t data_loc, uint32_t nr_blocks,
+		size_t *size_out)
+{
+	size_t compressed_size;
+	size_t uncompressed_size = out->index - data_loc;
+	buffer_write_int32_at(out, data_loc - 16, nr_blocks);
+	buffer_write_int32_at(out, data_loc - 4, uncompressed_size);
 
 	// NOTE: everything after this point needs to be compressed and then
 	//       encrypted before writing to disk.
-	for (uint32_t i = 0; i < ex->nr_blocks; i++) {
-		write_block(&out, &ex->blocks[i]);
-	}
-
-	size_t compressed_size;
-	size_t uncompressed_size = out.index - data_loc;
-	buffer_write_int32_at(&out, uncompressed_size_loc, uncompressed_size);
-
-	buffer_seek(&out, data_loc);
-	ex_compress(&out, uncompressed_size, &compressed_size);
-	buffer_write_int32_at(&out, compressed_size_loc, compressed_size);
+	buffer_seek(out, data_loc);
+	ex_compress(out, uncompressed_size, &compressed_size);
+	buffer_write_int32_at(out, data_loc - 8, compressed_size);
 
 	*size_out = data_loc + compressed_size;
-	return out.buf;
+	return out->buf;
+}
+
+uint8_t *ex_flatten(struct ex *ex, size_t *size_out)
+{
+	struct buffer out;
+	size_t data_loc = ex_flatten_begin(&out);
+	write_blocks(&out, ex);
+	return ex_flatten_end(&out, data_loc, ex->nr_blocks, size_out);
 }
 
 uint8_t *ex_write_mem(struct ex *ex, size_t *size_out)
@@ -250,11 +344,11 @@ uint8_t *ex_write_mem(struct ex *ex, size_t *size_out)
 	return flat;
 }
 
-void ex_write(FILE *out, struct ex *ex)
+/*
+ * Encrypt and write the output of ex_flatten (which is freed).
+ */
+void ex_write_flat(FILE *out, uint8_t *flat, size_t size)
 {
-	size_t size;
-	uint8_t *flat = ex_flatten(ex, &size);
-
 	ex_encode(flat+32, size - 32);
 
 	if (fwrite(flat, size, 1, out) != 1)
@@ -263,6 +357,13 @@ void ex_write(FILE *out, struct ex *ex)
 	free(flat);
 }
 
+void ex_write(FILE *out, struct ex *ex)
+{
+	size_t size;
+	uint8_t *flat = ex_flatten(ex, &size);
+	ex_write_flat(out, flat, size);
+}
+
 void ex_write_file(const char *path, struct ex *ex)
 {
 	FILE *out = checked_fopen(path, "wb");
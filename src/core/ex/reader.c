@@ -0,0 +1,657 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#include "little_endian.h"
+#include "system4.h"
+#include "system4/ex.h"
+#include "system4/string.h"
+#include "khash.h"
+#include "alice.h"
+#include "alice/ex.h"
+
+/*
+ * Lazy .ex reader. The decompressed block data is kept in memory and indexed
+ * by block name when the file is opened; each block is decoded on first use.
+ * Block names and string blocks can be accessed without decoding (or
+ * copying) anything.
+ */
+
+KHASH_MAP_INIT_STR(block_names, uint32_t);
+
+struct ex_reader_index {
+	khash_t(block_names) *map;
+	char **names;
+};
+
+struct ex_decoder {
+	struct ex_reader *r;
+	size_t pos;
+	size_t end;
+};
+
+static void free_value(struct ex_value *v);
+
+_Noreturn static void decode_error(struct ex_decoder *d, const char *what)
+{
+	ALICE_ERROR("Invalid .ex data at offset 0x%zx: %s", d->pos, what);
+}
+
+static void need(struct ex_decoder *d, size_t n)
+{
+	if (d->end - d->pos < n)
+		decode_error(d, "unexpected end of block");
+}
+
+static uint32_t read_u32(struct ex_decoder *d)
+{
+	need(d, 4);
+	uint32_t v = LittleEndian_getDW(d->r->data, d->pos);
+	d->pos += 4;
+	return v;
+}
+
+static float read_float(struct ex_decoder *d)
+{
+	union { uint32_t u; float f; } v = { .u = read_u32(d) };
+	return v.f;
+}
+
+/*
+ * Strings are stored NUL-padded to a multiple of 4 bytes (with no terminator
+ * if the length is already a multiple of 4).
+ */
+static const char *read_string_view(struct ex_decoder *d, size_t *len)
+{
+	uint32_t padded_size = read_u32(d);
+	need(d, padded_size);
+	const char *s = (const char*)d->r->data + d->pos;
+	*len = strnlen(s, padded_size);
+	d->pos += padded_size;
+	return s;
+}
+
+/*
+ * Strings in decoded values are copied out of the decompressed buffer, so that
+ * decoded blocks are ordinary ex values which can outlive the reader (and be
+ * freed with ex_free).
+ */
+static struct string *make_reader_string(struct ex_reader *r, const char *s, size_t len)
+{
+	if (r->conv)
+		return r->conv(s, len);
+	return make_string(s, len);
+}
+
+static struct string *read_string(struct ex_decoder *d)
+{
+	size_t len;
+	const char *s = read_string_view(d, &len);
+	return make_reader_string(d->r, s, len);
+}
+
+static struct ex_table *read_table(struct ex_decoder *d, struct ex_field *parent_fields,
+		uint32_t nr_parent_fields, bool subtable);
+static struct ex_list *read_list(struct ex_decoder *d);
+static void read_tree(struct ex_decoder *d, struct ex_tree *tree);
+
+static void read_value_data(struct ex_decoder *d, struct ex_value *v, struct ex_field *fields,
+		uint32_t nr_fields, bool subtable)
+{
+	switch (v->type) {
+	case EX_INT:
+		v->i = read_u32(d);
+		break;
+	case EX_FLOAT:
+		v->f = read_float(d);
+		break;
+	case EX_STRING:
+		v->s = read_string(d);
+		break;
+	case EX_TABLE:
+		v->t = read_table(d, fields, nr_fields, subtable);
+		break;
+	case EX_LIST:
+		v->list = read_list(d);
+		break;
+	case EX_TREE:
+		v->tree = xmalloc(sizeof(struct ex_tree));
+		read_tree(d, v->tree);
+		break;
+	default:
+		decode_error(d, "invalid value type");
+	}
+}
+
+static void read_field(struct ex_decoder *d, struct ex_field *f)
+{
+	f->type = read_u32(d);
+	f->name = read_string(d);
+	f->has_value = read_u32(d);
+	f->is_index = read_u32(d);
+	if (f->has_value) {
+		f->value.type = f->type;
+		read_value_data(d, &f->value, NULL, 0, false);
+	}
+
+	f->nr_subfields = 0;
+	f->subfields = NULL;
+	if (f->type == EX_TABLE) {
+		f->nr_subfields = read_u32(d);
+		f->subfields = xcalloc(f->nr_subfields, sizeof(struct ex_field));
+		for (uint32_t i = 0; i < f->nr_subfields; i++) {
+			read_field(d, &f->subfields[i]);
+		}
+	}
+}
+
+/*
+ * Sub-tables (tables within a row of another table) don't store their own
+ * fields; their layout is given by the subfields of the parent column.
+ */
+static struct ex_table *read_table(struct ex_decoder *d, struct ex_field *parent_fields,
+		uint32_t nr_parent_fields, bool subtable)
+{
+	struct ex_table *t = xcalloc(1, sizeof(struct ex_table));
+	struct ex_field *fields = parent_fields;
+	uint32_t nr_fields = nr_parent_fields;
+	if (!subtable) {
+		t->nr_fields = read_u32(d);
+		t->fields = xcalloc(t->nr_fields, sizeof(struct ex_field));
+		for (uint32_t i = 0; i < t->nr_fields; i++) {
+			read_field(d, &t->fields[i]);
+		}
+		fields = t->fields;
+		nr_fields = t->nr_fields;
+	}
+
+	// pre-Evenicle .ex files store the column count first
+	uint32_t a = read_u32(d);
+	uint32_t b = read_u32(d);
+	if (nr_fields && a == nr_fields && b != nr_fields) {
+		t->nr_columns = a;
+		t->nr_rows = b;
+	} else {
+		t->nr_rows = a;
+		t->nr_columns = b;
+	}
+
+	t->rows = xcalloc(t->nr_rows, sizeof(struct ex_value*));
+	for (uint32_t i = 0; i < t->nr_rows; i++) {
+		t->rows[i] = xcalloc(t->nr_columns, sizeof(struct ex_value));
+		for (uint32_t j = 0; j < t->nr_columns; j++) {
+			struct ex_field *sub = j < nr_fields ? fields[j].subfields : NULL;
+			uint32_t nr_sub = j < nr_fields ? fields[j].nr_subfields : 0;
+			t->rows[i][j].type = read_u32(d);
+			read_value_data(d, &t->rows[i][j], sub, nr_sub, true);
+		}
+	}
+	return t;
+}
+
+static struct ex_list *read_list(struct ex_decoder *d)
+{
+	struct ex_list *list = xmalloc(sizeof(struct ex_list));
+	list->nr_items = read_u32(d);
+	list->items = xcalloc(list->nr_items, sizeof(struct ex_list_item));
+	for (uint32_t i = 0; i < list->nr_items; i++) {
+		list->items[i].value.type = read_u32(d);
+		uint32_t size = list->items[i].size = read_u32(d);
+		need(d, size);
+		size_t end = d->pos + size;
+		read_value_data(d, &list->items[i].value, NULL, 0, false);
+		if (d->pos != end)
+			decode_error(d, "list item size mismatch");
+	}
+	return list;
+}
+
+static void read_tree(struct ex_decoder *d, struct ex_tree *tree)
+{
+	memset(tree, 0, sizeof(struct ex_tree));
+	tree->name = read_string(d);
+	tree->is_leaf = read_u32(d);
+
+	if (tree->is_leaf) {
+		tree->leaf.value.type = read_u32(d);
+		uint32_t size = tree->leaf.size = read_u32(d);
+		need(d, size);
+		size_t end = d->pos + size;
+		tree->leaf.name = read_string(d);
+		read_value_data(d, &tree->leaf.value, NULL, 0, false);
+		if (d->pos != end)
+			decode_error(d, "tree leaf size mismatch");
+		read_u32(d);
+		return;
+	}
+
+	tree->nr_children = read_u32(d);
+	tree->children = xcalloc(tree->nr_children, sizeof(struct ex_tree));
+	tree->_children = xcalloc(tree->nr_children, sizeof(struct ex_value));
+	for (uint32_t i = 0; i < tree->nr_children; i++) {
+		read_tree(d, &tree->children[i]);
+		tree->_children[i].type = EX_TREE;
+		tree->_children[i].tree = &tree->children[i];
+	}
+}
+
+static void free_field(struct ex_field *f)
+{
+	free_string(f->name);
+	if (f->has_value)
+		free_value(&f->value);
+	for (uint32_t i = 0; i < f->nr_subfields; i++) {
+		free_field(&f->subfields[i]);
+	}
+	free(f->subfields);
+}
+
+static void free_tree(struct ex_tree *tree)
+{
+	free_string(tree->name);
+	if (tree->is_leaf) {
+		free_string(tree->leaf.name);
+		free_value(&tree->leaf.value);
+		return;
+	}
+	for (uint32_t i = 0; i < tree->nr_children; i++) {
+		free_tree(&tree->children[i]);
+	}
+	free(tree->children);
+	free(tree->_children);
+}
+
+static void free_value(struct ex_value *v)
+{
+	switch (v->type) {
+	case EX_INT:
+	case EX_FLOAT:
+		break;
+	case EX_STRING:
+		free_string(v->s);
+		break;
+	case EX_TABLE:
+		for (uint32_t i = 0; i < v->t->nr_fields; i++) {
+			free_field(&v->t->fields[i]);
+		}
+		free(v->t->fields);
+		for (uint32_t i = 0; i < v->t->nr_rows; i++) {
+			for (uint32_t j = 0; j < v->t->nr_columns; j++) {
+				free_value(&v->t->rows[i][j]);
+			}
+			free(v->t->rows[i]);
+		}
+		free(v->t->rows);
+		free(v->t);
+		break;
+	case EX_LIST:
+		for (uint32_t i = 0; i < v->list->nr_items; i++) {
+			free_value(&v->list->items[i].value);
+		}
+		free(v->list->items);
+		free(v->list);
+		break;
+	case EX_TREE:
+		free_tree(v->tree);
+		free(v->tree);
+		break;
+	}
+}
+
+static void index_blocks(struct ex_reader *r)
+{
+	struct ex_decoder d = { .r = r, .pos = 0, .end = r->size };
+	r->blocks = xcalloc(r->nr_blocks, sizeof(struct ex_reader_block));
+	for (uint32_t i = 0; i < r->nr_blocks; i++) {
+		struct ex_reader_block *b = &r->blocks[i];
+		b->type = read_u32(&d);
+		b->size = read_u32(&d);
+		need(&d, b->size);
+		b->off = d.pos;
+		d.end = d.pos + b->size;
+		b->name = read_string_view(&d, &b->name_len);
+		d.pos = d.end;
+		d.end = r->size;
+	}
+
+	// hash the block names up front so that lookups don't modify the reader
+	r->index = xcalloc(1, sizeof(struct ex_reader_index));
+	r->index->map = kh_init(block_names);
+	r->index->names = xcalloc(r->nr_blocks + 1, sizeof(char*));
+	for (uint32_t i = 0; i < r->nr_blocks; i++) {
+		struct ex_reader_block *b = &r->blocks[i];
+		char *key = xmalloc(b->name_len + 1);
+		memcpy(key, b->name, b->name_len);
+		key[b->name_len] = '\0';
+		r->index->names[i] = key;
+		int ret;
+		khiter_t k = kh_put(block_names, r->index->map, key, &ret);
+		if (ret)
+			kh_value(r->index->map, k) = i;
+	}
+}
+
+struct ex_reader *ex_reader_open_conv(const char *path, struct string*(*conv)(const char*,size_t))
+{
+	size_t size;
+	uint32_t nr_blocks;
+	uint8_t *data = ex_decrypt(path, &size, &nr_blocks);
+	if (!data)
+		return NULL;
+
+	struct ex_reader *r = xcalloc(1, sizeof(struct ex_reader));
+	r->data = data;
+	r->size = size;
+	r->nr_blocks = nr_blocks;
+	r->conv = conv;
+	index_blocks(r);
+	return r;
+}
+
+struct ex_reader *ex_reader_open(const char *path)
+{
+	return ex_reader_open_conv(path, NULL);
+}
+
+/*
+ * Open a reader over an .ex file which is already in memory (e.g. a file in
+ * an archive). `data` is not modified and can be freed after this returns.
+ * Returns NULL if the data is not a valid .ex file.
+ */
+struct ex_reader *ex_reader_open_mem(const uint8_t *data, size_t size)
+{
+	if (size < 32 || memcmp(data, "HEAD", 4) || memcmp(data+8, "EXTF", 4)
+			|| memcmp(data+20, "DATA", 4))
+		return NULL;
+	uint32_t nr_blocks = LittleEndian_getDW(data, 16);
+	size_t compressed_size = LittleEndian_getDW(data, 24);
+	unsigned long uncompressed_size = LittleEndian_getDW(data, 28);
+	if (compressed_size > size - 32)
+		return NULL;
+
+	uint8_t *compressed = xmalloc(compressed_size);
+	memcpy(compressed, data + 32, compressed_size);
+	ex_decode(compressed, compressed_size);
+
+	uint8_t *buf = xmalloc(uncompressed_size ? uncompressed_size : 1);
+	int rv = uncompress(buf, &uncompressed_size, compressed, compressed_size);
+	free(compressed);
+	if (rv != Z_OK) {
+		free(buf);
+		return NULL;
+	}
+
+	struct ex_reader *r = xcalloc(1, sizeof(struct ex_reader));
+	r->data = buf;
+	r->size = uncompressed_size;
+	r->nr_blocks = nr_blocks;
+	index_blocks(r);
+	return r;
+}
+
+void ex_reader_close(struct ex_reader *r)
+{
+	for (uint32_t i = 0; i < r->nr_blocks; i++) {
+		ex_reader_release(r, i);
+	}
+	for (uint32_t i = 0; i < r->nr_blocks; i++) {
+		free(r->index->names[i]);
+	}
+	free(r->index->names);
+	kh_destroy(block_names, r->index->map);
+	free(r->index);
+	free(r->blocks);
+	free(r->data);
+	free(r);
+}
+
+/*
+ * Get the index of the first block with the given name, or -1 if there is
+ * no such block.
+ */
+int ex_reader_find(struct ex_reader *r, const char *name)
+{
+	khiter_t k = kh_get(block_names, r->index->map, name);
+	if (k == kh_end(r->index->map))
+		return -1;
+	return kh_value(r->index->map, k);
+}
+
+/*
+ * Get a block, decoding it if it hasn't been accessed yet. The block is owned
+ * by the reader and remains valid until it is released.
+ */
+struct ex_block *ex_reader_block(struct ex_reader *r, uint32_t i)
+{
+	struct ex_reader_block *b = &r->blocks[i];
+	if (b->block)
+		return b->block;
+
+	struct ex_decoder d = { .r = r, .pos = b->off, .end = b->off + b->size };
+	struct ex_block *block = xmalloc(sizeof(struct ex_block));
+	block->size = b->size;
+	block->name = read_string(&d);
+	block->val.type = b->type;
+	read_value_data(&d, &block->val, NULL, 0, false);
+	if (d.pos != d.end)
+		decode_error(&d, "block size mismatch");
+	if (block->val.type == EX_TREE) {
+		free_string(block->val.tree->name);
+		block->val.tree->name = string_ref(block->name);
+	}
+
+	b->block = block;
+	return block;
+}
+
+/*
+ * Free the decoded value of a block (it will be decoded again if it is
+ * accessed later).
+ */
+void ex_reader_release(struct ex_reader *r, uint32_t i)
+{
+	struct ex_reader_block *b = &r->blocks[i];
+	if (b->columns) {
+		ex_columns_free(b->columns);
+		free_value(&(struct ex_value) { .type = EX_TABLE, .t = b->header });
+		b->columns = NULL;
+		b->header = NULL;
+	}
+	if (!b->block)
+		return;
+	free_string(b->block->name);
+	free_value(&b->block->val);
+	free(b->block);
+	b->block = NULL;
+}
+
+/*
+ * Decode the rows of a table directly into columns. Returns false if a cell
+ * doesn't match the type of its column.
+ */
+static bool read_columns(struct ex_decoder *d, struct ex_columns *c)
+{
+	for (uint32_t i = 0; i < c->nr_rows; i++) {
+		for (uint32_t j = 0; j < c->nr_columns; j++) {
+			struct ex_column *col = &c->columns[j];
+			if (read_u32(d) != col->type)
+				return false;
+			switch (col->type) {
+			case EX_INT:
+				col->i[i] = read_u32(d);
+				break;
+			case EX_FLOAT:
+				col->f[i] = read_float(d);
+				break;
+			case EX_STRING: {
+				size_t len;
+				const char *s = read_string_view(d, &len);
+				if (d->r->conv) {
+					struct string *str = d->r->conv(s, len);
+					col->s[i] = ex_columns_add_string(c, str->text, str->size);
+					free_string(str);
+				} else {
+					col->s[i] = ex_columns_add_string(c, s, len);
+				}
+				break;
+			}
+			}
+		}
+	}
+	return true;
+}
+
+/*
+ * Get a table block in columnar form, decoding it if it hasn't been accessed
+ * yet. This avoids allocating a value for every cell. Returns NULL if the
+ * block isn't a table with homogeneous scalar columns (use ex_reader_block
+ * instead). The result is owned by the reader and remains valid until the
+ * block is released.
+ */
+struct ex_columns *ex_reader_columns(struct ex_reader *r, uint32_t i)
+{
+	struct ex_reader_block *b = &r->blocks[i];
+	if (b->columns)
+		return b->columns;
+	if (b->type != EX_TABLE)
+		return NULL;
+
+	struct ex_decoder d = { .r = r, .pos = b->off, .end = b->off + b->size };
+	size_t name_len;
+	read_string_view(&d, &name_len);
+
+	struct ex_table *t = xcalloc(1, sizeof(struct ex_table));
+	t->nr_fields = read_u32(&d);
+	t->fields = xcalloc(t->nr_fields, sizeof(struct ex_field));
+	for (uint32_t j = 0; j < t->nr_fields; j++) {
+		read_field(&d, &t->fields[j]);
+	}
+
+	uint32_t rows = read_u32(&d);
+	uint32_t columns = read_u32(&d);
+	if (t->nr_fields && rows == t->nr_fields && columns != t->nr_fields) {
+		uint32_t tmp = rows;
+		rows = columns;
+		columns = tmp;
+	}
+
+	struct ex_columns *c = ex_columns_new(t->fields, t->nr_fields, columns, rows);
+	if (!c || !read_columns(&d, c) || d.pos != d.end) {
+		if (c)
+			ex_columns_free(c);
+		free_value(&(struct ex_value) { .type = EX_TABLE, .t = t });
+		return NULL;
+	}
+
+	b->header = t;
+	b->columns = c;
+	return c;
+}
+
+struct ex_value *ex_reader_get(struct ex_reader *r, const char *name)
+{
+	int i = ex_reader_find(r, name);
+	if (i < 0)
+		return NULL;
+	return &ex_reader_block(r, i)->val;
+}
+
+/*
+ * Skip over the name of a block and return a decoder for its value.
+ */
+static bool scalar_block(struct ex_reader *r, const char *name, uint32_t type,
+		struct ex_decoder *d)
+{
+	int i = ex_reader_find(r, name);
+	if (i < 0 || r->blocks[i].type != type)
+		return false;
+	*d = (struct ex_decoder) {
+		.r = r,
+		.pos = r->blocks[i].off,
+		.end = r->blocks[i].off + r->blocks[i].size
+	};
+	size_t len;
+	read_string_view(d, &len);
+	return true;
+}
+
+int32_t ex_reader_get_int(struct ex_reader *r, const char *name, int32_t dflt)
+{
+	struct ex_decoder d;
+	if (!scalar_block(r, name, EX_INT, &d))
+		return dflt;
+	return read_u32(&d);
+}
+
+float ex_reader_get_float(struct ex_reader *r, const char *name, float dflt)
+{
+	struct ex_decoder d;
+	if (!scalar_block(r, name, EX_FLOAT, &d))
+		return dflt;
+	return read_float(&d);
+}
+
+/*
+ * Get the value of a string block without copying it. The returned string
+ * points into the reader's data and is not NUL-terminated; no encoding
+ * conversion is applied.
+ */
+const char *ex_reader_get_string(struct ex_reader *r, const char *name, size_t *len)
+{
+	struct ex_decoder d;
+	if (!scalar_block(r, name, EX_STRING, &d))
+		return NULL;
+	return read_string_view(&d, len);
+}
+
+struct ex_table *ex_reader_get_table(struct ex_reader *r, const char *name)
+{
+	struct ex_value *v = ex_reader_get(r, name);
+	return v && v->type == EX_TABLE ? v->t : NULL;
+}
+
+struct ex_list *ex_reader_get_list(struct ex_reader *r, const char *name)
+{
+	struct ex_value *v = ex_reader_get(r, name);
+	return v && v->type == EX_LIST ? v->list : NULL;
+}
+
+struct ex_tree *ex_reader_get_tree(struct ex_reader *r, const char *name)
+{
+	struct ex_value *v = ex_reader_get(r, name);
+	return v && v->type == EX_TREE ? v->tree : NULL;
+}
+
+/*
+ * Decode all blocks into a struct ex (to be freed with ex_free). Decoded
+ * blocks are moved out of the reader.
+ */
+struct ex *ex_reader_to_ex(struct ex_reader *r)
+{
+	struct ex *ex = xmalloc(sizeof(struct ex));
+	ex->nr_blocks = r->nr_blocks;
+	ex->blocks = xcalloc(r->nr_blocks, sizeof(struct ex_block));
+	for (uint32_t i = 0; i < r->nr_blocks; i++) {
+		ex->blocks[i] = *ex_reader_block(r, i);
+		free(r->blocks[i].block);
+		r->blocks[i].block = NULL;
+	}
+	return ex;
+}
@@ -0,0 +1,246 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "system4.h"
+#include "system4/buffer.h"
+#include "system4/ex.h"
+#include "system4/string.h"
+#include "khash.h"
+#include "alice.h"
+#include "alice/ex.h"
+
+/*
+ * Block-level editing of .ex files. Blocks which aren't touched by an edit
+ * are copied verbatim from the decompressed source data; only the blocks
+ * which are modified (or added) are decoded and re-serialized.
+ */
+
+KHASH_MAP_INIT_STR(block_index, uint32_t);
+
+void ex_edit(struct ex *base, struct ex *edit, enum ex_edit_mode mode)
+{
+	switch (mode) {
+	case EX_EDIT_APPEND:
+		ex_append(base, edit);
+		break;
+	case EX_EDIT_REPLACE:
+		ex_replace(base, edit);
+		break;
+	case EX_EDIT_PATCH:
+		ex_patch(base, edit);
+		break;
+	}
+}
+
+struct splice {
+	struct ex *edit;
+	enum ex_edit_mode mode;
+	int *first;                  // first edit block for each base block (or -1)
+	int *next;                   // next edit block for the same base block (or -1)
+	bool *deleted;               // base blocks deleted by a patch
+	struct ex_tree **del;        // __delete__ entries for base blocks
+	struct buffer out;
+	uint32_t nr_blocks;
+};
+
+static bool is_delete_block(struct splice *s, struct ex_block *b)
+{
+	return s->mode == EX_EDIT_PATCH && b->val.type == EX_TREE
+		&& !strcmp(b->name->text, EX_DELETE_BLOCK);
+}
+
+static void write_ex(struct splice *s, struct ex *ex)
+{
+	for (uint32_t i = 0; i < ex->nr_blocks; i++) {
+		ex_write_block(&s->out, &ex->blocks[i]);
+	}
+	s->nr_blocks += ex->nr_blocks;
+}
+
+/*
+ * Apply the edit blocks in the list starting at `first` (plus an optional
+ * __delete__ entry) to a sub-file containing the blocks of base, and write
+ * the result. The edit blocks are copied back into s->edit afterwards, so
+ * that they are freed along with it.
+ */
+static void apply_edit(struct splice *s, struct ex *base, int first, struct ex_tree *del)
+{
+	struct ex edit = {0};
+	for (int k = first; k >= 0; k = s->next[k])
+		edit.nr_blocks++;
+	edit.blocks = xcalloc(edit.nr_blocks + 1, sizeof(struct ex_block));
+
+	uint32_t n = 0;
+	for (int k = first; k >= 0; k = s->next[k])
+		edit.blocks[n++] = s->edit->blocks[k];
+
+	struct ex_tree del_tree = { .is_leaf = false };
+	if (del) {
+		del_tree.nr_children = 1;
+		del_tree.children = del;
+		edit.blocks[edit.nr_blocks++] = (struct ex_block) {
+			.name = cstr_to_string(EX_DELETE_BLOCK),
+			.val = { .type = EX_TREE, .tree = &del_tree },
+		};
+	}
+
+	ex_edit(base, &edit, s->mode);
+	write_ex(s, base);
+
+	n = 0;
+	for (int k = first; k >= 0; k = s->next[k])
+		s->edit->blocks[k] = edit.blocks[n++];
+	if (del)
+		free_string(edit.blocks[n].name);
+	free(edit.blocks);
+}
+
+static void splice_block(struct splice *s, struct ex_reader *r, uint32_t i)
+{
+	if (s->deleted[i])
+		return;
+
+	struct ex_reader_block *b = &r->blocks[i];
+	if (s->first[i] < 0 && !s->del[i]) {
+		buffer_write_int32(&s->out, b->type);
+		buffer_write_int32(&s->out, b->size);
+		buffer_write_bytes(&s->out, r->data + b->off, b->size);
+		s->nr_blocks++;
+		return;
+	}
+
+	struct ex *base = xmalloc(sizeof(struct ex));
+	base->nr_blocks = 1;
+	base->blocks = xmalloc(sizeof(struct ex_block));
+	base->blocks[0] = *ex_reader_block(r, i);
+	free(b->block);
+	b->block = NULL;
+
+	apply_edit(s, base, s->first[i], s->del[i]);
+	ex_free(base);
+}
+
+/*
+ * Apply an edit to the .ex file opened by base, returning the new file
+ * (which still needs to be encrypted; see ex_write_flat). Blocks of base
+ * which aren't named in the edit are copied without being decoded. The
+ * result is the same as decoding the whole file and calling ex_edit.
+ */
+uint8_t *ex_splice(struct ex_reader *base, struct ex *edit, enum ex_edit_mode mode,
+		size_t *size_out)
+{
+	struct splice s = {
+		.edit = edit,
+		.mode = mode,
+		.first = xcalloc(base->nr_blocks + 1, sizeof(int)),
+		.next = xcalloc(edit->nr_blocks + 1, sizeof(int)),
+		.deleted = xcalloc(base->nr_blocks + 1, sizeof(bool)),
+		.del = xcalloc(base->nr_blocks + 1, sizeof(struct ex_tree*)),
+	};
+
+	// index base blocks by name
+	khash_t(block_index) *index = kh_init(block_index);
+	char **names = xcalloc(base->nr_blocks + 1, sizeof(char*));
+	bool duplicates = false;
+	for (uint32_t i = 0; i < base->nr_blocks; i++) {
+		names[i] = xmalloc(base->blocks[i].name_len + 1);
+		memcpy(names[i], base->blocks[i].name, base->blocks[i].name_len);
+		names[i][base->blocks[i].name_len] = '\0';
+		int ret;
+		khiter_t k = kh_put(block_index, index, names[i], &ret);
+		if (!ret)
+			duplicates = true;
+		kh_value(index, k) = i;
+		s.first[i] = -1;
+	}
+
+	uint8_t *result;
+	if (duplicates) {
+		// edits apply to the first block with a given name
+		struct ex *ex = ex_reader_to_ex(base);
+		ex_edit(ex, edit, mode);
+		struct buffer out;
+		size_t data_loc = ex_flatten_begin(&out);
+		for (uint32_t i = 0; i < ex->nr_blocks; i++) {
+			ex_write_block(&out, &ex->blocks[i]);
+		}
+		result = ex_flatten_end(&out, data_loc, ex->nr_blocks, size_out);
+		ex_free(ex);
+		goto done;
+	}
+
+	// blocks deleted by a patch
+	for (uint32_t k = 0; k < edit->nr_blocks; k++) {
+		struct ex_block *e = &edit->blocks[k];
+		if (!is_delete_block(&s, e) || e->val.tree->is_leaf)
+			continue;
+		for (uint32_t j = 0; j < e->val.tree->nr_children; j++) {
+			struct ex_tree *c = &e->val.tree->children[j];
+			khiter_t it = kh_get(block_index, index, c->name->text);
+			if (it == kh_end(index))
+				continue;
+			uint32_t i = kh_value(index, it);
+			if (c->is_leaf && c->leaf.value.type != EX_LIST)
+				s.deleted[i] = true;
+			else
+				s.del[i] = c;
+		}
+	}
+
+	// assign edit blocks to base blocks (in reverse, to keep them in order);
+	// edits to deleted blocks become new blocks
+	int first_new = -1;
+	for (int k = edit->nr_blocks - 1; k >= 0; k--) {
+		struct ex_block *e = &edit->blocks[k];
+		if (is_delete_block(&s, e))
+			continue;
+		khiter_t it = kh_get(block_index, index, e->name->text);
+		if (it != kh_end(index) && !s.deleted[kh_value(index, it)]) {
+			uint32_t i = kh_value(index, it);
+			s.next[k] = s.first[i];
+			s.first[i] = k;
+		} else {
+			s.next[k] = first_new;
+			first_new = k;
+		}
+	}
+
+	size_t data_loc = ex_flatten_begin(&s.out);
+	for (uint32_t i = 0; i < base->nr_blocks; i++) {
+		splice_block(&s, base, i);
+	}
+	if (first_new >= 0) {
+		struct ex *ex = xcalloc(1, sizeof(struct ex));
+		apply_edit(&s, ex, first_new, NULL);
+		ex_free(ex);
+	}
+	result = ex_flatten_end(&s.out, data_loc, s.nr_blocks, size_out);
+done:
+	for (uint32_t i = 0; i < base->nr_blocks; i++) {
+		free(names[i]);
+	}
+	free(names);
+	kh_destroy(block_index, index);
+	free(s.first);
+	free(s.next);
+	free(s.deleted);
+	free(s.del);
+	return result;
+}
@@ -1,4 +1,7 @@
 %define api.prefix {yex_}
+%define api.pure full
+%param {void *scanner}
+%parse-param {struct ex **ex_out}
 
 %union {
     int token;
@@ -32,15 +35,8 @@
 #include "system4/string.h"
 #include "core/ex/ast.h"
 
-extern int yex_lex();
-extern unsigned long yex_line;
-
-struct ex *ex_data;
-
-void yex_error(const char *s)
-{
-    sys_error("ERROR: at line %lu: %s\n", yex_line, s);
-}
+extern int yex_lex(YEX_STYPE *lvalp, void *scanner);
+extern void yex_error(void *scanner, struct ex **ex_out, const char *s);
 
 enum ex_value_type ast_token_to_value_type(int token)
 {
@@ -88,7 +84,7 @@ enum ex_value_type ast_token_to_value_type(int token)
 
 %%
 
-exdata	:	stmts { ex_data = ast_make_ex($1); }
+exdata	:	stmts { *ex_out = ast_make_ex($1); }
 	;
 
 stmts	:	stmt ';'       { $$ = ast_make_block_list($1); }
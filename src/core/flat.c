@@ -15,12 +15,13 @@
  */
 
 #include <stdint.h>
+#include <inttypes.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 #include <limits.h>
+#include <time.h>
 #include "system4.h"
-#include "system4/buffer.h"
 #include "system4/cg.h"
 #include "system4/ex.h"
 #include "system4/file.h"
@@ -30,16 +31,30 @@
 #include "alice.h"
 #include "alice/ex.h"
 #include "alice/flat.h"
+#include "alice/jobs.h"
 
-static void buffer_write_file(struct buffer *buf, const char *path)
-{
-	size_t len;
-	uint8_t *data = file_read(path, &len);
-	if (!data)
-		ALICE_ERROR("reading '%s': %s", path, strerror(errno));
-	buffer_write_bytes(buf, data, len);
-	free(data);
-}
+/*
+ * A file referenced by a .flat manifest. The .flat is built in two passes:
+ * the first computes the layout from the sizes of the input files, and the
+ * second writes everything except the input files into a buffer of the exact
+ * size. The input files are then read (in parallel) directly into place.
+ */
+struct flat_input {
+	struct string *path;
+	size_t off;
+	size_t size;
+	int64_t mtime;
+	uint64_t hash;
+};
+
+/*
+ * Output buffer for the .flat being built. When `buf` is NULL, writes only
+ * advance the index (used to compute the layout).
+ */
+struct flat_writer {
+	uint8_t *buf;
+	size_t index;
+};
 
 static struct string *get_path(const struct string *dir, const char *file)
 {
@@ -49,46 +64,111 @@ static struct string *get_path(const struct string *dir, const char *file)
 	return path;
 }
 
-static void buffer_write_file_relative(struct buffer *buf, const struct string *dir, const char *name)
+#define HASH_INIT 0xcbf29ce484222325ULL
+
+static uint64_t hash_data(uint64_t h, const uint8_t *data, size_t size)
 {
-	struct string *path = get_path(dir, name);
-	buffer_write_file(buf, path->text);
-	free_string(path);
+	// FNV-1a
+	for (size_t i = 0; i < size; i++) {
+		h ^= data[i];
+		h *= 0x100000001b3ULL;
+	}
+	return h;
 }
 
-static void pad_align(struct buffer *b)
+struct read_input_job {
+	struct flat_input *in;
+	uint8_t *buf;
+};
+
+static void read_input_job(void *data)
 {
-	while (b->index & 3) {
-		uint8_t zero = 0;
-		buffer_write_bytes(b, &zero, 1);
-	}
+	struct read_input_job *job = data;
+	struct flat_input *in = job->in;
+	uint8_t *dst = job->buf + in->off;
+	FILE *f = file_open_utf8(in->path->text, "rb");
+	if (!f)
+		ALICE_ERROR("reading '%s': %s", in->path->text, strerror(errno));
+	if (fread(dst, 1, in->size, f) != in->size || fgetc(f) != EOF)
+		ALICE_ERROR("reading '%s': file changed while building .flat", in->path->text);
+	fclose(f);
+	in->hash = hash_data(HASH_INIT, dst, in->size);
 }
 
-static void deserialize_binary(struct buffer *b, struct string *s)
+static void writer_bytes(struct flat_writer *w, const void *data, size_t size)
 {
-	if (s->size % 2 != 0)
-		ALICE_ERROR("Serialized binary data has odd size");
+	if (w->buf)
+		memcpy(w->buf + w->index, data, size);
+	w->index += size;
+}
 
-	size_t off = b->index;
-	buffer_skip(b, 4);
+static void writer_int32(struct flat_writer *w, int32_t v)
+{
+	if (w->buf)
+		LittleEndian_putDW(w->buf, w->index, v);
+	w->index += 4;
+}
 
-	for (int i = 0; i < s->size; i += 2) {
-		uint8_t n;
-		sscanf(s->text+i, "%02hhx", &n);
-		buffer_write_bytes(b, &n, 1);
-	}
+static void writer_int32_at(struct flat_writer *w, size_t off, int32_t v)
+{
+	if (w->buf)
+		LittleEndian_putDW(w->buf, off, v);
+}
 
-	unsigned size = b->index - off - 4;
-	buffer_write_int32_at(b, off, size);
+static void writer_pad(struct flat_writer *w, size_t size)
+{
 	if (size & 3) {
-		int npad = 4 - (size & 3);
-		buffer_write_bytes(b, (const uint8_t*)"\0\0\0", npad);
+		size_t npad = 4 - (size & 3);
+		if (w->buf)
+			memset(w->buf + w->index, 0, npad);
+		w->index += npad;
 	}
 }
 
-static void write_libl_files(struct buffer *b, struct ex_table *libl, const struct string *dir)
+/*
+ * Reserve space for an input file (which is read later).
+ */
+static void writer_input(struct flat_writer *w, struct flat_input *in)
+{
+	in->off = w->index;
+	w->index += in->size;
+}
+
+// hex digit values, plus one (0 = invalid)
+static const uint8_t hex_values[256] = {
+	['0'] = 1, ['1'] = 2, ['2'] = 3, ['3'] = 4, ['4'] = 5,
+	['5'] = 6, ['6'] = 7, ['7'] = 8, ['8'] = 9, ['9'] = 10,
+	['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16,
+	['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16,
+};
+
+static void decode_hex(uint8_t *dst, const char *src, size_t size)
+{
+	const uint8_t *s = (const uint8_t*)src;
+	for (size_t i = 0; i < size; i++, s += 2) {
+		uint8_t hi = hex_values[s[0]];
+		uint8_t lo = hex_values[s[1]];
+		if (!hi || !lo)
+			ALICE_ERROR("Invalid character in serialized binary data");
+		dst[i] = ((hi - 1) << 4) | (lo - 1);
+	}
+}
+
+static void deserialize_binary(struct flat_writer *w, struct string *s)
+{
+	if (s->size % 2 != 0)
+		ALICE_ERROR("Serialized binary data has odd size");
+
+	unsigned size = s->size / 2;
+	writer_int32(w, size);
+	if (w->buf)
+		decode_hex(w->buf + w->index, s->text, size);
+	w->index += size;
+	writer_pad(w, size);
+}
+
+static void validate_libl(struct ex_table *libl)
 {
-	// validate fields
 	if (libl->nr_fields != 5)
 		ALICE_ERROR("Wrong number of columns in 'libl' table");
 	if (libl->fields[0].type != EX_STRING)
@@ -101,34 +181,10 @@ static void write_libl_files(struct buffer *b, struct ex_table *libl, const stru
 		ALICE_ERROR("Wrong type for column 'front' in 'libl' table");
 	if (libl->fields[4].type != EX_STRING)
 		ALICE_ERROR("Wrong type");
-
-	buffer_write_int32(b, libl->nr_rows);
-
-	for (unsigned i = 0; i < libl->nr_rows; i++) {
-		size_t off = b->index;
-		deserialize_binary(b, libl->rows[i][0].s);
-		buffer_write_int32(b, libl->rows[i][1].i);
-
-		struct string *path = get_path(dir, libl->rows[i][4].s->text);
-		if (libl->rows[i][2].i) {
-			buffer_write_int32(b, file_size(path->text) + 4);
-			buffer_write_int32(b, libl->rows[i][3].i);
-		} else {
-			buffer_write_int32(b, file_size(path->text));
-		}
-		buffer_write_file(b, path->text);
-		free_string(path);
-		unsigned size = b->index - off;
-		if (size & 3) {
-			int npad = 4 - (size & 3);
-			buffer_write_bytes(b, (const uint8_t*)"\0\0\0", npad);
-		}
-	}
 }
 
-static void write_talt_files(struct buffer *b, struct ex_table *talt, const struct string *dir)
+static void validate_talt(struct ex_table *talt)
 {
-	// validate fields
 	if (talt->nr_fields != 2)
 		ALICE_ERROR("Wrong number of columns in 'talt' table");
 	if (talt->fields[0].type != EX_STRING)
@@ -147,120 +203,382 @@ static void write_talt_files(struct buffer *b, struct ex_table *talt, const stru
 		ALICE_ERROR("Wrong type for column 'uk4' in 'talt.meta' table");
 	if (talt->fields[1].subfields[4].type != EX_INT)
 		ALICE_ERROR("Wrong type for column 'uk5' in 'talt.meta' table");
+}
 
-	buffer_write_int32(b, talt->nr_rows);
+static void write_libl_files(struct flat_writer *w, struct ex_table *libl, struct flat_input *files)
+{
+	writer_int32(w, libl->nr_rows);
+
+	for (unsigned i = 0; i < libl->nr_rows; i++) {
+		size_t off = w->index;
+		deserialize_binary(w, libl->rows[i][0].s);
+		writer_int32(w, libl->rows[i][1].i);
+
+		if (libl->rows[i][2].i) {
+			writer_int32(w, files[i].size + 4);
+			writer_int32(w, libl->rows[i][3].i);
+		} else {
+			writer_int32(w, files[i].size);
+		}
+		writer_input(w, &files[i]);
+		writer_pad(w, w->index - off);
+	}
+}
+
+static void write_talt_files(struct flat_writer *w, struct ex_table *talt, struct flat_input *files)
+{
+	writer_int32(w, talt->nr_rows);
 
 	for (unsigned i = 0; i < talt->nr_rows; i++) {
-		struct string *path = get_path(dir, talt->rows[i][0].s->text);
-		buffer_write_int32(b, file_size(path->text));
-		buffer_write_file(b, path->text);
-		free_string(path);
-		pad_align(b);
+		writer_int32(w, files[i].size);
+		writer_input(w, &files[i]);
+		writer_pad(w, w->index);
 
 		struct ex_table *meta = talt->rows[i][1].t;
-		buffer_write_int32(b, meta->nr_rows);
+		writer_int32(w, meta->nr_rows);
 		for (unsigned i = 0; i < meta->nr_rows; i++) {
-			deserialize_binary(b, meta->rows[i][0].s);
-			buffer_write_int32(b, meta->rows[i][1].i);
-			buffer_write_int32(b, meta->rows[i][2].i);
-			buffer_write_int32(b, meta->rows[i][3].i);
-			buffer_write_int32(b, meta->rows[i][4].i);
+			deserialize_binary(w, meta->rows[i][0].s);
+			writer_int32(w, meta->rows[i][1].i);
+			writer_int32(w, meta->rows[i][2].i);
+			writer_int32(w, meta->rows[i][3].i);
+			writer_int32(w, meta->rows[i][4].i);
 		}
 	}
 }
 
-static struct flat *build_flat(struct ex *ex, const struct string *dir)
+/*
+ * A parsed .flat manifest. The set of input files is known once the manifest
+ * has been read, so callers can check whether any of them have changed
+ * before loading them with flat_load_manifest.
+ */
+struct flat_manifest {
+	struct flat_input manifest;
+	struct ex *ex;
+	struct ex_index *index;
+	struct string *dir;
+	struct string *output_path;
+	bool elna;
+	struct ex_table *libl;
+	struct ex_table *talt;
+	bool tmnl;
+	unsigned nr_inputs;
+	struct flat_input *inputs;
+};
+
+static struct flat_input *add_input(struct flat_input *in, const struct string *dir, const char *name)
 {
-	struct buffer b;
-	struct flat *flat = xcalloc(1, sizeof(struct flat));
-	buffer_init(&b, NULL, 0);
+	in->path = get_path(dir, name);
+	in->size = 0;
+	return in + 1;
+}
 
-	if (ex_get_int(ex, "elna", 0)) {
-		flat->elna.present = true;
-		flat->elna.off = b.index;
-		flat->elna.size = 0;
-		buffer_write_bytes(&b, (uint8_t*)"ELNA", 4);
-		buffer_write_int32(&b, 0);
+struct flat_manifest *flat_read_manifest(const char *xpath)
+{
+	struct flat_manifest *mf = xcalloc(1, sizeof(struct flat_manifest));
+	char *dir = path_dirname_r(xpath);
+	mf->dir = cstr_to_string(dir);
+	free(dir);
+
+	// the manifest is hashed for the dependency file as it is read
+	struct flat_input *x = &mf->manifest;
+	ustat s;
+	x->path = cstr_to_string(xpath);
+	checked_stat(xpath, &s);
+	x->size = s.st_size;
+	x->mtime = s.st_mtime;
+	x->hash = HASH_INIT;
+	FILE *f = checked_fopen(xpath, "rb");
+	uint8_t buf[4096];
+	size_t n;
+	while ((n = fread(buf, 1, sizeof(buf), f)))
+		x->hash = hash_data(x->hash, buf, n);
+	rewind(f);
+	mf->ex = ex_parse(f, mf->dir->text);
+	fclose(f);
+	if (!mf->ex) {
+		ALICE_ERROR("Failed to read flat manifest file: %s", xpath);
+	}
+	mf->index = ex_index_new(mf->ex);
+
+	// FIXME: this sucks
+	struct string *output = ex_index_get_string(mf->index, "output");
+	if (output) {
+		char *uoutput = conv_output_utf8(output->text);
+		mf->output_path = cstr_to_string(uoutput);
+		free(uoutput);
+		free_string(output);
 	}
 
-	struct string *flat_path = ex_get_string(ex, "flat");
+	struct string *flat_path = ex_index_get_string(mf->index, "flat");
 	if (!flat_path)
 		ALICE_ERROR("'flat' path missing from .flat manifest");
-	flat->flat.present = true;
-	flat->flat.off = b.index;
-	buffer_write_file_relative(&b, dir, flat_path->text);
-	flat->flat.size = b.index - flat->flat.off - 8;
+	struct string *tmnl_path = ex_index_get_string(mf->index, "tmnl");
+	struct string *mtlc_path = ex_index_get_string(mf->index, "mtlc");
+	if (!mtlc_path)
+		ALICE_ERROR("'mtlc' path missing from .flat manifest");
+	struct ex_table *libl = ex_index_get_table(mf->index, "libl");
+	if (!libl)
+		ALICE_ERROR("'libl' table missing from .flat manifest");
+	validate_libl(libl);
+	struct ex_table *talt = ex_index_get_table(mf->index, "talt");
+	if (talt)
+		validate_talt(talt);
+
+	mf->elna = ex_index_get_int(mf->index, "elna", 0);
+	mf->tmnl = !!tmnl_path;
+	mf->libl = libl;
+	mf->talt = talt;
+
+	// input files, in the order they are written to the .flat
+	mf->nr_inputs = 2 + !!tmnl_path + libl->nr_rows + (talt ? talt->nr_rows : 0);
+	mf->inputs = xcalloc(mf->nr_inputs, sizeof(struct flat_input));
+	struct flat_input *in = add_input(mf->inputs, mf->dir, flat_path->text);
+	if (tmnl_path)
+		in = add_input(in, mf->dir, tmnl_path->text);
+	in = add_input(in, mf->dir, mtlc_path->text);
+	for (unsigned i = 0; i < libl->nr_rows; i++) {
+		in = add_input(in, mf->dir, libl->rows[i][4].s->text);
+	}
+	for (unsigned i = 0; talt && i < talt->nr_rows; i++) {
+		in = add_input(in, mf->dir, talt->rows[i][0].s->text);
+	}
+
 	free_string(flat_path);
+	if (tmnl_path)
+		free_string(tmnl_path);
+	free_string(mtlc_path);
+	return mf;
+}
+
+/*
+ * The output path given in the manifest, or NULL.
+ */
+struct string *flat_manifest_output_path(struct flat_manifest *mf)
+{
+	return mf->output_path;
+}
 
-	struct string *tmnl_path = ex_get_string(ex, "tmnl");
-	if (tmnl_path) {
+void flat_manifest_free(struct flat_manifest *mf)
+{
+	for (unsigned i = 0; i < mf->nr_inputs; i++) {
+		free_string(mf->inputs[i].path);
+	}
+	free(mf->inputs);
+	if (mf->output_path)
+		free_string(mf->output_path);
+	free_string(mf->dir);
+	ex_index_free(mf->index);
+	ex_free(mf->ex);
+	free_string(mf->manifest.path);
+	free(mf);
+}
+
+/*
+ * Write a .flat file (excluding the contents of the input files).
+ */
+static void write_flat(struct flat_writer *w, struct flat_manifest *mf, struct flat *flat)
+{
+	struct flat_input *in = mf->inputs;
+
+	if (mf->elna) {
+		flat->elna.present = true;
+		flat->elna.off = w->index;
+		flat->elna.size = 0;
+		writer_bytes(w, "ELNA", 4);
+		writer_int32(w, 0);
+	}
+
+	flat->flat.present = true;
+	flat->flat.off = w->index;
+	writer_input(w, in++);
+	flat->flat.size = w->index - flat->flat.off - 8;
+
+	if (mf->tmnl) {
 		flat->tmnl.present = true;
-		flat->tmnl.off = b.index;
-		buffer_write_file_relative(&b, dir, tmnl_path->text);
-		flat->tmnl.size = b.index - flat->tmnl.off - 8;
-		free_string(tmnl_path);
+		flat->tmnl.off = w->index;
+		writer_input(w, in++);
+		flat->tmnl.size = w->index - flat->tmnl.off - 8;
 	}
 
-	struct string *mtlc_path = ex_get_string(ex, "mtlc");
-	if (!mtlc_path)
-		ALICE_ERROR("'mtlc' path missing from .flat manifest");
 	flat->mtlc.present = true;
-	flat->mtlc.off = b.index;
-	buffer_write_file_relative(&b, dir, mtlc_path->text);
-	flat->mtlc.size = b.index - flat->mtlc.off - 8;
-	free_string(mtlc_path);
+	flat->mtlc.off = w->index;
+	writer_input(w, in++);
+	flat->mtlc.size = w->index - flat->mtlc.off - 8;
 
-	struct ex_table *libl = ex_get_table(ex, "libl");
-	if (!libl)
-		ALICE_ERROR("'libl' table missing from .flat manifest");
 	flat->libl.present = true;
-	flat->libl.off = b.index;
-	buffer_write_bytes(&b, (uint8_t*)"LIBL", 4);
-	buffer_write_int32(&b, 0);
-	write_libl_files(&b, libl, dir);
+	flat->libl.off = w->index;
+	writer_bytes(w, "LIBL", 4);
+	writer_int32(w, 0);
+	write_libl_files(w, mf->libl, in);
+	in += mf->libl->nr_rows;
 	// write the section size now that we know it
-	buffer_write_int32_at(&b, flat->libl.off + 4, b.index - flat->libl.off - 8);
+	writer_int32_at(w, flat->libl.off + 4, w->index - flat->libl.off - 8);
 
-	struct ex_table *talt = ex_get_table(ex, "talt");
-	if (talt) {
+	if (mf->talt) {
 		flat->talt.present = true;
-		flat->talt.off = b.index;
-		buffer_write_bytes(&b, (uint8_t*)"TALT", 4);
-		buffer_write_int32(&b, 0);
-		write_talt_files(&b, talt, dir);
+		flat->talt.off = w->index;
+		writer_bytes(w, "TALT", 4);
+		writer_int32(w, 0);
+		write_talt_files(w, mf->talt, in);
 		// write the section size now that we know it
-		buffer_write_int32_at(&b, flat->talt.off + 4, b.index - flat->talt.off - 8);
+		writer_int32_at(w, flat->talt.off + 4, w->index - flat->talt.off - 8);
+	}
+}
+
+struct flat *flat_load_manifest(struct flat_manifest *mf)
+{
+	for (unsigned i = 0; i < mf->nr_inputs; i++) {
+		struct flat_input *in = &mf->inputs[i];
+		ustat s;
+		if (stat_utf8(in->path->text, &s))
+			ALICE_ERROR("reading '%s': %s", in->path->text, strerror(errno));
+		in->size = s.st_size;
+		in->mtime = s.st_mtime;
 	}
 
-	flat->data_size = b.index;
-	flat->data = b.buf;
+	// compute layout
+	struct flat *flat = xcalloc(1, sizeof(struct flat));
+	struct flat_writer w = { .buf = NULL, .index = 0 };
+	write_flat(&w, mf, flat);
+
+	// write headers/metadata
+	flat->data_size = w.index;
+	flat->data = xmalloc(w.index);
 	flat->needs_free = true;
+	w = (struct flat_writer) { .buf = flat->data, .index = 0 };
+	write_flat(&w, mf, flat);
+
+	// read input files into place (in parallel)
+	struct read_input_job *jobs = xcalloc(mf->nr_inputs, sizeof(struct read_input_job));
+	struct job_group *group = job_group_new();
+	for (unsigned i = 0; i < mf->nr_inputs; i++) {
+		jobs[i].in = &mf->inputs[i];
+		jobs[i].buf = flat->data;
+		job_group_add(group, read_input_job, &jobs[i]);
+	}
+	job_group_run(group);
+	free(jobs);
 	return flat;
 }
 
 struct flat *flat_build(const char *xpath, struct string **output_path)
 {
-	struct string *dir = cstr_to_string(path_dirname(xpath));
-	struct ex *ex = ex_parse_file(xpath);
-	if (!ex) {
-		ALICE_ERROR("Failed to read flat manifest file: %s", xpath);
+	struct flat_manifest *mf = flat_read_manifest(xpath);
+	if (output_path && mf->output_path)
+		*output_path = string_ref(mf->output_path);
+	struct flat *flat = flat_load_manifest(mf);
+	flat_manifest_free(mf);
+	return flat;
+}
+
+/*
+ * Dependency files record the inputs of a built .flat file, so that it is
+ * only rebuilt when one of them changes. The format is:
+ *
+ *   flat-deps 1 <time written>
+ *   output <output path>
+ *   <hash> <size> <mtime> <path>
+ *   ...
+ *
+ * The first dependency is the manifest itself. A dependency whose size and
+ * mtime match is assumed to be unchanged, unless it was modified in the same
+ * second the dependency file was written; otherwise its contents are hashed.
+ */
+
+static bool hash_file(const char *path, uint64_t *hash)
+{
+	size_t size;
+	uint8_t *data = file_read(path, &size);
+	if (!data)
+		return false;
+	*hash = hash_data(HASH_INIT, data, size);
+	free(data);
+	return true;
+}
+
+/*
+ * The size and mtime recorded for a dependency are those from before it was
+ * read, so a change made while the .flat was being built is caught by the
+ * next check.
+ */
+static void write_dep(FILE *out, struct flat_input *in)
+{
+	fprintf(out, "%016" PRIx64 " %" PRIu64 " %" PRId64 " %s\n", in->hash, (uint64_t)in->size,
+			in->mtime, in->path->text);
+}
+
+/*
+ * Write the dependency file for a .flat built from a manifest. Must be
+ * called after flat_load_manifest.
+ */
+void flat_write_deps(struct flat_manifest *mf, const char *deps_path, const char *output_path)
+{
+	FILE *out = checked_fopen(deps_path, "wb");
+	fprintf(out, "flat-deps 1 %" PRId64 "\n", (int64_t)time(NULL));
+	fprintf(out, "output %s\n", output_path);
+	write_dep(out, &mf->manifest);
+	for (unsigned i = 0; i < mf->nr_inputs; i++) {
+		write_dep(out, &mf->inputs[i]);
 	}
+	fclose(out);
+}
+
+static void chomp(char *line)
+{
+	size_t len = strlen(line);
+	while (len && (line[len-1] == '\n' || line[len-1] == '\r'))
+		line[--len] = '\0';
+}
 
-	if (output_path) {
-		// FIXME: this sucks
-		struct string *tmp = ex_get_string(ex, "output");
-		if (tmp) {
-			char *utmp = conv_output_utf8(tmp->text);
-			*output_path = cstr_to_string(utmp);
-			free(utmp);
-			free_string(tmp);
+/*
+ * Check whether a .flat is up to date with respect to the dependencies
+ * recorded in a dependency file.
+ */
+bool flat_deps_up_to_date(const char *deps_path)
+{
+	FILE *in = file_open_utf8(deps_path, "rb");
+	if (!in)
+		return false;
+
+	bool up_to_date = false;
+	char line[PATH_MAX + 128];
+	int version;
+	int64_t written;
+	if (!fgets(line, sizeof(line), in)
+			|| sscanf(line, "flat-deps %d %" SCNd64, &version, &written) != 2
+			|| version != 1)
+		goto done;
+	if (!fgets(line, sizeof(line), in) || strncmp(line, "output ", 7))
+		goto done;
+	chomp(line);
+	if (!file_exists(line + 7))
+		goto done;
+
+	unsigned nr_deps = 0;
+	while (fgets(line, sizeof(line), in)) {
+		chomp(line);
+		uint64_t hash, size;
+		int64_t mtime;
+		int n;
+		if (sscanf(line, "%" SCNx64 " %" SCNu64 " %" SCNd64 " %n", &hash, &size, &mtime, &n) != 3)
+			goto done;
+		const char *path = line + n;
+		ustat s;
+		if (stat_utf8(path, &s))
+			goto done;
+		if ((uint64_t)s.st_size != size)
+			goto done;
+		if ((int64_t)s.st_mtime != mtime || mtime >= written) {
+			uint64_t h;
+			if (!hash_file(path, &h) || h != hash)
+				goto done;
 		}
+		nr_deps++;
 	}
-
-	struct flat *flat = build_flat(ex, dir);
-	free_string(dir);
-	ex_free(ex);
-	return flat;
+	up_to_date = nr_deps > 0;
+done:
+	fclose(in);
+	return up_to_date;
 }
 
 static const char *libl_get_extension(struct flat *flat, struct flat_library *lib)
@@ -329,12 +647,52 @@ static void write_section(const char *path, struct flat *flat, struct flat_secti
 	write_file(path, flat->data + section->off, section->size + 8);
 }
 
+struct payload_job {
+	char *path;
+	uint8_t *data;
+	size_t size;
+	bool cg;
+	bool png;
+};
+
+static void write_payload_job(void *data)
+{
+	struct payload_job *job = data;
+	if (job->cg)
+		write_cg(job->path, job->data, job->size, job->png);
+	else
+		write_file(job->path, job->data, job->size);
+}
+
+static void add_payload(struct job_group *group, struct payload_job *job, const char *path,
+		uint8_t *data, size_t size, bool cg, bool png)
+{
+	*job = (struct payload_job) {
+		.path = xstrdup(path),
+		.data = data,
+		.size = size,
+		.cg = cg,
+		.png = png,
+	};
+	job_group_add(group, write_payload_job, job);
+}
+
+/*
+ * Write the manifest for a .flat file along with the files it references.
+ * The files are written (and CGs converted) in parallel once the manifest
+ * has been written.
+ */
 void flat_extract(struct flat *flat, const char *output_file, bool png)
 {
 	FILE *out = checked_fopen(output_file, "wb");
 	char *prefix = escape_string_noconv(path_basename(output_file));
 	char path_buf[PATH_MAX];
 
+	struct job_group *group = job_group_new();
+	unsigned nr_jobs = flat->nr_libraries + (flat->talt.present ? flat->nr_talt_entries : 0);
+	struct payload_job *jobs = xcalloc(nr_jobs + 1, sizeof(struct payload_job));
+	unsigned job = 0;
+
 	// ELNA section
 	fprintf(out, "int elna = %d;\n\n", flat->elna.present ? 1 : 0);
 
@@ -371,12 +729,8 @@ void flat_extract(struct flat *flat, const char *output_file, bool png)
 
 		// write file
 		snprintf(path_buf, PATH_MAX-1, "%s.libl.%d.%s", output_file, i, ext);
-		if (lib->type == FLAT_LIB_CG) {
-			write_cg(path_buf, flat->data + lib->payload_off, lib->size, png);
-		} else {
-			write_file(path_buf, flat->data + lib->payload_off, lib->size);
-		}
-
+		add_payload(group, &jobs[job++], path_buf, flat->data + lib->payload_off,
+				lib->size, lib->type == FLAT_LIB_CG, png);
 	}
 	fprintf(out, "};\n");
 
@@ -399,11 +753,18 @@ void flat_extract(struct flat *flat, const char *output_file, bool png)
 
 			// write file
 			snprintf(path_buf, PATH_MAX-1, "%s.talt.%d.%s", output_file, i, ext);
-			write_cg(path_buf, flat->data + e->off, e->size, png);
+			add_payload(group, &jobs[job++], path_buf, flat->data + e->off, e->size,
+					true, png);
 		}
 		fprintf(out, "};\n");
 	}
 
 	free(prefix);
 	fclose(out);
+
+	job_group_run(group);
+	for (unsigned i = 0; i < job; i++) {
+		free(jobs[i].path);
+	}
+	free(jobs);
 }
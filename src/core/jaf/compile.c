@@ -28,6 +28,7 @@
 #include "system4/vector.h"
 #include "alice.h"
 #include "alice/jaf.h"
+#include "alice/profile.h"
 
 /*
  * NOTE: We need to pass some state between calls to handle
@@ -2654,31 +2655,55 @@ static void jaf_compile(struct ain *ain, struct jaf_block *toplevel)
 		WARNING("%d global initvals ignored", ain->nr_initvals);
 }
 
-void jaf_build(struct ain *out, const char **files, unsigned nr_files, const char **hll, unsigned nr_hll)
+void jaf_build(struct ain *out, const char **files, unsigned nr_files, const char **hll, unsigned nr_hll,
+		uint32_t flags)
 {
 	// First, we parse the source files and register type definitions in the ain file.
 	struct jaf_block *toplevel;
 	// pass 0: parse (type names registered in ain object here)
+	profile_begin("jaf.parse");
 	toplevel = jaf_parse(out, files, nr_files);
+	profile_count("files", nr_files);
+	profile_end();
 	// pass 1: resolve typedefs
+	profile_begin("jaf.resolve_types");
 	jaf_resolve_types(out, toplevel);
+	profile_end();
 	// pass 2: globals/functions
+	profile_begin("jaf.declarations");
 	jaf_process_declarations(out, toplevel);
+	profile_end();
 
 	// Now that type definitions are available, we parse the HLL files.
 	assert(nr_hll % 2 == 0);
+	profile_begin("jaf.hll_declarations");
 	for (unsigned i = 0; i < nr_hll; i += 2) {
 		struct jaf_block *hll_decl = jaf_parse(out, hll+i, 1);
 		jaf_process_hll_declarations(out, hll_decl, hll[i+1]);
 		jaf_free_block(hll_decl);
 	}
+	profile_end();
 
 	// pass 3: static analysis (type analysis, simplification, global initvals)
+	profile_begin("jaf.static_analysis");
 	toplevel = jaf_static_analyze(out, toplevel);
+	profile_end();
+
+	// optional: branch folding and dead code elimination
+	if (flags & JAF_OPTIMIZE) {
+		profile_begin("jaf.optimize");
+		jaf_optimize(out, toplevel);
+		profile_end();
+	}
 
 	// pass 4: allocate local variables
+	profile_begin("jaf.allocate_variables");
 	jaf_allocate_variables(out, toplevel);
+	profile_end();
 
+	profile_begin("jaf.compile");
 	jaf_compile(out, toplevel);
+	profile_count("functions", out->nr_functions);
+	profile_end();
 	jaf_free_block(toplevel);
 }
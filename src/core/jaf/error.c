@@ -23,6 +23,7 @@
 #include "system4/instructions.h"
 #include "system4/string.h"
 #include "alice/jaf.h"
+#include "alice/jobs.h"
 #include "alice/port.h"
 
 static const char *jaf_op_to_string(enum jaf_operator op)
@@ -426,6 +427,9 @@ void jaf_print_block_item(struct port *out, struct jaf_block_item *item)
 
 static void jaf_error_msg(const char *file, int line, const char *msgf, va_list ap)
 {
+	// write out any buffered log output before the error
+	if (jobs_active())
+		jobs_cancel();
 	sys_warning("%s:%d: " RED "error: " RESET, file, line);
 	sys_vwarning(msgf, ap);
 }
@@ -172,8 +172,35 @@ SIMPLIFY_ARITHMETIC_FUN(jaf_simplify_neq,       JAF_NEQ,       !=)
 SIMPLIFY_INTEGER_FUN   (jaf_simplify_bitand,    JAF_BIT_AND,   &)
 SIMPLIFY_INTEGER_FUN   (jaf_simplify_bitxor,    JAF_BIT_XOR,   ^)
 SIMPLIFY_INTEGER_FUN   (jaf_simplify_bitior,    JAF_BIT_IOR,   |)
-SIMPLIFY_INTEGER_FUN   (jaf_simplify_logand,    JAF_LOG_AND,   &&)
-SIMPLIFY_INTEGER_FUN   (jaf_simplify_logor,     JAF_LOG_OR,    ||)
+SIMPLIFY_INTEGER_FUN   (_jaf_simplify_logand,   JAF_LOG_AND,   &&)
+SIMPLIFY_INTEGER_FUN   (_jaf_simplify_logor,    JAF_LOG_OR,    ||)
+
+/*
+ * Short-circuit evaluation: if the LHS of a logical operator is constant and
+ * determines the result, the RHS is never evaluated and can be discarded.
+ */
+static struct jaf_expression *jaf_simplify_short_circuit(struct jaf_expression *e, int value)
+{
+	if (e->lhs->type != JAF_EXP_INT || !e->lhs->i != !value)
+		return NULL;
+	struct jaf_expression *r = e->lhs;
+	r->i = value;
+	jaf_free_expr(e->rhs);
+	free(e);
+	return r;
+}
+
+static struct jaf_expression *jaf_simplify_logand(struct jaf_expression *e)
+{
+	struct jaf_expression *r = jaf_simplify_short_circuit(e, 0);
+	return r ? r : _jaf_simplify_logand(e);
+}
+
+static struct jaf_expression *jaf_simplify_logor(struct jaf_expression *e)
+{
+	struct jaf_expression *r = jaf_simplify_short_circuit(e, 1);
+	return r ? r : _jaf_simplify_logor(e);
+}
 
 static struct jaf_expression *jaf_simplify_binary(struct jaf_expression *e)
 {
@@ -319,6 +346,39 @@ static struct jaf_expression *jaf_simplify_cast(struct jaf_expression *in)
 	return in;
 }
 
+/*
+ * Replace a reference to a constant with the constant's value.
+ */
+static struct jaf_expression *jaf_simplify_identifier(struct jaf_expression *in)
+{
+	if (in->ident.kind != JAF_IDENT_CONST)
+		return in;
+
+	struct jaf_expression *r;
+	struct ain_initval *val = &in->ident.constval;
+	switch (val->data_type) {
+	case AIN_INT:
+		r = jaf_integer(val->int_value);
+		break;
+	case AIN_FLOAT:
+		r = jaf_float(val->float_value);
+		break;
+	case AIN_STRING:
+		r = jaf_string(make_string(val->string_value, strlen(val->string_value)));
+		break;
+	default:
+		return in;
+	}
+	r->line = in->line;
+	r->file = in->file;
+
+	// NOTE: the constant value is shared with the declaration, so we don't
+	//       want jaf_free_expr to free it here
+	in->ident.kind = JAF_IDENT_UNRESOLVED;
+	jaf_free_expr(in);
+	return r;
+}
+
 static struct jaf_expression *jaf_simplify_char(struct jaf_expression *in)
 {
 	int c = 0;
@@ -362,7 +422,6 @@ struct jaf_expression *jaf_simplify(struct jaf_expression *in)
 	case JAF_EXP_INT:
 	case JAF_EXP_FLOAT:
 	case JAF_EXP_STRING:
-	case JAF_EXP_IDENTIFIER:
 	case JAF_EXP_THIS:
 	case JAF_EXP_FUNCALL:
 	case JAF_EXP_SYSCALL:
@@ -380,6 +439,8 @@ struct jaf_expression *jaf_simplify(struct jaf_expression *in)
 	case JAF_EXP_SOME:
 	case JAF_EXP_DUMMYREF:
 		return in;
+	case JAF_EXP_IDENTIFIER:
+		return jaf_simplify_identifier(in);
 	case JAF_EXP_UNARY:
 		return jaf_simplify_unary(in);
 	case JAF_EXP_BINARY:
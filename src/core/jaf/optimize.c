@@ -0,0 +1,282 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include "system4.h"
+#include "alice.h"
+#include "alice/jaf.h"
+
+/*
+ * Statement-level optimizations. This pass runs after static analysis (so
+ * that constant expressions have already been folded by jaf_simplify) and
+ * before variable allocation (so that variables declared in eliminated code
+ * are never allocated).
+ *
+ *   - if statements with a constant test are replaced by the taken branch
+ *   - while/for loops with a constant false test are removed
+ *   - statements following a return/goto/break/continue are removed, up to
+ *     the next statement which can be reached via a label
+ *
+ * Code containing a label (or case/default) is never removed, since it may
+ * be reachable via a jump from elsewhere in the function.
+ */
+
+static bool block_has_label(struct jaf_block *block);
+
+/*
+ * Returns true if a statement contains a jump target.
+ */
+static bool stmt_has_label(struct jaf_block_item *stmt)
+{
+	if (!stmt)
+		return false;
+
+	switch (stmt->kind) {
+	case JAF_STMT_LABELED:
+	case JAF_STMT_CASE:
+	case JAF_STMT_DEFAULT:
+		return true;
+	case JAF_STMT_COMPOUND:
+		return block_has_label(stmt->block);
+	case JAF_STMT_IF:
+		return stmt_has_label(stmt->cond.consequent)
+			|| stmt_has_label(stmt->cond.alternative);
+	case JAF_STMT_SWITCH:
+		return block_has_label(stmt->swi.body);
+	case JAF_STMT_WHILE:
+	case JAF_STMT_DO_WHILE:
+		return stmt_has_label(stmt->while_loop.body);
+	case JAF_STMT_FOR:
+		return stmt_has_label(stmt->for_loop.body);
+	default:
+		return false;
+	}
+}
+
+static bool block_has_label(struct jaf_block *block)
+{
+	if (!block)
+		return false;
+	for (size_t i = 0; i < block->nr_items; i++) {
+		if (stmt_has_label(block->items[i]))
+			return true;
+	}
+	return false;
+}
+
+static bool stmt_falls_through(struct jaf_block_item *stmt);
+
+/*
+ * Returns true if control can reach the end of a block.
+ */
+static bool block_falls_through(struct jaf_block *block)
+{
+	if (!block)
+		return true;
+
+	bool reachable = true;
+	for (size_t i = 0; i < block->nr_items; i++) {
+		if (!reachable && stmt_has_label(block->items[i]))
+			reachable = true;
+		if (reachable && !stmt_falls_through(block->items[i]))
+			reachable = false;
+	}
+	return reachable;
+}
+
+/*
+ * Returns true if control can reach the end of a statement. This is
+ * conservative: loops are always assumed to terminate.
+ */
+static bool stmt_falls_through(struct jaf_block_item *stmt)
+{
+	switch (stmt->kind) {
+	case JAF_STMT_GOTO:
+	case JAF_STMT_CONTINUE:
+	case JAF_STMT_BREAK:
+	case JAF_STMT_RETURN:
+		return false;
+	case JAF_STMT_LABELED:
+		return stmt_falls_through(stmt->label.stmt);
+	case JAF_STMT_COMPOUND:
+		return block_falls_through(stmt->block);
+	case JAF_STMT_IF:
+		return !stmt->cond.alternative
+			|| stmt_falls_through(stmt->cond.consequent)
+			|| stmt_falls_through(stmt->cond.alternative);
+	default:
+		return true;
+	}
+}
+
+static struct jaf_block_item *null_statement(struct jaf_block_item *stmt)
+{
+	struct jaf_block_item *r = jaf_null_statement();
+	r->line = stmt->line;
+	r->file = stmt->file;
+	return r;
+}
+
+static struct jaf_block_item *optimize_stmt(struct jaf_block_item *stmt);
+
+/*
+ * Returns true if the statement at index i in a block can be reached via a
+ * label at or after index i.
+ */
+static bool label_follows(struct jaf_block *block, size_t i)
+{
+	for (; i < block->nr_items; i++) {
+		if (stmt_has_label(block->items[i]))
+			return true;
+	}
+	return false;
+}
+
+static void optimize_block(struct jaf_block *block)
+{
+	if (!block)
+		return;
+
+	for (size_t i = 0; i < block->nr_items; i++) {
+		block->items[i] = optimize_stmt(block->items[i]);
+	}
+
+	// remove unreachable statements
+	bool reachable = true;
+	size_t n = 0;
+	for (size_t i = 0; i < block->nr_items; i++) {
+		struct jaf_block_item *item = block->items[i];
+		if (!reachable && stmt_has_label(item))
+			reachable = true;
+		// NOTE: unreachable declarations are kept if they might be referenced
+		//       by code after a label
+		if (!reachable && !(item->kind == JAF_DECL_VAR && label_follows(block, i+1))) {
+			jaf_free_block_item(item);
+			continue;
+		}
+		block->items[n++] = item;
+		if (reachable && !stmt_falls_through(item))
+			reachable = false;
+	}
+	block->nr_items = n;
+}
+
+static struct jaf_block_item *optimize_if(struct jaf_block_item *stmt)
+{
+	stmt->cond.consequent = optimize_stmt(stmt->cond.consequent);
+	stmt->cond.alternative = optimize_stmt(stmt->cond.alternative);
+	if (stmt->cond.test->type != JAF_EXP_INT)
+		return stmt;
+
+	struct jaf_block_item **taken, **not_taken;
+	if (stmt->cond.test->i) {
+		taken = &stmt->cond.consequent;
+		not_taken = &stmt->cond.alternative;
+	} else {
+		taken = &stmt->cond.alternative;
+		not_taken = &stmt->cond.consequent;
+	}
+	if (stmt_has_label(*not_taken))
+		return stmt;
+
+	struct jaf_block_item *r = *taken ? *taken : null_statement(stmt);
+	*taken = NULL;
+	jaf_free_block_item(stmt);
+	return r;
+}
+
+static struct jaf_block_item *optimize_while(struct jaf_block_item *stmt)
+{
+	stmt->while_loop.body = optimize_stmt(stmt->while_loop.body);
+	if (stmt->while_loop.test->type != JAF_EXP_INT || stmt->while_loop.test->i)
+		return stmt;
+	if (stmt_has_label(stmt->while_loop.body))
+		return stmt;
+
+	struct jaf_block_item *r = null_statement(stmt);
+	jaf_free_block_item(stmt);
+	return r;
+}
+
+static struct jaf_block_item *optimize_for(struct jaf_block_item *stmt)
+{
+	stmt->for_loop.body = optimize_stmt(stmt->for_loop.body);
+	if (!stmt->for_loop.test || stmt->for_loop.test->type != JAF_EXP_INT
+			|| stmt->for_loop.test->i)
+		return stmt;
+	if (stmt_has_label(stmt->for_loop.body))
+		return stmt;
+
+	// loop body is never executed, but the initializer still is
+	struct jaf_block_item *r;
+	if (stmt->for_loop.init && stmt->for_loop.init->nr_items) {
+		r = jaf_compound_statement(stmt->for_loop.init);
+		r->line = stmt->line;
+		r->file = stmt->file;
+		r->is_scope = true;
+		stmt->for_loop.init = NULL;
+	} else {
+		r = null_statement(stmt);
+	}
+	jaf_free_block_item(stmt);
+	return r;
+}
+
+static struct jaf_block_item *optimize_stmt(struct jaf_block_item *stmt)
+{
+	if (!stmt)
+		return NULL;
+
+	switch (stmt->kind) {
+	case JAF_STMT_LABELED:
+		stmt->label.stmt = optimize_stmt(stmt->label.stmt);
+		break;
+	case JAF_STMT_COMPOUND:
+		optimize_block(stmt->block);
+		break;
+	case JAF_STMT_IF:
+		return optimize_if(stmt);
+	case JAF_STMT_SWITCH:
+		optimize_block(stmt->swi.body);
+		break;
+	case JAF_STMT_WHILE:
+		return optimize_while(stmt);
+	case JAF_STMT_DO_WHILE:
+		stmt->while_loop.body = optimize_stmt(stmt->while_loop.body);
+		break;
+	case JAF_STMT_FOR:
+		return optimize_for(stmt);
+	case JAF_STMT_CASE:
+	case JAF_STMT_DEFAULT:
+		stmt->swi_case.stmt = optimize_stmt(stmt->swi_case.stmt);
+		break;
+	default:
+		break;
+	}
+	return stmt;
+}
+
+void jaf_optimize(struct ain *ain, struct jaf_block *block)
+{
+	for (size_t i = 0; i < block->nr_items; i++) {
+		struct jaf_block_item *item = block->items[i];
+		if (item->kind == JAF_DECL_FUN && item->fun.body) {
+			optimize_block(item->fun.body);
+		} else if (item->kind == JAF_DECL_STRUCT) {
+			jaf_optimize(ain, item->struc.methods);
+		}
+	}
+}
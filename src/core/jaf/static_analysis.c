@@ -34,12 +34,20 @@ static void jaf_analyze_stmt_pre(struct jaf_block_item *stmt, struct jaf_visitor
 	}
 }
 
+static bool is_constant_decl(struct jaf_block_item *item)
+{
+	return item->kind == JAF_DECL_VAR && (item->var.type->qualifiers & JAF_QUAL_CONST);
+}
+
 static void jaf_analyze_stmt_post(struct jaf_block_item *stmt, struct jaf_visitor *visitor)
 {
 	jaf_type_check_statement(visitor->env, stmt);
 
 	switch (stmt->kind) {
 	case JAF_DECL_VAR:
+		// global constants were already analyzed by jaf_analyze_constants
+		if (!visitor->env->parent && is_constant_decl(stmt))
+			break;
 		jaf_type_check_vardecl(visitor->env, stmt);
 		break;
 	case JAF_DECL_STRUCT:
@@ -180,16 +188,61 @@ static void jaf_check_builtin_hll(struct ain *ain)
 	}
 }
 
+static void jaf_analyze_constant(struct jaf_block_item *stmt, struct jaf_visitor *visitor)
+{
+	jaf_type_check_vardecl(visitor->env, stmt);
+}
+
+/*
+ * Analyze global constant declarations ahead of everything else, so that
+ * constants can be referenced from any source file regardless of the order
+ * in which the files are compiled.
+ */
+static void jaf_analyze_constants(struct ain *ain, struct jaf_block *block, struct jaf_env *env)
+{
+	vector_t(struct jaf_block_item*) constants = {0};
+	for (size_t i = 0; i < block->nr_items; i++) {
+		struct jaf_block_item *item = block->items[i];
+		if (is_constant_decl(item)) {
+			vector_push(struct jaf_block_item*, constants, item);
+		} else if (item->kind == JAF_DECL_STRUCT && item->struc.members) {
+			// constants declared in a struct body share the top-level scope
+			for (size_t j = 0; j < item->struc.members->nr_items; j++) {
+				if (is_constant_decl(item->struc.members->items[j]))
+					vector_push(struct jaf_block_item*, constants,
+							item->struc.members->items[j]);
+			}
+		}
+	}
+
+	struct jaf_block constants_block = {
+		.nr_items = vector_length(constants),
+		.items = vector_data(constants),
+	};
+	struct jaf_visitor visitor = {
+		.visit_stmt_post = jaf_analyze_constant,
+		.visit_expr_post = jaf_analyze_expr,
+		.env = env,
+	};
+	jaf_accept_block(ain, &constants_block, &visitor);
+	vector_destroy(constants);
+}
+
 struct jaf_block *jaf_static_analyze(struct ain *ain, struct jaf_block *block)
 {
 	jaf_check_builtin_hll(ain);
 
+	struct jaf_env env = { .ain = ain };
+	jaf_analyze_constants(ain, block, &env);
+
 	struct jaf_visitor visitor = {
 		.visit_stmt_pre = jaf_analyze_stmt_pre,
 		.visit_stmt_post = jaf_analyze_stmt_post,
 		.visit_expr_post = jaf_analyze_expr,
+		.env = &env,
 	};
 
 	jaf_accept_block(ain, block, &visitor);
+	vector_destroy(env.locals);
 	return block;
 }
@@ -329,13 +329,24 @@ static void _jaf_accept_block(struct jaf_block *block, struct jaf_visitor *visit
 	}
 }
 
+/*
+ * Visit every statement/expression in a block. If visitor->env is already set,
+ * it is used as the top-level scope (and is left intact afterwards);
+ * otherwise a temporary top-level scope is created.
+ */
 void jaf_accept_block(struct ain *ain, struct jaf_block *block, struct jaf_visitor *visitor)
 {
 	if (!block)
 		return;
 
+	if (visitor->env) {
+		_jaf_accept_block(block, visitor);
+		return;
+	}
+
 	struct jaf_env env = { .ain = ain };
 	visitor->env = &env;
 	_jaf_accept_block(block, visitor);
+	visitor->env = NULL;
 	vector_destroy(env.locals);
 }
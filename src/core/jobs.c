@@ -0,0 +1,426 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+#include "system4.h"
+#include "system4/string.h"
+#include "system4/vector.h"
+#include "alice.h"
+#include "alice/jobs.h"
+#include "alice/profile.h"
+
+/*
+ * A job's log is a sequence of text segments, interleaved with the logs of
+ * any jobs it spawns. Logs form a tree which is written out in order as far
+ * as possible whenever it changes.
+ */
+struct log_segment {
+	struct string *text;
+	struct job_log *child;
+};
+
+struct job_log {
+	vector_t(struct log_segment) segments;
+	size_t flushed;      // number of segments completely written
+	size_t text_flushed; // number of bytes written from the current segment
+	bool done;
+	struct job_log *parent;
+};
+
+struct job {
+	void (*fn)(void*);
+	void *data;
+	struct job_group *group;
+	struct job_log *log;
+	unsigned nr_deps;
+	vector_t(struct job*) dependents;
+	size_t profile_parent;
+};
+
+struct job_group {
+	vector_t(struct job*) jobs;
+	unsigned nr_pending;
+	struct job_log *root;
+};
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static vector_t(struct job*) queue;
+static size_t queue_head;
+static vector_t(pthread_t) workers;
+static bool shutting_down;
+static bool cancelled;
+static bool active;
+static void (*saved_error_handler)(const char *msg);
+
+static _Thread_local struct job_log *current_log;
+
+unsigned jobs_nr_cpus(void)
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors;
+#else
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return n > 0 ? n : 1;
+#endif
+}
+
+static struct job_log *log_new(struct job_log *parent)
+{
+	struct job_log *log = xcalloc(1, sizeof(struct job_log));
+	log->parent = parent;
+	if (parent) {
+		struct log_segment *seg = vector_pushp(struct log_segment, parent->segments);
+		seg->text = NULL;
+		seg->child = log;
+	}
+	return log;
+}
+
+static void log_free(struct job_log *log)
+{
+	struct log_segment *seg;
+	vector_foreach_p(seg, log->segments) {
+		if (seg->text)
+			free_string(seg->text);
+		if (seg->child)
+			log_free(seg->child);
+	}
+	vector_destroy(log->segments);
+	free(log);
+}
+
+/*
+ * Write as much of a log as possible. Returns true if the log was
+ * completely written.
+ */
+static bool log_flush(struct job_log *log)
+{
+	while (log->flushed < vector_length(log->segments)) {
+		struct log_segment *seg = &vector_A(log->segments, log->flushed);
+		if (seg->child) {
+			if (!log_flush(seg->child))
+				return false;
+			log_free(seg->child);
+			seg->child = NULL;
+			log->flushed++;
+			continue;
+		}
+		if (log->text_flushed < seg->text->size) {
+			sys_message("%s", seg->text->text + log->text_flushed);
+			log->text_flushed = seg->text->size;
+		}
+		// text may still be appended to the last segment
+		if (!log->done && log->flushed + 1 == vector_length(log->segments))
+			return false;
+		free_string(seg->text);
+		seg->text = NULL;
+		log->flushed++;
+		log->text_flushed = 0;
+	}
+	return log->done;
+}
+
+static void log_flush_root(struct job_log *log)
+{
+	while (log->parent)
+		log = log->parent;
+	log_flush(log);
+}
+
+static void log_append(struct job_log *log, const char *text, size_t len)
+{
+	// a segment which has already been flushed (e.g. the log of a finished
+	// child job) can't be appended to
+	size_t n = vector_length(log->segments);
+	if (n > log->flushed && !vector_A(log->segments, n-1).child) {
+		string_append_cstr(&vector_A(log->segments, n-1).text, text, len);
+	} else {
+		struct log_segment *seg = vector_pushp(struct log_segment, log->segments);
+		seg->text = make_string(text, len);
+		seg->child = NULL;
+	}
+	log_flush_root(log);
+}
+
+/*
+ * Replaces NOTICE (see alice.h). Messages written from a job are appended to
+ * the job's log; otherwise they are written immediately.
+ */
+void alice_notice(const char *fmt, ...)
+{
+	va_list ap;
+	va_start(ap, fmt);
+	int len = vsnprintf(NULL, 0, fmt, ap);
+	va_end(ap);
+
+	char *text = xmalloc(len + 1);
+	va_start(ap, fmt);
+	vsnprintf(text, len + 1, fmt, ap);
+	va_end(ap);
+
+	if (current_log) {
+		pthread_mutex_lock(&mutex);
+		log_append(current_log, text, len);
+		pthread_mutex_unlock(&mutex);
+	} else {
+		sys_message("%s", text);
+	}
+	free(text);
+}
+
+/*
+ * Stop starting new jobs and write out the log up to (and including) the
+ * current job. Called before exiting on a fatal error.
+ */
+void jobs_cancel(void)
+{
+	pthread_mutex_lock(&mutex);
+	cancelled = true;
+	if (current_log) {
+		log_flush_root(current_log);
+		// write whatever the failing job logged, even if it is out of order
+		for (size_t i = current_log->flushed; i < vector_length(current_log->segments); i++) {
+			struct log_segment *seg = &vector_A(current_log->segments, i);
+			if (seg->text) {
+				size_t off = i == current_log->flushed ? current_log->text_flushed : 0;
+				sys_message("%s", seg->text->text + off);
+			}
+		}
+		// don't write it again if another job fails
+		current_log->flushed = vector_length(current_log->segments);
+		current_log->text_flushed = 0;
+	}
+	pthread_mutex_unlock(&mutex);
+	fflush(stdout);
+}
+
+/*
+ * Called (via sys_error) when a job fails. Write out the log up to the
+ * failing job and exit without starting any further jobs.
+ */
+static void jobs_error_handler(const char *msg)
+{
+	jobs_cancel();
+	fputs(msg, stderr);
+	sys_exit(1);
+}
+
+static void queue_push(struct job *job)
+{
+	vector_push(struct job*, queue, job);
+	pthread_cond_broadcast(&cond);
+}
+
+/*
+ * Take the first queued job in a group (or in any group, if `group` is NULL).
+ */
+static struct job *queue_pop(struct job_group *group)
+{
+	if (cancelled)
+		return NULL;
+	for (size_t i = queue_head; i < vector_length(queue); i++) {
+		struct job *job = vector_A(queue, i);
+		if (group && job->group != group)
+			continue;
+		// move the jobs before it up one slot, keeping them in order
+		memmove(queue.a + queue_head + 1, queue.a + queue_head,
+				(i - queue_head) * sizeof(struct job*));
+		if (++queue_head == vector_length(queue)) {
+			queue_head = 0;
+			queue.n = 0;
+		}
+		return job;
+	}
+	return NULL;
+}
+
+/*
+ * Run a job. Must be called with the mutex held; the mutex is released
+ * while the job is running.
+ */
+static void run_job(struct job *job)
+{
+	pthread_mutex_unlock(&mutex);
+
+	struct job_log *saved_log = current_log;
+	profile_push_parent(job->profile_parent);
+	current_log = job->log;
+	job->fn(job->data);
+	current_log = saved_log;
+	profile_pop_parent();
+
+	pthread_mutex_lock(&mutex);
+	job->log->done = true;
+	log_flush_root(job->log);
+	struct job *dep;
+	vector_foreach(dep, job->dependents) {
+		if (--dep->nr_deps == 0)
+			queue_push(dep);
+	}
+	job->group->nr_pending--;
+	pthread_cond_broadcast(&cond);
+}
+
+static void *worker_main(possibly_unused void *data)
+{
+	pthread_mutex_lock(&mutex);
+	while (!shutting_down) {
+		struct job *job = queue_pop(NULL);
+		if (job)
+			run_job(job);
+		else
+			pthread_cond_wait(&cond, &mutex);
+	}
+	pthread_mutex_unlock(&mutex);
+	return NULL;
+}
+
+/*
+ * Start the thread pool. The calling thread counts towards the thread
+ * budget, since it executes jobs while waiting on a group.
+ */
+void jobs_init(unsigned nr_threads)
+{
+	if (!nr_threads)
+		nr_threads = jobs_nr_cpus();
+
+	saved_error_handler = sys_error_handler;
+	sys_error_handler = jobs_error_handler;
+	active = true;
+
+	for (unsigned i = 1; i < nr_threads; i++) {
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, worker_main, NULL))
+			ALICE_ERROR("pthread_create failed");
+		vector_push(pthread_t, workers, thread);
+	}
+}
+
+void jobs_fini(void)
+{
+	pthread_mutex_lock(&mutex);
+	shutting_down = true;
+	pthread_cond_broadcast(&cond);
+	pthread_mutex_unlock(&mutex);
+
+	pthread_t thread;
+	vector_foreach(thread, workers) {
+		pthread_join(thread, NULL);
+	}
+	vector_destroy(workers);
+	vector_init(workers);
+	vector_destroy(queue);
+	vector_init(queue);
+	queue_head = 0;
+	shutting_down = false;
+	cancelled = false;
+	active = false;
+	sys_error_handler = saved_error_handler;
+}
+
+/*
+ * True between jobs_init and jobs_fini.
+ */
+bool jobs_active(void)
+{
+	return active;
+}
+
+struct job_group *job_group_new(void)
+{
+	struct job_group *group = xcalloc(1, sizeof(struct job_group));
+	// a group created outside of a job gets its own log
+	if (!current_log)
+		group->root = log_new(NULL);
+	return group;
+}
+
+/*
+ * Add a job to a group. The job's log output is placed after any output
+ * already written by the current job.
+ */
+struct job *job_group_add(struct job_group *group, void (*fn)(void*), void *data)
+{
+	struct job *job = xcalloc(1, sizeof(struct job));
+	job->fn = fn;
+	job->data = data;
+	job->group = group;
+	job->profile_parent = profile_parent();
+	vector_push(struct job*, group->jobs, job);
+
+	pthread_mutex_lock(&mutex);
+	job->log = log_new(current_log ? current_log : group->root);
+	pthread_mutex_unlock(&mutex);
+	return job;
+}
+
+/*
+ * Don't start a job until another job in the same group has finished.
+ */
+void job_depends(struct job *job, struct job *dep)
+{
+	if (job->group != dep->group)
+		ALICE_ERROR("Job dependency across groups");
+	job->nr_deps++;
+	vector_push(struct job*, dep->dependents, job);
+}
+
+/*
+ * Run all jobs in a group and wait for them to finish. The group is freed.
+ */
+void job_group_run(struct job_group *group)
+{
+	pthread_mutex_lock(&mutex);
+	group->nr_pending = vector_length(group->jobs);
+	struct job *job;
+	vector_foreach(job, group->jobs) {
+		if (!job->nr_deps)
+			queue_push(job);
+	}
+	// only this group's jobs are run here, so that the caller isn't held up
+	// by an unrelated (possibly long) job
+	while (group->nr_pending) {
+		if ((job = queue_pop(group)))
+			run_job(job);
+		else
+			pthread_cond_wait(&cond, &mutex);
+	}
+	if (group->root) {
+		group->root->done = true;
+		log_flush(group->root);
+		log_free(group->root);
+	}
+	pthread_mutex_unlock(&mutex);
+
+	vector_foreach(job, group->jobs) {
+		vector_destroy(job->dependents);
+		free(job);
+	}
+	vector_destroy(group->jobs);
+	free(group);
+}
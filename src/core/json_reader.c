@@ -0,0 +1,562 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+
+#include <limits.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "system4.h"
+#include "system4/vector.h"
+#include "khash.h"
+#include "alice.h"
+#include "alice/json.h"
+
+KHASH_MAP_INIT_STR(json_keys, int);
+
+static const char *token_names[] = {
+	[JSON_END] = "end of input",
+	[JSON_BEGIN_OBJECT] = "an object",
+	[JSON_END_OBJECT] = "'}'",
+	[JSON_BEGIN_ARRAY] = "an array",
+	[JSON_END_ARRAY] = "']'",
+	[JSON_KEY] = "a key",
+	[JSON_STRING] = "a string",
+	[JSON_NUMBER] = "a number",
+	[JSON_TRUE] = "a boolean",
+	[JSON_FALSE] = "a boolean",
+	[JSON_NULL] = "null",
+};
+
+void json_reader_init(struct json_reader *r, const char *buf, size_t len, const char *name,
+		const char * const *key_names, int nr_keys)
+{
+	*r = (struct json_reader) {
+		.name = name,
+		.buf = buf,
+		.p = buf,
+		.end = buf + len,
+		.token = JSON_END,
+		.max_depth = 16,
+		.str_cap = 256,
+		.key = -1,
+		.key_names = key_names,
+	};
+	r->stack = xmalloc(r->max_depth);
+	r->str = xmalloc(r->str_cap);
+	r->str[0] = '\0';
+
+	// skip UTF-8 BOM
+	if (len >= 3 && !memcmp(buf, "\xef\xbb\xbf", 3))
+		r->p += 3;
+
+	if (!nr_keys)
+		return;
+	r->keys = kh_init(json_keys);
+	for (int i = 0; i < nr_keys; i++) {
+		int ret;
+		khiter_t k = kh_put(json_keys, r->keys, key_names[i], &ret);
+		kh_value(r->keys, k) = i;
+	}
+}
+
+void json_reader_fini(struct json_reader *r)
+{
+	if (r->keys)
+		kh_destroy(json_keys, r->keys);
+	free(r->stack);
+	free(r->str);
+	r->keys = NULL;
+	r->stack = NULL;
+	r->str = NULL;
+}
+
+_Noreturn void json_error(struct json_reader *r, const char *fmt, ...)
+{
+	int line = 1;
+	for (const char *p = r->buf; p < r->p && p < r->end; p++) {
+		if (*p == '\n')
+			line++;
+	}
+
+	char msg[512];
+	va_list ap;
+	va_start(ap, fmt);
+	vsnprintf(msg, sizeof(msg), fmt, ap);
+	va_end(ap);
+	ALICE_ERROR("%s:%d: %s", r->name, line, msg);
+}
+
+static _Noreturn void type_error(struct json_reader *r, const char *what)
+{
+	if (r->key >= 0)
+		json_error(r, "Expected %s for '%s'", what, r->key_names[r->key]);
+	json_error(r, "Expected %s", what);
+}
+
+static void skip_whitespace(struct json_reader *r)
+{
+	while (r->p < r->end) {
+		switch (*r->p) {
+		case ' ':
+		case '\t':
+		case '\n':
+		case '\r':
+			r->p++;
+			break;
+		default:
+			return;
+		}
+	}
+}
+
+static char peek_char(struct json_reader *r)
+{
+	return r->p < r->end ? *r->p : '\0';
+}
+
+static void push(struct json_reader *r, char c)
+{
+	if (r->depth == r->max_depth) {
+		r->max_depth *= 2;
+		r->stack = xrealloc(r->stack, r->max_depth);
+	}
+	r->stack[r->depth++] = c;
+}
+
+static void str_reserve(struct json_reader *r, size_t size)
+{
+	if (r->str_len + size + 1 <= r->str_cap)
+		return;
+	while (r->str_len + size + 1 > r->str_cap)
+		r->str_cap *= 2;
+	r->str = xrealloc(r->str, r->str_cap);
+}
+
+static void str_append(struct json_reader *r, const char *data, size_t size)
+{
+	str_reserve(r, size);
+	memcpy(r->str + r->str_len, data, size);
+	r->str_len += size;
+}
+
+static unsigned parse_hex4(struct json_reader *r, const char *p)
+{
+	if (r->end - p < 4)
+		json_error(r, "Unterminated string");
+	unsigned v = 0;
+	for (int i = 0; i < 4; i++) {
+		char c = p[i];
+		v <<= 4;
+		if (c >= '0' && c <= '9')
+			v |= c - '0';
+		else if (c >= 'a' && c <= 'f')
+			v |= c - 'a' + 10;
+		else if (c >= 'A' && c <= 'F')
+			v |= c - 'A' + 10;
+		else
+			json_error(r, "Invalid unicode escape");
+	}
+	return v;
+}
+
+static const char *parse_unicode_escape(struct json_reader *r, const char *p)
+{
+	// p points at the 'u'
+	unsigned c = parse_hex4(r, p + 1);
+	p += 5;
+	if (c >= 0xdc00 && c <= 0xdfff)
+		json_error(r, "Invalid unicode escape");
+	if (c >= 0xd800 && c <= 0xdbff) {
+		if (r->end - p < 6 || p[0] != '\\' || p[1] != 'u')
+			json_error(r, "Invalid unicode surrogate pair");
+		unsigned lo = parse_hex4(r, p + 2);
+		if (lo < 0xdc00 || lo > 0xdfff)
+			json_error(r, "Invalid unicode surrogate pair");
+		c = 0x10000 + (((c & 0x3ff) << 10) | (lo & 0x3ff));
+		p += 6;
+	}
+
+	char utf8[4];
+	int n;
+	if (c < 0x80) {
+		utf8[0] = c;
+		n = 1;
+	} else if (c < 0x800) {
+		utf8[0] = 0xc0 | (c >> 6);
+		utf8[1] = 0x80 | (c & 0x3f);
+		n = 2;
+	} else if (c < 0x10000) {
+		utf8[0] = 0xe0 | (c >> 12);
+		utf8[1] = 0x80 | ((c >> 6) & 0x3f);
+		utf8[2] = 0x80 | (c & 0x3f);
+		n = 3;
+	} else {
+		utf8[0] = 0xf0 | (c >> 18);
+		utf8[1] = 0x80 | ((c >> 12) & 0x3f);
+		utf8[2] = 0x80 | ((c >> 6) & 0x3f);
+		utf8[3] = 0x80 | (c & 0x3f);
+		n = 4;
+	}
+	str_append(r, utf8, n);
+	return p;
+}
+
+/*
+ * Decode the string at r->p (which points at the opening quote) into r->str.
+ */
+static void parse_string(struct json_reader *r)
+{
+	const char *p = r->p + 1;
+	r->str_len = 0;
+	while (true) {
+		// copy runs of unescaped characters in bulk
+		const char *run = p;
+		while (p < r->end && *p != '"' && *p != '\\')
+			p++;
+		str_append(r, run, p - run);
+		if (p >= r->end)
+			json_error(r, "Unterminated string");
+		if (*p == '"')
+			break;
+		if (r->end - p < 2)
+			json_error(r, "Unterminated string");
+		char c;
+		switch (p[1]) {
+		case '"':  c = '"'; break;
+		case '\\': c = '\\'; break;
+		case '/':  c = '/'; break;
+		case 'b':  c = '\b'; break;
+		case 'f':  c = '\f'; break;
+		case 'n':  c = '\n'; break;
+		case 'r':  c = '\r'; break;
+		case 't':  c = '\t'; break;
+		case 'u':
+			p = parse_unicode_escape(r, p + 1);
+			continue;
+		default:
+			json_error(r, "Invalid escape sequence '\\%c'", p[1]);
+		}
+		str_append(r, &c, 1);
+		p += 2;
+	}
+	r->str[r->str_len] = '\0';
+	r->p = p + 1;
+}
+
+static void parse_number(struct json_reader *r)
+{
+	char buf[64];
+	size_t len = 0;
+	const char *p = r->p;
+	while (p < r->end && len < sizeof(buf) - 1 && *p && strchr("0123456789+-.eE", *p))
+		buf[len++] = *p++;
+	buf[len] = '\0';
+
+	char *end;
+	r->number = strtod(buf, &end);
+	if (end == buf)
+		json_error(r, "Invalid number");
+	r->p += end - buf;
+}
+
+static void parse_literal(struct json_reader *r, const char *lit)
+{
+	size_t len = strlen(lit);
+	if ((size_t)(r->end - r->p) < len || memcmp(r->p, lit, len))
+		json_error(r, "Unexpected character '%c'", *r->p);
+	r->p += len;
+}
+
+static enum json_token end_container(struct json_reader *r, enum json_token token)
+{
+	r->p++;
+	r->depth--;
+	r->need_comma = true;
+	return r->token = token;
+}
+
+/*
+ * Read the next token. Inside an object, keys and values are returned as
+ * separate tokens (JSON_KEY followed by the first token of the value).
+ */
+enum json_token json_next(struct json_reader *r)
+{
+	skip_whitespace(r);
+	char top = r->depth ? r->stack[r->depth-1] : '\0';
+	if (top == '{' && r->token != JSON_KEY) {
+		if (peek_char(r) == '}')
+			return end_container(r, JSON_END_OBJECT);
+		if (r->need_comma) {
+			if (peek_char(r) != ',')
+				json_error(r, "Expected ',' or '}'");
+			r->p++;
+			skip_whitespace(r);
+		}
+		if (peek_char(r) != '"')
+			json_error(r, "Expected a key");
+		parse_string(r);
+		skip_whitespace(r);
+		if (peek_char(r) != ':')
+			json_error(r, "Expected ':'");
+		r->p++;
+		r->need_comma = false;
+		r->key = -1;
+		if (r->keys) {
+			khiter_t k = kh_get(json_keys, r->keys, r->str);
+			if (k != kh_end(r->keys))
+				r->key = kh_value(r->keys, k);
+		}
+		return r->token = JSON_KEY;
+	}
+	if (top == '[') {
+		if (peek_char(r) == ']')
+			return end_container(r, JSON_END_ARRAY);
+		if (r->need_comma) {
+			if (peek_char(r) != ',')
+				json_error(r, "Expected ',' or ']'");
+			r->p++;
+			skip_whitespace(r);
+		}
+	} else if (!top && r->need_comma) {
+		if (r->p < r->end)
+			json_error(r, "Unexpected data after JSON value");
+		return r->token = JSON_END;
+	}
+
+	if (r->p >= r->end)
+		json_error(r, "Unexpected end of input");
+
+	r->need_comma = true;
+	switch (*r->p) {
+	case '{':
+		r->p++;
+		push(r, '{');
+		r->need_comma = false;
+		return r->token = JSON_BEGIN_OBJECT;
+	case '[':
+		r->p++;
+		push(r, '[');
+		r->need_comma = false;
+		return r->token = JSON_BEGIN_ARRAY;
+	case '"':
+		parse_string(r);
+		return r->token = JSON_STRING;
+	case 't':
+		parse_literal(r, "true");
+		return r->token = JSON_TRUE;
+	case 'f':
+		parse_literal(r, "false");
+		return r->token = JSON_FALSE;
+	case 'n':
+		parse_literal(r, "null");
+		return r->token = JSON_NULL;
+	case '-':
+	case '0': case '1': case '2': case '3': case '4':
+	case '5': case '6': case '7': case '8': case '9':
+		parse_number(r);
+		return r->token = JSON_NUMBER;
+	}
+	json_error(r, "Unexpected character '%c'", *r->p);
+}
+
+/*
+ * Read the next key of the current object. Returns false at the end of the
+ * object.
+ */
+bool json_next_key(struct json_reader *r, int *key)
+{
+	if (json_next(r) == JSON_END_OBJECT)
+		return false;
+	*key = r->key;
+	return true;
+}
+
+void json_expect(struct json_reader *r, enum json_token token)
+{
+	if (json_next(r) != token)
+		type_error(r, token_names[token]);
+}
+
+/*
+ * Scan to the end of the innermost open object/array without decoding it,
+ * counting its elements. Returns a pointer past the closing bracket.
+ */
+static const char *scan_container(struct json_reader *r, int *count)
+{
+	int depth = 0;
+	int n = 0;
+	bool empty = true;
+	for (const char *p = r->p; p < r->end; p++) {
+		switch (*p) {
+		case ' ':
+		case '\t':
+		case '\n':
+		case '\r':
+			break;
+		case '"':
+			for (p++; p < r->end && *p != '"'; p++) {
+				if (*p == '\\')
+					p++;
+			}
+			empty = false;
+			break;
+		case '{':
+		case '[':
+			empty = false;
+			depth++;
+			break;
+		case '}':
+		case ']':
+			if (!depth--) {
+				*count = empty ? 0 : n + 1;
+				return p + 1;
+			}
+			break;
+		case ',':
+			if (!depth)
+				n++;
+			break;
+		default:
+			empty = false;
+			break;
+		}
+	}
+	json_error(r, "Unexpected end of input");
+}
+
+/*
+ * Skip the rest of the current value: after a key, its value; after the
+ * start of an object or array, everything up to the matching end.
+ */
+void json_skip(struct json_reader *r)
+{
+	if (r->token == JSON_KEY)
+		json_next(r);
+	if (r->token != JSON_BEGIN_OBJECT && r->token != JSON_BEGIN_ARRAY)
+		return;
+	int count;
+	r->p = scan_container(r, &count);
+	r->token = r->stack[--r->depth] == '{' ? JSON_END_OBJECT : JSON_END_ARRAY;
+	r->need_comma = true;
+}
+
+void json_mark(struct json_reader *r, struct json_mark *mark)
+{
+	*mark = (struct json_mark) {
+		.p = r->p,
+		.token = r->token,
+		.need_comma = r->need_comma,
+		.depth = r->depth,
+		.key = r->key,
+	};
+}
+
+/*
+ * Return to a position saved with json_mark. Used to look ahead in an object
+ * for a key that the reading of its other members depends on.
+ */
+void json_rewind(struct json_reader *r, const struct json_mark *mark)
+{
+	r->p = mark->p;
+	r->token = mark->token;
+	r->need_comma = mark->need_comma;
+	r->depth = mark->depth;
+	r->key = mark->key;
+}
+
+/*
+ * Count the elements of the array that was just begun, without consuming
+ * them.
+ */
+int json_count_elements(struct json_reader *r)
+{
+	if (r->token != JSON_BEGIN_ARRAY)
+		json_error(r, "Expected an array");
+	int count;
+	scan_container(r, &count);
+	return count;
+}
+
+/*
+ * Fail unless the given key is in a mask of keys seen (see JSON_KEY_BIT).
+ */
+void json_require(struct json_reader *r, uint64_t seen, int key)
+{
+	if (key >= JSON_MAX_TRACKED_KEYS)
+		ALICE_ERROR("json_require: key '%s' is not tracked", r->key_names[key]);
+	if (!(seen & JSON_KEY_BIT(key)))
+		json_error(r, "Missing '%s'", r->key_names[key]);
+}
+
+/*
+ * The current number token, converted to int the same way as cJSON.
+ */
+int json_int_value(struct json_reader *r)
+{
+	if (r->token != JSON_NUMBER)
+		type_error(r, "a number");
+	if (r->number >= INT_MAX)
+		return INT_MAX;
+	if (r->number <= (double)INT_MIN)
+		return INT_MIN;
+	return (int)r->number;
+}
+
+int json_read_int(struct json_reader *r)
+{
+	json_next(r);
+	return json_int_value(r);
+}
+
+double json_read_number(struct json_reader *r)
+{
+	if (json_next(r) != JSON_NUMBER)
+		type_error(r, "a number");
+	return r->number;
+}
+
+bool json_read_bool(struct json_reader *r)
+{
+	switch (json_next(r)) {
+	case JSON_TRUE:
+		return true;
+	case JSON_FALSE:
+		return false;
+	default:
+		type_error(r, "a boolean");
+	}
+}
+
+char *json_read_string(struct json_reader *r)
+{
+	if (json_next(r) != JSON_STRING)
+		type_error(r, "a string");
+	return xstrdup(r->str);
+}
+
+int32_t *json_read_int_array(struct json_reader *r, int *n)
+{
+	vector_t(int32_t) a = vector_initializer;
+	vector_set_capacity(int32_t, a, 8);
+	json_expect(r, JSON_BEGIN_ARRAY);
+	while (json_next(r) != JSON_END_ARRAY) {
+		vector_push(int32_t, a, json_int_value(r));
+	}
+	*n = vector_length(a);
+	return vector_data(a);
+}
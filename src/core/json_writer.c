@@ -0,0 +1,267 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "system4.h"
+#include "alice.h"
+#include "alice/json.h"
+#include "alice/port.h"
+
+void json_writer_init(struct json_writer *w, struct port *port, bool pretty)
+{
+	w->port = port;
+	w->pretty = pretty;
+	w->depth = 0;
+	w->max_depth = 16;
+	w->levels = xcalloc(w->max_depth, sizeof(struct json_level));
+	w->len = 0;
+}
+
+void json_writer_flush(struct json_writer *w)
+{
+	if (w->len && !port_write_bytes(w->port, (uint8_t*)w->buf, w->len))
+		ALICE_ERROR("Error writing JSON: %s", strerror(errno));
+	w->len = 0;
+}
+
+void json_writer_fini(struct json_writer *w)
+{
+	if (w->depth)
+		ALICE_ERROR("Unterminated JSON object or array");
+	json_writer_flush(w);
+	free(w->levels);
+	w->levels = NULL;
+}
+
+void json_writer_discard(struct json_writer *w)
+{
+	free(w->levels);
+	w->levels = NULL;
+	w->depth = 0;
+	w->len = 0;
+}
+
+static void write_bytes(struct json_writer *w, const char *data, size_t size)
+{
+	if (w->len + size > sizeof(w->buf)) {
+		json_writer_flush(w);
+		if (size > sizeof(w->buf)) {
+			if (!port_write_bytes(w->port, (const uint8_t*)data, size))
+				ALICE_ERROR("Error writing JSON: %s", strerror(errno));
+			return;
+		}
+	}
+	memcpy(w->buf + w->len, data, size);
+	w->len += size;
+}
+
+static void write_char(struct json_writer *w, char c)
+{
+	if (w->len == sizeof(w->buf))
+		json_writer_flush(w);
+	w->buf[w->len++] = c;
+}
+
+static void write_indent(struct json_writer *w, unsigned depth)
+{
+	for (unsigned i = 0; i < depth; i++) {
+		write_char(w, '\t');
+	}
+}
+
+/*
+ * Write the separator before a value. Values in objects are separated when
+ * their key is written.
+ */
+static void begin_value(struct json_writer *w)
+{
+	if (!w->depth)
+		return;
+	struct json_level *level = &w->levels[w->depth - 1];
+	if (level->object)
+		return;
+	if (!level->empty) {
+		if (w->pretty)
+			write_bytes(w, ", ", 2);
+		else
+			write_char(w, ',');
+	}
+	level->empty = false;
+}
+
+static void push_level(struct json_writer *w, bool object)
+{
+	if (w->depth == w->max_depth) {
+		w->max_depth *= 2;
+		w->levels = xrealloc(w->levels, w->max_depth * sizeof(struct json_level));
+	}
+	w->levels[w->depth++] = (struct json_level) { .object = object, .empty = true };
+}
+
+static struct json_level *pop_level(struct json_writer *w, bool object)
+{
+	if (!w->depth || w->levels[w->depth - 1].object != object)
+		ALICE_ERROR("Mismatched JSON %s end", object ? "object" : "array");
+	return &w->levels[--w->depth];
+}
+
+void json_begin_object(struct json_writer *w)
+{
+	begin_value(w);
+	write_char(w, '{');
+	if (w->pretty)
+		write_char(w, '\n');
+	push_level(w, true);
+}
+
+void json_end_object(struct json_writer *w)
+{
+	struct json_level *level = pop_level(w, true);
+	if (w->pretty) {
+		if (!level->empty)
+			write_char(w, '\n');
+		write_indent(w, w->depth);
+	}
+	write_char(w, '}');
+}
+
+void json_begin_array(struct json_writer *w)
+{
+	begin_value(w);
+	write_char(w, '[');
+	push_level(w, false);
+}
+
+void json_end_array(struct json_writer *w)
+{
+	pop_level(w, false);
+	write_char(w, ']');
+}
+
+static void write_string(struct json_writer *w, const char *str)
+{
+	write_char(w, '"');
+	const unsigned char *p = (const unsigned char*)(str ? str : "");
+	while (*p) {
+		// copy runs of characters that don't need escaping in bulk
+		const unsigned char *run = p;
+		while (*p > 31 && *p != '"' && *p != '\\')
+			p++;
+		write_bytes(w, (const char*)run, p - run);
+		if (!*p)
+			break;
+
+		char esc[8];
+		switch (*p) {
+		case '\\': write_bytes(w, "\\\\", 2); break;
+		case '"':  write_bytes(w, "\\\"", 2); break;
+		case '\b': write_bytes(w, "\\b", 2); break;
+		case '\f': write_bytes(w, "\\f", 2); break;
+		case '\n': write_bytes(w, "\\n", 2); break;
+		case '\r': write_bytes(w, "\\r", 2); break;
+		case '\t': write_bytes(w, "\\t", 2); break;
+		default:
+			snprintf(esc, sizeof(esc), "\\u%04x", *p);
+			write_bytes(w, esc, 6);
+			break;
+		}
+		p++;
+	}
+	write_char(w, '"');
+}
+
+void json_key(struct json_writer *w, const char *key)
+{
+	if (!w->depth || !w->levels[w->depth - 1].object)
+		ALICE_ERROR("JSON key outside of object");
+	struct json_level *level = &w->levels[w->depth - 1];
+	if (!level->empty) {
+		write_char(w, ',');
+		if (w->pretty)
+			write_char(w, '\n');
+	}
+	level->empty = false;
+	if (w->pretty)
+		write_indent(w, w->depth);
+	write_string(w, key);
+	write_char(w, ':');
+	if (w->pretty)
+		write_char(w, '\t');
+}
+
+void json_string(struct json_writer *w, const char *str)
+{
+	begin_value(w);
+	write_string(w, str);
+}
+
+/*
+ * Numbers are formatted the same way as cJSON: with 15 significant digits
+ * if that round-trips, otherwise 17.
+ */
+void json_number(struct json_writer *w, double d)
+{
+	char buf[32];
+	int len;
+	double test;
+
+	begin_value(w);
+	if (d * 0 != 0) {
+		write_bytes(w, "null", 4);
+		return;
+	}
+	len = snprintf(buf, sizeof(buf), "%1.15g", d);
+	if (sscanf(buf, "%lg", &test) != 1 || test != d)
+		len = snprintf(buf, sizeof(buf), "%1.17g", d);
+	write_bytes(w, buf, len);
+}
+
+void json_int(struct json_writer *w, int64_t i)
+{
+	char buf[24];
+	begin_value(w);
+	int len = snprintf(buf, sizeof(buf), "%" PRId64, i);
+	write_bytes(w, buf, len);
+}
+
+void json_bool(struct json_writer *w, bool b)
+{
+	begin_value(w);
+	if (b)
+		write_bytes(w, "true", 4);
+	else
+		write_bytes(w, "false", 5);
+}
+
+void json_null(struct json_writer *w)
+{
+	begin_value(w);
+	write_bytes(w, "null", 4);
+}
+
+void json_int_array(struct json_writer *w, const int32_t *values, int count)
+{
+	json_begin_array(w);
+	for (int i = 0; i < count; i++) {
+		json_int(w, values[i]);
+	}
+	json_end_array(w);
+}
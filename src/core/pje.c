@@ -28,11 +28,14 @@
 #include "system4/ini.h"
 #include "system4/string.h"
 #include "system4/vector.h"
+#include "khash.h"
 #include "alice.h"
 #include "alice/ain.h"
 #include "alice/ar.h"
 #include "alice/ex.h"
 #include "alice/jaf.h"
+#include "alice/jobs.h"
+#include "alice/profile.h"
 #include "alice/project.h"
 
 struct pje_formation {
@@ -74,6 +77,7 @@ struct pje_config {
 	int pact_input_size;
 	int major_version;
 	int minor_version;
+	bool optimize;
 };
 
 struct inc_config {
@@ -242,6 +246,8 @@ static void pje_parse(const char *path, struct pje_config *config)
 			config->sound_name = pje_string(&ini[i]);
 		} else if (!strcmp(ini[i].name->text, "FlatName")) {
 			config->flat_name = pje_string(&ini[i]);
+		} else if (!strcmp(ini[i].name->text, "Optimize")) {
+			config->optimize = pje_integer(&ini[i]);
 		} else if (!strcmp(ini[i].name->text, "CodeVersion")) {
 			if (!parse_version(pje_string_ptr(&ini[i])->text, &config->major_version, &config->minor_version)) {
 				ALICE_ERROR("Invalid CodeVersion");
@@ -607,16 +613,21 @@ static void pje_build_ain(struct pje_config *config, struct build_job *job)
 
 	// apply text substitution, if ModText given
 	if (config->mod_text) {
+		profile_begin("ain.read_text");
 		struct string *mod_text = string_path_join(config->pje_dir, config->mod_text->text);
 		ain_read_text(mod_text->text, ain);
 		free_string(mod_text);
+		profile_end();
 	}
 
 	// build
-	jaf_build(ain, source_files, nr_source_files, header_files, nr_header_files);
+	profile_count("source_files", nr_source_files);
+	jaf_build(ain, source_files, nr_source_files, header_files, nr_header_files,
+			config->optimize ? JAF_OPTIMIZE : 0);
 
 	// build .jam files
 	// XXX: DEPRECATED
+	profile_begin("ain.jam");
 	for (unsigned i = 0; i < vector_length(config->mod_jam); i++) {
 		struct string *mod_jam = string_path_join(config->source_dir,
 				vector_A(config->mod_jam, i)->text);
@@ -653,9 +664,16 @@ static void pje_build_ain(struct pje_config *config, struct build_job *job)
 		free(strings);
 		free(tmp);
 	}
+	profile_count("files", vector_length(config->mod_jam) + vector_length(job->jam_source));
+	profile_end();
 
 	// write to disk
+	profile_begin("ain.write");
 	ain_write(output_file->text, ain);
+	profile_end();
+	profile_count("functions", ain->nr_functions);
+	profile_count("strings", ain->nr_strings);
+	profile_count("messages", ain->nr_messages);
 
 	free_string(output_file);
 	free(source_files);
@@ -679,6 +697,7 @@ static struct ex *read_input_ex(struct string *ex_input)
 		return NULL;
 
 	struct ex *ex;
+	profile_begin("ex.read_input");
 	if (is_ex_file(ex_input->text)) {
 		NOTICE("EX     (input) %s", ex_input->text);
 		if (!(ex = ex_read_file(ex_input->text)))
@@ -688,22 +707,49 @@ static struct ex *read_input_ex(struct string *ex_input)
 		if (!(ex = ex_parse_file(ex_input->text)))
 			ALICE_ERROR("Failed to parse .txtex file: '%s'", ex_input->text);
 	}
+	profile_count("blocks", ex->nr_blocks);
+	profile_end();
 	return ex;
 }
 
+struct parse_job {
+	struct string *path;
+	struct ex *ex;
+};
+
+static void parse_txtex(void *data)
+{
+	struct parse_job *job = data;
+	NOTICE("TXTEX  %s", job->path->text);
+	profile_begin("ex.parse %s", job->path->text);
+	job->ex = ex_parse_file(job->path->text);
+	profile_count("blocks", job->ex->nr_blocks);
+	profile_end();
+}
+
 static struct ex *read_source_ex(struct build_job *job)
 {
+	// parse .txtex files in parallel
+	unsigned nr_sources = vector_length(job->ex_source);
+	struct parse_job *jobs = xcalloc(nr_sources, sizeof(struct parse_job));
+	struct job_group *group = job_group_new();
+	for (unsigned i = 0; i < nr_sources; i++) {
+		jobs[i].path = vector_A(job->ex_source, i);
+		job_group_add(group, parse_txtex, &jobs[i]);
+	}
+	job_group_run(group);
+
+	// append in source order
 	struct ex *source_ex = NULL;
-	for (unsigned i = 0; i < vector_length(job->ex_source); i++) {
-		NOTICE("TXTEX  %s", vector_A(job->ex_source, i)->text);
-		struct ex *this_ex = ex_parse_file(vector_A(job->ex_source, i)->text);
+	for (unsigned i = 0; i < nr_sources; i++) {
 		if (!source_ex) {
-			source_ex = this_ex;
+			source_ex = jobs[i].ex;
 		} else {
-			ex_append(source_ex, this_ex);
-			ex_free(this_ex);
+			ex_append(source_ex, jobs[i].ex);
+			ex_free(jobs[i].ex);
 		}
 	}
+	free(jobs);
 	return source_ex;
 }
 
@@ -764,7 +810,10 @@ static void pje_build_ex(struct pje_config *config, struct build_job *job)
 	if (ex && config->ex_name) {
 		struct string *out = string_path_join(config->output_dir, config->ex_name->text);
 		NOTICE("EX     %s", out->text);
+		profile_begin("ex.write %s", out->text);
 		ex_write_file(out->text, ex);
+		profile_count("blocks", ex->nr_blocks);
+		profile_end();
 		free_string(out);
 	}
 
@@ -772,7 +821,10 @@ static void pje_build_ex(struct pje_config *config, struct build_job *job)
 	if (source_ex && config->ex_mod_name) {
 		struct string *mod_out = string_path_join(config->output_dir, config->ex_mod_name->text);
 		NOTICE("EX     %s", mod_out->text);
+		profile_begin("ex.write %s", mod_out->text);
 		ex_write_file(mod_out->text, source_ex);
+		profile_count("blocks", source_ex->nr_blocks);
+		profile_end();
 		free_string(mod_out);
 	}
 
@@ -782,6 +834,66 @@ static void pje_build_ex(struct pje_config *config, struct build_job *job)
 		ex_free(source_ex);
 }
 
+// index of a .pactex file in the output file list, and its pact_merge (or -1)
+struct pact_index_entry {
+	size_t dst;
+	int merge;
+};
+
+KHASH_MAP_INIT_STR(pact_index, struct pact_index_entry);
+
+/*
+ * A .pactex file in the output archive, along with the .txtex files which
+ * are appended to it (in order).
+ */
+struct pact_merge {
+	struct ar_file_spec *dst;
+	vector_t(struct string*) src;
+};
+
+static void pact_merge(void *data)
+{
+	struct pact_merge *m = data;
+	assert(m->dst->type == AR_FILE_SPEC_MEM);
+
+	// pack .txtex to .ex
+	struct ex *src_ex = NULL;
+	struct string *src;
+	vector_foreach(src, m->src) {
+		NOTICE("TXTEX  %s", src->text);
+		profile_begin("pact.convert %s", src->text);
+		struct ex *ex = ex_parse_file(src->text);
+		if (!src_ex) {
+			src_ex = ex;
+		} else {
+			ex_append(src_ex, ex);
+			ex_free(ex);
+		}
+		profile_end();
+	}
+
+	// if matching file was found, append .ex data to it; only the blocks
+	// named in the .txtex files are decoded and re-encoded
+	uint8_t *out;
+	size_t out_size;
+	if (m->dst->mem.data) {
+		struct ex_reader *dst = ex_reader_open_mem(m->dst->mem.data, m->dst->mem.size);
+		if (!dst)
+			ALICE_ERROR("Failed to read .pactex file: %s", m->dst->name->text);
+		out = ex_splice(dst, src_ex, EX_EDIT_APPEND, &out_size);
+		ex_encode(out+32, out_size-32);
+		ex_reader_close(dst);
+	} else {
+		out = ex_write_mem(src_ex, &out_size);
+	}
+	ex_free(src_ex);
+
+	// update dst file in file list
+	free(m->dst->mem.data);
+	m->dst->mem.data = out;
+	m->dst->mem.size = out_size;
+}
+
 static void pje_build_pact(struct pje_config *config, struct build_job *job)
 {
 	if (!vector_length(job->pact))
@@ -799,6 +911,7 @@ static void pje_build_pact(struct pje_config *config, struct build_job *job)
 	}
 
 	// open input pact .afa
+	profile_begin("pact.read_input");
 	int error;
 	struct afa_archive *ar = afa_open(config->pact_input->text, ARCHIVE_MMAP, &error);
 	if (!ar)
@@ -811,6 +924,18 @@ static void pje_build_pact(struct pje_config *config, struct build_job *job)
 
 	// close input pact .afa
 	archive_free(&ar->ar);
+	profile_count("files", vector_length(dst_files));
+	profile_end();
+
+	// index input files by name
+	khash_t(pact_index) *index = kh_init(pact_index);
+	for (unsigned i = 0; i < vector_length(dst_files); i++) {
+		int ret;
+		khiter_t k = kh_put(pact_index, index, dst_files.a[i]->name->text, &ret);
+		// duplicate names map to the first file
+		if (ret)
+			kh_value(index, k) = (struct pact_index_entry) { .dst = i, .merge = -1 };
+	}
 
 	// get list of .txtex source files
 	ar_file_list src_files;
@@ -819,45 +944,54 @@ static void pje_build_pact(struct pje_config *config, struct build_job *job)
 		ar_dir_to_file_list(vector_A(job->pact, i), &src_files, AR_FT_TXTEX);
 	}
 
-	// for each .txtex source file
+	// group .txtex source files by output file (a new output file is added
+	// for any source file which doesn't match an input file)
+	vector_t(struct pact_merge) merges = vector_initializer;
 	for (unsigned i = 0; i < vector_length(src_files); i++) {
-		// pack .txtex to .ex
 		assert(src_files.a[i]->type == AR_FILE_SPEC_DISK);
-		NOTICE("TXTEX  %s", src_files.a[i]->disk.path->text);
-		struct ex *src_ex = ex_parse_file(src_files.a[i]->disk.path->text);
-
-		// search for matching file in dst_files
 		struct string *dst_name = replace_extension(src_files.a[i]->name->text, "pactex");
-		struct ar_file_spec *dst = NULL;
-		for (unsigned j = 0; j < vector_length(dst_files); j++) {
-			if (strcmp(dst_name->text, dst_files.a[j]->name->text))
-				continue;
-			dst = dst_files.a[j];
-			break;
-		}
-		// if matching file was found, append .ex data to it
-		if (dst) {
-			assert(dst->type == AR_FILE_SPEC_MEM);
-			// append src file to dst file
-			struct ex *dst_ex = ex_read(dst->mem.data, dst->mem.size);
-			ex_append(dst_ex, src_ex);
-			// update dst file in file list
-			free(dst->mem.data);
-			dst->mem.data = ex_write_mem(dst_ex, &dst->mem.size);
-			ex_free(dst_ex);
-		}
-		// if no matching file was found, add new file to list
-		else {
+		int ret;
+		khiter_t k = kh_put(pact_index, index, dst_name->text, &ret);
+		if (ret) {
+			// no matching file found: add new file to list
 			struct ar_file_spec *spec = xmalloc(sizeof(struct ar_file_spec));
 			spec->type = AR_FILE_SPEC_MEM;
-			spec->name = string_ref(dst_name);
-			spec->mem.data = ex_write_mem(src_ex, &spec->mem.size);
+			spec->name = dst_name;
+			spec->mem.data = NULL;
+			spec->mem.size = 0;
+			kh_value(index, k) = (struct pact_index_entry) {
+				.dst = vector_length(dst_files),
+				.merge = -1
+			};
 			vector_push(struct ar_file_spec*, dst_files, spec);
+		} else {
+			free_string(dst_name);
 		}
 
-		free_string(dst_name);
-		ex_free(src_ex);
+		struct pact_index_entry *e = &kh_value(index, k);
+		if (e->merge < 0) {
+			e->merge = vector_length(merges);
+			struct pact_merge *m = vector_pushp(struct pact_merge, merges);
+			m->dst = dst_files.a[e->dst];
+			vector_init(m->src);
+		}
+		struct pact_merge *m = &vector_A(merges, e->merge);
+		vector_push(struct string*, m->src, src_files.a[i]->disk.path);
+	}
+	kh_destroy(pact_index, index);
+
+	// merge each output file in parallel
+	struct job_group *group = job_group_new();
+	for (size_t i = 0; i < vector_length(merges); i++) {
+		job_group_add(group, pact_merge, &vector_A(merges, i));
 	}
+	job_group_run(group);
+
+	struct pact_merge *m;
+	vector_foreach_p(m, merges) {
+		vector_destroy(m->src);
+	}
+	vector_destroy(merges);
 
 	// sort file list before writing archive
 	ar_file_list_sort(&dst_files);
@@ -865,7 +999,10 @@ static void pje_build_pact(struct pje_config *config, struct build_job *job)
 	// write dst_files to new .afa
 	struct string *out = string_path_join(config->output_dir, config->pact_name->text);
 	NOTICE("AFA    %s", out->text);
+	profile_begin("pact.write %s", out->text);
 	write_afa(out, dst_files.a, vector_length(dst_files), 2);
+	profile_count("files", vector_length(dst_files));
+	profile_end();
 
 	free_string(out);
 	ar_file_list_free(&dst_files);
@@ -895,29 +1032,45 @@ static void pje_build_archive(struct pje_config *config, struct string *out_name
 	struct string *out_path = string_path_join(config->output_dir, out_name->text);
 	struct ar_manifest *ar = pje_make_manifest(out_path, list);
 	NOTICE("AFA    %s", ar->output_path->text);
+	profile_begin("archive %s", ar->output_path->text);
 	ar_pack_manifest(ar, 2);
+	profile_end();
 	pje_free_manifest(ar);
 }
 
-static void pje_build_archives(struct pje_config *config, struct build_job *job)
+// XXX: DEPRECATED
+static void pje_build_legacy_archives(struct pje_config *config, possibly_unused struct build_job *job)
 {
 	for (unsigned i = 0; i < vector_length(config->archives); i++) {
 		struct string *path = string_path_join(config->pje_dir, vector_A(config->archives, i)->text);
 		NOTICE("AFA    %s", path->text);
+		profile_begin("archive %s", path->text);
 		ar_pack(path->text, 2);
+		profile_end();
 		free_string(path);
 	}
+}
 
+static void pje_build_cg(struct pje_config *config, struct build_job *job)
+{
 	if (vector_length(job->cg) > 0) {
 		if (!config->cg_name)
 			ALICE_ERROR("CG files found but CgName not given");
 		pje_build_archive(config, config->cg_name, &job->cg);
 	}
+}
+
+static void pje_build_sound(struct pje_config *config, struct build_job *job)
+{
 	if (vector_length(job->sound) > 0) {
 		if (!config->sound_name)
 			ALICE_ERROR("Sound files found but SoundName not given");
 		pje_build_archive(config, config->sound_name, &job->sound);
 	}
+}
+
+static void pje_build_flat(struct pje_config *config, struct build_job *job)
+{
 	if (vector_length(job->flat) > 0) {
 		if (!config->flat_name)
 			ALICE_ERROR("Flat files found but FlatName not given");
@@ -925,6 +1078,21 @@ static void pje_build_archives(struct pje_config *config, struct build_job *job)
 	}
 }
 
+struct pje_step {
+	const char *name;
+	void (*build)(struct pje_config *config, struct build_job *job);
+	struct pje_config *config;
+	struct build_job *job;
+};
+
+static void pje_run_step(void *data)
+{
+	struct pje_step *step = data;
+	profile_begin("%s", step->name);
+	step->build(step->config, step->job);
+	profile_end();
+}
+
 void pje_build(const char *path)
 {
 	struct pje_config config = {0};
@@ -935,13 +1103,46 @@ void pje_build(const char *path)
 	}
 
 	struct build_job job = {0};
+	profile_begin("read_source");
 	pje_read_source(&job, config.source_dir, &config.system_source, true);
 	pje_read_source(&job, config.source_dir, &config.source, false);
+	profile_count("jaf", vector_length(job.system_source) + vector_length(job.source));
+	profile_count("hll", vector_length(job.headers) / 2);
+	profile_count("txtex", vector_length(job.ex_source));
+	profile_count("jam", vector_length(job.jam_source));
+	profile_end();
+
+	// The outputs don't share any data, so they can be built in parallel.
+	// Logs are written in this order.
+	struct pje_step steps[] = {
+		{ "ain", pje_build_ain, &config, &job },
+		{ "ex", pje_build_ex, &config, &job },
+		{ "pact", pje_build_pact, &config, &job },
+		{ "archives", pje_build_legacy_archives, &config, &job },
+		{ "cg", pje_build_cg, &config, &job },
+		{ "sound", pje_build_sound, &config, &job },
+		{ "flat", pje_build_flat, &config, &job },
+	};
+	const unsigned nr_steps = sizeof(steps) / sizeof(*steps);
+	struct job *jobs[sizeof(steps) / sizeof(*steps)];
+
+	struct job *legacy = NULL;
+	struct job_group *group = job_group_new();
+	for (unsigned i = 0; i < nr_steps; i++) {
+		jobs[i] = job_group_add(group, pje_run_step, &steps[i]);
+		if (steps[i].build == pje_build_legacy_archives)
+			legacy = jobs[i];
+	}
+	// legacy archives are built with the working directory changed to the
+	// manifest's directory, so nothing else may run at the same time
+	if (vector_length(config.archives) > 0) {
+		for (unsigned i = 0; i < nr_steps; i++) {
+			if (jobs[i] != legacy)
+				job_depends(jobs[i], legacy);
+		}
+	}
+	job_group_run(group);
 
-	pje_build_ain(&config, &job);
-	pje_build_ex(&config, &job);
-	pje_build_pact(&config, &job);
-	pje_build_archives(&config, &job);
 	build_job_free(&job);
 	pje_free(&config);
 }
@@ -47,7 +47,7 @@ bool port_file_open(struct port *port, const char *path)
 uint8_t *port_buffer_get(struct port *port, size_t *size_out)
 {
 	if (size_out)
-		*size_out = port->buffer.size;
+		*size_out = port->buffer.index;
 	buffer_write_int8(&port->buffer, '\0');
 	uint8_t *data = port->buffer.buf;
 	buffer_init(&port->buffer, NULL, 0);
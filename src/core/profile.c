@@ -0,0 +1,465 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+#include "system4.h"
+#include "system4/vector.h"
+#include "alice.h"
+#include "alice/profile.h"
+#include "cJSON.h"
+
+struct profile_sample {
+	double wall;
+	double cpu;
+	uint64_t read;
+	uint64_t written;
+};
+
+struct profile_counter {
+	char *name;
+	uint64_t value;
+};
+
+struct profile_span {
+	char *name;
+	size_t parent; // index + 1 (0 for top-level spans)
+	unsigned depth;
+	unsigned tid;
+	struct profile_sample begin;
+	double start;
+	double wall;
+	double cpu;
+	double cpu_total; // including the CPU time of child spans on other threads
+	long peak_rss; // KiB
+	uint64_t read;
+	uint64_t written;
+	vector_t(struct profile_counter) counts;
+};
+
+bool profile_enabled = false;
+
+// spans are shared between threads; each thread has its own stack
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static vector_t(struct profile_span) spans;
+static vector_t(size_t) open_spans;
+static double epoch;
+static unsigned nr_threads;
+static bool hwm_resettable;
+
+// span indices + 1, and parents pushed by profile_push_parent
+static _Thread_local vector_t(size_t) stack;
+static _Thread_local unsigned thread_id;
+
+static double wall_clock(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * CPU time of the calling thread.
+ */
+static double cpu_clock(void)
+{
+#ifdef _WIN32
+	return (double)clock() / CLOCKS_PER_SEC;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+}
+
+#ifdef __linux__
+static bool reset_hwm(void)
+{
+	FILE *f = fopen("/proc/self/clear_refs", "w");
+	if (!f)
+		return false;
+	bool ok = fputs("5", f) >= 0;
+	return !fclose(f) && ok;
+}
+#endif
+
+/*
+ * Peak RSS of the process (in KiB) since the previous call. On Linux the
+ * peak is reset after each call by writing to /proc/self/clear_refs (if that
+ * isn't possible, the current RSS is returned instead). Elsewhere this is the
+ * peak RSS of the process so far.
+ */
+static long interval_peak_rss(void)
+{
+#if defined(__linux__)
+	FILE *f = fopen("/proc/self/status", "r");
+	if (!f)
+		return 0;
+	char line[128];
+	long v, hwm = 0, rss = 0;
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "VmHWM: %ld", &v) == 1)
+			hwm = v;
+		else if (sscanf(line, "VmRSS: %ld", &v) == 1)
+			rss = v;
+	}
+	fclose(f);
+	if (!hwm_resettable)
+		return rss;
+	reset_hwm();
+	return hwm;
+#elif defined(_WIN32)
+	return 0;
+#else
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+#ifdef __APPLE__
+	return ru.ru_maxrss / 1024;
+#else
+	return ru.ru_maxrss;
+#endif
+#endif
+}
+
+/*
+ * Add the peak RSS since the previous sample to every open span. Must be
+ * called with the mutex held.
+ */
+static void sample_peak_rss(void)
+{
+	long rss = interval_peak_rss();
+	size_t *i;
+	vector_foreach_p(i, open_spans) {
+		struct profile_span *span = &vector_A(spans, *i);
+		if (rss > span->peak_rss)
+			span->peak_rss = rss;
+	}
+}
+
+/*
+ * Bytes read/written by the calling thread. Only available on Linux
+ * (elsewhere these are reported as 0).
+ */
+static void io_counters(uint64_t *read, uint64_t *written)
+{
+	*read = 0;
+	*written = 0;
+#ifdef __linux__
+	FILE *f = fopen("/proc/thread-self/io", "r");
+	if (!f && !(f = fopen("/proc/self/io", "r")))
+		return;
+	char line[128];
+	unsigned long long v;
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "rchar: %llu", &v) == 1)
+			*read = v;
+		else if (sscanf(line, "wchar: %llu", &v) == 1)
+			*written = v;
+	}
+	fclose(f);
+#endif
+}
+
+static void take_sample(struct profile_sample *sample)
+{
+	sample->wall = wall_clock();
+	sample->cpu = cpu_clock();
+	io_counters(&sample->read, &sample->written);
+}
+
+void profile_enable(void)
+{
+	profile_enabled = true;
+	epoch = wall_clock();
+#ifdef __linux__
+	hwm_resettable = reset_hwm();
+#endif
+}
+
+void profile_begin(const char *fmt, ...)
+{
+	if (!profile_enabled)
+		return;
+
+	char name[512];
+	va_list ap;
+	va_start(ap, fmt);
+	vsnprintf(name, sizeof(name), fmt, ap);
+	va_end(ap);
+
+	struct profile_span span = {
+		.name = xstrdup(name),
+		.parent = profile_parent(),
+	};
+	take_sample(&span.begin);
+	span.start = span.begin.wall - epoch;
+
+	pthread_mutex_lock(&mutex);
+	if (!thread_id)
+		thread_id = ++nr_threads;
+	span.tid = thread_id;
+	if (span.parent)
+		span.depth = vector_A(spans, span.parent - 1).depth + 1;
+	sample_peak_rss();
+	vector_push(size_t, stack, vector_length(spans) + 1);
+	vector_push(size_t, open_spans, vector_length(spans));
+	vector_push(struct profile_span, spans, span);
+	pthread_mutex_unlock(&mutex);
+}
+
+void profile_end(void)
+{
+	if (!profile_enabled)
+		return;
+	if (vector_empty(stack) || !vector_peek(stack))
+		ALICE_ERROR("profile_end called without matching profile_begin");
+
+	struct profile_sample end;
+	take_sample(&end);
+
+	pthread_mutex_lock(&mutex);
+	size_t index = vector_pop(stack) - 1;
+	struct profile_span *span = &vector_A(spans, index);
+	span->wall = end.wall - span->begin.wall;
+	span->cpu = end.cpu - span->begin.cpu;
+	span->read = end.read - span->begin.read;
+	span->written = end.written - span->begin.written;
+	sample_peak_rss();
+	for (size_t i = 0; i < vector_length(open_spans); i++) {
+		if (vector_A(open_spans, i) == index) {
+			vector_A(open_spans, i) = vector_peek(open_spans);
+			vector_pop(open_spans);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&mutex);
+}
+
+/*
+ * The parent of the next span begun on the calling thread (as an opaque
+ * handle for profile_push_parent).
+ */
+size_t profile_parent(void)
+{
+	return vector_empty(stack) ? 0 : vector_peek(stack);
+}
+
+/*
+ * Set the parent of the spans begun on the calling thread until the matching
+ * call to profile_pop_parent (used to nest spans from a job under the span
+ * which created it).
+ */
+void profile_push_parent(size_t parent)
+{
+	if (profile_enabled)
+		vector_push(size_t, stack, parent);
+}
+
+void profile_pop_parent(void)
+{
+	if (profile_enabled)
+		vector_pop(stack);
+}
+
+/*
+ * Add to a named item count on the innermost open span.
+ */
+void profile_count(const char *name, uint64_t n)
+{
+	if (!profile_enabled || !profile_parent())
+		return;
+
+	pthread_mutex_lock(&mutex);
+	struct profile_span *span = &vector_A(spans, profile_parent() - 1);
+	struct profile_counter *c;
+	vector_foreach_p(c, span->counts) {
+		if (!strcmp(c->name, name)) {
+			c->value += n;
+			goto out;
+		}
+	}
+	c = vector_pushp(struct profile_counter, span->counts);
+	c->name = xstrdup(name);
+	c->value = n;
+out:
+	pthread_mutex_unlock(&mutex);
+}
+
+/*
+ * Compute the CPU time of each span including its child spans. Children on
+ * the same thread are already counted in the parent's CPU time; only the
+ * time of children on other threads (i.e. jobs) is added.
+ */
+static void compute_cpu_totals(void)
+{
+	struct profile_span *span;
+	vector_foreach_p(span, spans) {
+		span->cpu_total = span->cpu;
+	}
+	// children always come after their parents
+	for (size_t i = vector_length(spans); i > 0; i--) {
+		span = &vector_A(spans, i - 1);
+		if (!span->parent)
+			continue;
+		struct profile_span *parent = &vector_A(spans, span->parent - 1);
+		if (span->tid != parent->tid)
+			parent->cpu_total += span->cpu_total;
+		else
+			parent->cpu_total += span->cpu_total - span->cpu;
+	}
+}
+
+static void add_span_fields(cJSON *o, struct profile_span *span)
+{
+	cJSON_AddNumberToObject(o, "cpu", span->cpu);
+	cJSON_AddNumberToObject(o, "cpu_total", span->cpu_total);
+	cJSON_AddNumberToObject(o, "peak_rss", span->peak_rss);
+	cJSON_AddNumberToObject(o, "read", span->read);
+	cJSON_AddNumberToObject(o, "written", span->written);
+	struct profile_counter *c;
+	vector_foreach_p(c, span->counts) {
+		cJSON_AddNumberToObject(o, c->name, c->value);
+	}
+}
+
+static void print_json(FILE *out, cJSON *root)
+{
+	char *text = cJSON_Print(root);
+	fprintf(out, "%s\n", text);
+	free(text);
+	cJSON_Delete(root);
+}
+
+/*
+ * Write recorded spans as a JSON object of the form:
+ *
+ *   { "spans": [ { "name": ..., "depth": ..., "start": ..., "wall": ...,
+ *                  "cpu": ..., "cpu_total": ..., "peak_rss": ..., "read": ...,
+ *                  "written": ..., <counts>... }, ... ] }
+ *
+ * Times are in seconds, peak RSS in KiB and I/O in bytes. "cpu" is the CPU
+ * time of the span's own thread, and "cpu_total" also includes the CPU time
+ * of its child spans on other threads.
+ */
+void profile_write_json(FILE *out)
+{
+	compute_cpu_totals();
+	cJSON *root = cJSON_CreateObject();
+	cJSON *a = cJSON_AddArrayToObject(root, "spans");
+	struct profile_span *span;
+	vector_foreach_p(span, spans) {
+		cJSON *o = cJSON_CreateObject();
+		cJSON_AddStringToObject(o, "name", span->name);
+		cJSON_AddNumberToObject(o, "depth", span->depth);
+		cJSON_AddNumberToObject(o, "thread", span->tid);
+		cJSON_AddNumberToObject(o, "start", span->start);
+		cJSON_AddNumberToObject(o, "wall", span->wall);
+		add_span_fields(o, span);
+		cJSON_AddItemToArray(a, o);
+	}
+	print_json(out, root);
+}
+
+/*
+ * Write recorded spans in the Chrome trace event format, which can be
+ * loaded in chrome://tracing or Perfetto.
+ */
+void profile_write_chrome_trace(FILE *out)
+{
+	compute_cpu_totals();
+	cJSON *root = cJSON_CreateObject();
+	cJSON *a = cJSON_AddArrayToObject(root, "traceEvents");
+	struct profile_span *span;
+	vector_foreach_p(span, spans) {
+		cJSON *o = cJSON_CreateObject();
+		cJSON_AddStringToObject(o, "name", span->name);
+		cJSON_AddStringToObject(o, "ph", "X");
+		cJSON_AddNumberToObject(o, "ts", span->start * 1e6);
+		cJSON_AddNumberToObject(o, "dur", span->wall * 1e6);
+		cJSON_AddNumberToObject(o, "pid", 1);
+		cJSON_AddNumberToObject(o, "tid", span->tid);
+		add_span_fields(cJSON_AddObjectToObject(o, "args"), span);
+		cJSON_AddItemToArray(a, o);
+	}
+	cJSON_AddStringToObject(root, "displayTimeUnit", "ms");
+	print_json(out, root);
+}
+
+static double mib(uint64_t bytes)
+{
+	return bytes / (1024.0 * 1024.0);
+}
+
+/*
+ * Print a table of recorded spans, indented by nesting depth. CPU time
+ * includes the CPU time of the span's children on other threads; I/O is
+ * measured per thread, so it doesn't include the work done by any jobs a span
+ * was waiting on. RSS is the peak RSS of the whole process during the span.
+ */
+void profile_print_summary(FILE *out)
+{
+	compute_cpu_totals();
+	int width = 5;
+	struct profile_span *span;
+	vector_foreach_p(span, spans) {
+		int w = span->depth * 2 + strlen(span->name);
+		if (w > width)
+			width = w;
+	}
+	if (width > 60)
+		width = 60;
+
+	fprintf(out, "%-*s %11s %11s %11s %11s %11s  %s\n", width, "Phase",
+		"Wall (s)", "CPU (s)", "RSS (MiB)", "Read (MiB)", "Write (MiB)", "Counts");
+	vector_foreach_p(span, spans) {
+		int indent = span->depth * 2;
+		fprintf(out, "%*s%-*.*s %11.3f %11.3f %11.1f %11.1f %11.1f ",
+			indent, "", width - indent, width - indent, span->name,
+			span->wall, span->cpu_total, span->peak_rss / 1024.0,
+			mib(span->read), mib(span->written));
+		struct profile_counter *c;
+		vector_foreach_p(c, span->counts) {
+			fprintf(out, " %s=%llu", c->name, (unsigned long long)c->value);
+		}
+		fputc('\n', out);
+	}
+}
+
+void profile_fini(void)
+{
+	struct profile_span *span;
+	vector_foreach_p(span, spans) {
+		struct profile_counter *c;
+		vector_foreach_p(c, span->counts) {
+			free(c->name);
+		}
+		vector_destroy(span->counts);
+		free(span->name);
+	}
+	vector_destroy(spans);
+	vector_destroy(open_spans);
+	vector_destroy(stack);
+	vector_init(spans);
+	vector_init(open_spans);
+	vector_init(stack);
+	profile_enabled = false;
+}
@@ -14,127 +14,317 @@
  * along with this program; if not, see <http://gnu.org/licenses/>.
  */
 
-#include "math.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__SSE2__) && !defined(SCALE_NO_SIMD)
+#define SCALE_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && !defined(SCALE_NO_SIMD)
+#define SCALE_NEON
+#include <arm_neon.h>
+#endif
 #include "system4.h"
 #include "system4/cg.h"
 #include "alice.h"
 
-/* Bicubic interpolation implementation adapted from:
- * https://blog.demofox.org/2015/08/15/resizing-images-with-bicubic-interpolation/
+/*
+ * Separable bicubic (Catmull-Rom) scaler. The image is scaled horizontally
+ * and then vertically, using 4-tap fixed-point filters which are computed
+ * once per output column/row. Large downscales are first reduced by an
+ * integer factor with an area-averaging (box) filter, since a 4-tap filter
+ * would skip most of the input pixels.
  *
- * Copyright 2019 Alan Wolfe
- *
- * Permission is hereby granted, free of charge, to any person obtaining a
- * copy of this software and associated documentation files (the “Software”),
- * to deal in the Software without restriction, including without limitation
- * the rights to use, copy, modify, merge, publish, distribute, sublicense,
- * and/or sell copies of the Software, and to permit persons to whom the
- * Software is furnished to do so, subject to the following conditions:
- *
- * The above copyright notice and this permission notice shall be included in
- * all copies or substantial portions of the Software.
- *
- * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
- * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
- * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
- * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
- * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
- * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
- * IN THE SOFTWARE.
+ * The SIMD and scalar implementations produce identical results (building
+ * with SCALE_NO_SIMD defined selects the scalar implementation).
  */
 
-#define CLAMP(v, min, max) if (v < min) { v = min; } else if (v > max) { v = max; }
+#define WEIGHT_BITS 14
+#define WEIGHT_ONE (1 << WEIGHT_BITS)
+#define WEIGHT_ROUND (1 << (WEIGHT_BITS - 1))
+
+// filter for a single output pixel; taps are contiguous in the source
+struct filter_taps {
+	int start;
+	int16_t w[4];
+};
+
+struct image {
+	uint8_t *pixels;
+	int w, h;
+	int pitch;
+};
+
+static struct filter_taps *compute_taps(int in_size, int out_size, float scale)
+{
+	struct filter_taps *taps = xcalloc(out_size, sizeof(struct filter_taps));
+	int max_start = in_size > 4 ? in_size - 4 : 0;
+	for (int i = 0; i < out_size; i++) {
+		// offset by half a pixel to keep the image centered
+		float center = (i + 0.5f) / scale - 0.5f;
+		float t = center - floorf(center);
+		int first = (int)floorf(center) - 1;
+		float w[4] = {
+			((-t + 2.0f) * t - 1.0f) * t / 2.0f,
+			((3.0f * t - 5.0f) * t * t + 2.0f) / 2.0f,
+			((-3.0f * t + 4.0f) * t + 1.0f) * t / 2.0f,
+			(t - 1.0f) * t * t / 2.0f,
+		};
+
+		// taps outside of the image are folded onto the edge pixels
+		int start = first < 0 ? 0 : (first > max_start ? max_start : first);
+		float folded[4] = { 0 };
+		for (int k = 0; k < 4; k++) {
+			int x = first + k;
+			x = x < 0 ? 0 : (x >= in_size ? in_size - 1 : x);
+			folded[x - start] += w[k];
+		}
+
+		// convert to fixed point; rounding error goes to the largest weight
+		int sum = 0, largest = 0;
+		for (int k = 0; k < 4; k++) {
+			taps[i].w[k] = lrintf(folded[k] * WEIGHT_ONE);
+			sum += taps[i].w[k];
+			if (abs(taps[i].w[k]) > abs(taps[i].w[largest]))
+				largest = k;
+		}
+		taps[i].w[largest] += WEIGHT_ONE - sum;
+		taps[i].start = start;
+	}
+	return taps;
+}
 
-// t is a value that goes from 0 to 1 to interpolate in a C1 continuous way
-// across uniformly sampled data points. When t is 0, this will return B. When
-// t is 1, this will return C. Inbetween values will return an interpolation
-// between B and C. A and B are used to calculate slopes at the edges.
-static float cubic_hermite(float A, float B, float C, float D, float t)
+static uint8_t clamp_pixel(int32_t acc)
 {
-	float a = -A / 2.0f + (3.0f*B) / 2.0f - (3.0f*C) / 2.0f + D / 2.0f;
-	float b = A - (5.0f*B) / 2.0f + 2.0f*C - D / 2.0f;
-	float c = -A / 2.0f + C / 2.0f;
-	float d = B;
+	acc = (acc + WEIGHT_ROUND) >> WEIGHT_BITS;
+	return acc < 0 ? 0 : (acc > 255 ? 255 : acc);
+}
 
-	return a*t*t*t + b*t*t + c*t + d;
+#ifdef SCALE_SSE2
+static __m128i weight_pair(int16_t a, int16_t b)
+{
+	return _mm_set1_epi32((uint16_t)a | ((uint32_t)(uint16_t)b << 16));
 }
 
-static const uint8_t *get_pixel_clamped(const struct cg *in, int x, int y)
+/*
+ * Filter 8 16-bit values from each of 4 rows.
+ */
+static __m128i filter8_sse2(__m128i a, __m128i b, __m128i c, __m128i d, __m128i w01, __m128i w23)
 {
-	CLAMP(x, 0, in->metrics.w - 1);
-	CLAMP(y, 0, in->metrics.h - 1);
-	return &((uint8_t*)in->pixels)[(y * in->metrics.w * 4) + (x * 4)];
+	const __m128i round = _mm_set1_epi32(WEIGHT_ROUND);
+	__m128i lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(a, b), w01),
+			_mm_madd_epi16(_mm_unpacklo_epi16(c, d), w23));
+	__m128i hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(a, b), w01),
+			_mm_madd_epi16(_mm_unpackhi_epi16(c, d), w23));
+	lo = _mm_srai_epi32(_mm_add_epi32(lo, round), WEIGHT_BITS);
+	hi = _mm_srai_epi32(_mm_add_epi32(hi, round), WEIGHT_BITS);
+	return _mm_packs_epi32(lo, hi);
 }
+#endif
 
-static void sample_bicubic(struct cg *in, uint8_t *out, float u, float v)
+/*
+ * Scale a row of RGBA pixels horizontally.
+ */
+static void scale_row_h(uint8_t *dst, const uint8_t *src, const struct filter_taps *taps,
+		int out_w, int in_w)
 {
-	// calculate coordinates -> also need to offset by half a pixel to keep
-	// image from shifting down and left half a pixel
-	float x = (u * in->metrics.w) - 0.5f;
-	int xint = x;
-	float xfract = x - floorf(x);
-
-	float y = (v * in->metrics.h) - 0.5f;
-	int yint = y;
-	float yfract = y - floorf(y);
-
-	// 1st row
-	const uint8_t *p00 = get_pixel_clamped(in, xint - 1, yint - 1);
-	const uint8_t *p10 = get_pixel_clamped(in, xint + 0, yint - 1);
-	const uint8_t *p20 = get_pixel_clamped(in, xint + 1, yint - 1);
-	const uint8_t *p30 = get_pixel_clamped(in, xint + 2, yint - 1);
-
-	// 2nd row
-	const uint8_t *p01 = get_pixel_clamped(in, xint - 1, yint + 0);
-	const uint8_t *p11 = get_pixel_clamped(in, xint + 0, yint + 0);
-	const uint8_t *p21 = get_pixel_clamped(in, xint + 1, yint + 0);
-	const uint8_t *p31 = get_pixel_clamped(in, xint + 2, yint + 0);
-
-	// 3rd row
-	const uint8_t *p02 = get_pixel_clamped(in, xint - 1, yint + 1);
-	const uint8_t *p12 = get_pixel_clamped(in, xint + 0, yint + 1);
-	const uint8_t *p22 = get_pixel_clamped(in, xint + 1, yint + 1);
-	const uint8_t *p32 = get_pixel_clamped(in, xint + 2, yint + 1);
-
-	// 4th row
-	const uint8_t *p03 = get_pixel_clamped(in, xint - 1, yint + 2);
-	const uint8_t *p13 = get_pixel_clamped(in, xint + 0, yint + 2);
-	const uint8_t *p23 = get_pixel_clamped(in, xint + 1, yint + 2);
-	const uint8_t *p33 = get_pixel_clamped(in, xint + 2, yint + 2);
-
-	// interpolate bi-cubically
-	// clamp the values since the curve can put the value below 0 or above 255
-	for (int i = 0; i <  4; i++) {
-		float col0 = cubic_hermite(p00[i], p10[i], p20[i], p30[i], xfract);
-		float col1 = cubic_hermite(p01[i], p11[i], p21[i], p31[i], xfract);
-		float col2 = cubic_hermite(p02[i], p12[i], p22[i], p32[i], xfract);
-		float col3 = cubic_hermite(p03[i], p13[i], p23[i], p33[i], xfract);
-		float value = cubic_hermite(col0, col1, col2, col3, yfract);
-		CLAMP(value, 0.0f, 255.0f);
-		out[i] = value;
+	int x = 0;
+	// the SIMD kernels read 4 whole pixels
+	if (in_w >= 4) {
+#ifdef SCALE_SSE2
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i round = _mm_set1_epi32(WEIGHT_ROUND);
+		for (; x < out_w; x++) {
+			const struct filter_taps *t = &taps[x];
+			__m128i px = _mm_loadu_si128((const __m128i*)(src + t->start * 4));
+			__m128i p01 = _mm_unpacklo_epi8(px, zero);
+			__m128i p23 = _mm_unpackhi_epi8(px, zero);
+			// interleave channels of adjacent pixels, e.g. r0 r1 g0 g1 ...
+			p01 = _mm_unpacklo_epi16(p01, _mm_srli_si128(p01, 8));
+			p23 = _mm_unpacklo_epi16(p23, _mm_srli_si128(p23, 8));
+			__m128i acc = _mm_add_epi32(_mm_madd_epi16(p01, weight_pair(t->w[0], t->w[1])),
+					_mm_madd_epi16(p23, weight_pair(t->w[2], t->w[3])));
+			acc = _mm_srai_epi32(_mm_add_epi32(acc, round), WEIGHT_BITS);
+			acc = _mm_packs_epi32(acc, acc);
+			acc = _mm_packus_epi16(acc, acc);
+			uint32_t v = _mm_cvtsi128_si32(acc);
+			memcpy(dst + x * 4, &v, 4);
+		}
+#elif defined(SCALE_NEON)
+		for (; x < out_w; x++) {
+			const struct filter_taps *t = &taps[x];
+			uint8x16_t px = vld1q_u8(src + t->start * 4);
+			int16x8_t p01 = vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(px)));
+			int16x8_t p23 = vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(px)));
+			int32x4_t acc = vmull_n_s16(vget_low_s16(p01), t->w[0]);
+			acc = vmlal_n_s16(acc, vget_high_s16(p01), t->w[1]);
+			acc = vmlal_n_s16(acc, vget_low_s16(p23), t->w[2]);
+			acc = vmlal_n_s16(acc, vget_high_s16(p23), t->w[3]);
+			uint16x4_t v16 = vqrshrun_n_s32(acc, WEIGHT_BITS);
+			uint8x8_t v8 = vqmovn_u16(vcombine_u16(v16, v16));
+			vst1_lane_u32((uint32_t*)(dst + x * 4), vreinterpret_u32_u8(v8), 0);
+		}
+#endif
+	}
+	int nr_taps = in_w < 4 ? in_w : 4;
+	for (; x < out_w; x++) {
+		const struct filter_taps *t = &taps[x];
+		const uint8_t *p = src + t->start * 4;
+		for (int c = 0; c < 4; c++) {
+			int32_t acc = 0;
+			for (int k = 0; k < nr_taps; k++) {
+				acc += t->w[k] * p[k * 4 + c];
+			}
+			dst[x * 4 + c] = clamp_pixel(acc);
+		}
 	}
 }
 
+/*
+ * Compute a row of output bytes from 4 (horizontally scaled) rows.
+ */
+static void scale_row_v(uint8_t *dst, const uint8_t *rows[4], const int16_t *w, int n)
+{
+	int i = 0;
+#ifdef SCALE_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i w01 = weight_pair(w[0], w[1]);
+	const __m128i w23 = weight_pair(w[2], w[3]);
+	for (; i + 16 <= n; i += 16) {
+		__m128i r0 = _mm_loadu_si128((const __m128i*)(rows[0] + i));
+		__m128i r1 = _mm_loadu_si128((const __m128i*)(rows[1] + i));
+		__m128i r2 = _mm_loadu_si128((const __m128i*)(rows[2] + i));
+		__m128i r3 = _mm_loadu_si128((const __m128i*)(rows[3] + i));
+		__m128i lo = filter8_sse2(_mm_unpacklo_epi8(r0, zero), _mm_unpacklo_epi8(r1, zero),
+				_mm_unpacklo_epi8(r2, zero), _mm_unpacklo_epi8(r3, zero), w01, w23);
+		__m128i hi = filter8_sse2(_mm_unpackhi_epi8(r0, zero), _mm_unpackhi_epi8(r1, zero),
+				_mm_unpackhi_epi8(r2, zero), _mm_unpackhi_epi8(r3, zero), w01, w23);
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(lo, hi));
+	}
+#elif defined(SCALE_NEON)
+	for (; i + 8 <= n; i += 8) {
+		int16x8_t r0 = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(rows[0] + i)));
+		int16x8_t r1 = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(rows[1] + i)));
+		int16x8_t r2 = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(rows[2] + i)));
+		int16x8_t r3 = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(rows[3] + i)));
+		int32x4_t lo = vmull_n_s16(vget_low_s16(r0), w[0]);
+		lo = vmlal_n_s16(lo, vget_low_s16(r1), w[1]);
+		lo = vmlal_n_s16(lo, vget_low_s16(r2), w[2]);
+		lo = vmlal_n_s16(lo, vget_low_s16(r3), w[3]);
+		int32x4_t hi = vmull_n_s16(vget_high_s16(r0), w[0]);
+		hi = vmlal_n_s16(hi, vget_high_s16(r1), w[1]);
+		hi = vmlal_n_s16(hi, vget_high_s16(r2), w[2]);
+		hi = vmlal_n_s16(hi, vget_high_s16(r3), w[3]);
+		uint16x8_t v = vcombine_u16(vqrshrun_n_s32(lo, WEIGHT_BITS),
+				vqrshrun_n_s32(hi, WEIGHT_BITS));
+		vst1_u8(dst + i, vqmovn_u16(v));
+	}
+#endif
+	for (; i < n; i++) {
+		int32_t acc = w[0] * rows[0][i] + w[1] * rows[1][i]
+			+ w[2] * rows[2][i] + w[3] * rows[3][i];
+		dst[i] = clamp_pixel(acc);
+	}
+}
+
+/*
+ * Reduce an image by an integer factor, averaging each f*f block of pixels
+ * (blocks at the right/bottom edges may be smaller).
+ */
+static struct image box_reduce(const struct image *in, int f)
+{
+	struct image out = {
+		.w = (in->w + f - 1) / f,
+		.h = (in->h + f - 1) / f,
+	};
+	out.pitch = out.w * 4;
+	out.pixels = xmalloc(out.pitch * out.h);
+
+	uint32_t *acc = xmalloc(out.w * 4 * sizeof(uint32_t));
+	for (int oy = 0; oy < out.h; oy++) {
+		int y0 = oy * f;
+		int nr_rows = min(f, in->h - y0);
+		memset(acc, 0, out.w * 4 * sizeof(uint32_t));
+		for (int y = y0; y < y0 + nr_rows; y++) {
+			const uint8_t *p = in->pixels + y * in->pitch;
+			for (int ox = 0; ox < out.w; ox++) {
+				uint32_t *a = acc + ox * 4;
+				int nr_cols = min(f, in->w - ox * f);
+				for (int x = 0; x < nr_cols; x++, p += 4) {
+					a[0] += p[0];
+					a[1] += p[1];
+					a[2] += p[2];
+					a[3] += p[3];
+				}
+			}
+		}
+		uint8_t *dst = out.pixels + oy * out.pitch;
+		for (int ox = 0; ox < out.w; ox++) {
+			uint32_t n = min(f, in->w - ox * f) * nr_rows;
+			for (int c = 0; c < 4; c++) {
+				dst[ox * 4 + c] = (acc[ox * 4 + c] + n / 2) / n;
+			}
+		}
+	}
+	free(acc);
+	return out;
+}
+
 struct cg *scale_cg_bicubic(struct cg *in, float scale)
 {
 	struct cg *out = xmalloc(sizeof(struct cg));
 	*out = *in;
-	out->metrics.w = in->metrics.w * scale;
-	out->metrics.h = in->metrics.h * scale;
-	// FIXME: pitch?
+	out->metrics.w = max(1, (int)(in->metrics.w * scale));
+	out->metrics.h = max(1, (int)(in->metrics.h * scale));
+	out->metrics.pixel_pitch = out->metrics.w * 4;
 	out->pixels = xmalloc(out->metrics.w * out->metrics.h * 4);
 
-	uint8_t *row = out->pixels;
+	struct image src = {
+		.pixels = in->pixels,
+		.w = in->metrics.w,
+		.h = in->metrics.h,
+		.pitch = in->metrics.pixel_pitch ? in->metrics.pixel_pitch : in->metrics.w * 4,
+	};
+
+	// large downscales are done mostly by area-averaging
+	struct image reduced = { 0 };
+	int factor = 1.0f / scale;
+	if (factor >= 2) {
+		reduced = box_reduce(&src, factor);
+		src = reduced;
+	}
+
+	// the output size is truncated (and the reduced size rounded up), so the
+	// actual scale may differ for each axis
+	float xscale = (float)out->metrics.w / (float)src.w;
+	float yscale = (float)out->metrics.h / (float)src.h;
+	struct filter_taps *xtaps = compute_taps(src.w, out->metrics.w, xscale);
+	struct filter_taps *ytaps = compute_taps(src.h, out->metrics.h, yscale);
+
+	// horizontal pass
+	int tmp_pitch = out->metrics.w * 4;
+	uint8_t *tmp = xmalloc(tmp_pitch * src.h);
+	for (int y = 0; y < src.h; y++) {
+		scale_row_h(tmp + y * tmp_pitch, src.pixels + y * src.pitch, xtaps,
+				out->metrics.w, src.w);
+	}
+
+	// vertical pass
 	for (int y = 0; y < out->metrics.h; y++) {
-		uint8_t *pixel = row;
-		float v = (float)y / (float)(out->metrics.h - 1);
-		for (int x = 0; x < out->metrics.w; x++) {
-			float u = (float)x / (float)(out->metrics.w - 1);
-			sample_bicubic(in, pixel, u, v);
-			pixel += 4;
+		const struct filter_taps *t = &ytaps[y];
+		const uint8_t *rows[4];
+		for (int k = 0; k < 4; k++) {
+			// rows past the bottom edge (of images < 4 rows) have 0 weight
+			rows[k] = tmp + min(t->start + k, src.h - 1) * tmp_pitch;
 		}
-		row += out->metrics.w * 4;
+		scale_row_v((uint8_t*)out->pixels + y * out->metrics.pixel_pitch, rows, t->w,
+				tmp_pitch);
 	}
 
+	free(tmp);
+	free(xtaps);
+	free(ytaps);
+	free(reduced.pixels);
 	return out;
 }
@@ -0,0 +1,428 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <png.h>
+#include "system4.h"
+#include "system4/cg.h"
+#include "system4/file.h"
+#include "system4/string.h"
+#include "alice.h"
+#include "alice/thumbnail.h"
+
+/*
+ * Thumbnails are stored in the cache described by the freedesktop.org
+ * thumbnail managing standard: $XDG_CACHE_HOME/thumbnails/<flavor>/<md5>.png,
+ * where <md5> is the MD5 digest of the file's URI. The PNG records the URI,
+ * mtime and size of the original file, which are checked to decide whether
+ * a cached thumbnail is still valid. Files which can't be thumbnailed get an
+ * entry under fail/alice-tools/ so that they aren't retried until they change.
+ */
+
+#define FAIL_DIR "fail/alice-tools"
+
+static const struct {
+	const char *name;
+	int size;
+} flavors[] = {
+	{ "normal",   128 },
+	{ "large",    256 },
+	{ "x-large",  512 },
+	{ "xx-large", 1024 },
+};
+
+#define NR_FLAVORS (sizeof(flavors) / sizeof(*flavors))
+
+/*
+ * MD5 (RFC 1321).
+ */
+
+struct md5 {
+	uint32_t h[4];
+	uint8_t block[64];
+	size_t block_len;
+	uint64_t len;
+};
+
+static const uint32_t md5_k[64] = {
+	0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+	0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+	0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+	0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+	0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+	0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+	0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+	0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391,
+};
+
+static const uint8_t md5_r[64] = {
+	7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+	5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20,
+	4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+	6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21,
+};
+
+static void md5_init(struct md5 *md5)
+{
+	md5->h[0] = 0x67452301;
+	md5->h[1] = 0xefcdab89;
+	md5->h[2] = 0x98badcfe;
+	md5->h[3] = 0x10325476;
+	md5->block_len = 0;
+	md5->len = 0;
+}
+
+static void md5_block(struct md5 *md5, const uint8_t *p)
+{
+	uint32_t m[16];
+	for (int i = 0; i < 16; i++) {
+		m[i] = p[i*4] | (p[i*4+1] << 8) | (p[i*4+2] << 16) | ((uint32_t)p[i*4+3] << 24);
+	}
+
+	uint32_t a = md5->h[0], b = md5->h[1], c = md5->h[2], d = md5->h[3];
+	for (int i = 0; i < 64; i++) {
+		uint32_t f;
+		int g;
+		if (i < 16) {
+			f = (b & c) | (~b & d);
+			g = i;
+		} else if (i < 32) {
+			f = (d & b) | (~d & c);
+			g = (5*i + 1) % 16;
+		} else if (i < 48) {
+			f = b ^ c ^ d;
+			g = (3*i + 5) % 16;
+		} else {
+			f = c ^ (b | ~d);
+			g = (7*i) % 16;
+		}
+		uint32_t tmp = d;
+		d = c;
+		c = b;
+		uint32_t x = a + f + md5_k[i] + m[g];
+		b = b + ((x << md5_r[i]) | (x >> (32 - md5_r[i])));
+		a = tmp;
+	}
+	md5->h[0] += a;
+	md5->h[1] += b;
+	md5->h[2] += c;
+	md5->h[3] += d;
+}
+
+static void md5_update(struct md5 *md5, const uint8_t *data, size_t size)
+{
+	md5->len += size;
+	while (size) {
+		size_t n = min(size, 64 - md5->block_len);
+		memcpy(md5->block + md5->block_len, data, n);
+		md5->block_len += n;
+		data += n;
+		size -= n;
+		if (md5->block_len == 64) {
+			md5_block(md5, md5->block);
+			md5->block_len = 0;
+		}
+	}
+}
+
+static void md5_hex(struct md5 *md5, char out[33])
+{
+	uint64_t bits = md5->len * 8;
+	uint8_t pad[72] = { 0x80 };
+	size_t pad_len = (md5->block_len < 56 ? 56 : 120) - md5->block_len;
+	for (int i = 0; i < 8; i++) {
+		pad[pad_len + i] = bits >> (i * 8);
+	}
+	md5_update(md5, pad, pad_len + 8);
+	for (int i = 0; i < 16; i++) {
+		sprintf(out + i*2, "%02x", (md5->h[i/4] >> ((i%4) * 8)) & 0xff);
+	}
+}
+
+/*
+ * Get the file:// URI for a path, escaped the same way as GLib (which is
+ * what most file managers use to compute the cache key).
+ */
+static char *file_uri(const char *path)
+{
+#ifdef _WIN32
+	char *abs = _fullpath(NULL, path, 0);
+#else
+	char *abs = realpath(path, NULL);
+#endif
+	if (!abs)
+		return NULL;
+
+	struct string *uri = make_string("file://", 7);
+	for (const uint8_t *p = (uint8_t*)abs; *p; p++) {
+		if ((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') || (*p >= '0' && *p <= '9')
+				|| strchr("-._~!$&'()*+,;=:@/", *p)) {
+			string_push_back(&uri, *p);
+		} else {
+			char esc[4];
+			snprintf(esc, sizeof(esc), "%%%02X", *p);
+			string_append_cstr(&uri, esc, 3);
+		}
+	}
+	free(abs);
+
+	char *r = xstrdup(uri->text);
+	free_string(uri);
+	return r;
+}
+
+/*
+ * Scale a CG so that its larger dimension is `size` pixels.
+ */
+struct cg *thumbnail_scale(struct cg *in, int size, bool upscale)
+{
+	float scale = (float)size / (float)max(in->metrics.w, in->metrics.h);
+	if (!upscale && scale > 1.0f)
+		scale = 1.0f;
+	return scale_cg_bicubic(in, scale);
+}
+
+struct string *thumbnail_default_cache_dir(void)
+{
+	const char *cache = getenv("XDG_CACHE_HOME");
+	if (cache && *cache) {
+		struct string *dir = cstr_to_string(cache);
+		string_append_cstr(&dir, "/thumbnails", 11);
+		return dir;
+	}
+	const char *home = getenv("HOME");
+	if (!home || !*home)
+		ALICE_ERROR("Neither XDG_CACHE_HOME nor HOME is set");
+	struct string *dir = cstr_to_string(home);
+	string_append_cstr(&dir, "/.cache/thumbnails", 18);
+	return dir;
+}
+
+/*
+ * Get the thumbnail size used in the cache for a requested size.
+ */
+int thumbnail_cache_size(int size)
+{
+	for (unsigned i = 0; i < NR_FLAVORS; i++) {
+		if (size <= flavors[i].size)
+			return flavors[i].size;
+	}
+	return flavors[NR_FLAVORS-1].size;
+}
+
+static const char *flavor_name(int size)
+{
+	for (unsigned i = 0; i < NR_FLAVORS; i++) {
+		if (size == flavors[i].size)
+			return flavors[i].name;
+	}
+	ALICE_ERROR("Invalid thumbnail size: %d", size);
+}
+
+struct thumbnail_info {
+	const char *uri;
+	char mtime[24];
+	char size[24];
+	char width[16];
+	char height[16];
+};
+
+/*
+ * Check that a cached thumbnail (or failure entry) refers to the current
+ * version of the original file.
+ */
+static bool cache_entry_valid(const char *path, const struct thumbnail_info *info)
+{
+	FILE *f = file_open_utf8(path, "rb");
+	if (!f)
+		return false;
+
+	png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+	png_infop png_info = png ? png_create_info_struct(png) : NULL;
+	bool valid = false;
+	if (!png_info)
+		goto done;
+	if (setjmp(png_jmpbuf(png)))
+		goto done;
+
+	png_init_io(png, f);
+	png_read_info(png, png_info);
+
+	png_textp text;
+	int nr_text;
+	bool uri_ok = false, mtime_ok = false, size_ok = true;
+	png_get_text(png, png_info, &text, &nr_text);
+	for (int i = 0; i < nr_text; i++) {
+		if (!strcmp(text[i].key, "Thumb::URI"))
+			uri_ok = !strcmp(text[i].text, info->uri);
+		else if (!strcmp(text[i].key, "Thumb::MTime"))
+			mtime_ok = !strcmp(text[i].text, info->mtime);
+		else if (!strcmp(text[i].key, "Thumb::Size"))
+			size_ok = !strcmp(text[i].text, info->size);
+	}
+	valid = uri_ok && mtime_ok && size_ok;
+done:
+	png_destroy_read_struct(&png, png_info ? &png_info : NULL, NULL);
+	fclose(f);
+	return valid;
+}
+
+static bool write_png(FILE *f, struct cg *cg, const struct thumbnail_info *info)
+{
+	png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+	png_infop png_info = png ? png_create_info_struct(png) : NULL;
+	int pitch = cg->metrics.pixel_pitch ? cg->metrics.pixel_pitch : cg->metrics.w * 4;
+	png_bytep *rows = xmalloc(cg->metrics.h * sizeof(png_bytep));
+	for (int y = 0; y < cg->metrics.h; y++) {
+		rows[y] = (png_bytep)cg->pixels + y * pitch;
+	}
+	bool ok = false;
+	if (!png_info)
+		goto done;
+	if (setjmp(png_jmpbuf(png)))
+		goto done;
+
+	png_init_io(png, f);
+	png_set_IHDR(png, png_info, cg->metrics.w, cg->metrics.h, 8, PNG_COLOR_TYPE_RGBA,
+			PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+
+	png_text text[6];
+	int nr_text = 0;
+	text[nr_text++] = (png_text) { PNG_TEXT_COMPRESSION_NONE, "Thumb::URI", (char*)info->uri };
+	text[nr_text++] = (png_text) { PNG_TEXT_COMPRESSION_NONE, "Thumb::MTime", (char*)info->mtime };
+	text[nr_text++] = (png_text) { PNG_TEXT_COMPRESSION_NONE, "Thumb::Size", (char*)info->size };
+	if (info->width[0]) {
+		text[nr_text++] = (png_text) { PNG_TEXT_COMPRESSION_NONE, "Thumb::Image::Width", (char*)info->width };
+		text[nr_text++] = (png_text) { PNG_TEXT_COMPRESSION_NONE, "Thumb::Image::Height", (char*)info->height };
+	}
+	text[nr_text++] = (png_text) { PNG_TEXT_COMPRESSION_NONE, "Software", "alice-tools " ALICE_TOOLS_VERSION };
+	png_set_text(png, png_info, text, nr_text);
+	png_write_info(png, png_info);
+
+	png_write_image(png, rows);
+	png_write_end(png, NULL);
+	ok = true;
+done:
+	png_destroy_write_struct(&png, png_info ? &png_info : NULL);
+	free(rows);
+	return ok;
+}
+
+/*
+ * Write a cache entry. The PNG is written to a temporary file and renamed
+ * into place, so that readers never see a partial thumbnail.
+ */
+static bool write_cache_entry(const char *path, struct cg *cg, const struct thumbnail_info *info)
+{
+	static atomic_uint counter;
+	char tmp[PATH_MAX];
+	snprintf(tmp, sizeof(tmp), "%s.%d.%u.tmp", path, (int)getpid(), atomic_fetch_add(&counter, 1));
+
+	mkdir_for_file(path);
+	FILE *f = file_open_utf8(tmp, "wb");
+	if (!f) {
+		WARNING("fopen(\"%s\"): %s", tmp, strerror(errno));
+		return false;
+	}
+	bool ok = write_png(f, cg, info);
+	if (fclose(f))
+		ok = false;
+#ifndef _WIN32
+	chmod(tmp, 0600);
+#endif
+	if (!ok || rename(tmp, path)) {
+		WARNING("Failed to write thumbnail \"%s\"", path);
+		remove(tmp);
+		return false;
+	}
+	return true;
+}
+
+/*
+ * Get the path to an up to date cached thumbnail for a CG file, generating
+ * the thumbnail if necessary. `size` must be one of the cache sizes (see
+ * thumbnail_cache_size). Returns NULL if the file can't be thumbnailed.
+ */
+struct string *thumbnail_cache_file(const struct string *cache_dir, const char *path, int size)
+{
+	ustat s;
+	if (stat_utf8(path, &s)) {
+		WARNING("stat(\"%s\"): %s", path, strerror(errno));
+		return NULL;
+	}
+	char *uri = file_uri(path);
+	if (!uri) {
+		WARNING("Failed to resolve path \"%s\": %s", path, strerror(errno));
+		return NULL;
+	}
+
+	struct thumbnail_info info = { .uri = uri };
+	snprintf(info.mtime, sizeof(info.mtime), "%lld", (long long)s.st_mtime);
+	snprintf(info.size, sizeof(info.size), "%llu", (unsigned long long)s.st_size);
+
+	char name[38];
+	struct md5 md5;
+	md5_init(&md5);
+	md5_update(&md5, (uint8_t*)uri, strlen(uri));
+	md5_hex(&md5, name);
+	strcat(name, ".png");
+
+	struct string *dir = string_path_join(cache_dir, flavor_name(size));
+	struct string *thumb = string_path_join(dir, name);
+	free_string(dir);
+	dir = string_path_join(cache_dir, FAIL_DIR);
+	struct string *fail = string_path_join(dir, name);
+	free_string(dir);
+
+	if (cache_entry_valid(thumb->text, &info))
+		goto done;
+	if (cache_entry_valid(fail->text, &info))
+		goto failed;
+
+	struct cg *in = cg_load_file(path);
+	if (!in) {
+		WARNING("Failed to load CG: %s", path);
+		// record the failure with a 1x1 placeholder image
+		uint8_t pixel[4] = { 0 };
+		struct cg placeholder = { .metrics = { .w = 1, .h = 1, .pixel_pitch = 4 }, .pixels = pixel };
+		write_cache_entry(fail->text, &placeholder, &info);
+		goto failed;
+	}
+	snprintf(info.width, sizeof(info.width), "%d", in->metrics.w);
+	snprintf(info.height, sizeof(info.height), "%d", in->metrics.h);
+	struct cg *out = thumbnail_scale(in, size, false);
+	bool ok = write_cache_entry(thumb->text, out, &info);
+	cg_free(in);
+	cg_free(out);
+	if (!ok)
+		goto failed;
+done:
+	free_string(fail);
+	free(uri);
+	return thumb;
+failed:
+	free_string(thumb);
+	free_string(fail);
+	free(uri);
+	return NULL;
+}
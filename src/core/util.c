@@ -145,6 +145,42 @@ void chdir_to_file(const char *filename)
 	free(tmp);
 }
 
+static bool is_path_sep(char c)
+{
+#ifdef _WIN32
+	return c == '/' || c == '\\';
+#else
+	return c == '/';
+#endif
+}
+
+/*
+ * Reentrant version of path_dirname: returns the directory part of `path` in
+ * newly allocated memory.
+ *
+ * path_dirname_r("dir/file") -> "dir"
+ * path_dirname_r("file") -> "."
+ * path_dirname_r("/file") -> "/"
+ */
+char *path_dirname_r(const char *path)
+{
+	size_t len = strlen(path);
+	// strip trailing separators, then the last component and its separators
+	while (len > 1 && is_path_sep(path[len-1]))
+		len--;
+	while (len > 0 && !is_path_sep(path[len-1]))
+		len--;
+	if (len == 0)
+		return xstrdup(".");
+	while (len > 1 && is_path_sep(path[len-1]))
+		len--;
+
+	char *dir = xmalloc(len + 1);
+	memcpy(dir, path, len);
+	dir[len] = '\0';
+	return dir;
+}
+
 /*
  * replace_extension("filename", "ext") -> "filename.ext"
  * replace_extension("filename.oth", "ext") -> "filename.ext"
@@ -15,33 +15,61 @@
  */
 
 #include "ex_table_model.hpp"
+#include "galice.hpp"
 
 extern "C" {
 #include "system4/ex.h"
 #include "system4/string.h"
 #include "alice.h"
+#include "alice/ex.h"
 }
 
 ExTableModel::ExTableModel(struct ex_table *table, QObject *parent)
 	: QAbstractTableModel(parent)
 	, table(table)
+	, columns(nullptr)
+	, reader(nullptr)
+	, block(0)
 {
 }
 
+/*
+ * Show a table block of an open .ex file. Homogeneous tables are decoded in
+ * columnar form only; other tables are decoded into rows.
+ */
+ExTableModel::ExTableModel(struct ex_reader *reader, unsigned block, QObject *parent)
+	: QAbstractTableModel(parent)
+	, table(nullptr)
+	, columns(GAlice::acquireExColumns(reader, block))
+	, reader(reader)
+	, block(block)
+{
+	if (!columns)
+		table = GAlice::acquireExBlock(reader, block)->val.t;
+}
+
+ExTableModel::~ExTableModel()
+{
+	if (reader)
+		GAlice::releaseExBlock(reader, block);
+}
+
 int ExTableModel::rowCount(const QModelIndex & /*parent*/) const
 {
-	return table->nr_rows;
+	return columns ? columns->nr_rows : table->nr_rows;
 }
 
 int ExTableModel::columnCount(const QModelIndex & /*parent*/) const
 {
-	return table->nr_columns;
+	return columns ? columns->nr_columns : table->nr_columns;
 }
 
 QVariant ExTableModel::headerData(int section, Qt::Orientation orientation, int role) const
 {
-	if (role == Qt::DisplayRole && orientation == Qt::Horizontal && section < (int)table->nr_fields)
-		return QString(table->fields[section].name->text);
+	uint32_t nr_fields = columns ? columns->nr_fields : table->nr_fields;
+	struct ex_field *fields = columns ? columns->fields : table->fields;
+	if (role == Qt::DisplayRole && orientation == Qt::Horizontal && section < (int)nr_fields)
+		return QString(fields[section].name->text);
 	if (role == Qt::DisplayRole && orientation == Qt::Vertical)
 		return QString::number(section);
 	return QVariant();
@@ -68,9 +96,20 @@ static QString exValueToString(struct ex_value *v)
 
 QVariant ExTableModel::data(const QModelIndex &index, int role) const
 {
-	if (index.row() >= (int)table->nr_rows || index.column() >= (int)table->nr_columns)
+	if (index.row() >= rowCount() || index.column() >= columnCount())
 		return QVariant();
-	if (role == Qt::DisplayRole)
-		return exValueToString(&table->rows[index.row()][index.column()]);
-	return QVariant();
+	if (role != Qt::DisplayRole)
+		return QVariant();
+	if (columns) {
+		switch (columns->columns[index.column()].type) {
+		case EX_INT:
+			return QString::number(ex_columns_int(columns, index.row(), index.column()));
+		case EX_FLOAT:
+			return QString::number(ex_columns_float(columns, index.row(), index.column()));
+		case EX_STRING:
+			return QString(ex_columns_string(columns, index.row(), index.column()));
+		}
+		return QVariant();
+	}
+	return exValueToString(&table->rows[index.row()][index.column()]);
 }
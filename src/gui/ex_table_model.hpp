@@ -21,11 +21,15 @@
 #include <QVector>
 
 struct ex_table;
+struct ex_columns;
+struct ex_reader;
 
 class ExTableModel : public QAbstractTableModel {
 	Q_OBJECT
 public:
 	ExTableModel(struct ex_table *table, QObject *parent = nullptr);
+	ExTableModel(struct ex_reader *reader, unsigned block, QObject *parent = nullptr);
+	~ExTableModel();
 	int rowCount(const QModelIndex &parent = QModelIndex()) const override;
 	int columnCount(const QModelIndex &parent = QModelIndex()) const override;
 	QVariant headerData(int section, Qt::Orientation orientation,
@@ -33,6 +37,10 @@ public:
 	QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
 private:
 	struct ex_table *table;
+	struct ex_columns *columns;
+	// table block of an open .ex file (or NULL)
+	struct ex_reader *reader;
+	unsigned block;
 };
 
 #endif /* GALICE_EX_TABLE_MODEL_HPP */
@@ -15,13 +15,16 @@
  */
 
 #include <cctype>
+#include <cstring>
 #include <iostream>
 #include <QApplication>
 #include <QCommandLineParser>
 #include <QCursor>
 #include <QFileInfo>
 #include <QGuiApplication>
+#include <QHash>
 #include <QMessageBox>
+#include <QPair>
 
 #include "galice.hpp"
 #include "mainwindow.hpp"
@@ -38,9 +41,12 @@ extern "C" {
 #include "system4/ex.h"
 #include "system4/cg.h"
 #include "system4/file.h"
+#include "system4/string.h"
+#include "system4/utfsjis.h"
 #include "alice.h"
 #include "alice/ain.h"
 #include "alice/acx.h"
+#include "alice/ex.h"
 #include "alice/ar.h"
 }
 
@@ -273,15 +279,15 @@ void GAlice::openExFile(const QString &path)
 {
 	QGuiApplication::setOverrideCursor(Qt::WaitCursor);
 
-	set_encodings("CP932", "UTF-8");
-	struct ex *ex = ex_read_file_conv(path.toUtf8(), string_conv_output);
-	if (!ex) {
+	struct ex_reader *reader = ex_reader_open_conv(path.toUtf8(), exStringConv);
+	if (!reader) {
 		QGuiApplication::restoreOverrideCursor();
 		fileError(path, tr("Failed to read .ex file"));
 		return;
 	}
 
-	std::shared_ptr<struct ex> ptr(ex, ex_free);
+	// blocks are decoded when they are opened in the navigator
+	std::shared_ptr<struct ex_reader> ptr(reader, ex_reader_close);
 	emit getInstance().openedExFile(path, ptr);
 	QGuiApplication::restoreOverrideCursor();
 }
@@ -493,6 +499,60 @@ void GAlice::openExValue(const QString &name, struct ex_value *value, bool newTa
 	emit getInstance().openedExValue(name, value, newTab);
 }
 
+void GAlice::openExBlock(const QString &name, struct ex_reader *reader, unsigned i, bool newTab)
+{
+	emit getInstance().openedExBlock(name, reader, i, newTab);
+}
+
+/*
+ * Convert a string in a .ex file to UTF-8. Blocks are decoded long after the
+ * file is opened, so this can't depend on the current encodings (as
+ * string_conv_output does).
+ */
+struct string *GAlice::exStringConv(const char *str, size_t len)
+{
+	if (!len)
+		return make_string("", 0);
+	char *u = sjis2utf(str, len);
+	struct string *s = make_string(u, strlen(u));
+	free(u);
+	return s;
+}
+
+// number of users of each decoded block of an open .ex file
+static QHash<QPair<struct ex_reader*, unsigned>, int> exBlockRefs;
+
+/*
+ * Decode a block of an open .ex file. The block stays decoded until every
+ * user has called releaseExBlock.
+ */
+struct ex_block *GAlice::acquireExBlock(struct ex_reader *reader, unsigned i)
+{
+	exBlockRefs[qMakePair(reader, i)]++;
+	return ex_reader_block(reader, i);
+}
+
+/*
+ * Decode a table block of an open .ex file in columnar form. Returns NULL
+ * (without acquiring the block) if the table isn't homogeneous.
+ */
+struct ex_columns *GAlice::acquireExColumns(struct ex_reader *reader, unsigned i)
+{
+	struct ex_columns *columns = ex_reader_columns(reader, i);
+	if (columns)
+		exBlockRefs[qMakePair(reader, i)]++;
+	return columns;
+}
+
+void GAlice::releaseExBlock(struct ex_reader *reader, unsigned i)
+{
+	auto key = qMakePair(reader, i);
+	if (--exBlockRefs[key] > 0)
+		return;
+	exBlockRefs.remove(key);
+	ex_reader_release(reader, i);
+}
+
 void GAlice::fileError(const QString &filename, const QString &message)
 {
 	error(QString("%1: %2").arg(message).arg(filename));
@@ -22,7 +22,10 @@
 
 struct ain;
 struct cg;
-struct ex;
+struct ex_block;
+struct ex_columns;
+struct ex_reader;
+struct string;
 struct acx;
 struct archive;
 struct flat;
@@ -74,13 +77,19 @@ public:
 	static void openImage(const QString &name, const uint8_t *bytes, size_t size, bool newTab = false);
 	static void openAinFunction(struct ain *ain, int i, bool newTab = false);
 	static void openExValue(const QString &name, struct ex_value *value, bool newTab = false);
+	static void openExBlock(const QString &name, struct ex_reader *reader, unsigned i,
+			bool newTab = false);
+	static struct ex_block *acquireExBlock(struct ex_reader *reader, unsigned i);
+	static struct ex_columns *acquireExColumns(struct ex_reader *reader, unsigned i);
+	static void releaseExBlock(struct ex_reader *reader, unsigned i);
+	static struct string *exStringConv(const char *str, size_t len);
 	static void error(const QString &message);
 	[[noreturn]] static void criticalError(const QString &message);
 	static void status(const QString &message);
 
 signals:
 	void openedAinFile(const QString &fileName, std::shared_ptr<struct ain> ain);
-	void openedExFile(const QString &fileName, std::shared_ptr<struct ex> ex);
+	void openedExFile(const QString &fileName, std::shared_ptr<struct ex_reader> ex);
 	void openedFlatFile(const QString &fileName, std::shared_ptr<struct flat> flat);
 	void openedAcxFile(const QString &filename, std::shared_ptr<struct acx> acx, bool newTab);
 	void openedArchive(const QString &fileName, std::shared_ptr<struct archive> ar);
@@ -88,6 +97,7 @@ signals:
 	void openedText(const QString &name, char *text, FileFormat format, bool newTab);
 	void openedAinFunction(struct ain *ainFile, int i, bool newTab);
 	void openedExValue(const QString &name, struct ex_value *value, bool newTab);
+	void openedExBlock(const QString &name, struct ex_reader *reader, unsigned i, bool newTab);
 	void errorMessage(const QString &message);
 	void statusMessage(const QString &message);
 
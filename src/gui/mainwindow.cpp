@@ -59,6 +59,7 @@ MainWindow::MainWindow(QWidget *parent)
 	connect(&GAlice::getInstance(), &GAlice::openedText, this, &MainWindow::openTextFile);
 	connect(&GAlice::getInstance(), &GAlice::openedAinFunction, this, &MainWindow::openFunction);
 	connect(&GAlice::getInstance(), &GAlice::openedExValue, this, &MainWindow::openExValue);
+	connect(&GAlice::getInstance(), &GAlice::openedExBlock, this, &MainWindow::openExBlock);
 }
 
 void MainWindow::closeEvent(QCloseEvent *event)
@@ -234,6 +235,20 @@ void MainWindow::openExValue(const QString &name, struct ex_value *value, bool n
         free(data);
 }
 
+void MainWindow::openExBlock(const QString &name, struct ex_reader *reader, unsigned i, bool newTab)
+{
+	if (reader->blocks[i].type == EX_TABLE) {
+		ExTableModel *model = new ExTableModel(reader, i);
+		ExTableView *view = new ExTableView(model);
+		openViewer(name, view, newTab);
+		return;
+	}
+	// other values are dumped as text, so the block isn't kept decoded
+	struct ex_block *block = GAlice::acquireExBlock(reader, i);
+	openExValue(name, &block->val, newTab);
+	GAlice::releaseExBlock(reader, i);
+}
+
 void MainWindow::openAcxFile(const QString &name, std::shared_ptr<struct acx> acx, bool newTab)
 {
 	AcxModel *model = new AcxModel(acx);
@@ -46,6 +46,7 @@ public slots:
 	void openTextFile(const QString &name, char *text, FileFormat format, bool newTab);
         void openFunction(struct ain *ain, int i, bool newTab);
         void openExValue(const QString &name, struct ex_value *value, bool newTab);
+	void openExBlock(const QString &name, struct ex_reader *reader, unsigned i, bool newTab);
 	void openAcxFile(const QString &name, std::shared_ptr<struct acx> acx, bool newTab);
 	void openImage(const QString &name, std::shared_ptr<struct cg> cg, bool newTab);
 
@@ -90,7 +90,7 @@ void Navigator::addAinFile(const QString &fileName, std::shared_ptr<struct ain>
 	addFile(fileName, widget);
 }
 
-void Navigator::addExFile(const QString &fileName, std::shared_ptr<struct ex> ex)
+void Navigator::addExFile(const QString &fileName, std::shared_ptr<struct ex_reader> ex)
 {
         QWidget *widget = new QWidget;
         NavigatorModel *model = NavigatorModel::fromExFile(ex);
@@ -24,7 +24,7 @@
 #include <QVector>
 
 struct ain;
-struct ex;
+struct ex_reader;
 class MainWindow;
 
 extern "C" {
@@ -43,7 +43,7 @@ public:
 
 private slots:
         void addAinFile(const QString &fileName, std::shared_ptr<struct ain> ain);
-        void addExFile(const QString &fileName, std::shared_ptr<struct ex> ex);
+        void addExFile(const QString &fileName, std::shared_ptr<struct ex_reader> ex);
 	void addFlatFile(const QString &fileName, std::shared_ptr<struct flat> flat);
         void addArchive(const QString &fileName, std::shared_ptr<struct archive> ar);
 
@@ -26,6 +26,7 @@ extern "C" {
 #include "system4/string.h"
 #include "alice.h"
 #include "alice/ain.h"
+#include "alice/ex.h"
 #include "alice/port.h"
 }
 
@@ -125,10 +126,10 @@ NavigatorModel::Node *NavigatorModel::Node::makeCGNode(struct string *name,
 	return node;
 }
 
-NavigatorModel::Node *NavigatorModel::Node::fromEx(struct ex *ex)
+NavigatorModel::Node *NavigatorModel::Node::fromExReader(struct ex_reader *reader)
 {
         Node *root = new Node(NavigatorNode::RootNode);
-        root->appendExFileChildren(ex);
+        root->appendExReaderChildren(reader);
         return root;
 }
 
@@ -223,11 +224,67 @@ void NavigatorModel::Node::appendExValueChildren(struct ex_value *value)
         }
 }
 
-void NavigatorModel::Node::appendExFileChildren(struct ex *exFile)
+NavigatorModel::Node *NavigatorModel::Node::fromExBlock(struct ex_reader *reader, unsigned i)
+{
+	struct ex_reader_block *b = &reader->blocks[i];
+	Node *node = new Node(NavigatorNode::ExBlockNode);
+	node->node.exBlock.reader = reader;
+	node->node.exBlock.i = i;
+	if (reader->conv)
+		node->node.exBlock.name = reader->conv(b->name, b->name_len);
+	else
+		node->node.exBlock.name = make_string(b->name, b->name_len);
+	node->node.exBlock.columnar = false;
+
+	// scalar values are shown in the navigator, so they are decoded now;
+	// other blocks are decoded when they are expanded
+	node->node.exBlock.loaded = b->type == EX_INT || b->type == EX_FLOAT
+		|| b->type == EX_STRING;
+	if (node->node.exBlock.loaded)
+		GAlice::acquireExBlock(reader, i);
+	return node;
+}
+
+void NavigatorModel::Node::appendExReaderChildren(struct ex_reader *reader)
 {
-        for (unsigned i = 0; i < exFile->nr_blocks; i++) {
-                appendChild(Node::fromExKeyValue(exFile->blocks[i].name, &exFile->blocks[i].val));
-        }
+	for (unsigned i = 0; i < reader->nr_blocks; i++) {
+		appendChild(Node::fromExBlock(reader, i));
+	}
+}
+
+/*
+ * Decode an .ex block and create (but don't append) its child nodes.
+ * Homogeneous tables are only decoded in columnar form (to be opened in a
+ * table view), so they have no child nodes.
+ */
+QVector<NavigatorModel::Node*> NavigatorModel::Node::fetchExBlock()
+{
+	struct ex_reader *reader = node.exBlock.reader;
+	unsigned i = node.exBlock.i;
+	if (GAlice::acquireExColumns(reader, i)) {
+		GAlice::releaseExBlock(reader, i);
+		node.exBlock.columnar = true;
+		return QVector<Node*>();
+	}
+
+	Node tmp(NavigatorNode::ExStringKeyValueNode);
+	tmp.appendExValueChildren(&GAlice::acquireExBlock(reader, i)->val);
+	node.exBlock.loaded = true;
+
+	QVector<Node*> nodes = tmp.children;
+	tmp.children.clear();
+	return nodes;
+}
+
+/*
+ * Free the child nodes of an .ex block and release the decoded block.
+ */
+void NavigatorModel::Node::releaseExBlock()
+{
+	qDeleteAll(children);
+	children.clear();
+	GAlice::releaseExBlock(node.exBlock.reader, node.exBlock.i);
+	node.exBlock.loaded = false;
 }
 
 static struct string *timeline_typestr(enum flat_timeline_type t)
@@ -643,13 +700,12 @@ void NavigatorModel::Node::fromArchiveIter(struct archive_data *data, void *user
                 // nothing
         } else if (!strcasecmp(ext, "pactex") || !strcasecmp(ext, "ex")) {
                 archive_load_file(data);
-                set_input_encoding("CP932");
-                set_output_encoding("UTF-8");
-                struct ex *ex = ex_read_conv(data->data, data->size, string_conv_output);
-                if (ex) {
-                        child->appendExFileChildren(ex);
+                struct ex_reader *reader = ex_reader_open_mem(data->data, data->size);
+                if (reader) {
+                        reader->conv = GAlice::exStringConv;
+                        child->appendExReaderChildren(reader);
                         child->node.ar.type = NavigatorNode::ExFile;
-                        child->node.ar.ex = ex;
+                        child->node.ar.ex = reader;
                 } else {
                         // TODO: status message?
                 }
@@ -701,7 +757,7 @@ NavigatorModel::Node::~Node()
                 case NavigatorNode::NormalFile:
                         break;
                 case NavigatorNode::ExFile:
-                        ex_free(node.ar.ex);
+                        ex_reader_close(node.ar.ex);
                         break;
 		case NavigatorNode::FlatFile:
 			flat_free(node.ar.flat);
@@ -718,6 +774,10 @@ NavigatorModel::Node::~Node()
 		}
 	} else if (node.type == NavigatorNode::CGNode) {
 		free_string(node.cg.name);
+	} else if (node.type == NavigatorNode::ExBlockNode) {
+		if (node.exBlock.loaded)
+			GAlice::releaseExBlock(node.exBlock.reader, node.exBlock.i);
+		free_string(node.exBlock.name);
 	}
 }
 
@@ -756,6 +816,24 @@ int NavigatorModel::Node::columnCount()
         return 3;
 }
 
+bool NavigatorModel::Node::hasChildren()
+{
+	return canFetchMore() || !children.isEmpty();
+}
+
+/*
+ * Check if the node is an .ex block that hasn't been decoded yet.
+ */
+bool NavigatorModel::Node::canFetchMore()
+{
+	if (node.type != NavigatorNode::ExBlockNode)
+		return false;
+	if (node.exBlock.loaded || node.exBlock.columnar)
+		return false;
+	uint32_t type = node.exBlock.reader->blocks[node.exBlock.i].type;
+	return type == EX_TABLE || type == EX_LIST || type == EX_TREE;
+}
+
 QVariant NavigatorModel::Node::data(int column) const
 {
 	if (column == 0) {
@@ -768,10 +846,10 @@ QVariant NavigatorModel::Node::data(int column) const
 	return QVariant();
 }
 
-NavigatorModel *NavigatorModel::fromExFile(std::shared_ptr<struct ex> ex, QObject *parent)
+NavigatorModel *NavigatorModel::fromExFile(std::shared_ptr<struct ex_reader> ex, QObject *parent)
 {
 	NavigatorModel *model = new NavigatorModel(parent);
-	model->root = Node::fromEx(ex.get());
+	model->root = Node::fromExReader(ex.get());
 	model->exFile = ex;
 	return model;
 }
@@ -857,6 +935,59 @@ int NavigatorModel::columnCount(const QModelIndex &parent) const
         return root->columnCount();
 }
 
+bool NavigatorModel::hasChildren(const QModelIndex &parent) const
+{
+	if (parent.column() > 0)
+		return false;
+	if (!parent.isValid())
+		return root->hasChildren();
+	return static_cast<Node*>(parent.internalPointer())->hasChildren();
+}
+
+bool NavigatorModel::canFetchMore(const QModelIndex &parent) const
+{
+	if (!parent.isValid())
+		return false;
+	return static_cast<Node*>(parent.internalPointer())->canFetchMore();
+}
+
+void NavigatorModel::fetchMore(const QModelIndex &parent)
+{
+	if (!parent.isValid())
+		return;
+	Node *node = static_cast<Node*>(parent.internalPointer());
+	if (!node->canFetchMore())
+		return;
+
+	QVector<Node*> children = node->fetchExBlock();
+	if (children.isEmpty())
+		return;
+	beginInsertRows(parent, 0, children.size() - 1);
+	for (Node *child : children) {
+		node->appendChild(child);
+	}
+	endInsertRows();
+}
+
+/*
+ * Free the children of a collapsed .ex block. They are created again (and
+ * the block decoded again) if it is expanded later.
+ */
+void NavigatorModel::collapse(const QModelIndex &index)
+{
+	if (!index.isValid())
+		return;
+	Node *node = static_cast<Node*>(index.internalPointer());
+	if (node->node.type != NavigatorNode::ExBlockNode || !node->node.exBlock.loaded)
+		return;
+	if (node->childCount() == 0)
+		return;
+
+	beginRemoveRows(index, 0, node->childCount() - 1);
+	node->releaseExBlock();
+	endRemoveRows();
+}
+
 QVariant NavigatorModel::data(const QModelIndex &index, int role) const
 {
         if (!index.isValid())
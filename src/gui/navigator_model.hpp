@@ -25,7 +25,7 @@
 class NavigatorModel : public QAbstractItemModel {
 	Q_OBJECT
 public:
-	static NavigatorModel *fromExFile(std::shared_ptr<struct ex> exFile, QObject *parent = nullptr);
+	static NavigatorModel *fromExFile(std::shared_ptr<struct ex_reader> exFile, QObject *parent = nullptr);
 	static NavigatorModel *fromFlatFile(std::shared_ptr<struct flat> flatFile, QObject *parent = nullptr);
 	static NavigatorModel *fromAinFile(std::shared_ptr<struct ain> ainFile, QObject *parent = nullptr);
 	static NavigatorModel *fromArchive(std::shared_ptr<struct archive> ar, QObject *parent = nullptr);
@@ -40,8 +40,12 @@ public:
 	QModelIndex parent(const QModelIndex &index) const override;
 	int rowCount(const QModelIndex &parent = QModelIndex()) const override;
 	int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+	bool hasChildren(const QModelIndex &parent = QModelIndex()) const override;
+	bool canFetchMore(const QModelIndex &parent) const override;
+	void fetchMore(const QModelIndex &parent) override;
 
 	NavigatorNode *getNode(const QModelIndex &index) const;
+	void collapse(const QModelIndex &index);
 
 private:
 	explicit NavigatorModel(QObject *parent = nullptr)
@@ -49,7 +53,7 @@ private:
 
 	class Node {
 	public:
-		static Node *fromEx(struct ex *exFile);
+		static Node *fromExReader(struct ex_reader *reader);
 		static Node *fromFlat(struct flat *flatFile);
 		static Node *fromAin(struct ain *ainFile);
 		static Node *fromArchive(struct archive *ar);
@@ -59,6 +63,10 @@ private:
 		Node *child(int i);
 		int childCount();
 		int columnCount();
+		bool hasChildren();
+		bool canFetchMore();
+		QVector<Node*> fetchExBlock();
+		void releaseExBlock();
 		QVariant data(int column) const;
 		int row();
 		Node *parent();
@@ -73,6 +81,7 @@ private:
 		static Node *fromExRow(int index, struct ex_table *table,
 				struct ex_field *fields, unsigned nFields);
 		static Node *fromExColumn(struct ex_value *value, struct ex_field *field);
+		static Node *fromExBlock(struct ex_reader *reader, unsigned i);
 		static Node *fromFlatTimeline(struct flat_timeline *tl, int version);
 		static Node *fromFlatLibrary(struct flat_library *lib, int version);
 		static Node *fromAinItem(struct ain *ain, int i, NavigatorNode::NodeType type);
@@ -88,7 +97,7 @@ private:
 		static Node *makeIndexNode(const char *name, int index);
 		static Node *makeCGNode(struct string *name, const uint8_t *data, size_t size);
 		void appendExValueChildren(struct ex_value *value);
-		void appendExFileChildren(struct ex *exFile);
+		void appendExReaderChildren(struct ex_reader *reader);
 		void appendFlatFileChildren(struct flat *flat);
 		void appendFlatKeyDataGraphic(struct flat_key_data_graphic* key, int version);
 		void appendFlatKeyFrameGraphic(struct flat_key_frame_graphic* key, int version);
@@ -100,7 +109,7 @@ private:
 		Node *parentNode;
 	};
 	Node *root;
-	std::shared_ptr<struct ex> exFile;
+	std::shared_ptr<struct ex_reader> exFile;
 	std::shared_ptr<struct flat> flatFile;
 	std::shared_ptr<struct ain> ainFile;
 	std::shared_ptr<struct archive> arFile;
@@ -107,6 +107,7 @@ QVector<FileFormat> NavigatorNode::getSupportedFormats() const
 	case ExStringKeyValueNode:
 	case ExIntKeyValueNode:
 	case ExRowNode:
+	case ExBlockNode:
 		return QVector<FileFormat>({FileFormat::TXTEX});
 	case CGNode:
 		return getSupportedConversionFormats(cgTypeToFileFormat(cg.type));
@@ -263,6 +264,15 @@ bool NavigatorNode::write(struct port *port, FileFormat format) const
 		set_encodings("UTF-8", "UTF-8");
 		ex_dump_table_row(port, exRow.t, exRow.i);
 		return true;
+	case ExBlockNode:
+		if (format != FileFormat::TXTEX)
+			return false;
+		set_encodings("UTF-8", "UTF-8");
+		if (!GAlice::acquireExColumns(exBlock.reader, exBlock.i))
+			GAlice::acquireExBlock(exBlock.reader, exBlock.i);
+		ex_dump_reader_block(port, exBlock.reader, exBlock.i);
+		GAlice::releaseExBlock(exBlock.reader, exBlock.i);
+		return true;
 	case CGNode:
 		return convertFormatBytes(port, cg.data, cg.size,
 				cgTypeToFileFormat(cg.type), format);
@@ -314,6 +324,10 @@ void NavigatorNode::open(bool newTab) const
 	case ExRowNode:
 		// TODO
 		break;
+	case ExBlockNode:
+		GAlice::openExBlock(QString::fromUtf8(exBlock.name->text), exBlock.reader,
+				exBlock.i, newTab);
+		break;
 	case CGNode:
 		GAlice::openImage(QString::fromUtf8(cg.name->text), cg.data, cg.size);
 		break;
@@ -395,6 +409,8 @@ QString NavigatorNode::getName() const
 		return "[" + QString::number(exKV.key.i) + "]";
 	case ExRowNode:
 		return exRowName(exRow.t, exRow.i);
+	case ExBlockNode:
+		return QString::fromUtf8(exBlock.name->text);
 	case FlatTimelineNode:
 		return sjis_string_to_qstring(flat_timeline->name);
 	case FlatLibraryNode:
@@ -436,12 +452,15 @@ QVariant NavigatorNode::getType() const
 			return ex_strtype(exKV.value->type);
 		case ExRowNode:
 			return "row";
+		case ExBlockNode:
+			return ex_strtype(exBlock.reader->blocks[exBlock.i].type);
 	}
 	return QVariant();
 }
 
 QVariant NavigatorNode::getValue() const
 {
+	struct ex_value *value;
 	switch (type) {
 	case RootNode:
 		return "Value";
@@ -469,6 +488,18 @@ QVariant NavigatorNode::getValue() const
 		default:        break;
 		}
 		break;
+	case ExBlockNode:
+		// scalar blocks are acquired when the node is created
+		if (!exBlock.loaded)
+			break;
+		value = &ex_reader_block(exBlock.reader, exBlock.i)->val;
+		switch (value->type) {
+		case EX_INT:    return value->i;
+		case EX_FLOAT:  return value->f;
+		case EX_STRING: return QString::fromUtf8(value->s->text);
+		default:        break;
+		}
+		break;
 	case KVNode:
 		switch (kv.type) {
 		case ValueType::Int:
@@ -41,6 +41,7 @@ public:
 		ExStringKeyValueNode,
 		ExIntKeyValueNode,
 		ExRowNode,
+		ExBlockNode,
 		FlatTimelineNode,
 		FlatLibraryNode,
 		KVNode,
@@ -89,6 +90,14 @@ public:
 			unsigned i;
 			struct ex_table *t;
 		} exRow;
+		// ExBlockNode
+		struct {
+			struct ex_reader *reader;
+			unsigned i;
+			struct string *name;
+			bool loaded;   // block acquired (see GAlice::acquireExBlock)
+			bool columnar; // homogeneous table (no child nodes)
+		} exBlock;
 		struct flat_timeline *flat_timeline;
 		struct flat_library *flat_library;
 		struct talt_entry *flat_talt;
@@ -126,7 +135,7 @@ public:
 			struct archive_data *data;
 			NodeFileType type;
 			union {
-				struct ex *ex;
+				struct ex_reader *ex;
 				struct archive *ar;
 				struct flat *flat;
 			};
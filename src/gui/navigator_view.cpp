@@ -32,6 +32,7 @@ NavigatorView::NavigatorView(NavigatorModel *model, QWidget *parent)
 {
         setModel(model);
 	connect(this, &QTreeView::activated, this, &NavigatorView::requestOpen);
+	connect(this, &QTreeView::collapsed, model, &NavigatorModel::collapse);
 }
 
 NavigatorView::~NavigatorView()
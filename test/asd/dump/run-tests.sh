@@ -0,0 +1,107 @@
+#!/usr/bin/env bash
+
+cd $(dirname "$0")
+
+ALICE="${ALICE:-alice}"
+EXPECT="$(pwd)/expect"
+TMP="$(mktemp -d)"
+
+# build the test saves from their JSON
+for f in global resume badtype; do
+    if ! $ALICE asd build -o "$TMP/$f.asd" "$f.json"; then
+        echo "failed to build $f.asd"
+        rm -rf "$TMP"
+        exit 1
+    fi
+done
+cd "$TMP"
+
+# run 'asd dump --batch' and compare its output with a golden file
+function run_test {
+    local name="$1" status="$2"
+    shift 2
+    $ALICE asd dump --batch -j 2 -o "$name.ndjson" "$@" 2> "$name.log"
+    local s=$?
+    if [ $s != $status ]; then
+        echo "$name: exit status $s, expected $status"
+        cat "$name.log"
+        return 1
+    fi
+    if ! cmp -s "$name.ndjson" "$EXPECT/$name.ndjson"; then
+        echo "$name: output differs:"
+        diff "$EXPECT/$name.ndjson" "$name.ndjson"
+        return 1
+    fi
+    echo "$name test passed"
+    return 0
+}
+
+function test_batch {
+    run_test batch 1 global.asd resume.asd badtype.asd
+}
+
+function test_globals {
+    run_test globals 0 --globals g_count,g_name global.asd
+}
+
+function test_struct_types {
+    run_test struct-types 0 --struct-types Pos,5 global.asd resume.asd
+}
+
+function test_heap_kinds {
+    run_test heap-kinds 0 --heap-kinds string,delegate resume.asd \
+        && run_test heap-kinds-none 0 --heap-kinds none resume.asd
+}
+
+function test_comments_only {
+    run_test comments-only 0 --comments-only resume.asd
+}
+
+function test_error {
+    echo "not a save file" > bad.asd
+    local OUT
+    OUT="$($ALICE asd dump --batch global.asd bad.asd missing.asd 2> /dev/null)"
+    if [ $? != 1 ]; then
+        echo "error: failure not reported in exit status"
+        return 1
+    fi
+    local lines
+    mapfile -t lines <<< "$OUT"
+    if [ ${#lines[@]} != 3 ] \
+        || [ "${lines[0]}" != "$(sed -n 1p "$EXPECT/batch.ndjson")" ] \
+        || [[ "${lines[1]}" != '{"file":"bad.asd","error":"'*'"}' ]] \
+        || [[ "${lines[2]}" != '{"file":"missing.asd","error":"'*'"}' ]]; then
+        echo "error: unexpected output:"
+        echo "$OUT"
+        return 1
+    fi
+
+    # a single save is an error as a whole
+    if $ALICE asd dump -o /dev/null badtype.asd 2> /dev/null; then
+        echo "error: unrepresentable value not reported"
+        return 1
+    fi
+
+    echo "error test passed"
+    return 0
+}
+
+FAILED=0
+NTESTS=6
+
+test_batch || FAILED=$((FAILED+1))
+test_globals || FAILED=$((FAILED+1))
+test_struct_types || FAILED=$((FAILED+1))
+test_heap_kinds || FAILED=$((FAILED+1))
+test_comments_only || FAILED=$((FAILED+1))
+test_error || FAILED=$((FAILED+1))
+
+echo Passed: $((NTESTS - FAILED))/$NTESTS
+echo Failed: $FAILED/$NTESTS
+
+cd /
+rm -rf "$TMP"
+
+if (( FAILED > 0 )); then
+    exit 1
+fi
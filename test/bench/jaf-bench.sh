@@ -0,0 +1,102 @@
+#!/usr/bin/env bash
+#
+# Compiler benchmark: generates a synthetic .jaf project and records the time
+# spent in each jaf_build pass.
+#
+# Usage: jaf-bench.sh [scale] [results-file]
+#
+# The project size grows linearly with the scale factor (default: 1, which
+# generates ~2000 functions). One JSON object is appended to the results file
+# (default: jaf-bench.jsonl) per run, so results can be compared over time.
+
+SCALE="${1:-1}"
+RESULTS="${2:-jaf-bench.jsonl}"
+ALICE="${ALICE:-alice}"
+
+NR_FUNCTIONS=$((2000 * SCALE))
+NR_STRUCTS=$((50 * SCALE))
+NR_STRINGS=$((2000 * SCALE))
+NR_MESSAGES=$((2000 * SCALE))
+NR_HLL=$((200 * SCALE))
+
+WORKDIR="$(mktemp -d)"
+trap 'rm -rf "$WORKDIR"' EXIT
+
+JAF="$WORKDIR/bench.jaf"
+HLL="$WORKDIR/Bench.hll"
+
+# HLL library declarations
+for ((i = 0; i < NR_HLL; i++)); do
+    echo "int Fun$i(int a, int b);"
+done > "$HLL"
+
+{
+    echo "int result = 0;"
+    echo
+
+    # nested struct hierarchy: each struct contains the previous one
+    echo "struct S0 { int v; int get() { return v; } };"
+    for ((i = 1; i < NR_STRUCTS; i++)); do
+        echo "struct S$i { S$((i-1)) inner; int v; int get() { return v + inner.get(); } };"
+    done
+    echo
+
+    # string table
+    for ((i = 0; i < NR_STRINGS; i++)); do
+        echo "string str$i = \"string constant number $i\";"
+    done
+    echo
+
+    # message table
+    echo "void message(int n, int total, string msg) { result = result + 1; }"
+    echo "void messages(void)"
+    echo "{"
+    for ((i = 0; i < NR_MESSAGES; i++)); do
+        echo "	'Message number $i';"
+    done
+    echo "}"
+    echo
+
+    # functions
+    echo "int fun0(int a, int b) { return a + b; }"
+    for ((i = 1; i < NR_FUNCTIONS; i++)); do
+        cat <<EOF
+int fun$i(int a, int b)
+{
+	int x = fun$((i-1))(a, b);
+	string s = str$((i % NR_STRINGS));
+	for (int j = 0; j < a; j++) {
+		if (x > b)
+			x -= Bench.Fun$((i % NR_HLL))(j, b);
+		else
+			x += s.Length();
+	}
+	return x;
+}
+EOF
+    done
+    echo
+
+    echo "int main()"
+    echo "{"
+    echo "	S$((NR_STRUCTS-1)) s;"
+    echo "	messages();"
+    echo "	return fun$((NR_FUNCTIONS-1))(1, 2) + s.get();"
+    echo "}"
+} > "$JAF"
+
+PROFILE="$WORKDIR/profile.json"
+if ! "$ALICE" ain edit --jaf "$JAF" --hll "$HLL" -o "$WORKDIR/bench.ain" \
+        --profile "$PROFILE" --silent; then
+    echo compile failed
+    exit 1
+fi
+
+COMMIT="$(git -C "$(dirname "$0")" rev-parse --short HEAD 2>/dev/null || echo unknown)"
+printf '{"date":"%s","commit":"%s","scale":%d,"functions":%d,"structs":%d,"strings":%d,"messages":%d,"hll_functions":%d,"profile":%s}\n' \
+    "$(date -u +%Y-%m-%dT%H:%M:%SZ)" "$COMMIT" "$SCALE" \
+    "$NR_FUNCTIONS" "$NR_STRUCTS" "$NR_STRINGS" "$NR_MESSAGES" "$NR_HLL" \
+    "$(tr -d '\n\t' < "$PROFILE")" >> "$RESULTS"
+
+# human-readable summary
+tr -d '\n\t' < "$PROFILE" | grep -o '"name":"[^"]*"\|"wall":[0-9.e+-]*' | paste - -
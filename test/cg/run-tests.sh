@@ -0,0 +1,179 @@
+#!/usr/bin/env bash
+
+cd $(dirname "$0")
+
+ALICE="${ALICE:-alice}"
+TMP="$(mktemp -d)"
+CACHE="$TMP/cache"
+
+# escape a path the same way as GLib's g_filename_to_uri
+function uri_escape {
+    local LC_ALL=C s="$1" out="" c i
+    for ((i = 0; i < ${#s}; i++)); do
+        c="${s:i:1}"
+        case "$c" in
+            [a-zA-Z0-9._~!\$\&\'\(\)*+,\;=:@/-]) out+="$c" ;;
+            *) out+=$(printf '%%%02X' "'$c") ;;
+        esac
+    done
+    printf '%s' "$out"
+}
+
+# path of the cached thumbnail for a file (see the thumbnail managing standard)
+function cache_path {
+    local uri="file://$(uri_escape "$(realpath "$2")")"
+    printf '%s/%s/%s.png' "$CACHE" "$1" "$(printf '%s' "$uri" | md5sum | cut -d' ' -f1)"
+}
+
+# width and height of a PNG, from the IHDR chunk
+function png_size {
+    od -An -tu1 -j16 -N8 "$1" | awk '{ print $1*16777216+$2*65536+$3*256+$4 "x" $5*16777216+$6*65536+$7*256+$8 }'
+}
+
+function test_thumbnail_cache {
+    local SRC="$TMP/a dir/テスト #1.png"
+    mkdir -p "$TMP/a dir"
+    cp test.png "$SRC"
+
+    local EXPECTED="$(cache_path normal "$SRC")"
+    local OUT="$(echo "$SRC" | $ALICE cg thumbnail --batch --cache-dir "$CACHE" -s 128)"
+    if [ "$OUT" != "$EXPECTED" ]; then
+        echo "thumbnail cache: got '$OUT', expected '$EXPECTED'"
+        return 1
+    fi
+    if [ ! -f "$EXPECTED" ]; then
+        echo "thumbnail cache: $EXPECTED not written"
+        return 1
+    fi
+    if [ "$(png_size "$EXPECTED")" != 128x64 ]; then
+        echo "thumbnail cache: wrong thumbnail size: $(png_size "$EXPECTED")"
+        return 1
+    fi
+    if ! grep -aqF "file://$(uri_escape "$(realpath "$SRC")")" "$EXPECTED"; then
+        echo "thumbnail cache: Thumb::URI missing"
+        return 1
+    fi
+
+    # an up to date thumbnail is reused (also when given as a file:// URI)
+    touch -d @1000000000 "$EXPECTED"
+    OUT="$(echo "file://$(uri_escape "$(realpath "$SRC")")" | $ALICE cg thumbnail --batch --cache-dir "$CACHE" -s 100)"
+    if [ "$OUT" != "$EXPECTED" ] || [ "$(stat -c %Y "$EXPECTED")" != 1000000000 ]; then
+        echo "thumbnail cache: cached thumbnail not reused"
+        return 1
+    fi
+
+    # ...and regenerated when the file changes
+    touch -d @1100000000 "$SRC"
+    OUT="$(echo "$SRC" | $ALICE cg thumbnail --batch --cache-dir "$CACHE" -s 128)"
+    if [ "$OUT" != "$EXPECTED" ] || [ "$(stat -c %Y "$EXPECTED")" == 1000000000 ]; then
+        echo "thumbnail cache: stale thumbnail not regenerated"
+        return 1
+    fi
+
+    # thumbnails aren't upscaled
+    EXPECTED="$(cache_path large "$SRC")"
+    OUT="$(echo "$SRC" | $ALICE cg thumbnail --batch --cache-dir "$CACHE" -s 256)"
+    if [ "$OUT" != "$EXPECTED" ] || [ "$(png_size "$EXPECTED")" != 160x80 ]; then
+        echo "thumbnail cache: wrong large thumbnail '$OUT' ($(png_size "$EXPECTED"))"
+        return 1
+    fi
+
+    echo "thumbnail cache test passed"
+    return 0
+}
+
+function test_thumbnail_order {
+    local INPUTS=() EXPECTED="" i
+    echo "not a CG" > "$TMP/bad.png"
+    for ((i = 0; i < 20; i++)); do
+        cp test.png "$TMP/$i.png"
+        INPUTS+=("$TMP/$i.png")
+        EXPECTED+="$(cache_path normal "$TMP/$i.png")"$'\n'
+        if [ $i == 7 ]; then
+            INPUTS+=("$TMP/bad.png" "$TMP/missing.png")
+            EXPECTED+=$'\n\n'
+        fi
+    done
+
+    local OUT="$(printf '%s\n' "${INPUTS[@]}" | $ALICE cg thumbnail --batch -j 4 --cache-dir "$CACHE" -s 128; echo .)"
+    if [ "$OUT" != "$EXPECTED." ]; then
+        echo "thumbnail order: output differs:"
+        diff <(echo "$EXPECTED.") <(echo "$OUT")
+        return 1
+    fi
+    if [ ! -f "$CACHE/fail/alice-tools/$(basename "$(cache_path normal "$TMP/bad.png")")" ]; then
+        echo "thumbnail order: failure not recorded"
+        return 1
+    fi
+
+    echo "thumbnail order test passed"
+    return 0
+}
+
+function test_convert_batch {
+    local IN="$TMP/convert" OUT="$TMP/convert-out"
+    mkdir -p "$IN/sub" "$IN/other"
+    cp test.png "$IN/a.png"
+    cp test.png "$IN/sub/b.png"
+    touch -d @1000000000 "$IN/a.png" "$IN/sub/b.png"
+
+    # a.png is given twice but converted once
+    if ! $ALICE cg convert --batch -j 4 -t qnt -o "$OUT" "$IN/a.png" "$IN" > "$TMP/convert.log" 2>&1; then
+        echo "convert batch: conversion failed"
+        cat "$TMP/convert.log"
+        return 1
+    fi
+    if [ "$(grep -c ' -> ' "$TMP/convert.log")" != 2 ]; then
+        echo "convert batch: expected 2 conversions"
+        cat "$TMP/convert.log"
+        return 1
+    fi
+
+    # batch output matches single file conversion
+    $ALICE cg convert -t qnt test.png "$TMP/single.qnt"
+    for f in a.qnt sub/b.qnt; do
+        if ! cmp -s "$OUT/$f" "$TMP/single.qnt"; then
+            echo "convert batch: $f differs from single file conversion"
+            return 1
+        fi
+    done
+
+    # up to date outputs are skipped
+    $ALICE cg convert --batch -t qnt -o "$OUT" "$IN" > "$TMP/convert.log" 2>&1
+    if ! grep -q "Converted 0 files (2 up to date, 0 failed)" "$TMP/convert.log"; then
+        echo "convert batch: up to date outputs not skipped"
+        cat "$TMP/convert.log"
+        return 1
+    fi
+
+    # two inputs with the same output file are rejected
+    cp test.png "$IN/other/a.png"
+    if $ALICE cg convert --batch -f -t qnt -o "$OUT" "$IN/a.png" "$IN/other/a.png" > "$TMP/convert.log" 2>&1; then
+        echo "convert batch: conflicting outputs not reported"
+        return 1
+    fi
+    if [ "$(grep -c ' -> ' "$TMP/convert.log")" != 1 ]; then
+        echo "convert batch: expected 1 conversion"
+        cat "$TMP/convert.log"
+        return 1
+    fi
+
+    echo "convert batch test passed"
+    return 0
+}
+
+FAILED=0
+NTESTS=3
+
+test_thumbnail_cache || FAILED=$((FAILED+1))
+test_thumbnail_order || FAILED=$((FAILED+1))
+test_convert_batch || FAILED=$((FAILED+1))
+
+echo Passed: $((NTESTS - FAILED))/$NTESTS
+echo Failed: $FAILED/$NTESTS
+
+rm -rf "$TMP"
+
+if (( FAILED > 0 )); then
+    exit 1
+fi
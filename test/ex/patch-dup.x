@@ -0,0 +1,14 @@
+string new = "first";
+
+table 新表 = {
+	{ indexed int Id, int v },
+	{ 1, 10 },
+};
+
+string new = "second";
+
+table 新表 = {
+	{ indexed int Id, int v },
+	{ 1, 11 },
+	{ 2, 20 },
+};
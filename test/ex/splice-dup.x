@@ -0,0 +1,5 @@
+int i = 1;
+string s = "first";
+int i = 2;
+list l = { 1 };
+string s = "second";
@@ -0,0 +1,20 @@
+string s = "Edited";
+
+table 列表 = {
+	{ indexed int Id, string Name, float Weight },
+	{ 2, "zwei", 2.0 },
+	{ 4, "four", 2.5 },
+};
+
+list テストリスト = { 4, 5 };
+
+tree テスト木 = {
+	ノードB = {
+		リスト = (list) { 10 },
+	},
+	ノードC = {
+		葉ノード = "新しい",
+	},
+};
+
+int new = 42;
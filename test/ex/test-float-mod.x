@@ -0,0 +1,7 @@
+float f = 1.50001;
+
+table 浮動表 = {
+	{ indexed int Id, float value },
+	{ 0, 0.25 },
+	{ 1, 100.12501 },
+};
@@ -0,0 +1,96 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "system4.h"
+#include "system4/ex.h"
+#include "system4/string.h"
+#include "alice.h"
+#include "alice/ex.h"
+
+/*
+ * Checks that ex_tree_index_child finds the first child with a given name,
+ * both in small nodes (searched linearly) and in large nodes (indexed).
+ *
+ * Usage: test-index
+ */
+
+static void make_tree(struct ex_tree *tree, uint32_t nr_children)
+{
+	*tree = (struct ex_tree) { .name = cstr_to_string("tree"), .is_leaf = false };
+	tree->nr_children = nr_children;
+	tree->children = xcalloc(nr_children, sizeof(struct ex_tree));
+	for (uint32_t i = 0; i < nr_children; i++) {
+		char name[16];
+		// the last child has the same name as the first
+		snprintf(name, sizeof(name), "n%u", i+1 < nr_children ? i : 0);
+		tree->children[i] = (struct ex_tree) {
+			.name = cstr_to_string(name),
+			.is_leaf = true,
+			.leaf = {
+				.name = cstr_to_string(name),
+				.value = { .type = EX_INT, .i = i },
+			},
+		};
+	}
+}
+
+static void free_tree(struct ex_tree *tree)
+{
+	for (uint32_t i = 0; i < tree->nr_children; i++) {
+		free_string(tree->children[i].name);
+		free_string(tree->children[i].leaf.name);
+	}
+	free(tree->children);
+	free_string(tree->name);
+}
+
+static bool run_test(struct ex_tree_index *index, uint32_t nr_children)
+{
+	printf("Running index test for %u children... ", nr_children);
+	struct ex_tree tree;
+	make_tree(&tree, nr_children);
+
+	bool ok = true;
+	// look up every name twice, so that large nodes are looked up in the index
+	for (int pass = 0; pass < 2; pass++) {
+		for (uint32_t i = 0; i+1 < nr_children; i++) {
+			char name[16];
+			snprintf(name, sizeof(name), "n%u", i);
+			struct ex_tree *child = ex_tree_index_child(index, &tree, name);
+			ok = ok && child == &tree.children[i];
+		}
+		ok = ok && !ex_tree_index_child(index, &tree, "missing");
+	}
+	ok = ok && !ex_tree_index_child(index, &tree.children[0], "n0");
+
+	printf("%s\n", ok ? "OK" : "FAILED");
+	free_tree(&tree);
+	return ok;
+}
+
+int main(void)
+{
+	struct ex_tree_index *index = ex_tree_index_new();
+	int failed = 0;
+	failed += !run_test(index, 4);
+	failed += !run_test(index, 100);
+	ex_tree_index_free(index);
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,34 @@
+int i = 13;
+string s = "Test";
+
+table テスト表 = {
+	{ indexed int Id, string 名前, float value, table sub { int a, int b} },
+	{ 0,    "テスト", 1.5, { { 5, 6 } } },
+	{ 2002, "New",    3.0, { { 1, 2 }, { 3, 4 } } },
+};
+
+table 列表 = {
+	{ indexed int Id, string Name, float Weight },
+	{ 1, "one", 0.5 },
+	{ 2, "two", 2.5 },
+	{ 3, "three", 1.5 },
+};
+
+list テストリスト = { 1, 2, 3 };
+
+tree テスト木 = {
+	ノードA = {
+		リスト = (list) { 0, 4 },
+		子ノード = {
+			葉ノード = "変更",
+		},
+	},
+	表ノード = (table) {
+		{ indexed int idx, int a, int b },
+		{ 0, 4, 8 },
+		{ 1, -8, -16 },
+		{ 2, 16, 32 },
+	},
+};
+
+string new = "New block";
@@ -0,0 +1,162 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "system4.h"
+#include "system4/buffer.h"
+#include "system4/ex.h"
+#include "system4/file.h"
+#include "alice.h"
+#include "alice/ex.h"
+
+/*
+ * Checks that the lazy reader (core/ex/reader.c) decodes every .ex file in
+ * the test/ex directory exactly like libsys4's ex_read does, whether it is
+ * opened from a file or from memory. .txtex files are built into a .ex file
+ * first. Both results are re-encoded and compared byte for byte. Table
+ * blocks in columnar form must also be written back (with ex_write_columns)
+ * exactly as they are stored.
+ *
+ * Usage: test-reader <test/ex directory>
+ */
+
+#define BUILT_EX "test-reader.ex"
+
+static bool check_columns(const char *ex_path)
+{
+	struct ex_reader *r = ex_reader_open(ex_path);
+	if (!r)
+		ALICE_ERROR("ex_reader_open(\"%s\") failed", ex_path);
+
+	bool ok = true;
+	for (uint32_t i = 0; i < r->nr_blocks; i++) {
+		struct ex_columns *c = ex_reader_columns(r, i);
+		if (!c)
+			continue;
+		// the table follows the (padded) block name
+		struct ex_reader_block *b = &r->blocks[i];
+		size_t name_size = 4 + ((b->name_len + 3) & ~3);
+		struct buffer out;
+		buffer_init(&out, xmalloc(128), 128);
+		ex_write_columns(&out, c);
+		ok = ok && out.index == b->size - name_size
+			&& !memcmp(out.buf, r->data + b->off + name_size, out.index);
+		free(out.buf);
+		ex_reader_release(r, i);
+	}
+	ex_reader_close(r);
+	return ok;
+}
+
+static bool run_test(const char *dir, const char *name)
+{
+	char path[1024];
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	printf("Running reader test for %s... ", name);
+
+	const char *ex_path = path;
+	bool built = !strcmp(strrchr(name, '.'), ".x");
+	if (built) {
+		struct ex *ex = ex_parse_file(path);
+		if (!ex)
+			ALICE_ERROR("failed to parse .txtex file: %s", path);
+		ex_write_file(BUILT_EX, ex);
+		ex_free(ex);
+		ex_path = BUILT_EX;
+	}
+
+	// libsys4
+	struct ex *ex = ex_read_file(ex_path);
+	if (!ex)
+		ALICE_ERROR("ex_read_file(\"%s\") failed", ex_path);
+	size_t ex_size;
+	uint8_t *ex_data = ex_write_mem(ex, &ex_size);
+	ex_free(ex);
+
+	// ex_reader
+	struct ex_reader *r = ex_reader_open(ex_path);
+	if (!r)
+		ALICE_ERROR("ex_reader_open(\"%s\") failed", ex_path);
+	ex = ex_reader_to_ex(r);
+	ex_reader_close(r);
+	size_t reader_size;
+	uint8_t *reader_data = ex_write_mem(ex, &reader_size);
+	ex_free(ex);
+
+	// ex_reader over a file in memory
+	size_t file_size;
+	uint8_t *file_data = file_read(ex_path, &file_size);
+	r = ex_reader_open_mem(file_data, file_size);
+	if (!r)
+		ALICE_ERROR("ex_reader_open_mem(\"%s\") failed", ex_path);
+	free(file_data);
+	ex = ex_reader_to_ex(r);
+	ex_reader_close(r);
+	size_t mem_size;
+	uint8_t *mem_data = ex_write_mem(ex, &mem_size);
+	ex_free(ex);
+
+	bool columns_ok = check_columns(ex_path);
+
+	if (built)
+		remove(BUILT_EX);
+
+	if (!columns_ok) {
+		printf("FAILED (columns differ)\n");
+		free(ex_data);
+		free(reader_data);
+		free(mem_data);
+		return false;
+	}
+
+	bool ok = ex_size == reader_size && !memcmp(ex_data, reader_data, ex_size)
+		&& ex_size == mem_size && !memcmp(ex_data, mem_data, ex_size);
+	printf("%s\n", ok ? "OK" : "FAILED (output differs)");
+	free(ex_data);
+	free(reader_data);
+	free(mem_data);
+	return ok;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc != 2) {
+		fprintf(stderr, "Usage: %s <test/ex directory>\n", argv[0]);
+		return 1;
+	}
+	set_input_encoding("UTF-8");
+	set_output_encoding("CP932");
+
+	int nr_tests = 0, failed = 0;
+	char *d_name;
+	UDIR *d = checked_opendir(argv[1]);
+	while ((d_name = readdir_utf8(d)) != NULL) {
+		const char *ext = strrchr(d_name, '.');
+		if (ext && (!strcmp(ext, ".ex") || !strcmp(ext, ".x"))) {
+			nr_tests++;
+			failed += !run_test(argv[1], d_name);
+		}
+		free(d_name);
+	}
+	closedir_utf8(d);
+
+	printf("%d/%d tests passed\n", nr_tests - failed, nr_tests);
+	return failed || !nr_tests ? 1 : 0;
+}
@@ -0,0 +1,132 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "system4.h"
+#include "system4/ex.h"
+#include "system4/file.h"
+#include "alice.h"
+#include "alice/ex.h"
+
+/*
+ * Checks that ex_splice (used by 'ex edit') writes exactly the same file as
+ * decoding the whole .ex file, applying the edit and writing it out again.
+ *
+ * Usage: test-splice <test/ex directory>
+ */
+
+#define BASE_EX "test-splice-base.ex"
+#define SPLICE_EX "test-splice-out.ex"
+#define EDIT_EX "test-splice-ref.ex"
+
+static const char *srcdir;
+
+static struct ex *parse(const char *name)
+{
+	char path[1024];
+	snprintf(path, sizeof(path), "%s/%s", srcdir, name);
+	struct ex *ex = ex_parse_file(path);
+	if (!ex)
+		ALICE_ERROR("failed to parse .txtex file: %s", path);
+	return ex;
+}
+
+static uint8_t *read_output(const char *path, size_t *size)
+{
+	uint8_t *data = file_read(path, size);
+	if (!data)
+		ALICE_ERROR("failed to read %s", path);
+	remove(path);
+	return data;
+}
+
+static const char *mode_name(enum ex_edit_mode mode)
+{
+	switch (mode) {
+	case EX_EDIT_APPEND:  return "append";
+	case EX_EDIT_REPLACE: return "replace";
+	case EX_EDIT_PATCH:   return "patch";
+	}
+	return "?";
+}
+
+static bool run_test(const char *base_name, const char *edit_name, enum ex_edit_mode mode)
+{
+	printf("Running splice test (%s) for %s + %s... ", mode_name(mode), base_name, edit_name);
+
+	struct ex *base = parse(base_name);
+	ex_write_file(BASE_EX, base);
+	ex_free(base);
+
+	// ex_splice
+	struct ex_reader *r = ex_reader_open(BASE_EX);
+	if (!r)
+		ALICE_ERROR("ex_reader_open(\"%s\") failed", BASE_EX);
+	struct ex *edit = parse(edit_name);
+	size_t flat_size;
+	uint8_t *flat = ex_splice(r, edit, mode, &flat_size);
+	FILE *out = checked_fopen(SPLICE_EX, "wb");
+	ex_write_flat(out, flat, flat_size);
+	fclose(out);
+	ex_reader_close(r);
+	ex_free(edit);
+
+	// ex_read_file + ex_edit + ex_write
+	struct ex *ex = ex_read_file(BASE_EX);
+	if (!ex)
+		ALICE_ERROR("ex_read_file(\"%s\") failed", BASE_EX);
+	edit = parse(edit_name);
+	ex_edit(ex, edit, mode);
+	ex_write_file(EDIT_EX, ex);
+	ex_free(edit);
+	ex_free(ex);
+
+	size_t splice_size, edit_size;
+	uint8_t *splice_data = read_output(SPLICE_EX, &splice_size);
+	uint8_t *edit_data = read_output(EDIT_EX, &edit_size);
+	remove(BASE_EX);
+
+	bool ok = splice_size == edit_size && !memcmp(splice_data, edit_data, edit_size);
+	printf("%s\n", ok ? "OK" : "FAILED (output differs)");
+	free(splice_data);
+	free(edit_data);
+	return ok;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc != 2) {
+		fprintf(stderr, "Usage: %s <test/ex directory>\n", argv[0]);
+		return 1;
+	}
+	srcdir = argv[1];
+	set_input_encoding("UTF-8");
+	set_output_encoding("CP932");
+
+	int failed = 0;
+	failed += !run_test("test.x", "splice.x", EX_EDIT_APPEND);
+	failed += !run_test("test.x", "splice.x", EX_EDIT_REPLACE);
+	failed += !run_test("test.x", "test-mod.x", EX_EDIT_REPLACE);
+	failed += !run_test("test.x", "patch-dup.x", EX_EDIT_PATCH);
+	// base blocks with duplicate names (falls back to decoding the whole file)
+	failed += !run_test("splice-dup.x", "splice.x", EX_EDIT_APPEND);
+	failed += !run_test("splice-dup.x", "splice.x", EX_EDIT_REPLACE);
+	return failed ? 1 : 0;
+}
@@ -8,6 +8,13 @@ table テスト表 = {
 	{ 1001, "Test",   2.1, { { 7, 8 } } },
 };
 
+table 列表 = {
+	{ indexed int Id, string Name, float Weight },
+	{ 1, "one", 0.5 },
+	{ 2, "two", 1.0 },
+	{ 3, "three", 1.5 },
+};
+
 list テストリスト = { 1, 2, 3 };
 
 tree テスト木 = {
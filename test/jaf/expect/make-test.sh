@@ -2,12 +2,19 @@
 
 function usage {
     echo Usage:
-    echo "    $0 <jaf-file>"
-    echo "    $0 <jaf-file> <version>"
-    echo "    $0 <jaf-file> <out-name> <version>"
-    echo "    $0 <jaf-file> <jam-file> <json-file> <version>"
+    echo "    $0 [--optimize] <jaf-file>"
+    echo "    $0 [--optimize] <jaf-file> <version>"
+    echo "    $0 [--optimize] <jaf-file> <out-name> <version>"
+    echo "    $0 [--optimize] <jaf-file> <jam-file> <json-file> <version>"
 }
 
+# extra flags for the compiler
+JAF_FLAGS=
+if [ "$1" = "--optimize" ]; then
+    JAF_FLAGS="$1"
+    shift
+fi
+
 if [ "$#" -eq 1 ]; then
     JAF_FILE="$1"
     JAM_FILE="${JAF_FILE%.*}.jam"
@@ -52,7 +59,7 @@ if [[ "${JSON_FILE##*.}" != "json" ]]; then
 fi
 
 AIN_FILE=$(mktemp --suffix=.ain)
-if ! ${ALICE:-alice} ain edit --jaf "$JAF_FILE" -o "$AIN_FILE" --ain-version "$VERSION" --silent; then
+if ! ${ALICE:-alice} ain edit --jaf "$JAF_FILE" $JAF_FLAGS -o "$AIN_FILE" --ain-version "$VERSION" --silent; then
     echo compile failed
     rm -f "$AIN_FILE"
     exit 1;
@@ -13,6 +13,11 @@ for f in *.json; do
     VERSION=$(jq '.version' "$f")
     JAFFILE=${f%%.*}.jaf
     JAMFILE=${f%.json}.jam
-    ./make-test.sh "$JAFFILE" "$JAMFILE" "$f" "$VERSION"
+    # *.opt.json files are the expected output with --optimize
+    if [[ "$f" == *.opt.json ]]; then
+        ./make-test.sh --optimize "$JAFFILE" "$JAMFILE" "$f" "$VERSION"
+    else
+        ./make-test.sh "$JAFFILE" "$JAMFILE" "$f" "$VERSION"
+    fi
 done
 
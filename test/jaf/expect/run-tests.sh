@@ -37,6 +37,8 @@ run_test option.jaf 12
 run_test option.v14.jaf 14
 run_test enum.jaf 12
 run_test enum.jaf enum.v14 14
+run_test optimize.jaf
+run_test --optimize optimize.jaf optimize.opt 4
 
 echo Passed: $((NTESTS - FAILED))/$NTESTS
 echo Failed: $FAILED/$NTESTS
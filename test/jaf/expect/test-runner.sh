@@ -1,5 +1,12 @@
 #!/usr/bin/env bash
 
+# extra flags for the compiler
+JAF_FLAGS=
+if [ "$1" = "--optimize" ]; then
+    JAF_FLAGS="$1"
+    shift
+fi
+
 if [ "$#" -eq 1 ]; then
     JAF_FILE="$1"
     JAM_FILE="${JAF_FILE%.*}.jam"
@@ -25,11 +32,11 @@ else
     exit 1
 fi
 
-printf "Running test $JAF_FILE (v$VERSION)... "
+printf "Running test $JAF_FILE ${JAF_FLAGS:+$JAF_FLAGS }(v$VERSION)... "
 
 # compile jaf file
 ACTUAL_AIN="$(mktemp --suffix=.ain)"
-if ! ${ALICE:-alice} ain edit --jaf "$JAF_FILE" -o "$ACTUAL_AIN" --ain-version "$VERSION" --silent; then
+if ! ${ALICE:-alice} ain edit --jaf "$JAF_FILE" $JAF_FLAGS -o "$ACTUAL_AIN" --ain-version "$VERSION" --silent; then
     echo compile failed
     rm -f "$ACTUAL_AIN"
     exit 1
@@ -131,5 +131,11 @@ cd $(dirname "$0")
 
 ./test-runner.sh const-local.jaf
 ./test-runner.sh const-global.jaf
+./test-runner.sh const-fold.jaf
+./test-runner.sh const-forward.jaf
 
 ./test-runner.sh goto.jaf
+
+# optimizations
+./test-runner.sh dead-code.jaf
+./test-runner.sh dead-code.jaf --optimize
@@ -1,11 +1,12 @@
 #!/bin/sh
 
 TEST_FILE="$1"
+shift
 AIN_FILE="$(mktemp --suffix=.ain)"
 
-printf "Running test $TEST_FILE... "
+printf "Running test $TEST_FILE $*... "
 
-if ! alice ain edit --jaf "$TEST_FILE" -o "$AIN_FILE" --silent; then
+if ! alice ain edit --jaf "$TEST_FILE" "$@" -o "$AIN_FILE" --silent; then
     echo compile failed
     rm -f "$AIN_FILE"
     exit 1
@@ -0,0 +1,87 @@
+#!/usr/bin/env bash
+
+cd $(dirname "$0")
+
+# The log and outputs of a parallel build must match a sequential build. The
+# .txtex files are parsed in a group nested inside the project's own group.
+function test_order {
+    rm -rf out
+    if ! ${ALICE:-alice} project build -j 1 jobs.pje > seq.log; then
+        echo order: sequential build failed
+        return 1
+    fi
+    mv out seq
+
+    for j in 2 8 8 8; do
+        rm -rf out
+        if ! ${ALICE:-alice} project build -j $j jobs.pje > par.log; then
+            echo order: parallel build failed "(-j $j)"
+            return 1
+        fi
+        if ! diff seq.log par.log; then
+            echo order: log differs "(-j $j)"
+            return 1
+        fi
+        for f in jobs.ain jobs.ex; do
+            if ! cmp -s "seq/$f" "out/$f"; then
+                echo order: $f differs "(-j $j)"
+                return 1
+            fi
+        done
+    done
+    echo order test passed
+    return 0
+}
+
+# A failing job stops the build. The log is written up to and including the
+# failing job, and nothing after it.
+function test_error_job {
+    rm -rf out
+    if ${ALICE:-alice} project build -j 8 error-ex.pje > err.log 2> /dev/null; then
+        echo error: build succeeded with a bad .txtex file
+        return 1
+    fi
+    if ! grep -qF "bad.txtex" err.log; then
+        echo error: log of failing job missing
+        return 1
+    fi
+    if grep -qF "two.txtex" err.log || grep -q "^EX " err.log; then
+        echo error: log written past the failing job
+        return 1
+    fi
+    echo error test passed
+    return 0
+}
+
+# A compile error exits outside of the job error handler; the buffered log
+# must still be written.
+function test_error_jaf {
+    rm -rf out
+    if ${ALICE:-alice} project build -j 8 error-jaf.pje > err.log 2> err.txt; then
+        echo error-jaf: build succeeded with a bad .jaf file
+        return 1
+    fi
+    if ! grep -q "^AIN " err.log || ! grep -q "undefined_variable\|error" err.txt; then
+        echo error-jaf: log or error message missing
+        return 1
+    fi
+    echo error-jaf test passed
+    return 0
+}
+
+FAILED=0
+NTESTS=3
+
+test_order || FAILED=$((FAILED+1))
+test_error_job || FAILED=$((FAILED+1))
+test_error_jaf || FAILED=$((FAILED+1))
+
+echo Passed: $((NTESTS - FAILED))/$NTESTS
+echo Failed: $FAILED/$NTESTS
+
+rm -rf out seq
+rm -f seq.log par.log err.log err.txt
+
+if (( FAILED > 0 )); then
+    exit 1
+fi
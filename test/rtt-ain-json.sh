@@ -0,0 +1,39 @@
+#!/usr/bin/env bash
+
+SRC_AIN="$1"
+SRC_JSON=$(mktemp)
+DST_JSON=$(mktemp)
+DST_AIN=$(mktemp "${SRC_AIN}.XXXXXX")
+
+cleanup() {
+    rm -f "$SRC_JSON" "$DST_JSON" "$DST_AIN"
+}
+
+printf "Running JSON RTT for $SRC_AIN... "
+
+if ! ${ALICE:-alice} ain dump --json -o "$SRC_JSON" "$SRC_AIN"; then
+    echo dump failed
+    cleanup
+    exit 1
+fi
+
+if ! ${ALICE:-alice} ain edit --json "$SRC_JSON" -o "$DST_AIN" "$SRC_AIN"; then
+    echo edit failed
+    cleanup
+    exit 1
+fi
+
+if ! ${ALICE:-alice} ain dump --json -o "$DST_JSON" "$DST_AIN"; then
+    echo dump of rebuilt .ain failed
+    cleanup
+    exit 1
+fi
+
+if ! cmp -s "$SRC_JSON" "$DST_JSON"; then
+    echo "FAIL: JSON dumps differ"
+    cleanup
+    exit 1
+fi
+
+echo ok
+cleanup
@@ -0,0 +1,64 @@
+#!/usr/bin/env bash
+
+SRC_ASD="$1"
+SRC_JSON=$(mktemp)
+DST_JSON=$(mktemp)
+SORTED_JSON=$(mktemp)
+SRC_RAW=$(mktemp)
+DST_RAW=$(mktemp)
+DST_ASD=$(mktemp "${SRC_ASD}.XXXXXX")
+
+cleanup() {
+    rm -f "$SRC_JSON" "$DST_JSON" "$SORTED_JSON" "$SRC_RAW" "$DST_RAW" "$DST_ASD"
+}
+
+# rebuild $1 into $DST_ASD and compare the decoded save with the original
+build_and_compare() {
+    if ! ${ALICE:-alice} asd build -o "$DST_ASD" "$1"; then
+        echo build failed
+        cleanup
+        exit 1
+    fi
+    if ! ${ALICE:-alice} asd dump -d -o "$SRC_RAW" "$SRC_ASD" || \
+       ! ${ALICE:-alice} asd dump -d -o "$DST_RAW" "$DST_ASD"; then
+        echo decode failed
+        cleanup
+        exit 1
+    fi
+    if ! cmp -s "$SRC_RAW" "$DST_RAW"; then
+        echo "FAIL: decoded save files differ ($2)"
+        cleanup
+        exit 1
+    fi
+}
+
+printf "Running RTT for $SRC_ASD... "
+
+if ! ${ALICE:-alice} asd dump -o "$SRC_JSON" "$SRC_ASD"; then
+    echo dump failed
+    cleanup
+    exit 1
+fi
+
+build_and_compare "$SRC_JSON" "dumped order"
+
+if ! ${ALICE:-alice} asd dump -o "$DST_JSON" "$DST_ASD"; then
+    echo dump of rebuilt save failed
+    cleanup
+    exit 1
+fi
+
+if ! cmp -s "$SRC_JSON" "$DST_JSON"; then
+    echo "FAIL: JSON dumps differ"
+    cleanup
+    exit 1
+fi
+
+# object members may come in any order
+if command -v jq > /dev/null; then
+    jq -S . "$SRC_JSON" > "$SORTED_JSON"
+    build_and_compare "$SORTED_JSON" "sorted keys"
+fi
+
+echo ok
+cleanup
@@ -0,0 +1,52 @@
+#!/usr/bin/env bash
+
+OLD_X="$1"
+NEW_X="$2"
+OLD_EX=$(mktemp)
+NEW_EX=$(mktemp)
+PATCH_X=$(mktemp)
+DST_EX=$(mktemp)
+NEW_DUMP=$(mktemp)
+DST_DUMP=$(mktemp)
+
+cleanup() {
+    rm -f "$OLD_EX" "$NEW_EX" "$PATCH_X" "$DST_EX" "$NEW_DUMP" "$DST_DUMP"
+}
+
+printf "Running diff RTT for $OLD_X -> $NEW_X... "
+
+if ! ${ALICE:-alice} ex build -o "$OLD_EX" "$OLD_X" || \
+   ! ${ALICE:-alice} ex build -o "$NEW_EX" "$NEW_X"; then
+    echo build failed
+    cleanup
+    exit 1
+fi
+
+if ! ${ALICE:-alice} ex diff -o "$PATCH_X" "$OLD_EX" "$NEW_EX"; then
+    echo diff failed
+    cleanup
+    exit 1
+fi
+
+if ! ${ALICE:-alice} ex edit --patch -o "$DST_EX" "$OLD_EX" "$PATCH_X"; then
+    echo patch failed
+    cleanup
+    exit 1
+fi
+
+if ! ${ALICE:-alice} ex compare "$NEW_EX" "$DST_EX"; then
+    echo compare failed
+    cleanup
+    exit 1
+fi
+
+# 'ex compare' tolerates small float differences; the dumps must match exactly
+if ! ${ALICE:-alice} ex dump -o "$NEW_DUMP" "$NEW_EX" || \
+   ! ${ALICE:-alice} ex dump -o "$DST_DUMP" "$DST_EX" || \
+   ! cmp -s "$NEW_DUMP" "$DST_DUMP"; then
+    echo exact compare failed
+    cleanup
+    exit 1
+fi
+
+cleanup
@@ -0,0 +1,68 @@
+#!/usr/bin/env bash
+
+# Split an .ex file into one source file per block and build it as a project.
+# Parallel builds (which parse the sources and write the blocks in parallel)
+# must match a sequential build, and the result must match the original file.
+
+SRC_EX="$1"
+DIR=$(mktemp -d)
+
+fail() {
+    echo "$1"
+    rm -rf "$DIR"
+    exit 1
+}
+
+printf "Running parallel build RTT for $SRC_EX... "
+
+mkdir "$DIR/src"
+if ! ${ALICE:-alice} ex dump --split -o "$DIR/src/blocks.x" "$SRC_EX"; then
+    fail "dump failed"
+fi
+rm "$DIR/src/blocks.x"
+
+# rename the block files (<index>_<name>.x) to <index>.x, so that the project
+# file doesn't depend on the encoding of the block names
+NR_BLOCKS=0
+for f in "$DIR"/src/*.x; do
+    name="${f##*/}"
+    mv "$f" "$DIR/src/${name%%_*}.x"
+    NR_BLOCKS=$((NR_BLOCKS+1))
+done
+
+printf 'int main(void)\n{\n\treturn 0;\n}\n' > "$DIR/src/main.jaf"
+{
+    echo 'ProjectName = "rtt"'
+    echo 'CodeName = "rtt.ain"'
+    echo 'SourceDir = "src"'
+    echo 'OutputDir = "out"'
+    echo 'Source = {'
+    echo '    "main.jaf",'
+    for ((i = 0; i < NR_BLOCKS; i++)); do
+        echo "    \"$i.x\","
+    done
+    echo '}'
+    echo 'ExName = "rtt.ex"'
+} > "$DIR/rtt.pje"
+
+if ! ${ALICE:-alice} project build -j 1 "$DIR/rtt.pje" > /dev/null; then
+    fail "sequential build failed"
+fi
+mv "$DIR/out" "$DIR/seq"
+
+for j in 2 8 8 8; do
+    if ! ${ALICE:-alice} project build -j $j "$DIR/rtt.pje" > /dev/null; then
+        fail "parallel build failed (-j $j)"
+    fi
+    if ! cmp -s "$DIR/seq/rtt.ex" "$DIR/out/rtt.ex"; then
+        fail "FAIL: parallel build differs from sequential build (-j $j)"
+    fi
+    rm -rf "$DIR/out"
+done
+
+if ! ${ALICE:-alice} ex compare "$SRC_EX" "$DIR/seq/rtt.ex"; then
+    fail "compare failed"
+fi
+
+echo ok
+rm -rf "$DIR"
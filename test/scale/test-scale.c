@@ -0,0 +1,211 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "system4.h"
+#include "system4/cg.h"
+#include "alice.h"
+#include "alice/thumbnail.h"
+
+/*
+ * Tests for the bicubic scaler (core/scale.c).
+ */
+
+struct cg *scale_cg_bicubic_scalar(struct cg *in, float scale);
+
+static int nr_tests = 0;
+static int nr_failed = 0;
+
+#define check(cond, ...) \
+	do { \
+		nr_tests++; \
+		if (!(cond)) { \
+			nr_failed++; \
+			printf("FAILED: "); \
+			printf(__VA_ARGS__); \
+			printf("\n"); \
+		} \
+	} while (0)
+
+static uint8_t *pixel(struct cg *cg, int x, int y)
+{
+	return (uint8_t*)cg->pixels + y * cg->metrics.pixel_pitch + x * 4;
+}
+
+static struct cg *make_cg(int w, int h)
+{
+	struct cg *cg = xcalloc(1, sizeof(struct cg));
+	cg->type = ALCG_PNG;
+	cg->metrics.w = w;
+	cg->metrics.h = h;
+	cg->metrics.bpp = 24;
+	cg->metrics.has_pixel = true;
+	cg->metrics.has_alpha = true;
+	cg->metrics.pixel_pitch = w * 4;
+	cg->pixels = xcalloc(w * h, 4);
+	return cg;
+}
+
+static void fill(struct cg *cg, int x0, int y0, int w, int h, uint32_t rgba)
+{
+	for (int y = y0; y < y0 + h; y++) {
+		for (int x = x0; x < x0 + w; x++) {
+			memcpy(pixel(cg, x, y), &rgba, 4);
+		}
+	}
+}
+
+static uint32_t get(struct cg *cg, int x, int y)
+{
+	uint32_t rgba;
+	memcpy(&rgba, pixel(cg, x, y), 4);
+	return rgba;
+}
+
+// deterministic noise, so that every filter tap matters
+static struct cg *make_noise(int w, int h)
+{
+	struct cg *cg = make_cg(w, h);
+	uint32_t state = 0x12345678 ^ (w * 31 + h);
+	uint8_t *p = cg->pixels;
+	for (int i = 0; i < w * h * 4; i++) {
+		state = state * 1664525 + 1013904223;
+		p[i] = state >> 24;
+	}
+	return cg;
+}
+
+static void test_dimensions(void)
+{
+	static const struct { int w, h; float scale; int out_w, out_h; } tests[] = {
+		{ 100, 50,  0.5f,  50, 25 },
+		{ 640, 480, 0.4f,  256, 192 },
+		{ 10,  10,  0.3f,  3,  3 },
+		{ 1000, 7,  0.01f, 10, 1 },
+		{ 3,   2,   4.0f,  12, 8 },
+		{ 1,   1,   0.1f,  1,  1 },
+	};
+	for (unsigned i = 0; i < sizeof(tests)/sizeof(*tests); i++) {
+		struct cg *in = make_noise(tests[i].w, tests[i].h);
+		struct cg *out = scale_cg_bicubic(in, tests[i].scale);
+		check(out->metrics.w == tests[i].out_w && out->metrics.h == tests[i].out_h
+				&& out->metrics.pixel_pitch == out->metrics.w * 4,
+				"%dx%d * %g: got %dx%d, expected %dx%d",
+				tests[i].w, tests[i].h, tests[i].scale,
+				out->metrics.w, out->metrics.h, tests[i].out_w, tests[i].out_h);
+		cg_free(out);
+		cg_free(in);
+	}
+}
+
+static void test_solid(void)
+{
+	static const float scales[] = { 0.1f, 0.3f, 0.5f, 0.77f, 1.0f, 1.5f, 3.0f };
+	for (unsigned i = 0; i < sizeof(scales)/sizeof(*scales); i++) {
+		struct cg *in = make_cg(37, 23);
+		fill(in, 0, 0, 37, 23, 0x80ff4010);
+		struct cg *out = scale_cg_bicubic(in, scales[i]);
+		bool ok = true;
+		for (int y = 0; y < out->metrics.h; y++) {
+			for (int x = 0; x < out->metrics.w; x++) {
+				ok = ok && get(out, x, y) == 0x80ff4010;
+			}
+		}
+		check(ok, "solid color changed at scale %g", scales[i]);
+		cg_free(out);
+		cg_free(in);
+	}
+}
+
+static void test_blocks(void)
+{
+	// each 4x4 block is reduced to a single pixel
+	static const uint32_t colors[3][3] = {
+		{ 0xff0000ff, 0xff00ff00, 0xffff0000 },
+		{ 0x00000000, 0xffffffff, 0x80808080 },
+		{ 0x11223344, 0x55667788, 0x99aabbcc },
+	};
+	struct cg *in = make_cg(12, 12);
+	for (int y = 0; y < 3; y++) {
+		for (int x = 0; x < 3; x++) {
+			fill(in, x * 4, y * 4, 4, 4, colors[y][x]);
+		}
+	}
+	struct cg *out = scale_cg_bicubic(in, 0.25f);
+	for (int y = 0; y < 3; y++) {
+		for (int x = 0; x < 3; x++) {
+			check(get(out, x, y) == colors[y][x], "block (%d,%d): got %08x, expected %08x",
+					x, y, get(out, x, y), colors[y][x]);
+		}
+	}
+	cg_free(out);
+	cg_free(in);
+}
+
+static void test_reduced_edge(void)
+{
+	// 10 pixels are reduced by a factor of 3 to 4 pixels, the last of which
+	// is the (white) right column; the last output pixel is centered near it
+	struct cg *in = make_cg(10, 10);
+	fill(in, 9, 0, 1, 10, 0xffffffff);
+	struct cg *out = scale_cg_bicubic(in, 0.3f);
+	check(get(out, 0, 1) == 0, "left edge: got %08x", get(out, 0, 1));
+	uint8_t *p = pixel(out, out->metrics.w - 1, 1);
+	check(p[0] > 192 && p[0] == p[1] && p[1] == p[2] && p[2] == p[3],
+			"right edge: got %02x%02x%02x%02x", p[3], p[2], p[1], p[0]);
+	cg_free(out);
+	cg_free(in);
+}
+
+static void test_simd(void)
+{
+	static const struct { int w, h; float scale; } tests[] = {
+		{ 64,  48,  0.5f },
+		{ 301, 199, 0.37f },
+		{ 640, 480, 0.4f },
+		{ 1000, 7,  0.01f },
+		{ 17,  13,  2.3f },
+		{ 3,   2,   4.0f },
+		{ 2,   5,   0.9f },
+	};
+	for (unsigned i = 0; i < sizeof(tests)/sizeof(*tests); i++) {
+		struct cg *in = make_noise(tests[i].w, tests[i].h);
+		struct cg *a = scale_cg_bicubic(in, tests[i].scale);
+		struct cg *b = scale_cg_bicubic_scalar(in, tests[i].scale);
+		check(a->metrics.w == b->metrics.w && a->metrics.h == b->metrics.h
+				&& !memcmp(a->pixels, b->pixels, a->metrics.w * a->metrics.h * 4),
+				"%dx%d * %g: SIMD and scalar output differ",
+				tests[i].w, tests[i].h, tests[i].scale);
+		cg_free(a);
+		cg_free(b);
+		cg_free(in);
+	}
+}
+
+int main(void)
+{
+	test_dimensions();
+	test_solid();
+	test_blocks();
+	test_reduced_edge();
+	test_simd();
+	printf("%d/%d tests passed\n", nr_tests - nr_failed, nr_tests);
+	return nr_failed ? 1 : 0;
+}
@@ -8,3 +8,9 @@ for f in $AINDIR/*.ain
 do
     $RTT "$f"
 done
+
+JSON_RTT="$(dirname $0)/rtt-ain-json.sh"
+for f in $AINDIR/*.ain
+do
+    $JSON_RTT "$f"
+done
@@ -0,0 +1,10 @@
+#!/usr/bin/env bash
+
+RTT="$(dirname $0)/rtt-asd.sh"
+ASDDIR="$(dirname $0)/asd"
+
+shopt -s nullglob
+for f in $ASDDIR/*.asd
+do
+    $RTT "$f"
+done
@@ -7,3 +7,30 @@ shopt -s nullglob
 for f in $EXDIR/*.ex; do
     $RTT "$f"
 done
+
+DIFF="$(dirname $0)/rtt-ex-diff.sh"
+$DIFF "$EXDIR/test.x" "$EXDIR/test-mod.x"
+$DIFF "$EXDIR/test-mod.x" "$EXDIR/test.x"
+
+# round-trip a file built from source (exercises the columnar table dumper)
+SRC_EX=$(mktemp --suffix=.ex)
+${ALICE:-alice} ex build -o "$SRC_EX" "$EXDIR/test.x" && $RTT "$SRC_EX"
+rm -f "$SRC_EX"
+
+$DIFF "$EXDIR/test-float.x" "$EXDIR/test-float-mod.x"
+
+# blocks appended by a patch must be merged with later blocks of the same name
+printf "Running patch test for $EXDIR/patch-dup.x... "
+BASE_EX=$(mktemp --suffix=.ex)
+DST_EX=$(mktemp --suffix=.ex)
+DST_X=$(mktemp)
+if ! ${ALICE:-alice} ex build -o "$BASE_EX" "$EXDIR/test.x" || \
+   ! ${ALICE:-alice} ex edit --patch -o "$DST_EX" "$BASE_EX" "$EXDIR/patch-dup.x" || \
+   ! ${ALICE:-alice} ex dump -o "$DST_X" "$DST_EX"; then
+    echo patch failed
+elif [ "$(grep -c '^string new = ' "$DST_X")" != 1 ] || \
+     [ "$(grep -c '^table 新表 = ' "$DST_X")" != 1 ] || \
+     ! grep -q '"second"' "$DST_X"; then
+    echo duplicate blocks
+fi
+rm -f "$BASE_EX" "$DST_EX" "$DST_X"